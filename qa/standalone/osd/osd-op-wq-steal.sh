@@ -0,0 +1,98 @@
+#!/usr/bin/env bash
+#
+# Skewed PG load against the sharded op queue, with and without
+# osd_op_queue_work_stealing.
+#
+# PGs go to op shards by ps % shards, so a pool with 9 PGs on 8
+# single-thread shards puts two PGs on shard 0 and one on each of the
+# others.  Under an even load over the PGs shard 0 backs up with twice
+# the work of the others and caps the throughput; with work stealing
+# the other shards' threads take on its second PG.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Library Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Library Public License for more details.
+#
+
+source $CEPH_ROOT/qa/standalone/ceph-helpers.sh
+
+function run() {
+    local dir=$1
+    shift
+
+    export CEPH_MON="127.0.0.1:7190" # git grep '\<7190\>' : there must be only one
+    export CEPH_ARGS
+    CEPH_ARGS+="--fsid=$(uuidgen) --auth-supported=none "
+    CEPH_ARGS+="--mon-host=$CEPH_MON "
+
+    local funcs=${@:-$(set | sed -n -e 's/^\(TEST_[0-9a-z_]*\) .*/\1/p')}
+    for func in $funcs ; do
+        setup $dir || return 1
+        $func $dir || return 1
+        teardown $dir || return 1
+    done
+}
+
+# run rados bench against a pool with a skewed PG to shard mapping and
+# print "<iops> <steals>"
+function skewed_bench() {
+    local dir=$1
+    local stealing=$2
+    local poolname=hot
+
+    run_mon $dir a --osd_pool_default_size=1 \
+        --osd_pool_default_pg_autoscale_mode=off || return 1
+    run_mgr $dir x || return 1
+    run_osd $dir 0 \
+        --debug-osd=0 --debug-ms=0 \
+        --osd-op-num-shards=8 \
+        --osd-op-num-threads-per-shard=1 \
+        --osd-op-queue=wpq \
+        --osd-op-queue-work-stealing=$stealing || return 1
+
+    # 9 PGs for 8 shards: shard 0 gets ps 0 and 8
+    create_pool $poolname 9 9 || return 1
+    wait_for_clean || return 1
+
+    local iops=$(rados -p $poolname bench 30 write -b 4096 -t 64 \
+        --no-cleanup --format=json | jq '.average_iops')
+    local steals=$(ceph daemon $(get_asok_path osd.0) perf dump osd | \
+        jq '.osd.op_wq_steals')
+    echo "work stealing $stealing: $iops iops, $steals steals" >&2
+    ceph daemon $(get_asok_path osd.0) dump_op_pq_state >&2
+
+    rados -p $poolname cleanup || return 1
+    kill_daemons $dir || return 1
+    echo $iops $steals
+}
+
+function TEST_skewed_pg_load() {
+    local dir=$1
+
+    local out iops_off steals_off iops_on steals_on
+    out=$(skewed_bench $dir false) || return 1
+    read iops_off steals_off <<< "$out"
+    test "$steals_off" = "0" || return 1
+
+    teardown $dir || return 1
+    setup $dir || return 1
+
+    out=$(skewed_bench $dir true) || return 1
+    read iops_on steals_on <<< "$out"
+    test "$steals_on" -gt 0 || return 1
+
+    # throughput depends on the machine; report it, don't assert on it
+    echo "iops without stealing $iops_off, with $iops_on" >&2
+}
+
+main osd-op-wq-steal "$@"
+
+# Local Variables:
+# compile-command: "cd ../.. ; make -j4 && test/osd/osd-op-wq-steal.sh"
+# End:
@@ -70,6 +70,16 @@ void OpHistory::on_shutdown()
   shutdown = true;
 }
 
+bool OpHistory::want(const TrackedOp& op) const
+{
+  uint32_t rate = history_sample_rate.load();
+  if (rate <= 1)
+    return true;
+  if (op.get_duration() >= history_slow_op_threshold.load())
+    return true;
+  return op.seq % rate == 0;
+}
+
 void OpHistory::_insert_delayed(const utime_t& now, TrackedOpRef op)
 {
   std::lock_guard history_lock(ops_history_lock);
@@ -137,13 +147,48 @@ void OpHistory::dump_ops(utime_t now, Formatter *f, set<string> filters, bool by
   f->close_section();
 }
 
+/*
+ * Ops are registered without taking the shard lock: they are pushed
+ * onto the incoming stack, and moved over to ops_in_flight_sharded
+ * by whoever next takes the lock to walk or unregister ops.  Each
+ * thread registers to a shard of its own, so the push rarely races.
+ */
 struct ShardedTrackingData {
   ceph::mutex ops_in_flight_lock_sharded;
   TrackedOp::tracked_op_list_t ops_in_flight_sharded;
+  std::atomic<TrackedOp*> incoming = {nullptr};
   explicit ShardedTrackingData(string lock_name)
     : ops_in_flight_lock_sharded(ceph::make_mutex(lock_name)) {}
+
+  void push(TrackedOp *op) {
+    op->incoming_next = incoming.load(std::memory_order_relaxed);
+    while (!incoming.compare_exchange_weak(op->incoming_next, op,
+					   std::memory_order_release,
+					   std::memory_order_relaxed))
+      ;
+  }
+  /// move the registered ops over, caller holds ops_in_flight_lock_sharded
+  void drain() {
+    TrackedOp *op = incoming.exchange(nullptr, std::memory_order_acquire);
+    // the stack holds the newest op first
+    TrackedOp::tracked_op_list_t arrived;
+    while (op) {
+      TrackedOp *next = op->incoming_next;
+      op->incoming_next = nullptr;
+      arrived.push_front(*op);
+      op = next;
+    }
+    ops_in_flight_sharded.splice(ops_in_flight_sharded.end(), arrived);
+  }
 };
 
+static uint32_t get_thread_shard()
+{
+  static std::atomic<uint32_t> next_thread = {0};
+  static thread_local uint32_t thread_shard = next_thread++;
+  return thread_shard;
+}
+
 OpTracker::OpTracker(CephContext *cct_, bool tracking, uint32_t num_shards):
   seq(0),
   num_optracker_shards(num_shards),
@@ -161,6 +206,7 @@ OpTracker::OpTracker(CephContext *cct_, bool tracking, uint32_t num_shards):
 OpTracker::~OpTracker() {
   while (!sharded_in_flight_list.empty()) {
     ceph_assert((sharded_in_flight_list.back())->ops_in_flight_sharded.empty());
+    ceph_assert(!(sharded_in_flight_list.back())->incoming.load());
     delete sharded_in_flight_list.back();
     sharded_in_flight_list.pop_back();
   }
@@ -171,7 +217,6 @@ bool OpTracker::dump_historic_ops(Formatter *f, bool by_duration, set<string> fi
   if (!tracking_enabled)
     return false;
 
-  std::shared_lock l{lock};
   utime_t now = ceph_clock_now();
   history.dump_ops(now, f, filters, by_duration);
   return true;
@@ -206,7 +251,6 @@ bool OpTracker::dump_historic_slow_ops(Formatter *f, set<string> filters)
   if (!tracking_enabled)
     return false;
 
-  std::shared_lock l{lock};
   utime_t now = ceph_clock_now();
   history.dump_slow_ops(now, f, filters);
   return true;
@@ -217,7 +261,6 @@ bool OpTracker::dump_ops_in_flight(Formatter *f, bool print_only_blocked, set<st
   if (!tracking_enabled)
     return false;
 
-  std::shared_lock l{lock};
   f->open_object_section("ops_in_flight"); // overall dump
   uint64_t total_ops_in_flight = 0;
   f->open_array_section("ops"); // list of TrackedOps
@@ -226,6 +269,7 @@ bool OpTracker::dump_ops_in_flight(Formatter *f, bool print_only_blocked, set<st
     ShardedTrackingData* sdata = sharded_in_flight_list[i];
     ceph_assert(NULL != sdata); 
     std::lock_guard locker(sdata->ops_in_flight_lock_sharded);
+    sdata->drain();
     for (auto& op : sdata->ops_in_flight_sharded) {
       if (print_only_blocked && (now - op.get_initiated() <= complaint_time))
         break;
@@ -252,16 +296,11 @@ bool OpTracker::register_inflight_op(TrackedOp *i)
   if (!tracking_enabled)
     return false;
 
-  std::shared_lock l{lock};
-  uint64_t current_seq = ++seq;
-  uint32_t shard_index = current_seq % num_optracker_shards;
-  ShardedTrackingData* sdata = sharded_in_flight_list[shard_index];
+  i->seq = ++seq;
+  i->shard = get_thread_shard() % num_optracker_shards;
+  ShardedTrackingData* sdata = sharded_in_flight_list[i->shard];
   ceph_assert(NULL != sdata);
-  {
-    std::lock_guard locker(sdata->ops_in_flight_lock_sharded);
-    sdata->ops_in_flight_sharded.push_back(*i);
-    i->seq = current_seq;
-  }
+  sdata->push(i);
   return true;
 }
 
@@ -270,11 +309,11 @@ void OpTracker::unregister_inflight_op(TrackedOp* const i)
   // caller checks;
   ceph_assert(i->state);
 
-  uint32_t shard_index = i->seq % num_optracker_shards;
-  ShardedTrackingData* sdata = sharded_in_flight_list[shard_index];
+  ShardedTrackingData* sdata = sharded_in_flight_list[i->shard];
   ceph_assert(NULL != sdata);
   {
     std::lock_guard locker(sdata->ops_in_flight_lock_sharded);
+    sdata->drain();
     auto p = sdata->ops_in_flight_sharded.iterator_to(*i);
     sdata->ops_in_flight_sharded.erase(p);
   }
@@ -282,7 +321,8 @@ void OpTracker::unregister_inflight_op(TrackedOp* const i)
 
 void OpTracker::record_history_op(TrackedOpRef&& i)
 {
-  std::shared_lock l{lock};
+  if (!history.want(*i))
+    return;  // dropping the last ref frees the op
   history.insert(ceph_clock_now(), std::move(i));
 }
 
@@ -296,10 +336,10 @@ bool OpTracker::visit_ops_in_flight(utime_t* oldest_secs,
   utime_t oldest_op = now;
   uint64_t total_ops_in_flight = 0;
 
-  std::shared_lock l{lock};
   for (const auto sdata : sharded_in_flight_list) {
     ceph_assert(sdata);
     std::lock_guard locker(sdata->ops_in_flight_lock_sharded);
+    sdata->drain();
     if (!sdata->ops_in_flight_sharded.empty()) {
       utime_t oldest_op_tmp =
 	sdata->ops_in_flight_sharded.front().get_initiated();
@@ -323,6 +363,7 @@ bool OpTracker::visit_ops_in_flight(utime_t* oldest_secs,
     ShardedTrackingData* sdata = sharded_in_flight_list[iter];
     ceph_assert(NULL != sdata);
     std::lock_guard locker(sdata->ops_in_flight_lock_sharded);
+    sdata->drain();
     for (auto& op : sdata->ops_in_flight_sharded) {
       if (!visit(op))
 	break;
@@ -421,6 +462,7 @@ void OpTracker::get_age_ms_histogram(pow2_hist_t *h)
     ShardedTrackingData* sdata = sharded_in_flight_list[iter];
     ceph_assert(NULL != sdata);
     std::lock_guard locker(sdata->ops_in_flight_lock_sharded);
+    sdata->drain();
 
     for (auto& i : sdata->ops_in_flight_sharded) {
       utime_t age = now - i.get_initiated();
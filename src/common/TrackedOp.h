@@ -62,6 +62,7 @@ class OpHistory {
   std::atomic_uint32_t history_duration{0};
   std::atomic_size_t history_slow_op_size{0};
   std::atomic_uint32_t history_slow_op_threshold{0};
+  std::atomic_uint32_t history_sample_rate{1};
   std::atomic_bool shutdown{false};
   OpHistoryServiceThread opsvc;
   friend class OpHistoryServiceThread;
@@ -83,6 +84,8 @@ public:
     opsvc.insert_op(now, op);
   }
 
+  /// false if op is sampled out; slow ops are always kept
+  bool want(const TrackedOp& op) const;
   void _insert_delayed(const utime_t& now, TrackedOpRef op);
   void dump_ops(utime_t now, ceph::Formatter *f, std::set<std::string> filters = {""}, bool by_duration=false);
   void dump_slow_ops(utime_t now, ceph::Formatter *f, std::set<std::string> filters = {""});
@@ -95,6 +98,9 @@ public:
     history_slow_op_size = new_size;
     history_slow_op_threshold = new_threshold;
   }
+  void set_sample_rate(uint32_t new_rate) {
+    history_sample_rate = new_rate;
+  }
 };
 
 struct ShardedTrackingData;
@@ -107,7 +113,6 @@ class OpTracker {
   float complaint_time;
   int log_threshold;
   std::atomic<bool> tracking_enabled;
-  ceph::shared_mutex lock = ceph::make_shared_mutex("OpTracker::lock");
 
 public:
   CephContext *cct;
@@ -123,6 +128,10 @@ public:
   void set_history_slow_op_size_and_threshold(uint32_t new_size, uint32_t new_threshold) {
     history.set_slow_op_size_and_threshold(new_size, new_threshold);
   }
+  /// keep only one in new_rate completed ops in the history
+  void set_history_sample_rate(uint32_t new_rate) {
+    history.set_sample_rate(new_rate);
+  }
   bool is_tracking() const {
     return tracking_enabled;
   }
@@ -201,8 +210,10 @@ class TrackedOp : public boost::intrusive::list_base_hook<> {
 private:
   friend class OpHistory;
   friend class OpTracker;
+  friend struct ShardedTrackingData;
 
   boost::intrusive::list_member_hook<> tracker_item;
+  TrackedOp *incoming_next = nullptr; ///< next op registered to our shard
 
 public:
   typedef boost::intrusive::list<
@@ -249,6 +260,7 @@ protected:
   std::vector<Event> events;    ///< std::list of events and their times
   mutable ceph::mutex lock = ceph::make_mutex("TrackedOp::lock"); ///< to protect the events list
   uint64_t seq = 0;        ///< a unique value std::set by the OpTracker
+  uint32_t shard = 0;      ///< the OpTracker shard holding us
 
   uint32_t warn_interval_multiplier = 1; //< limits output of a given op warning
 
@@ -114,6 +114,7 @@ static const char *blkdev_props2strings[] = {
   [BLKDEV_PROP_VENDOR]              = "device/device/vendor",
   [BLKDEV_PROP_NUMA_NODE]           = "device/device/numa_node",
   [BLKDEV_PROP_NUMA_CPUS]           = "device/device/local_cpulist",
+  [BLKDEV_PROP_ZONED]               = "queue/zoned",
 };
 
 const char *BlkDev::sysfsdir() const {
@@ -236,6 +237,13 @@ bool BlkDev::is_rotational() const
   return get_int_property(BLKDEV_PROP_ROTATIONAL) > 0;
 }
 
+bool BlkDev::is_host_managed() const
+{
+  char zoned[80];
+  int r = get_string_property(BLKDEV_PROP_ZONED, zoned, sizeof(zoned));
+  return r == 0 && strcmp(zoned, "host-managed") == 0;
+}
+
 int BlkDev::get_numa_node(int *node) const
 {
   int numa = get_int_property(BLKDEV_PROP_NUMA_NODE);
@@ -840,6 +848,11 @@ bool BlkDev::is_rotational() const
   return false;
 }
 
+bool BlkDev::is_host_managed() const
+{
+  return false;
+}
+
 int BlkDev::get_numa_node(int *node) const
 {
   return -1;
@@ -999,6 +1012,11 @@ bool BlkDev::is_rotational() const
 #endif
 }
 
+bool BlkDev::is_host_managed() const
+{
+  return false;
+}
+
 int BlkDev::get_numa_node(int *node) const
 {
   int numa = get_int_property(BLKDEV_PROP_NUMA_NODE);
@@ -1173,6 +1191,11 @@ bool BlkDev::is_rotational(const char *devname) const
   return false;
 }
 
+bool BlkDev::is_host_managed() const
+{
+  return false;
+}
+
 int BlkDev::model(char *model, size_t max) const
 {
   return -EOPNOTSUPP;
@@ -17,6 +17,7 @@ enum blkdev_prop_t {
   BLKDEV_PROP_VENDOR,
   BLKDEV_PROP_NUMA_NODE,
   BLKDEV_PROP_NUMA_CPUS,
+  BLKDEV_PROP_ZONED,
   BLKDEV_PROP_NUMPROPS,
 };
 
@@ -57,6 +58,7 @@ public:
   bool support_discard() const;
   bool is_nvme() const;
   bool is_rotational() const;
+  bool is_host_managed() const;
   int get_numa_node(int *node) const;
   int dev(char *dev, size_t max) const;
   int vendor(char *vendor, size_t max) const;
@@ -621,6 +621,7 @@ OPTION(osd_op_num_shards_ssd, OPT_INT)
 OPTION(osd_op_queue, OPT_STR)
 
 OPTION(osd_op_queue_cut_off, OPT_STR) // Min priority to go to strict queue. (low, high)
+OPTION(osd_op_queue_work_stealing, OPT_BOOL) // idle shard threads take ops from other shards
 
 OPTION(osd_ignore_stale_divergent_priors, OPT_BOOL) // do not assert on divergent_prior entries which aren't in the log and whose on-disk objects are newer
 
@@ -726,6 +727,7 @@ OPTION(osd_pg_epoch_persisted_max_stale, OPT_U32) // make this < map_cache_size!
 OPTION(osd_min_pg_log_entries, OPT_U32)  // number of entries to keep in the pg log when trimming it
 OPTION(osd_max_pg_log_entries, OPT_U32) // max entries, say when degraded, before we trim
 OPTION(osd_pg_log_dups_tracked, OPT_U32) // how many versions back to track combined in both pglog's regular + dup logs
+OPTION(osd_pg_log_dups_on_disk_only, OPT_BOOL) // don't keep pg log dups in memory
 OPTION(osd_object_clean_region_max_num_intervals, OPT_INT) // number of intervals in clean_offsets
 OPTION(osd_force_recovery_pg_log_entries_factor, OPT_FLOAT) // max entries factor before force recovery
 OPTION(osd_pg_log_trim_min, OPT_U32)
@@ -885,6 +887,11 @@ OPTION(bdev_aio_poll_ms, OPT_INT)  // milliseconds
 OPTION(bdev_aio_max_queue_depth, OPT_INT)
 OPTION(bdev_aio_reap_max, OPT_INT)
 OPTION(bdev_block_size, OPT_INT)
+OPTION(bdev_ioring, OPT_BOOL)
+OPTION(bdev_ioring_hipri, OPT_BOOL)
+OPTION(bdev_ioring_sqthread_poll, OPT_BOOL)
+OPTION(bdev_zoned_emulation_zone_size, OPT_U64)
+OPTION(bdev_zoned_emulation_conventional_zones, OPT_U64)
 OPTION(bdev_debug_aio, OPT_BOOL)
 OPTION(bdev_debug_aio_suicide_timeout, OPT_FLOAT)
 OPTION(bdev_debug_aio_log_age, OPT_DOUBLE)
@@ -908,6 +915,7 @@ OPTION(bluefs_log_compact_min_ratio, OPT_FLOAT)      // before we consider
 OPTION(bluefs_log_compact_min_size, OPT_U64)  // before we consider
 OPTION(bluefs_min_flush_size, OPT_U64)  // ignore flush until its this big
 OPTION(bluefs_compact_log_sync, OPT_BOOL)  // sync or async log compaction?
+OPTION(bluefs_compact_log_incremental, OPT_BOOL)  // async compaction without the lock held
 OPTION(bluefs_buffered_io, OPT_BOOL)
 OPTION(bluefs_sync_write, OPT_BOOL)
 OPTION(bluefs_allocator, OPT_STR)     // stupid | bitmap
@@ -1001,6 +1009,10 @@ OPTION(bluestore_cache_meta_ratio, OPT_DOUBLE)
 OPTION(bluestore_cache_kv_ratio, OPT_DOUBLE)
 OPTION(bluestore_kvbackend, OPT_STR)
 OPTION(bluestore_allocator, OPT_STR)     // stupid | bitmap
+OPTION(bluestore_alloc_snapshot, OPT_BOOL)
+OPTION(bluestore_zoned_cleaner_interval, OPT_DOUBLE)
+OPTION(bluestore_zoned_cleaner_free_ratio, OPT_DOUBLE)
+OPTION(bluestore_zoned_cleaner_max_live_ratio, OPT_DOUBLE)
 OPTION(bluestore_freelist_blocks_per_key, OPT_INT)
 OPTION(bluestore_bitmapallocator_blocks_per_zone, OPT_INT) // must be power of 2 aligned, e.g., 512, 1024, 2048...
 OPTION(bluestore_bitmapallocator_span_size, OPT_INT) // must be power of 2 aligned, e.g., 512, 1024, 2048...
@@ -1017,18 +1029,23 @@ OPTION(bluestore_fsck_on_mkfs_deep, OPT_BOOL)
 OPTION(bluestore_sync_submit_transaction, OPT_BOOL) // submit kv txn in queueing thread (not kv_sync_thread)
 OPTION(bluestore_fsck_read_bytes_cap, OPT_U64)
 OPTION(bluestore_fsck_quick_fix_threads, OPT_INT)
+OPTION(bluestore_fsck_deep_read_threads, OPT_INT)
+OPTION(bluestore_fsck_progress_interval, OPT_DOUBLE)
 OPTION(bluestore_throttle_bytes, OPT_U64)
 OPTION(bluestore_throttle_deferred_bytes, OPT_U64)
 OPTION(bluestore_throttle_cost_per_io_hdd, OPT_U64)
 OPTION(bluestore_throttle_cost_per_io_ssd, OPT_U64)
 OPTION(bluestore_throttle_cost_per_io, OPT_U64)
 OPTION(bluestore_deferred_batch_ops, OPT_U64)
+OPTION(bluestore_deferred_merge, OPT_BOOL)
+OPTION(bluestore_deferred_flush_window, OPT_DOUBLE)
 OPTION(bluestore_deferred_batch_ops_hdd, OPT_U64)
 OPTION(bluestore_deferred_batch_ops_ssd, OPT_U64)
 OPTION(bluestore_nid_prealloc, OPT_INT)
 OPTION(bluestore_blobid_prealloc, OPT_U64)
 OPTION(bluestore_clone_cow, OPT_BOOL)  // do copy-on-write for clones
 OPTION(bluestore_default_buffered_read, OPT_BOOL)
+OPTION(bluestore_cache_decompressed_blobs, OPT_BOOL)
 OPTION(bluestore_default_buffered_write, OPT_BOOL)
 OPTION(bluestore_debug_misc, OPT_BOOL)
 OPTION(bluestore_debug_no_reuse_blocks, OPT_BOOL)
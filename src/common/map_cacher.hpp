@@ -35,6 +35,12 @@ public:
     const std::set<K> &to_remove ///< [in] keys to remove
     ) = 0;
 
+  /// Remove all keys in [first, last)
+  virtual void remove_range(
+    const K &first, ///< [in] first key to remove
+    const K &last   ///< [in] key after the last key to remove
+    ) = 0;
+
   /// Add context to fire when data is readable
   virtual void add_callback(
     Context *c ///< [in] Context to fire on readable
@@ -156,6 +162,26 @@ public:
     t->add_callback(new TransHolder(vptrs));
   }
 
+  /// Adds operation removing [first, last), which must hold just keys
+  void remove_range(
+    const set<K> &keys,  ///< [in] all the keys in [first, last)
+    const K &first,      ///< [in]
+    const K &last,       ///< [in]
+    Transaction<K, V> *t ///< [out] transaction to use
+    ) {
+    std::set<VPtr> vptrs;
+    for (typename set<K>::const_iterator i = keys.begin();
+	 i != keys.end();
+	 ++i) {
+      boost::optional<V> empty;
+      VPtr ip = in_progress.lookup_or_create(*i, empty);
+      *ip = empty;
+      vptrs.insert(ip);
+    }
+    t->remove_range(first, last);
+    t->add_callback(new TransHolder(vptrs));
+  }
+
   /// Gets keys, uses cached values for unstable keys
   int get_keys(
     const set<K> &keys_to_get, ///< [in] set of keys to fetch
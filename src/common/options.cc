@@ -934,6 +934,28 @@ std::vector<Option> get_global_options() {
     .set_default(4_K)
     .set_description("Maximum amount of data to prefetch out of the socket receive buffer"),
 
+    Option("ms_async_rx_buffer_pool_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Memory each messenger worker keeps for recycling receive buffers, 0 to allocate every buffer")
+    .set_long_description("Frame segments of a page or more are read into page aligned buffers, which go back to the worker pool once the messages holding them are done with.  Off by default since every worker of every process keeps this much; worth setting on OSDs receiving large writes."),
+
+    Option("ms_async_send_zerocopy_min_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Send data of at least this many bytes with MSG_ZEROCOPY, 0 to always copy")
+    .set_long_description("With MSG_ZEROCOPY the kernel transmits straight out of the message buffers instead of copying them, which pays off for large messages only.  The buffers are held until the kernel reports it is done with them.  Needs Linux 4.14 or later and the posix messenger stack."),
+
+    Option("ms_async_busy_poll_us", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Microseconds each messenger worker busy polls for events after handling some, before it sleeps; 0 to always sleep")
+    .set_long_description("Polling saves the wakeup latency of sleeping in epoll when messages arrive in quick succession, at the cost of a busy CPU per worker.  The value is also set as SO_BUSY_POLL on the sockets where the kernel supports it.  Read when the workers start.  Compare the workers' msgr_poll_time and msgr_idle_time perf counters to see what it costs.")
+    .add_see_also("ms_async_op_threads"),
+
+    Option("ms_fast_dispatch_batch_size", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(16)
+    .set_min(1)
+    .set_description("Most messages read off one connection to fast dispatch together")
+    .set_long_description("Messages decoded from one read burst are handed to the fast dispatcher as a batch, so it can amortize queueing costs over them.  A batch is delivered once the socket has no more data ready or it reaches this many messages.  1 delivers each message on its own.  Only the v2 protocol batches."),
+
     Option("ms_initial_backoff", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(.2)
     .set_description("Initial backoff after a network error is detected (seconds)"),
@@ -2822,6 +2844,11 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description("Do not store full-object checksums if the backend (bluestore) does its own checksums.  Only usable with all BlueStore OSDs."),
 
+    Option("osd_coalesce_reads", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Read consecutive read and sparse-read ops of a client request with a single readv")
+    .set_long_description("Overlapping and adjacent extents are merged, and every op gets its slice of the merged extents.  Only applies to replicated pools; erasure coded pools already issue the reads of a request together."),
+
     Option("osd_op_queue", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("wpq")
     .set_enum_allowed( { "wpq", "prioritized",
@@ -2840,58 +2867,65 @@ std::vector<Option> get_global_options() {
     .set_long_description("the threshold between high priority ops that use strict priority ordering and low priority ops that use a fairness algorithm that may or may not incorporate priority")
     .add_see_also("osd_op_queue"),
 
+    Option("osd_op_queue_work_stealing", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("let idle op threads take queued ops from other shards")
+    .set_long_description("When an op shard has nothing queued, its threads look for another shard with more ops queued than it has threads, and process ops from it instead of sleeping. Stolen ops still go through the owning shard's PG slots and PG locks, so per-PG ordering is preserved; an op for a PG that is being processed is left to the thread processing it. Helps when a few hot PGs map to the same shard.")
+    .add_see_also("osd_op_num_shards")
+    .add_see_also("osd_op_num_threads_per_shard"),
+
     Option("osd_mclock_scheduler_client_res", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description("IO proportion reserved for each client (default)")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_client_wgt", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description("IO share for each client (default) over reservation")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_client_lim", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(999999)
     .set_description("IO limit for each client (default) over reservation")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_background_recovery_res", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description("IO proportion reserved for background recovery (default)")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_background_recovery_wgt", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description("IO share for each background recovery over reservation")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_background_recovery_lim", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(999999)
     .set_description("IO limit for background recovery over reservation")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_background_best_effort_res", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description("IO proportion reserved for background best_effort (default)")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_background_best_effort_wgt", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(1)
     .set_description("IO share for each background best_effort over reservation")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_background_best_effort_lim", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(999999)
     .set_description("IO limit for background best_effort over reservation")
-    .set_long_description("Only considered for osd_op_queue = mClockScheduler")
+    .set_long_description("Only considered for osd_op_queue = mClockScheduler with osd_mclock_profile = custom")
     .add_see_also("osd_op_queue"),
 
     Option("osd_mclock_scheduler_anticipation_timeout", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
@@ -2899,6 +2933,58 @@ std::vector<Option> get_global_options() {
     .set_description("mclock anticipation timeout in seconds")
     .set_long_description("the amount of time that mclock waits until the unused resource is forfeited"),
 
+    Option("osd_mclock_profile", Option::TYPE_STR, Option::LEVEL_ADVANCED)
+    .set_default("high_client_ops")
+    .set_enum_allowed( { "high_client_ops", "balanced", "high_recovery_ops", "custom" } )
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("how the mclock scheduler splits the OSD's capacity between clients and background work")
+    .set_long_description("high_client_ops, balanced and high_recovery_ops derive reservations, weights and limits for each op class from the measured capacity of the OSD. custom uses the osd_mclock_scheduler_* values as they are. Only considered for osd_op_queue = mclock_scheduler")
+    .add_see_also("osd_op_queue")
+    .add_see_also("osd_mclock_max_capacity_iops_hdd")
+    .add_see_also("osd_mclock_max_capacity_iops_ssd"),
+
+    Option("osd_mclock_max_capacity_iops_hdd", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(315.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("random 4K write IOPS the OSD's rotational device sustains")
+    .set_long_description("Measured at OSD startup if still at its default and osd_mclock_skip_benchmark is not set; the result is stored in the mon config, so later starts reuse it. Only considered for osd_op_queue = mclock_scheduler")
+    .add_see_also("osd_mclock_profile"),
+
+    Option("osd_mclock_max_capacity_iops_ssd", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(21500.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("random 4K write IOPS the OSD's solid state device sustains")
+    .set_long_description("Measured at OSD startup if still at its default and osd_mclock_skip_benchmark is not set; the result is stored in the mon config, so later starts reuse it. Only considered for osd_op_queue = mclock_scheduler")
+    .add_see_also("osd_mclock_profile"),
+
+    Option("osd_mclock_max_sequential_bandwidth_hdd", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(150_M)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("sequential bandwidth in bytes/second of the OSD's rotational device")
+    .set_long_description("Together with the IOPS capacity this determines how many bytes an op may move before it costs as much as one more random IO. Only considered for osd_op_queue = mclock_scheduler")
+    .add_see_also("osd_mclock_profile"),
+
+    Option("osd_mclock_max_sequential_bandwidth_ssd", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(1200_M)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("sequential bandwidth in bytes/second of the OSD's solid state device")
+    .set_long_description("Together with the IOPS capacity this determines how many bytes an op may move before it costs as much as one more random IO. Only considered for osd_op_queue = mclock_scheduler")
+    .add_see_also("osd_mclock_profile"),
+
+    Option("osd_mclock_skip_benchmark", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("do not measure the IOPS capacity of the OSD at startup")
+    .set_long_description("Set this when osd_mclock_max_capacity_iops_hdd/ssd are configured by hand")
+    .add_see_also("osd_mclock_max_capacity_iops_hdd")
+    .add_see_also("osd_mclock_max_capacity_iops_ssd"),
+
+    Option("osd_mclock_calibration_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(30.0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("seconds of continuous backlog after which the mclock scheduler re-estimates its capacity (0 to disable)")
+    .set_long_description("While an op shard never runs out of queued ops, the rate at which they are dequeued is the rate at which the OSD completes them. After this long, that rate replaces the configured capacity. Only considered for osd_op_queue = mclock_scheduler")
+    .add_see_also("osd_mclock_profile"),
+
     Option("osd_ignore_stale_divergent_priors", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_description(""),
@@ -2907,6 +2993,19 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("osd_ec_codec_threads", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(2)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("threads helping to erasure code large writes and reads")
+    .set_long_description("Buffers of at least osd_ec_codec_slice_size bytes per thread are split into runs of whole stripes, and the runs are encoded or decoded in parallel by these threads and the op thread. The threads are shared by all PGs of the OSD. 0 encodes and decodes on the op thread only.")
+    .add_see_also("osd_ec_codec_slice_size"),
+
+    Option("osd_ec_codec_slice_size", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
+    .set_default(256_K)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("smallest run of stripes, in logical bytes, handed to an erasure code thread")
+    .add_see_also("osd_ec_codec_threads"),
+
     Option("osd_recover_clone_overlap_limit", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description(""),
@@ -2966,6 +3065,23 @@ std::vector<Option> get_global_options() {
     .set_default(2)
     .set_description("Time in seconds to sleep before next snap trim when data is on HDD and journal is on SSD"),
 
+    Option("osd_snap_trim_objects_per_sec", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_description("Maximum number of clones a PG trims per second, 0 for no limit")
+    .set_long_description("Between rounds of trimming the PG sleeps long enough to stay within this rate, or for osd_snap_trim_sleep if that is longer.")
+    .add_see_also({"osd_snap_trim_sleep", "osd_snap_trim_batch_size"}),
+
+    Option("osd_snap_trim_batch_size", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_description("Number of clones trimmed by each snap trim transaction")
+    .set_long_description("Each of the osd_pg_max_concurrent_snap_trims concurrent trim operations of a PG removes this many clones in one transaction.  Larger batches cut the per-transaction overhead and let the snap mapper remove the keys of a snapshot in ranges.")
+    .add_see_also({"osd_pg_max_concurrent_snap_trims", "osd_snap_trim_range_delete_min_keys"}),
+
+    Option("osd_snap_trim_range_delete_min_keys", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(8)
+    .set_description("Shortest run of adjacent snap mapper keys removed as a range, 0 to never use ranges")
+    .add_see_also("osd_snap_trim_batch_size"),
+
     Option("osd_scrub_invalid_stats", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description(""),
@@ -3211,6 +3327,11 @@ std::vector<Option> get_global_options() {
     .set_default(5)
     .set_description("Set the maximum number of times we will preempt a deep scrub due to a client operation before blocking client IO to complete the scrub"),
 
+    Option("osd_scrub_resume", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Continue an interrupted scrub from where it stopped")
+    .set_long_description("The primary records its position in the scrub results object after each chunk.  If the scrub is interrupted and the same kind of scrub is started again by the same primary, before any other scrub of the PG completed or the PG split, it picks up from that position.  PG stats are not checked by a resumed scrub.  Repair always starts from the beginning."),
+
     Option("osd_deep_scrub_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
     .set_default(7_day)
     .set_description("Deep scrub each PG (i.e., verify data checksums) at least this often"),
@@ -3224,6 +3345,12 @@ std::vector<Option> get_global_options() {
     .set_default(512_K)
     .set_description("Number of bytes to read from an object at a time during deep scrub"),
 
+    Option("osd_deep_scrub_store_digest", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Have the object store compute object data digests for deep scrub")
+    .set_long_description("The object store checks its own checksums and returns only the crc32c of the data, instead of handing the data to the OSD to hash.  BlueStore reuses its stored crc32c checksums for this where it can.")
+    .add_see_also("osd_deep_scrub_stride"),
+
     Option("osd_deep_scrub_keys", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(1024)
     .set_description("Number of keys to read from an object at a time during deep scrub"),
@@ -3305,6 +3432,14 @@ std::vector<Option> get_global_options() {
     .add_see_also("osd_min_pg_log_entries")
     .add_see_also("osd_max_pg_log_entries"),
 
+    Option("osd_pg_log_dups_on_disk_only", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_flag(Option::FLAG_STARTUP)
+    .set_description("keep the dup detection entries of the pg log on disk only")
+    .set_long_description("Dups are still written to the pg log object, but dropped from memory once committed, and only read back for ops the client resent.  A small index of their reqid hashes tells which keys to read.  This saves memory on OSDs with many PGs, but the dups are no longer shared with peers when merging logs.")
+    .add_service("osd")
+    .add_see_also("osd_pg_log_dups_tracked"),
+
     Option("osd_object_clean_region_max_num_intervals", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(10)
     .set_description("number of intervals in clean_offsets")
@@ -3478,6 +3613,13 @@ std::vector<Option> get_global_options() {
     .set_default(10.0)
     .set_description(""),
 
+    Option("osd_op_history_sample_rate", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
+    .set_default(1)
+    .set_min(1)
+    .set_description("Keep one in this many completed ops in the op history")
+    .set_long_description("Ops slower than osd_op_history_slow_op_threshold are always kept.  Sampling cuts the cost of op tracking at high op rates so that it can stay enabled.")
+    .add_see_also({"osd_op_history_size", "osd_op_history_slow_op_threshold"}),
+
     Option("osd_target_transaction_size", Option::TYPE_INT, Option::LEVEL_ADVANCED)
     .set_default(30)
     .set_description(""),
@@ -3893,6 +4035,31 @@ std::vector<Option> get_global_options() {
     .set_default(4_K)
     .set_description(""),
 
+    Option("bdev_ioring", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Enables Linux io_uring API instead of libaio")
+    .set_long_description("Requires a kernel with io_uring support and a build with WITH_LIBURING; falls back to libaio otherwise. Device fds are registered with the ring and, unless bdev_ioring_hipri is set, flush is queued as an asynchronous fdatasync."),
+
+    Option("bdev_ioring_hipri", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Use polled IO completions with io_uring (IORING_SETUP_IOPOLL)")
+    .set_long_description("Not supported yet and ignored: completions are reaped by waiting for the ring's fd, which an IOPOLL ring never signals."),
+
+    Option("bdev_ioring_sqthread_poll", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Offload io_uring submission to a kernel polling thread (IORING_SETUP_SQPOLL)"),
+
+    Option("bdev_zoned_emulation_zone_size", Option::TYPE_SIZE, Option::LEVEL_DEV)
+    .set_default(0)
+    .set_description("Emulate a host-managed zoned main device with zones of this size (0 disables)")
+    .set_long_description("Lets BlueStore's zoned device, allocator and cleaner run on an ordinary file or block device.  Write pointers are only tracked in memory.")
+    .add_see_also("bdev_zoned_emulation_conventional_zones"),
+
+    Option("bdev_zoned_emulation_conventional_zones", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(1)
+    .set_description("Number of leading zones that accept random writes when emulating a zoned device")
+    .add_see_also("bdev_zoned_emulation_zone_size"),
+
     Option("bdev_debug_aio", Option::TYPE_BOOL, Option::LEVEL_DEV)
     .set_default(false)
     .set_description(""),
@@ -3957,6 +4124,11 @@ std::vector<Option> get_global_options() {
     .set_default(false)
     .set_description(""),
 
+    Option("bluefs_compact_log_incremental", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_description("Encode and write the compacted BlueFS log without holding the BlueFS lock")
+    .set_long_description("Async log compaction only copies the in-memory metadata under the lock; encoding and writing the new log head happen without it, so that concurrent writers (e.g. the RocksDB WAL) do not stall for the whole compaction."),
+
     Option("bluefs_buffered_io", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(true)
     .set_description(""),
@@ -4326,10 +4498,31 @@ std::vector<Option> get_global_options() {
 
     Option("bluestore_allocator", Option::TYPE_STR, Option::LEVEL_ADVANCED)
     .set_default("bitmap")
-    .set_enum_allowed({"bitmap", "stupid", "avl"})
+    .set_enum_allowed({"bitmap", "stupid", "avl", "hybrid"})
     .set_description("Allocator policy")
     .set_long_description("Allocator to use for bluestore.  Stupid should only be used for testing."),
 
+    Option("bluestore_alloc_snapshot", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(false)
+    .set_description("Save allocator state to BlueFS on clean shutdown")
+    .set_long_description("On umount the free space map is written to a BlueFS file together with the freelist sequence it matches. The next mount loads it instead of walking the freelist in the DB, which can take minutes on large fragmented devices. Any mount that may modify the freelist invalidates the snapshot, and a stale or damaged snapshot is ignored.")
+    .add_see_also("bluestore_allocator"),
+
+    Option("bluestore_zoned_cleaner_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(5.0)
+    .set_description("How often (seconds) the zone cleaner of a zoned main device wakes up"),
+
+    Option("bluestore_zoned_cleaner_free_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.1)
+    .set_description("Start relocating live data once less than this fraction of a zoned main device is writable")
+    .set_long_description("Zones without any live data are reset regardless of this setting.")
+    .add_see_also("bluestore_zoned_cleaner_max_live_ratio"),
+
+    Option("bluestore_zoned_cleaner_max_live_ratio", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(.5)
+    .set_description("Only relocate zones with at most this fraction of live data")
+    .add_see_also("bluestore_zoned_cleaner_free_ratio"),
+
     Option("bluestore_freelist_blocks_per_key", Option::TYPE_SIZE, Option::LEVEL_DEV)
     .set_default(128)
     .set_description("Block (and bits) per database key"),
@@ -4397,12 +4590,22 @@ std::vector<Option> get_global_options() {
     Option("bluestore_fsck_read_bytes_cap", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(64_M)
     .set_flag(Option::FLAG_RUNTIME)
-    .set_description("Maximum bytes read at once by deep fsck"),
+    .set_description("Maximum bytes read at once by deep fsck")
+    .set_long_description("With bluestore_fsck_deep_read_threads, the cap is split evenly across the read threads, so it bounds the total bytes read at once."),
 
     Option("bluestore_fsck_quick_fix_threads", Option::TYPE_INT, Option::LEVEL_ADVANCED)
       .set_default(2)
       .set_description("Number of additional threads to perform quick-fix (shallow fsck) command"),
 
+    Option("bluestore_fsck_deep_read_threads", Option::TYPE_INT, Option::LEVEL_ADVANCED)
+      .set_default(4)
+      .set_description("Number of threads reading object data during deep fsck")
+      .set_long_description("Object data is read back in parallel with the metadata walk. 0 makes deep fsck read every object inline."),
+
+    Option("bluestore_fsck_progress_interval", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+      .set_default(10.0)
+      .set_description("Seconds between fsck progress and throughput reports in the log, 0 disables"),
+
     Option("bluestore_throttle_bytes", Option::TYPE_SIZE, Option::LEVEL_ADVANCED)
     .set_default(64_M)
     .set_flag(Option::FLAG_RUNTIME)
@@ -4435,6 +4638,19 @@ std::vector<Option> get_global_options() {
     .set_flag(Option::FLAG_RUNTIME)
     .set_description("Max number of deferred writes before we flush the deferred write queue"),
 
+    Option("bluestore_deferred_merge", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Submit deferred writes of all sequencers together")
+    .set_long_description("When flushing the deferred write queue, sort the pending writes of all sequencers by offset and coalesce adjacent ones into single ios instead of submitting each sequencer's batch on its own."),
+
+    Option("bluestore_deferred_flush_window", Option::TYPE_FLOAT, Option::LEVEL_ADVANCED)
+    .set_default(0)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Minimum time between deferred write queue flushes triggered by bluestore_deferred_batch_ops")
+    .set_long_description("Lets more sequencers queue deferred writes before they are merged and submitted. Flushes forced by the deferred throttle are not delayed.")
+    .add_see_also({"bluestore_deferred_merge", "bluestore_deferred_batch_ops", "bluestore_max_defer_interval"}),
+
     Option("bluestore_deferred_batch_ops_hdd", Option::TYPE_UINT, Option::LEVEL_ADVANCED)
     .set_default(64)
     .set_flag(Option::FLAG_RUNTIME)
@@ -4465,6 +4681,13 @@ std::vector<Option> get_global_options() {
     .set_flag(Option::FLAG_RUNTIME)
     .set_description("Cache read results by default (unless hinted NOCACHE or WONTNEED)"),
 
+    Option("bluestore_cache_decompressed_blobs", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
+    .set_default(true)
+    .set_flag(Option::FLAG_RUNTIME)
+    .set_description("Keep decompressed blobs in the buffer cache after unbuffered reads")
+    .set_long_description("A read from a compressed blob has to decompress the whole blob. With this set, the decompressed data is cached (cold, so that it is trimmed first) even if the read is not buffered, so that reads of neighbouring ranges do not decompress the blob again. Reads hinted NOCACHE or DONTNEED are not cached.")
+    .add_see_also("bluestore_default_buffered_read"),
+
     Option("bluestore_default_buffered_write", Option::TYPE_BOOL, Option::LEVEL_ADVANCED)
     .set_default(false)
     .set_flag(Option::FLAG_RUNTIME)
@@ -4580,6 +4803,10 @@ std::vector<Option> get_global_options() {
     .set_default(4)
     .set_description(""),
 
+    Option("bluestore_hybrid_alloc_mem_cap", Option::TYPE_UINT, Option::LEVEL_DEV)
+    .set_default(64_M)
+    .set_description("Maximum RAM hybrid allocator should use before enabling bitmap supplement"),
+
     // -----------------------------------------
     // kstore
 
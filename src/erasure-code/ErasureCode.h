@@ -120,6 +120,10 @@ namespace ceph {
     int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) override;
 
+    bool supports_stripe_batching() const override {
+      return false;
+    }
+
   protected:
     int parse(const ErasureCodeProfile &profile,
 	      std::ostream *ss);
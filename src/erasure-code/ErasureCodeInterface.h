@@ -459,6 +459,20 @@ namespace ceph {
      */
     virtual int decode_concat(const std::map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    /**
+     * Return true if the chunks of several stripes can be coded with
+     * a single call.
+     *
+     * That holds when each byte of a coding chunk only depends on the
+     * bytes at the same offset of the other chunks, so that the
+     * concatenation of the chunks of consecutive stripes encodes and
+     * decodes like one large stripe.  Such codes are also expected to
+     * allow concurrent **encode_chunks** and **decode** calls.
+     *
+     * @return **true** if stripes may be batched
+     */
+    virtual bool supports_stripe_batching() const = 0;
   };
 
   typedef std::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
@@ -80,6 +80,13 @@ public:
                             const std::map<int, ceph::buffer::list> &chunks,
                             std::map<int, ceph::buffer::list> *decoded) override;
 
+  // ec_encode_data() works bytewise and the decoding tables are
+  // shared through a locked cache
+  bool supports_stripe_batching() const override
+  {
+    return true;
+  }
+
   int init(ceph::ErasureCodeProfile &profile, std::ostream *ss) override;
 
   virtual void isa_encode(char **data,
@@ -63,6 +63,12 @@ public:
 		    const std::map<int, ceph::buffer::list> &chunks,
 		    std::map<int, ceph::buffer::list> *decoded) override;
 
+  // every technique codes blocks of w * packetsize bytes (or words)
+  // independently, and the matrices are read-only once prepared
+  bool supports_stripe_batching() const override {
+    return true;
+  }
+
   int init(ceph::ErasureCodeProfile &profile, std::ostream *ss) override;
 
   virtual void jerasure_encode(char **data,
@@ -78,6 +78,9 @@
 /* Defind if you have POSIX AIO */
 #cmakedefine HAVE_POSIXAIO
 
+/* Defined if you have liburing */
+#cmakedefine HAVE_LIBURING
+
 /* Defined if OpenLDAP enabled */
 #cmakedefine HAVE_OPENLDAP
 
@@ -208,6 +211,9 @@
 /* Define to 1 if you have the <linux/version.h> header file. */
 #cmakedefine HAVE_LINUX_VERSION_H 1
 
+/* Define to 1 if you have the <linux/blkzoned.h> header file. */
+#cmakedefine HAVE_LINUX_BLKZONED_H 1
+
 /* Define to 1 if you have sched.h. */
 #cmakedefine HAVE_SCHED 1
 
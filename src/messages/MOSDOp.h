@@ -36,7 +36,7 @@ namespace _mosdop {
 template<typename V>
 class MOSDOp : public MOSDFastDispatchOp {
 private:
-  static constexpr int HEAD_VERSION = 8;
+  static constexpr int HEAD_VERSION = 9;
   static constexpr int COMPAT_VERSION = 3;
 
 private:
@@ -65,6 +65,15 @@ private:
   bool bdata_encode;
   osd_reqid_t reqid; // reqid explicitly set by sender
 
+  // dmclock delta/rho: responses the client got from other OSDs since
+  // its previous request to this one (in total, and in reservation phase)
+  uint32_t qos_delta = 0;
+  uint32_t qos_rho = 0;
+
+  // set by the scheduler on the OSD, and returned in the reply
+  bool qos_reservation = false;
+  uint32_t qos_cost = 0;
+
 public:
   friend MOSDOpReply;
 
@@ -82,6 +91,14 @@ public:
   void set_spg(spg_t p) {
     pgid = p;
   }
+  void set_qos_params(uint32_t delta, uint32_t rho) {
+    qos_delta = delta;
+    qos_rho = rho;
+  }
+  void set_qos_response(bool reservation, uint32_t cost) {
+    qos_reservation = reservation;
+    qos_cost = cost;
+  }
 
   // Fields decoded in partial decoding
   pg_t get_pg() const {
@@ -104,6 +121,14 @@ public:
     ceph_assert(!partial_decode_needed);
     return flags;
   }
+  uint32_t get_qos_delta() const {
+    ceph_assert(!partial_decode_needed);
+    return qos_delta;
+  }
+  uint32_t get_qos_rho() const {
+    ceph_assert(!partial_decode_needed);
+    return qos_rho;
+  }
   osd_reqid_t get_reqid() const {
     ceph_assert(!partial_decode_needed);
     if (reqid.name != entity_name_t() || reqid.tid != 0) {
@@ -361,7 +386,7 @@ struct ceph_osd_request_head {
       encode(retry_attempt, payload);
       encode(features, payload);
     } else {
-      // latest v8 encoding with hobject_t hash separate from pgid, no
+      // latest v9 encoding with hobject_t hash separate from pgid, no
       // reassert version
       header.version = HEAD_VERSION;
 
@@ -371,6 +396,12 @@ struct ceph_osd_request_head {
       encode(flags, payload);
       encode(reqid, payload);
       encode_trace(payload, features);
+      if (HAVE_FEATURE(features, OSD_OP_QOS)) {
+	encode(qos_delta, payload);
+	encode(qos_rho, payload);
+      } else {
+	header.version = 8;
+      }
 
       // -- above decoded up front; below decoded post-dispatch thread --
 
@@ -399,7 +430,7 @@ struct ceph_osd_request_head {
     p = std::cbegin(payload);
 
     // Always keep here the newest version of decoding order/rule
-    if (header.version == HEAD_VERSION) {
+    if (header.version >= 8) {
       decode(pgid, p);      // actual pgid
       uint32_t hash;
       decode(hash, p); // raw hash value
@@ -408,6 +439,10 @@ struct ceph_osd_request_head {
       decode(flags, p);
       decode(reqid, p);
       decode_trace(p);
+      if (header.version >= 9) {
+	decode(qos_delta, p);
+	decode(qos_rho, p);
+      }
     } else if (header.version == 7) {
       decode(pgid.pgid, p);      // raw pgid
       hobj.set_hash(pgid.pgid.ps());
@@ -31,7 +31,7 @@
 
 class MOSDOpReply : public Message {
 private:
-  static constexpr int HEAD_VERSION = 8;
+  static constexpr int HEAD_VERSION = 9;
   static constexpr int COMPAT_VERSION = 2;
 
   object_t oid;
@@ -47,6 +47,8 @@ private:
   int32_t retry_attempt = -1;
   bool do_redirect;
   request_redirect_t redirect;
+  bool qos_reservation = false;  ///< served in the dmclock reservation phase
+  uint32_t qos_cost = 0;         ///< dmclock cost charged for the op
 
 public:
   const object_t& get_oid() const { return oid; }
@@ -125,6 +127,9 @@ public:
   int get_retry_attempt() const {
     return retry_attempt;
   }
+
+  bool get_qos_reservation() const { return qos_reservation; }
+  uint32_t get_qos_cost() const { return qos_cost; }
   
   // osdmap
   epoch_t get_map_epoch() const { return osdmap_epoch; }
@@ -154,6 +159,8 @@ public:
     user_version = 0;
     retry_attempt = req->get_retry_attempt();
     do_redirect = false;
+    qos_reservation = req->qos_reservation;
+    qos_cost = req->qos_cost;
 
     for (unsigned i = 0; i < ops.size(); i++) {
       // zero out input data
@@ -223,6 +230,12 @@ public:
         }
       }
       encode_trace(payload, features);
+      if (HAVE_FEATURE(features, OSD_OP_QOS)) {
+	encode(qos_reservation, payload);
+	encode(qos_cost, payload);
+      } else if (header.version == HEAD_VERSION) {
+	header.version = 8;
+      }
     }
   }
   void decode_payload() override {
@@ -256,6 +269,8 @@ public:
       if (do_redirect)
 	decode(redirect, p);
       decode_trace(p);
+      decode(qos_reservation, p);
+      decode(qos_cost, p);
     } else if (header.version < 2) {
       ceph_osd_reply_head head;
       decode(head, p);
@@ -5204,7 +5204,7 @@ namespace {
     COMPRESSION_MAX_BLOB_SIZE, COMPRESSION_MIN_BLOB_SIZE,
     CSUM_TYPE, CSUM_MAX_BLOCK, CSUM_MIN_BLOCK, FINGERPRINT_ALGORITHM,
     PG_AUTOSCALE_MODE, PG_NUM_MIN, TARGET_SIZE_BYTES, TARGET_SIZE_RATIO,
-    PG_AUTOSCALE_BIAS };
+    PG_AUTOSCALE_BIAS, QOS_RESERVATION, QOS_WEIGHT, QOS_LIMIT };
 
   std::set<osd_pool_get_choices>
     subtract_second_from_first(const std::set<osd_pool_get_choices>& first,
@@ -5939,6 +5939,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
       {"target_size_bytes", TARGET_SIZE_BYTES},
       {"target_size_ratio", TARGET_SIZE_RATIO},
       {"pg_autoscale_bias", PG_AUTOSCALE_BIAS},
+      {"qos_reservation", QOS_RESERVATION},
+      {"qos_weight", QOS_WEIGHT},
+      {"qos_limit", QOS_LIMIT},
     };
 
     typedef std::set<osd_pool_get_choices> choices_set_t;
@@ -6155,6 +6158,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	  case TARGET_SIZE_BYTES:
 	  case TARGET_SIZE_RATIO:
 	  case PG_AUTOSCALE_BIAS:
+	  case QOS_RESERVATION:
+	  case QOS_WEIGHT:
+	  case QOS_LIMIT:
             pool_opts_t::key_t key = pool_opts_t::get_opt_desc(i->first).key;
             if (p->opts.is_set(key)) {
               if(*it == CSUM_TYPE) {
@@ -6312,6 +6318,9 @@ bool OSDMonitor::preprocess_command(MonOpRequestRef op)
 	  case TARGET_SIZE_BYTES:
 	  case TARGET_SIZE_RATIO:
 	  case PG_AUTOSCALE_BIAS:
+	  case QOS_RESERVATION:
+	  case QOS_WEIGHT:
+	  case QOS_LIMIT:
 	    for (i = ALL_CHOICES.begin(); i != ALL_CHOICES.end(); ++i) {
 	      if (i->second == *it)
 		break;
@@ -8430,6 +8439,12 @@ int OSDMonitor::prepare_command_pool_set(const cmdmap_t& cmdmap,
 	ss << "pg_autoscale_bias must be between 0 and 1000";
 	return -EINVAL;
       }
+    } else if (var == "qos_reservation" || var == "qos_weight" ||
+	       var == "qos_limit") {
+      if (f < 0.0) {
+	ss << var << " must be >= 0";
+	return -EINVAL;
+      }
     }
 
     pool_opts_t::opt_desc_t desc = pool_opts_t::get_opt_desc(var);
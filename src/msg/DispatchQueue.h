@@ -202,6 +202,7 @@ class DispatchQueue {
   void fast_dispatch(Message* m) {
     return fast_dispatch(ref_t<Message>(m, false)); /* consume ref */
   }
+  void fast_dispatch_batch(std::vector<ref_t<Message>>& ms);
   void fast_preprocess(const ref_t<Message>& m);
   void enqueue(const ref_t<Message>& m, int priority, uint64_t id);
   void enqueue(Message* m, int priority, uint64_t id) {
@@ -17,6 +17,7 @@
 #define CEPH_DISPATCHER_H
 
 #include <memory>
+#include <vector>
 #include "include/buffer_fwd.h"
 #include "include/ceph_assert.h"
 #include "msg/MessageRef.h"
@@ -84,6 +85,21 @@ public:
     return ms_fast_dispatch(MessageRef(m).detach()); /* XXX N.B. always consumes ref */
   }
 
+  /**
+   * Perform a "fast dispatch" on a batch of messages read off one
+   * Connection in a single burst, in receipt order. The same rules as
+   * for ms_fast_dispatch() apply to each of them. Dispatchers may
+   * override this to amortize per-message costs (e.g. queue locks)
+   * over the batch; by default each message is fast dispatched in turn.
+   *
+   * @param ms The Messages to fast dispatch; all of them are consumed.
+   */
+  virtual void ms_fast_dispatch_batch(std::vector<MessageRef>& ms) {
+    for (auto& m : ms) {
+      ms_fast_dispatch2(m);
+    }
+  }
+
   /**
    * Let the Dispatcher preview a Message before it is dispatched. This
    * function is called on *every* Message, prior to the fast/regular dispatch
@@ -672,6 +672,42 @@ public:
   void ms_fast_dispatch(Message *m) {
     return ms_fast_dispatch(ref_t<Message>(m, false)); /* consume ref */
   }
+  /**
+   * Deliver a batch of Messages via "fast dispatch", in order. Runs of
+   * consecutive Messages handled by the same Dispatcher are handed to it
+   * as one batch.
+   *
+   * @param ms The Messages we are fast dispatching; cleared on return.
+   * If none of our Dispatchers can handle one of them, ceph_abort().
+   */
+  void ms_fast_dispatch_batch(std::vector<ref_t<Message>>& ms) {
+    const utime_t now = ceph_clock_now();
+    std::vector<ref_t<Message>> run;
+    Dispatcher *run_dispatcher = nullptr;
+    for (auto& m : ms) {
+      m->set_dispatch_stamp(now);
+      Dispatcher *d = nullptr;
+      for (const auto &dispatcher : fast_dispatchers) {
+	if (dispatcher->ms_can_fast_dispatch2(m)) {
+	  d = dispatcher;
+	  break;
+	}
+      }
+      if (!d) {
+	ceph_abort();
+      }
+      if (d != run_dispatcher && !run.empty()) {
+	run_dispatcher->ms_fast_dispatch_batch(run);
+	run.clear();
+      }
+      run_dispatcher = d;
+      run.push_back(std::move(m));
+    }
+    if (!run.empty()) {
+      run_dispatcher->ms_fast_dispatch_batch(run);
+    }
+    ms.clear();
+  }
   /**
    *
    */
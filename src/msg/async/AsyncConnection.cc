@@ -234,14 +234,16 @@ ssize_t AsyncConnection::read_until(unsigned len, char *p)
   recv_end = recv_start = 0;
   /* nothing left in the prefetch buffer */
   if (left > (uint64_t)recv_max_prefetch) {
-    /* this was a large read, we don't prefetch for these */
+    /* this was a large read, it goes straight into p, and whatever
+     * follows it into the prefetch buffer */
     do {
-      r = read_bulk(p+state_offset, left);
+      r = read_bulk(p+state_offset, left, true);
       ldout(async_msgr->cct, 25) << __func__ << " read_bulk left is " << left << " got " << r << dendl;
       if (r < 0) {
         ldout(async_msgr->cct, 1) << __func__ << " read failed" << dendl;
         return -1;
-      } else if (r == static_cast<int>(left)) {
+      } else if (r >= static_cast<int>(left)) {
+        recv_end = r - left;
         state_offset = 0;
         return 0;
       }
@@ -276,12 +278,21 @@ ssize_t AsyncConnection::read_until(unsigned len, char *p)
 }
 
 /* return -1 means `fd` occurs error or closed, it should be closed
- * return 0 means EAGAIN or EINTR */
-ssize_t AsyncConnection::read_bulk(char *buf, unsigned len)
+ * return 0 means EAGAIN or EINTR
+ * with prefetch, anything read beyond len is in recv_buf */
+ssize_t AsyncConnection::read_bulk(char *buf, unsigned len, bool prefetch)
 {
   ssize_t nread;
  again:
-  nread = cs.read(buf, len);
+  if (prefetch) {
+    struct iovec iov[2] = {
+      { buf, len },
+      { recv_buf, static_cast<size_t>(recv_max_prefetch) }
+    };
+    nread = cs.readv(iov, 2);
+  } else {
+    nread = cs.read(buf, len);
+  }
   if (nread < 0) {
     if (nread == -EAGAIN) {
       nread = 0;
@@ -369,6 +380,12 @@ void AsyncConnection::process() {
 
   ldout(async_msgr->cct, 20) << __func__ << dendl;
 
+  // completed sends raise read events too; reap them whatever the
+  // protocol is waiting for, it may not read for a while
+  if (cs) {
+    cs.reap_send_completions();
+  }
+
   switch (state) {
     case STATE_NONE: {
       ldout(async_msgr->cct, 20) << __func__ << " enter none state" << dendl;
@@ -54,7 +54,7 @@ class AsyncConnection : public Connection {
   ssize_t read(unsigned len, char *buffer,
                std::function<void(char *, ssize_t)> callback);
   ssize_t read_until(unsigned needed, char *p);
-  ssize_t read_bulk(char *buf, unsigned len);
+  ssize_t read_bulk(char *buf, unsigned len, bool prefetch = false);
 
   ssize_t write(bufferlist &bl, std::function<void(ssize_t)> callback,
                 bool more=false);
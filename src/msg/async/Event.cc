@@ -94,6 +94,31 @@ EventCenter::Poller::~Poller()
   slot = -1;
 }
 
+/*
+ * Keeps the center polling for a while after it last handled events, so
+ * the next ones are picked up without the wakeup latency of sleeping in
+ * the event driver.  A busy center never sleeps; an idle one sleeps once
+ * the budget runs out.
+ */
+class EventCenter::BusyPoller : public EventCenter::Poller {
+  const ceph::timespan budget;
+  ceph::mono_clock::time_point deadline;
+
+ public:
+  BusyPoller(EventCenter *center, ceph::timespan budget)
+    : Poller(center, "EventCenter::BusyPoller"), budget(budget) {}
+
+  int poll() override {
+    return 0;
+  }
+  bool keep_polling(ceph::mono_clock::time_point now) override {
+    return now < deadline;
+  }
+  void busy(ceph::mono_clock::time_point now) {
+    deadline = now + budget;
+  }
+};
+
 ostream& EventCenter::_event_prefix(std::ostream *_dout)
 {
   return *_dout << "Event(" << this << " nevent=" << nevent
@@ -138,6 +163,14 @@ int EventCenter::init(int nevent, unsigned center_id, const std::string &type)
   file_events.resize(nevent);
   this->nevent = nevent;
 
+  // dpdk polls all the time anyway
+  const uint64_t busy_poll_us =
+    cct->_conf.get_val<uint64_t>("ms_async_busy_poll_us");
+  if (busy_poll_us && type != "dpdk") {
+    busy_poller = std::make_unique<BusyPoller>(
+      this, std::chrono::microseconds(busy_poll_us));
+  }
+
   if (!driver->need_wakeup())
     return 0;
 
@@ -321,8 +354,14 @@ void EventCenter::delete_time_event(uint64_t id)
 void EventCenter::wakeup()
 {
   // No need to wake up since we never sleep
-  if (!pollers.empty() || !driver->need_wakeup())
+  if (!driver->need_wakeup())
     return ;
+  // or are not sleeping now, and will check before we do
+  if (!pollers.empty()) {
+    wakeup_requested = true;
+    if (!sleeping.load())
+      return ;
+  }
 
   ldout(cct, 20) << __func__ << dendl;
   char buf = 'c';
@@ -361,7 +400,19 @@ int EventCenter::process_time_events()
   return processed;
 }
 
-int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *working_dur)
+bool EventCenter::keep_polling(ceph::mono_clock::time_point now) const
+{
+  for (auto p : pollers) {
+    if (p->keep_polling(now))
+      return true;
+  }
+  return false;
+}
+
+int EventCenter::process_events(unsigned timeout_microseconds,
+				ceph::timespan *working_dur,
+				ceph::timespan *idle_dur,
+				ceph::timespan *poll_dur)
 {
   struct timeval tv;
   int numevents;
@@ -381,7 +432,17 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
     }
   }
 
-  bool blocking = pollers.empty() && !external_num_events.load();
+  auto poll_start = ceph::mono_clock::now();
+  bool blocking = !external_num_events.load() && !keep_polling(poll_start);
+  if (blocking && !pollers.empty()) {
+    // wakeup() skips waking us while we poll: tell it we are going to
+    // sleep, then make sure nobody asked before it could see that
+    sleeping = true;
+    if (wakeup_requested.exchange(false) || external_num_events.load()) {
+      sleeping = false;
+      blocking = false;
+    }
+  }
   if (!blocking)
     timeout_microseconds = 0;
   tv.tv_sec = timeout_microseconds / 1000000;
@@ -391,6 +452,8 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
   vector<FiredFileEvent> fired_events;
   numevents = driver->event_wait(fired_events, &tv);
   auto working_start = ceph::mono_clock::now();
+  if (blocking && !pollers.empty())
+    sleeping = false;
   for (int event_id = 0; event_id < numevents; event_id++) {
     int rfired = 0;
     FileEvent *event;
@@ -440,8 +503,16 @@ int EventCenter::process_events(unsigned timeout_microseconds,  ceph::timespan *
       numevents += pollers[i]->poll();
   }
 
+  auto working_end = ceph::mono_clock::now();
+  if (numevents && busy_poller)
+    busy_poller->busy(working_end);
+  if (idle_dur)
+    *idle_dur = blocking ? working_start - poll_start : ceph::timespan::zero();
+  if (poll_dur)
+    *poll_dur = !blocking && !numevents ? working_end - poll_start :
+      ceph::timespan::zero();
   if (working_dur)
-    *working_dur = ceph::mono_clock::now() - working_start;
+    *working_dur = working_end - working_start;
   return numevents;
 }
 
@@ -38,6 +38,7 @@
 #endif
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 
@@ -133,6 +134,14 @@ class EventCenter {
      */
     virtual int poll() = 0;
 
+    /**
+     * Whether the center should keep polling instead of sleeping in the
+     * event driver while it finds nothing to do.
+     */
+    virtual bool keep_polling(ceph::mono_clock::time_point now) {
+      return true;
+    }
+
    private:
     /// The EventCenter object that owns this Poller.  NULL means the
     /// EventCenter has been deleted.
@@ -166,6 +175,12 @@ class EventCenter {
   // use an intrusive list here because it isn't reentrant: we need
   // to add/remove elements while the center is traversing the list.
   std::vector<Poller*> pollers;
+  class BusyPoller;
+  std::unique_ptr<BusyPoller> busy_poller;
+  // with pollers, wakeup() only wakes us if we are about to sleep;
+  // otherwise it leaves a request for us to see before we do
+  std::atomic<bool> sleeping = {false};
+  std::atomic<bool> wakeup_requested = {false};
   std::map<uint64_t, std::multimap<clock_type::time_point, TimeEvent>::iterator> event_map;
   uint64_t time_event_next_id;
   int notify_receive_fd;
@@ -176,6 +191,7 @@ class EventCenter {
   AssociatedCenters *global_centers = nullptr;
 
   int process_time_events();
+  bool keep_polling(ceph::mono_clock::time_point now) const;
   FileEvent *_get_file_event(int fd) {
     ceph_assert(fd < nevent);
     return &file_events[fd];
@@ -203,7 +219,19 @@ class EventCenter {
   uint64_t create_time_event(uint64_t milliseconds, EventCallbackRef ctxt);
   void delete_file_event(int fd, int mask);
   void delete_time_event(uint64_t id);
-  int process_events(unsigned timeout_microseconds, ceph::timespan *working_dur = nullptr);
+  /**
+   * Wait for events and handle them
+   *
+   * @param timeout_microseconds longest to wait
+   * @param[out] working_dur time spent handling events
+   * @param[out] idle_dur time spent sleeping in the event driver
+   * @param[out] poll_dur time spent busy polling without finding events
+   * @return the number of events handled
+   */
+  int process_events(unsigned timeout_microseconds,
+		     ceph::timespan *working_dur = nullptr,
+		     ceph::timespan *idle_dur = nullptr,
+		     ceph::timespan *poll_dur = nullptr);
   void wakeup();
 
   // Used by external thread
@@ -15,17 +15,23 @@
  */
 
 #include <sys/socket.h>
+#include <poll.h>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
 #include "include/buffer.h"
 #include "include/str_list.h"
+#include "common/ceph_time.h"
 #include "common/errno.h"
 #include "common/strtol.h"
 #include "common/dout.h"
@@ -37,15 +43,94 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define HAVE_MSG_ZEROCOPY
+#endif
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
+  Worker *worker;
+
+  /*
+   * MSG_ZEROCOPY: the kernel sends straight out of our buffers, so
+   * they are held until it reports on the error queue that it is done
+   * with them.  Each zero-copy sendmsg() is numbered by the kernel, and
+   * with TCP the notifications come back in order.
+   */
+  uint64_t zerocopy_min_bytes = 0;  ///< 0 if zero-copy is off
+  uint32_t zerocopy_next_seq = 0;   ///< number of the next zero-copy call
+  /// buffers sent, with the number of the last call sending them
+  std::deque<std::pair<uint32_t, bufferlist>> zerocopy_pending;
+  /// how long close() waits for the kernel to be done with them
+  static constexpr auto zerocopy_close_wait = std::chrono::milliseconds(100);
+
+ public:
+  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected,
+				    Worker *w)
+      : handler(h), _fd(f), sa(sa), connected(connected), worker(w) {
+    init_zerocopy();
+  }
+
+ private:
+  void init_zerocopy() {
+#ifdef HAVE_MSG_ZEROCOPY
+    CephContext *cct = worker->cct;
+    uint64_t min_bytes =
+      cct->_conf.get_val<Option::size_t>("ms_async_send_zerocopy_min_bytes");
+    if (!min_bytes)
+      return;
+    int on = 1;
+    if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0) {
+      int r = -errno;
+      ldout(cct, 1) << __func__ << " unable to enable SO_ZEROCOPY on fd "
+		    << _fd << ": " << cpp_strerror(r) << dendl;
+      return;
+    }
+    zerocopy_min_bytes = min_bytes;
+#endif
+  }
+
+  /// release the buffers the kernel is done with
+  void reap_zerocopy() {
+#ifdef HAVE_MSG_ZEROCOPY
+    // drain the error queue, anything left on it keeps raising EPOLLERR
+    while (true) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+	// EAGAIN: nothing more to reap yet
+	break;
+      }
+      for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+	   cm = CMSG_NXTHDR(&msg, cm)) {
+	if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+	      (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+	  continue;
+	auto serr = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+	if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+	  continue;
+	// calls [ee_info, ee_data] are done
+	uint32_t hi = serr->ee_data;
+	if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+	  worker->perf_logger->inc(l_msgr_send_zerocopy_fallbacks,
+				   hi - serr->ee_info + 1);
+	}
+	while (!zerocopy_pending.empty() &&
+	       (int32_t)(zerocopy_pending.front().first - hi) <= 0) {
+	  zerocopy_pending.pop_front();
+	}
+      }
+    }
+#endif
+  }
 
  public:
-  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
 
   int is_connected() override {
     if (connected)
@@ -73,24 +158,45 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     return r;
   }
 
+  ssize_t readv(const struct iovec *iov, int iovcnt) override {
+    ssize_t r = ::readv(_fd, iov, iovcnt);
+    if (r < 0)
+      r = -errno;
+    return r;
+  }
+
   // return the sent length
   // < 0 means error occurred
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  ssize_t do_sendmsg(struct msghdr &msg, unsigned len, bool more, bool *zerocopy)
   {
     size_t sent = 0;
     while (1) {
       MSGR_SIGPIPE_STOPPER;
       ssize_t r;
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      int flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+#ifdef HAVE_MSG_ZEROCOPY
+      if (*zerocopy)
+	flags |= MSG_ZEROCOPY;
+#endif
+      r = ::sendmsg(_fd, &msg, flags);
       if (r < 0) {
         if (errno == EINTR) {
           continue;
         } else if (errno == EAGAIN) {
           break;
+        } else if (errno == ENOBUFS && *zerocopy) {
+          // out of optmem to pin pages with, copy the rest
+          worker->perf_logger->inc(l_msgr_send_zerocopy_fallbacks);
+          *zerocopy = false;
+          continue;
         }
         return -errno;
       }
 
+      if (*zerocopy) {
+        ++zerocopy_next_seq;
+        worker->perf_logger->inc(l_msgr_send_zerocopy_bytes, r);
+      }
       sent += r;
       if (len == sent) break;
 
@@ -111,6 +217,10 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t send(bufferlist &bl, bool more) override {
+    if (!zerocopy_pending.empty())
+      reap_zerocopy();
+    bool zerocopy = zerocopy_min_bytes && bl.length() >= zerocopy_min_bytes;
+    uint32_t zerocopy_first_seq = zerocopy_next_seq;
     size_t sent_bytes = 0;
     auto pb = std::cbegin(bl.buffers());
     uint64_t left_pbrs = std::size(bl.buffers());
@@ -129,7 +239,7 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 	msglen += pb->length();
 	++pb;
       }
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      ssize_t r = do_sendmsg(msg, msglen, left_pbrs || more, &zerocopy);
       if (r < 0)
         return r;
 
@@ -146,17 +256,55 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
         bl.swap(swapped);
       } else {
-        bl.clear();
+        swapped.swap(bl);
+      }
+      if (zerocopy_next_seq != zerocopy_first_seq) {
+        // swapped holds what was sent, keep it until the kernel is done
+        zerocopy_pending.emplace_back(zerocopy_next_seq - 1,
+                                      std::move(swapped));
       }
     }
 
     return static_cast<ssize_t>(sent_bytes);
   }
+  // the completions on the error queue raise EPOLLERR, which is
+  // delivered as a read event: an idle connection would otherwise pin
+  // its last sends until the next one
+  void reap_send_completions() override {
+    if (!zerocopy_pending.empty())
+      reap_zerocopy();
+  }
   void shutdown() override {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
+    // give the kernel a moment to get what we sent out
+    auto deadline = ceph::mono_clock::now() + zerocopy_close_wait;
+    while (!zerocopy_pending.empty()) {
+      reap_zerocopy();
+      auto now = ceph::mono_clock::now();
+      if (zerocopy_pending.empty() || now >= deadline)
+	break;
+      struct pollfd pfd = {_fd, 0, 0};  // POLLERR is always reported
+      if (::poll(&pfd, 1, std::chrono::ceil<std::chrono::milliseconds>(
+		   deadline - now).count()) <= 0)
+	break;
+    }
+    if (!zerocopy_pending.empty()) {
+      // the kernel would go on sending out of these buffers after the
+      // close, and we could not tell when it is done; reset the
+      // connection instead, which drops what it has not sent yet
+      ldout(worker->cct, 1) << __func__ << " resetting fd " << _fd
+			    << " with " << zerocopy_pending.size()
+			    << " zero-copy sends in flight" << dendl;
+      struct linger l = {1, 0};
+      if (::setsockopt(_fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l)) < 0) {
+	ldout(worker->cct, 1) << __func__ << " unable to set SO_LINGER on fd "
+			      << _fd << ": " << cpp_strerror(errno) << dendl;
+      }
+    }
     ::close(_fd);
+    zerocopy_pending.clear();
   }
   int fd() const override {
     return _fd;
@@ -211,7 +359,7 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   out->set_sockaddr((sockaddr*)&ss);
   handler.set_priority(sd, opt.priority, out->get_family());
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true, w));
   *sock = ConnectedSocket(std::move(csi));
   return 0;
 }
@@ -280,7 +428,7 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority, addr.get_family());
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock, this)));
   return 0;
 }
 
@@ -53,6 +53,33 @@ void ProtocolV2::run_continuation(CtRef continuation) {
   } catch (const DecryptionError &) {
     lderr(cct) << __func__ << " failed to decrypt frame payload" << dendl;
   }
+  // nothing more to read for now: deliver what we got. _fault() and stop()
+  // have already flushed or dropped it if the connection went down
+  flush_fast_dispatch();
+}
+
+// returns false if the connection changed state (e.g. was reused by
+// another connection) while it was unlocked for dispatch
+bool ProtocolV2::flush_fast_dispatch() {
+  if (pending_fast_dispatch.empty()) {
+    return true;
+  }
+  const auto prev_state = state;
+  std::vector<ref_t<Message>> batch;
+  batch.swap(pending_fast_dispatch);
+  ldout(cct, 20) << __func__ << " " << batch.size() << " messages" << dendl;
+  const auto fast_dispatch_time = ceph::mono_clock::now();
+  connection->lock.unlock();
+  connection->dispatch_queue->fast_dispatch_batch(batch);
+  connection->recv_start_time = ceph::mono_clock::now();
+  connection->logger->tinc(l_msgr_running_fast_dispatch_time,
+                           connection->recv_start_time - fast_dispatch_time);
+  connection->lock.lock();
+  if (pending_fast_dispatch.empty()) {
+    // keep the capacity for the next burst
+    pending_fast_dispatch.swap(batch);
+  }
+  return state == prev_state;
 }
 
 #define WRITE(B, D, C) write(D, CONTINUATION(C), B)
@@ -93,7 +120,9 @@ ProtocolV2::ProtocolV2(AsyncConnection *connection)
       can_write(false),
       bannerExchangeCallback(nullptr),
       next_tag(static_cast<Tag>(0)),
-      keepalive(false) {
+      keepalive(false),
+      fast_dispatch_batch_size(
+	cct->_conf.get_val<uint64_t>("ms_fast_dispatch_batch_size")) {
 }
 
 ProtocolV2::~ProtocolV2() {
@@ -144,6 +173,7 @@ void ProtocolV2::reset_session() {
   }
 
   connection->dispatch_queue->discard_queue(connection->conn_id);
+  pending_fast_dispatch.clear();
   discard_out_queue();
   connection->outgoing_bl.clear();
 
@@ -172,6 +202,8 @@ void ProtocolV2::stop() {
 
   reset_recv_state();
   discard_out_queue();
+  // the session is gone, don't deliver what is left of its last burst
+  pending_fast_dispatch.clear();
 
   connection->_stop();
 
@@ -302,6 +334,14 @@ CtPtr ProtocolV2::_fault() {
     return nullptr;
   }
 
+  // messages read before the fault are acked already, hand them to the
+  // dispatcher ahead of the reset we may queue below
+  if (!flush_fast_dispatch()) {
+    ldout(cct, 10) << __func__ << " connection changed state while dispatching"
+                   << dendl;
+    return nullptr;
+  }
+
   if (connection->policy.lossy &&
       !(state >= START_CONNECT && state <= SESSION_RECONNECTING)) {
     ldout(cct, 2) << __func__ << " on lossy channel, failing" << dendl;
@@ -1169,7 +1209,7 @@ CtPtr ProtocolV2::read_frame_segment() {
   const auto& cur_rx_desc = rx_segments_desc.at(rx_segments_data.size());
   rx_buffer_t rx_buffer;
   try {
-    rx_buffer = buffer::ptr_node::create(buffer::create_aligned(
+    rx_buffer = buffer::ptr_node::create(connection->worker->create_rx_buffer(
       get_onwire_size(cur_rx_desc.length), cur_rx_desc.alignment));
   } catch (std::bad_alloc&) {
     // Catching because of potential issues with satisfying alignment.
@@ -1519,6 +1559,7 @@ CtPtr ProtocolV2::handle_message() {
   connection->logger->tinc(l_msgr_running_recv_time,
 			   fast_dispatch_time - connection->recv_start_time);
   if (connection->delay_state) {
+    const bool reused = !flush_fast_dispatch();
     double delay_period = 0;
     if (rand() % 10000 < cct->_conf->ms_inject_delay_probability * 10000.0) {
       delay_period =
@@ -1528,22 +1569,29 @@ CtPtr ProtocolV2::handle_message() {
                     << " " << *message << dendl;
     }
     connection->delay_state->queue(delay_period, message);
-  } else if (messenger->ms_can_fast_dispatch(message)) {
-    connection->lock.unlock();
-    connection->dispatch_queue->fast_dispatch(message);
-    connection->recv_start_time = ceph::mono_clock::now();
-    connection->logger->tinc(l_msgr_running_fast_dispatch_time,
-                             connection->recv_start_time - fast_dispatch_time);
-    connection->lock.lock();
-    // we might have been reused by another connection
-    // let's check if that is the case
-    if (state != READY) {
-      // yes, that was the case, let's do nothing
+    if (reused) {
       return nullptr;
     }
+  } else if (messenger->ms_can_fast_dispatch(message)) {
+    // held until the rest of this read burst is parsed, see
+    // run_continuation()
+    pending_fast_dispatch.emplace_back(message, false);
+    if (pending_fast_dispatch.size() >= fast_dispatch_batch_size) {
+      // we might have been reused by another connection
+      // let's check if that is the case
+      if (!flush_fast_dispatch()) {
+	// yes, that was the case, let's do nothing
+	return nullptr;
+      }
+    }
   } else {
+    // keep it behind the fast dispatched messages that came before it
+    const bool reused = !flush_fast_dispatch();
     connection->dispatch_queue->enqueue(message, message->get_priority(),
                                         connection->conn_id);
+    if (reused) {
+      return nullptr;
+    }
   }
 
   handle_message_ack(current_header.ack_seq);
@@ -115,9 +115,14 @@ private:
   bool keepalive;
   bool write_in_progress = false;
 
+  // messages read in this burst, fast dispatched together
+  std::vector<ceph::ref_t<Message>> pending_fast_dispatch;
+  const uint64_t fast_dispatch_batch_size;
+
   ostream &_conn_prefix(std::ostream *_dout);
   void run_continuation(Ct<ProtocolV2> *pcontinuation);
   void run_continuation(Ct<ProtocolV2> &continuation);
+  bool flush_fast_dispatch();
 
   Ct<ProtocolV2> *read(CONTINUATION_RXBPTR_TYPE<ProtocolV2> &next,
                        rx_buffer_t&& buffer);
@@ -0,0 +1,104 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "include/buffer_raw.h"
+#include "include/intarith.h"
+#include "include/page.h"
+#include "RxBufferPool.h"
+
+class RxBufferPool::raw_pooled : public ceph::buffer::raw {
+  std::shared_ptr<RxBufferPool> pool;
+  unsigned order;
+
+  /// what the buffer holds past len, which raw does not account for
+  uint64_t get_slack() const {
+    return (CEPH_PAGE_SIZE << order) - len;
+  }
+ public:
+  raw_pooled(std::shared_ptr<RxBufferPool> pool, char *buf, unsigned len,
+	     unsigned order)
+    : raw(buf, len), pool(std::move(pool)), order(order) {
+    mempool::get_pool(mempool::mempool_buffer_anon).adjust_count(
+      0, get_slack());
+  }
+  ~raw_pooled() override {
+    mempool::get_pool(mempool::mempool_buffer_anon).adjust_count(
+      0, -(int64_t)get_slack());
+    pool->put(data, order);
+  }
+  raw* clone_empty() override {
+    return ceph::buffer::create_page_aligned(len).release();
+  }
+};
+
+RxBufferPool::~RxBufferPool()
+{
+  for (auto& free_list : free_lists) {
+    for (auto buf : free_list) {
+      ::free(buf);
+    }
+  }
+}
+
+unsigned RxBufferPool::get_order(unsigned len)
+{
+  unsigned pages = (len + CEPH_PAGE_SIZE - 1) >> CEPH_PAGE_SHIFT;
+  return pages > 1 ? cbits(pages - 1) : 0;
+}
+
+void RxBufferPool::put(char *buf, unsigned order)
+{
+  const uint64_t size = CEPH_PAGE_SIZE << order;
+  {
+    std::lock_guard l(lock);
+    if (cached_bytes + size <= max_bytes) {
+      free_lists[order].push_back(buf);
+      cached_bytes += size;
+      return;
+    }
+  }
+  ::free(buf);
+}
+
+ceph::unique_leakable_ptr<ceph::buffer::raw> RxBufferPool::create(
+  unsigned len, bool *reused)
+{
+  if (!max_bytes || len < CEPH_PAGE_SIZE) {
+    return nullptr;
+  }
+  const unsigned order = get_order(len);
+  if (order > MAX_ORDER) {
+    return nullptr;
+  }
+  const uint64_t size = CEPH_PAGE_SIZE << order;
+  char *buf = nullptr;
+  {
+    std::lock_guard l(lock);
+    if (!free_lists[order].empty()) {
+      buf = free_lists[order].back();
+      free_lists[order].pop_back();
+      cached_bytes -= size;
+    }
+  }
+  *reused = buf != nullptr;
+  if (!buf) {
+    void *p;
+    if (::posix_memalign(&p, CEPH_PAGE_SIZE, size)) {
+      throw std::bad_alloc();
+    }
+    buf = static_cast<char*>(p);
+  }
+  return ceph::unique_leakable_ptr<ceph::buffer::raw>(
+    new raw_pooled(shared_from_this(), buf, len, order));
+}
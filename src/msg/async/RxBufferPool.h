@@ -0,0 +1,59 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+#define CEPH_MSG_ASYNC_RXBUFFERPOOL_H
+
+#include <memory>
+#include <vector>
+
+#include "include/buffer.h"
+#include "include/spinlock.h"
+
+/**
+ * Page aligned receive buffers, recycled
+ *
+ * Frame segments are read into buffers handed out by the Worker's pool.
+ * The buffers go with the messages they are decoded into and are freed
+ * on whichever thread drops the last reference, at which point they
+ * return here to be read into again, up to max_bytes worth of them.
+ * Buffer sizes are rounded up to a power of two pages.
+ */
+class RxBufferPool : public std::enable_shared_from_this<RxBufferPool> {
+  class raw_pooled;
+
+  static constexpr unsigned MAX_ORDER = 10;  ///< pool up to 4MB buffers
+
+  ceph::spinlock lock;
+  std::vector<char*> free_lists[MAX_ORDER + 1];  ///< indexed by order
+  uint64_t max_bytes;
+  uint64_t cached_bytes = 0;
+
+  static unsigned get_order(unsigned len);
+  void put(char *buf, unsigned order);
+
+ public:
+  explicit RxBufferPool(uint64_t max_bytes)
+    : max_bytes(max_bytes) {}
+  ~RxBufferPool();
+
+  /**
+   * Get a buffer of len bytes, page aligned
+   *
+   * @param[out] reused true if the buffer was recycled
+   * @return a buffer, or nullptr if len is not pooled
+   */
+  ceph::unique_leakable_ptr<ceph::buffer::raw> create(unsigned len,
+						      bool *reused);
+};
+
+#endif
@@ -49,14 +49,17 @@ std::function<void ()> NetworkStack::add_thread(unsigned worker_id)
       while (!w->done) {
         ldout(cct, 30) << __func__ << " calling event process" << dendl;
 
-        ceph::timespan dur;
-        int r = w->center.process_events(EventMaxWaitUs, &dur);
+        ceph::timespan dur, idle_dur, poll_dur;
+        int r = w->center.process_events(EventMaxWaitUs, &dur, &idle_dur,
+                                         &poll_dur);
         if (r < 0) {
           ldout(cct, 20) << __func__ << " process events failed: "
                          << cpp_strerror(errno) << dendl;
           // TODO do something?
         }
         w->perf_logger->tinc(l_msgr_running_total_time, dur);
+        w->perf_logger->tinc(l_msgr_idle_time, idle_dur);
+        w->perf_logger->tinc(l_msgr_poll_time, poll_dur);
       }
       w->reset();
       w->destroy();
@@ -17,10 +17,14 @@
 #ifndef CEPH_MSG_ASYNC_STACK_H
 #define CEPH_MSG_ASYNC_STACK_H
 
+#include <sys/uio.h>
+
+#include "include/page.h"
 #include "include/spinlock.h"
 #include "common/perf_counters.h"
 #include "msg/msg_types.h"
 #include "msg/async/Event.h"
+#include "msg/async/RxBufferPool.h"
 
 class Worker;
 class ConnectedSocketImpl {
@@ -28,8 +32,14 @@ class ConnectedSocketImpl {
   virtual ~ConnectedSocketImpl() {}
   virtual int is_connected() = 0;
   virtual ssize_t read(char*, size_t) = 0;
+  /// scatter read, stacks without it just fill the first iovec
+  virtual ssize_t readv(const struct iovec *iov, int iovcnt) {
+    return read(static_cast<char*>(iov[0].iov_base), iov[0].iov_len);
+  }
   virtual ssize_t zero_copy_read(bufferptr&) = 0;
   virtual ssize_t send(bufferlist &bl, bool more) = 0;
+  /// release what the stack is done sending; called on every read event
+  virtual void reap_send_completions() {}
   virtual void shutdown() = 0;
   virtual void close() = 0;
   virtual int fd() const = 0;
@@ -94,6 +104,10 @@ class ConnectedSocket {
   ssize_t read(char* buf, size_t len) {
     return _csi->read(buf, len);
   }
+  /// Read the input stream into several buffers with copy.
+  ssize_t readv(const struct iovec *iov, int iovcnt) {
+    return _csi->readv(iov, iovcnt);
+  }
   /// Gets the input stream.
   ///
   /// Gets an object returning data sent from the remote endpoint.
@@ -106,6 +120,14 @@ class ConnectedSocket {
   ssize_t send(bufferlist &bl, bool more) {
     return _csi->send(bl, more);
   }
+  /// Releases buffers of earlier sends the stack is done with.
+  ///
+  /// Some stacks hold on to the data sent until they are told it is
+  /// out, which shows up as a read event whether or not anybody is
+  /// reading.
+  void reap_send_completions() {
+    _csi->reap_send_completions();
+  }
   /// Disables output to the socket.
   ///
   /// Current or future writes that have not been successfully flushed
@@ -210,6 +232,15 @@ enum {
   l_msgr_send_messages_queue_lat,
   l_msgr_handle_ack_lat,
 
+  l_msgr_send_zerocopy_bytes,
+  l_msgr_send_zerocopy_fallbacks,
+
+  l_msgr_recv_buffer_allocs,
+  l_msgr_recv_buffer_reuses,
+
+  l_msgr_idle_time,
+  l_msgr_poll_time,
+
   l_msgr_last,
 };
 
@@ -227,12 +258,15 @@ class Worker {
 
   std::atomic_uint references;
   EventCenter center;
+  std::shared_ptr<RxBufferPool> rx_buffer_pool;
 
   Worker(const Worker&) = delete;
   Worker& operator=(const Worker&) = delete;
 
   Worker(CephContext *c, unsigned worker_id)
-    : cct(c), perf_logger(NULL), id(worker_id), references(0), center(c) {
+    : cct(c), perf_logger(NULL), id(worker_id), references(0), center(c),
+      rx_buffer_pool(std::make_shared<RxBufferPool>(
+        c->_conf.get_val<Option::size_t>("ms_async_rx_buffer_pool_bytes"))) {
     char name[128];
     sprintf(name, "AsyncMessenger::Worker-%u", id);
     // initialize perf_logger
@@ -253,6 +287,15 @@ class Worker {
     plb.add_time_avg(l_msgr_send_messages_queue_lat, "msgr_send_messages_queue_lat", "Network sent messages lat");
     plb.add_time_avg(l_msgr_handle_ack_lat, "msgr_handle_ack_lat", "Connection handle ack lat");
 
+    plb.add_u64_counter(l_msgr_send_zerocopy_bytes, "msgr_send_zerocopy_bytes", "Network bytes sent with MSG_ZEROCOPY", NULL, 0, unit_t(UNIT_BYTES));
+    plb.add_u64_counter(l_msgr_send_zerocopy_fallbacks, "msgr_send_zerocopy_fallbacks", "MSG_ZEROCOPY sends the kernel copied anyway");
+
+    plb.add_u64_counter(l_msgr_recv_buffer_allocs, "msgr_recv_buffer_allocs", "Receive buffers allocated");
+    plb.add_u64_counter(l_msgr_recv_buffer_reuses, "msgr_recv_buffer_reuses", "Receive buffers recycled from the pool");
+
+    plb.add_time(l_msgr_idle_time, "msgr_idle_time", "The total time of thread sleeping for events");
+    plb.add_time(l_msgr_poll_time, "msgr_poll_time", "The total time of thread busy polling without finding events");
+
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
   }
@@ -271,6 +314,21 @@ class Worker {
 
   virtual void initialize() {}
   PerfCounters *get_perf_counter() { return perf_logger; }
+  /// buffer to read len bytes of a frame into, aligned to at least align
+  ceph::unique_leakable_ptr<buffer::raw> create_rx_buffer(unsigned len,
+							  unsigned align) {
+    bool reused = false;
+    ceph::unique_leakable_ptr<buffer::raw> r;
+    if (align <= CEPH_PAGE_SIZE) {
+      r = rx_buffer_pool->create(len, &reused);
+    }
+    if (!r) {
+      r = buffer::create_aligned(len, align);
+    }
+    perf_logger->inc(reused ? l_msgr_recv_buffer_reuses :
+		     l_msgr_recv_buffer_allocs);
+    return r;
+  }
   void release_worker() {
     int oldref = references.fetch_sub(1);
     ceph_assert(oldref > 0);
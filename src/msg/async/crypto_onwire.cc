@@ -17,6 +17,11 @@ static constexpr const std::size_t AESGCM_KEY_LEN{16};
 static constexpr const std::size_t AESGCM_IV_LEN{12};
 static constexpr const std::size_t AESGCM_TAG_LEN{16};
 static constexpr const std::size_t AESGCM_BLOCK_LEN{16};
+// Fragments shorter than this are gathered up and ciphered together.
+// OpenSSL's AES-NI/PCLMUL stitched GCM code only kicks in for long
+// runs; calling into it for every small buffer of a message, header and
+// footer included, costs more than copying them together first.
+static constexpr const std::size_t AESGCM_GATHER_LEN{4096};
 
 struct nonce_t {
   std::uint32_t random_seq;
@@ -34,9 +39,12 @@ class AES128GCM_OnWireTxHandler : public ceph::crypto::onwire::TxHandler {
   CephContext* const cct;
   std::unique_ptr<EVP_CIPHER_CTX, decltype(&::EVP_CIPHER_CTX_free)> ectx;
   ceph::bufferlist buffer;
+  ceph::bufferlist plaintext;  ///< of all updates, ciphered in one pass
   nonce_t nonce;
   static_assert(sizeof(nonce) == AESGCM_IV_LEN);
 
+  void encrypt(unsigned char* out, const unsigned char* in, std::size_t len);
+
 public:
   AES128GCM_OnWireTxHandler(CephContext* const cct,
 			    const key_t& key,
@@ -84,38 +92,63 @@ void AES128GCM_OnWireTxHandler::reset_tx_handler(
 
   buffer.reserve(std::accumulate(std::begin(update_size_sequence),
     std::end(update_size_sequence), AESGCM_TAG_LEN));
+  plaintext.clear();
 
   ++nonce.random_seq;
 }
 
+void AES128GCM_OnWireTxHandler::encrypt(
+  unsigned char* out, const unsigned char* in, std::size_t len)
+{
+  if (!len) {
+    return;
+  }
+  int update_len = 0;
+  if(1 != EVP_EncryptUpdate(ectx.get(), out, &update_len, in, len)) {
+    throw std::runtime_error("EVP_EncryptUpdate failed");
+  }
+  ceph_assert_always(update_len >= 0);
+  ceph_assert(static_cast<std::size_t>(update_len) == len);
+}
+
 void AES128GCM_OnWireTxHandler::authenticated_encrypt_update(
   const ceph::bufferlist& plaintext)
 {
-  auto filler = buffer.append_hole(plaintext.length());
-
-  for (const auto& plainbuf : plaintext.buffers()) {
-    int update_len = 0;
-
-    if(1 != EVP_EncryptUpdate(ectx.get(),
-	reinterpret_cast<unsigned char*>(filler.c_str()),
-	&update_len,
-	reinterpret_cast<const unsigned char*>(plainbuf.c_str()),
-	plainbuf.length())) {
-      throw std::runtime_error("EVP_EncryptUpdate failed");
-    }
-    ceph_assert_always(update_len >= 0);
-    ceph_assert(static_cast<unsigned>(update_len) == plainbuf.length());
-    filler.advance(update_len);
-  }
+  // the segments of a frame are ciphered together at _final()
+  this->plaintext.append(plaintext);
 
   ldout(cct, 15) << __func__
 		 << " plaintext.length()=" << plaintext.length()
-		 << " buffer.length()=" << buffer.length()
+		 << " pending=" << this->plaintext.length()
 		 << dendl;
 }
 
 ceph::bufferlist AES128GCM_OnWireTxHandler::authenticated_encrypt_final()
 {
+  {
+    auto filler = buffer.append_hole(plaintext.length());
+    auto* out = reinterpret_cast<unsigned char*>(filler.c_str());
+    // small fragments are copied into place and ciphered there in runs,
+    // large ones ciphered straight from where they are
+    auto* run = out;
+    std::size_t run_len = 0;
+    for (const auto& plainbuf : plaintext.buffers()) {
+      const auto* in = reinterpret_cast<const unsigned char*>(plainbuf.c_str());
+      if (plainbuf.length() < AESGCM_GATHER_LEN) {
+	::memcpy(run + run_len, in, plainbuf.length());
+	run_len += plainbuf.length();
+      } else {
+	encrypt(run, run, run_len);
+	run += run_len;
+	encrypt(run, in, plainbuf.length());
+	run += plainbuf.length();
+	run_len = 0;
+      }
+    }
+    encrypt(run, run, run_len);
+    plaintext.clear();
+  }
+
   int final_len = 0;
   auto filler = buffer.append_hole(AESGCM_BLOCK_LEN);
   if(1 != EVP_EncryptFinal_ex(ectx.get(),
@@ -200,8 +233,28 @@ ceph::bufferlist AES128GCM_OnWireRxHandler::authenticated_decrypt_update(
   ceph_assert(ciphertext.length() > 0);
   //ceph_assert(ciphertext.length() % AESGCM_BLOCK_LEN == 0);
 
-  // NOTE: we might consider in-place transformations in the future. AFAIK
-  // OpenSSL's might sustain that but lack of clear confirmation postpones.
+  // GCM is fine deciphering in place.  Do that when the ciphertext is a
+  // whole buffer of its own, as a frame segment read off the wire is, and
+  // spare an allocation and a pass over memory.
+  if (ciphertext.get_num_buffers() == 1) {
+    const auto& cipherbuf = ciphertext.front();
+    if (cipherbuf.raw_nref() == 1 &&
+	cipherbuf.offset() == 0 &&
+	cipherbuf.length() == cipherbuf.raw_length() &&
+	cipherbuf.is_aligned(alignment)) {
+      // a single buffer, c_str() won't copy
+      auto* buf = reinterpret_cast<unsigned char*>(ciphertext.c_str());
+      int update_len = 0;
+      if (1 != EVP_DecryptUpdate(ectx.get(), buf, &update_len,
+	  buf, cipherbuf.length())) {
+	throw std::runtime_error("EVP_DecryptUpdate failed");
+      }
+      ceph_assert_always(update_len >= 0);
+      ceph_assert(cipherbuf.length() == static_cast<unsigned>(update_len));
+      return std::move(ciphertext);
+    }
+  }
+
   auto plainnode = ceph::buffer::ptr_node::create(buffer::create_aligned(
     ciphertext.length(), alignment));
   auto* plainbuf = reinterpret_cast<unsigned char*>(plainnode->c_str());
@@ -104,6 +104,19 @@ int NetHandler::set_socket_options(int sd, bool nodelay, int size)
     }
   }
 
+#ifdef SO_BUSY_POLL
+  // let the kernel busy poll the device queue when we read an empty socket
+  int busy_poll = cct->_conf.get_val<uint64_t>("ms_async_busy_poll_us");
+  if (busy_poll) {
+    // more than net.core.busy_read needs CAP_NET_ADMIN; not fatal
+    if (::setsockopt(sd, SOL_SOCKET, SO_BUSY_POLL, (void*)&busy_poll,
+		     sizeof(busy_poll)) < 0) {
+      ldout(cct, 5) << "couldn't set SO_BUSY_POLL to " << busy_poll << ": "
+		    << cpp_strerror(errno) << dendl;
+    }
+  }
+#endif
+
   // block ESIGPIPE
 #ifdef CEPH_USE_SO_NOSIGPIPE
   int val = 1;
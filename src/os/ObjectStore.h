@@ -468,6 +468,35 @@ public:
      ceph::buffer::list& bl,
      uint32_t op_flags = 0) = 0;
 
+  /**
+   * digest -- crc32c of a byte range of an object
+   *
+   * Like read, but only the crc32c of the data comes back.  A store
+   * keeping checksums of its own verifies them on the way and may fold
+   * them into the result rather than hashing the data a second time.
+   *
+   * @param cid collection for object
+   * @param oid oid of object
+   * @param offset location offset of first byte to be hashed
+   * @param len number of bytes to be hashed
+   * @param crc [in,out] seed on entry, crc32c of the bytes on return
+   * @param op_flags is CEPH_OSD_OP_FLAG_*
+   * @returns number of bytes hashed on success, or negative error code on failure.
+   */
+  virtual int digest(
+    CollectionHandle &c,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    uint32_t *crc,
+    uint32_t op_flags = 0) {
+    ceph::buffer::list bl;
+    int r = read(c, oid, offset, len, bl, op_flags);
+    if (r > 0)
+      *crc = bl.crc32c(*crc);
+    return r;
+  }
+
   /**
    * fiemap -- get extent std::map of data of an object
    *
@@ -5,6 +5,8 @@
 #include "StupidAllocator.h"
 #include "BitmapAllocator.h"
 #include "AvlAllocator.h"
+#include "HybridAllocator.h"
+#include "ZonedAllocator.h"
 #include "common/debug.h"
 #include "common/admin_socket.h"
 #define dout_subsys ceph_subsys_bluestore
@@ -101,7 +103,8 @@ Allocator::~Allocator()
 
 
 Allocator *Allocator::create(CephContext* cct, string type,
-                             int64_t size, int64_t block_size, const std::string& name)
+                             int64_t size, int64_t block_size, const std::string& name,
+                             int64_t zone_size, int64_t first_sequential_zone)
 {
   Allocator* alloc = nullptr;
   if (type == "stupid") {
@@ -110,6 +113,13 @@ Allocator *Allocator::create(CephContext* cct, string type,
     alloc = new BitmapAllocator(cct, size, block_size, name);
   } else if (type == "avl") {
     return new AvlAllocator(cct, size, block_size, name);
+  } else if (type == "hybrid") {
+    return new HybridAllocator(cct, size, block_size,
+      cct->_conf.get_val<uint64_t>("bluestore_hybrid_alloc_mem_cap"),
+      name);
+  } else if (type == "zoned") {
+    return new ZonedAllocator(cct, size, block_size, zone_size,
+      first_sequential_zone, name);
   }
   if (alloc == nullptr) {
     lderr(cct) << "Allocator::" << __func__ << " unknown alloc type "
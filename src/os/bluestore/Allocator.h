@@ -60,7 +60,9 @@ public:
   virtual void shutdown() = 0;
 
   static Allocator *create(CephContext* cct, string type, int64_t size,
-			   int64_t block_size, const std::string& name = "");
+			   int64_t block_size, const std::string& name = "",
+			   int64_t zone_size = 0,
+			   int64_t first_sequential_zone = 0);
 private:
   class SocketHook;
   SocketHook* asok_hook = nullptr;
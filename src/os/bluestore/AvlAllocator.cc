@@ -97,37 +97,70 @@ void AvlAllocator::_add_to_tree(uint64_t start, uint64_t size)
     rs_after->start = start;
     range_size_tree.insert(*rs_after);
   } else {
-    auto new_rs = new range_seg_t{start, end};
-    range_tree.insert_before(rs_after, *new_rs);
-    range_size_tree.insert(*new_rs);
+    _try_insert_range(start, end, &rs_after);
+    return;
   }
   num_free += size;
 }
 
-void AvlAllocator::_remove_from_tree(uint64_t start, uint64_t size)
+void AvlAllocator::_try_insert_range(uint64_t start,
+				     uint64_t end,
+				     range_tree_t::iterator* insert_pos)
 {
-  uint64_t end = start + size;
-
-  assert(size != 0);
-  assert(size <= num_free);
-
-  auto rs = range_tree.find(range_t{start, end}, range_tree.key_comp());
-  /* Make sure we completely overlap with someone */
-  assert(rs != range_tree.end());
-  assert(rs->start <= start);
-  assert(rs->end >= end);
+  bool fits = !range_count_cap || range_tree.size() < range_count_cap;
+  bool remove_lowest = false;
+  if (!fits && end - start > _lowest_size_available()) {
+    // keep the larger range in the tree and evict the shortest one
+    remove_lowest = true;
+    fits = true;
+  }
+  if (!fits) {
+    _spillover_range(start, end);
+    return;
+  }
+  // NB: insert before evicting, since the evicted range might be the
+  // one insert_pos refers to.
+  auto new_rs = new range_seg_t{start, end};
+  if (insert_pos) {
+    range_tree.insert_before(*insert_pos, *new_rs);
+  } else {
+    range_tree.insert(*new_rs);
+  }
+  range_size_tree.insert(*new_rs);
+  num_free += end - start;
+
+  if (remove_lowest) {
+    auto r = range_size_tree.begin();
+    uint64_t lowest_start = r->start;
+    uint64_t lowest_end = r->end;
+    range_size_tree.erase(r);
+    range_tree.erase_and_dispose(range_tree.iterator_to(*r), dispose_rs{});
+    num_free -= lowest_end - lowest_start;
+    _spillover_range(lowest_start, lowest_end);
+  }
+}
 
+void AvlAllocator::_process_range_removal(uint64_t start, uint64_t end,
+					  range_tree_t::iterator& rs)
+{
   bool left_over = (rs->start != start);
   bool right_over = (rs->end != end);
 
   range_size_tree.erase(*rs);
 
   if (left_over && right_over) {
-    auto new_seg = new range_seg_t{end, rs->end};
+    auto old_right_end = rs->end;
+    auto insert_pos = rs;
+    ceph_assert(insert_pos != range_tree.end());
+    ++insert_pos;
     rs->end = start;
-    range_tree.insert(rs, *new_seg);
-    range_size_tree.insert(*new_seg);
     range_size_tree.insert(*rs);
+    // the right part is accounted as a fresh range, which might be
+    // spilled over if we are at range_count_cap
+    assert(num_free >= old_right_end - start);
+    num_free -= old_right_end - start;
+    _try_insert_range(end, old_right_end, &insert_pos);
+    return;
   } else if (left_over) {
     rs->end = start;
     range_size_tree.insert(*rs);
@@ -137,8 +170,54 @@ void AvlAllocator::_remove_from_tree(uint64_t start, uint64_t size)
   } else {
     range_tree.erase_and_dispose(rs, dispose_rs{});
   }
-  assert(num_free >= size);
-  num_free -= size;
+  assert(num_free >= end - start);
+  num_free -= end - start;
+}
+
+void AvlAllocator::_remove_from_tree(uint64_t start, uint64_t size)
+{
+  uint64_t end = start + size;
+
+  assert(size != 0);
+  assert(size <= num_free);
+
+  auto rs = range_tree.find(range_t{start, end}, range_tree.key_comp());
+  /* Make sure we completely overlap with someone */
+  assert(rs != range_tree.end());
+  assert(rs->start <= start);
+  assert(rs->end >= end);
+
+  _process_range_removal(start, end, rs);
+}
+
+void AvlAllocator::_try_remove_from_tree(uint64_t start, uint64_t size,
+  std::function<void(uint64_t, uint64_t, bool)> notify)
+{
+  uint64_t end = start + size;
+
+  ceph_assert(size != 0);
+
+  // first range which ends past start, i.e. the leftmost candidate
+  // for an overlap
+  auto rs = range_tree.lower_bound(range_t{start, start + 1},
+				   range_tree.key_comp());
+
+  while (start < end) {
+    if (rs == range_tree.end() || rs->start >= end) {
+      notify(start, end - start, false);
+      break;
+    }
+    if (start < rs->start) {
+      notify(start, rs->start - start, false);
+      start = rs->start;
+    }
+    auto next_rs = std::next(rs);
+    auto range_end = std::min(rs->end, end);
+    _process_range_removal(start, range_end, rs);
+    notify(start, range_end - start, true);
+    start = range_end;
+    rs = next_rs;
+  }
 }
 
 int AvlAllocator::_allocate(
@@ -147,7 +226,6 @@ int AvlAllocator::_allocate(
   uint64_t *offset,
   uint64_t *length)
 {
-  std::lock_guard l(lock);
   uint64_t max_size = 0;
   if (auto p = range_size_tree.rbegin(); p != range_size_tree.rend()) {
     max_size = p->end - p->start;
@@ -201,6 +279,7 @@ int AvlAllocator::_allocate(
 AvlAllocator::AvlAllocator(CephContext* cct,
 			   int64_t device_size,
 			   int64_t block_size,
+			   uint64_t max_mem,
 			   const std::string& name) :
   Allocator(name),
   num_total(device_size),
@@ -209,9 +288,17 @@ AvlAllocator::AvlAllocator(CephContext* cct,
     cct->_conf.get_val<uint64_t>("bluestore_avl_alloc_bf_threshold")),
   range_size_alloc_free_pct(
     cct->_conf.get_val<uint64_t>("bluestore_avl_alloc_bf_free_pct")),
+  range_count_cap(max_mem / sizeof(range_seg_t)),
   cct(cct)
 {}
 
+AvlAllocator::AvlAllocator(CephContext* cct,
+			   int64_t device_size,
+			   int64_t block_size,
+			   const std::string& name) :
+  AvlAllocator(cct, device_size, block_size, 0, name)
+{}
+
 int64_t AvlAllocator::allocate(
   uint64_t want,
   uint64_t unit,
@@ -236,6 +323,17 @@ int64_t AvlAllocator::allocate(
     max_alloc_size = cap;
   }
 
+  std::lock_guard l(lock);
+  return _allocate(want, unit, max_alloc_size, hint, extents);
+}
+
+int64_t AvlAllocator::_allocate(
+  uint64_t want,
+  uint64_t unit,
+  uint64_t max_alloc_size,
+  int64_t  hint,
+  PExtentVector* extents)
+{
   uint64_t allocated = 0;
   while (allocated < want) {
     uint64_t offset, length;
@@ -254,6 +352,11 @@ int64_t AvlAllocator::allocate(
 void AvlAllocator::release(const interval_set<uint64_t>& release_set)
 {
   std::lock_guard l(lock);
+  _release(release_set);
+}
+
+void AvlAllocator::_release(const interval_set<uint64_t>& release_set)
+{
   for (auto p = release_set.begin(); p != release_set.end(); ++p) {
     const auto offset = p.get_start();
     const auto length = p.get_len();
@@ -265,6 +368,17 @@ void AvlAllocator::release(const interval_set<uint64_t>& release_set)
   }
 }
 
+void AvlAllocator::_release(const PExtentVector& release_set)
+{
+  for (auto& e : release_set) {
+    ldout(cct, 10) << __func__ << std::hex
+                   << " offset 0x" << e.offset
+                   << " length 0x" << e.length
+                   << std::dec << dendl;
+    _add_to_tree(e.offset, e.length);
+  }
+}
+
 uint64_t AvlAllocator::get_free()
 {
   std::lock_guard l(lock);
@@ -274,16 +388,26 @@ uint64_t AvlAllocator::get_free()
 double AvlAllocator::get_fragmentation()
 {
   std::lock_guard l(lock);
+  return _get_fragmentation();
+}
+
+double AvlAllocator::_get_fragmentation() const
+{
   auto free_blocks = p2align(num_free, block_size) / block_size;
   if (free_blocks <= 1) {
     return .0;
-  }  
+  }
   return (static_cast<double>(range_tree.size() - 1) / (free_blocks - 1));
 }
 
 void AvlAllocator::dump()
 {
   std::lock_guard l(lock);
+  _dump();
+}
+
+void AvlAllocator::_dump() const
+{
   ldout(cct, 0) << __func__ << " range_tree: " << dendl;
   for (auto& rs : range_tree) {
     ldout(cct, 0) << std::hex
@@ -302,6 +426,11 @@ void AvlAllocator::dump()
 }
 
 void AvlAllocator::dump(std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  _dump(notify);
+}
+
+void AvlAllocator::_dump(std::function<void(uint64_t offset, uint64_t length)> notify) const
 {
   for (auto& rs : range_tree) {
     notify(rs.start, rs.end - rs.start);
@@ -331,6 +460,11 @@ void AvlAllocator::init_rm_free(uint64_t offset, uint64_t length)
 void AvlAllocator::shutdown()
 {
   std::lock_guard l(lock);
+  _shutdown();
+}
+
+void AvlAllocator::_shutdown()
+{
   range_size_tree.clear();
   range_tree.clear_and_dispose(dispose_rs{});
 }
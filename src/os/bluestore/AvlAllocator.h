@@ -46,7 +46,17 @@ struct range_seg_t {
   boost::intrusive::avl_set_member_hook<> size_hook;
 };
 
-class AvlAllocator final : public Allocator {
+class AvlAllocator : public Allocator {
+protected:
+  /*
+  * ctor intended for the usage from descendant class(es) which
+  * provides handling for spilled over entries
+  * (when entry count >= max_entries)
+  */
+  AvlAllocator(CephContext* cct, int64_t device_size, int64_t block_size,
+    uint64_t max_mem,
+    const std::string& name);
+
 public:
   AvlAllocator(CephContext* cct, int64_t device_size, int64_t block_size,
 	       const std::string& name);
@@ -55,23 +65,21 @@ public:
     uint64_t unit,
     uint64_t max_alloc_size,
     int64_t  hint,
-    PExtentVector *extents) final;
-  void release(const interval_set<uint64_t>& release_set) final;
-  uint64_t get_free() final;
-  double get_fragmentation() final;
+    PExtentVector *extents) override;
+  void release(const interval_set<uint64_t>& release_set) override;
+  uint64_t get_free() override;
+  double get_fragmentation() override;
 
-  void dump() final;
-  void dump(std::function<void(uint64_t offset, uint64_t length)> notify) final;
-  void init_add_free(uint64_t offset, uint64_t length) final;
-  void init_rm_free(uint64_t offset, uint64_t length) final;
-  void shutdown() final;
+  void dump() override;
+  void dump(std::function<void(uint64_t offset, uint64_t length)> notify) override;
+  void init_add_free(uint64_t offset, uint64_t length) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+  void shutdown() override;
 
 private:
   template<class Tree>
   uint64_t _block_picker(const Tree& t, uint64_t *cursor, uint64_t size,
     uint64_t align);
-  void _add_to_tree(uint64_t start, uint64_t size);
-  void _remove_from_tree(uint64_t start, uint64_t size);
   int _allocate(
     uint64_t size,
     uint64_t unit,
@@ -131,6 +139,70 @@ private:
    */
   int range_size_alloc_free_pct = 0;
 
+  /*
+  * Max amount of range entries allowed. 0 - unlimited
+  */
+  uint64_t range_count_cap = 0;
+
+  /*
+   * Insert a new range, or push either it or the shortest range we
+   * track to _spillover_range() when range_count_cap is reached.
+   */
+  void _try_insert_range(uint64_t start,
+			 uint64_t end,
+			 range_tree_t::iterator* insert_pos);
+  /*
+   * Remove [start, end) from rs, which must fully contain it.
+   */
+  void _process_range_removal(uint64_t start, uint64_t end,
+			      range_tree_t::iterator& rs);
+
+protected:
   CephContext* cct;
   std::mutex lock;
+
+  uint64_t _lowest_size_available() const {
+    auto rs = range_size_tree.begin();
+    return rs != range_size_tree.end() ? rs->end - rs->start : 0;
+  }
+  int64_t get_capacity() const {
+    return num_total;
+  }
+  uint64_t get_block_size() const {
+    return block_size;
+  }
+
+  /*
+   * Called instead of inserting a range once range_count_cap is
+   * reached; must be overridden whenever range_count_cap is non-zero.
+   */
+  virtual void _spillover_range(uint64_t start, uint64_t end) {
+    ceph_abort_msg("range_count_cap reached without spillover handler");
+  }
+
+  // the following methods expect the caller to hold the lock
+  void _add_to_tree(uint64_t start, uint64_t size);
+  void _remove_from_tree(uint64_t start, uint64_t size);
+  /*
+   * Remove whatever part of [start, start + size) is tracked by the
+   * tree; notify(offset, length, found) is called for every chunk so
+   * the caller can take care of the parts the tree did not have.
+   */
+  void _try_remove_from_tree(uint64_t start, uint64_t size,
+    std::function<void(uint64_t offset, uint64_t length, bool found)> notify);
+  int64_t _allocate(
+    uint64_t want,
+    uint64_t unit,
+    uint64_t max_alloc_size,
+    int64_t  hint,
+    PExtentVector *extents);
+  void _release(const interval_set<uint64_t>& release_set);
+  void _release(const PExtentVector& release_set);
+  uint64_t _get_free() const {
+    return num_free;
+  }
+  double _get_fragmentation() const;
+  void _dump() const;
+  void _dump(std::function<void(uint64_t offset, uint64_t length)> notify) const;
+  void _shutdown();
 };
@@ -21,6 +21,7 @@
 
 #if defined(HAVE_LIBAIO) || defined(HAVE_POSIXAIO)
 #include "KernelDevice.h"
+#include "ZonedDevice.h"
 #endif
 
 #if defined(HAVE_SPDK)
@@ -84,7 +85,8 @@ void IOContext::release_running_aios()
 }
 
 BlockDevice *BlockDevice::create(CephContext* cct, const string& path,
-				 aio_callback_t cb, void *cbpriv, aio_callback_t d_cb, void *d_cbpriv)
+				 aio_callback_t cb, void *cbpriv, aio_callback_t d_cb, void *d_cbpriv,
+				 bool zoned_emulation)
 {
   string type = "kernel";
   char buf[PATH_MAX + 1];
@@ -113,6 +115,13 @@ BlockDevice *BlockDevice::create(CephContext* cct, const string& path,
   }
 #endif
 
+#if defined(HAVE_LIBAIO) || defined(HAVE_POSIXAIO)
+  if (type == "kernel" &&
+      (zoned_emulation || ZonedDevice::support(path))) {
+    type = "zoned";
+  }
+#endif
+
   dout(1) << __func__ << " path " << path << " type " << type << dendl;
 
 #if defined(HAVE_BLUESTORE_PMEM)
@@ -124,6 +133,9 @@ BlockDevice *BlockDevice::create(CephContext* cct, const string& path,
   if (type == "kernel") {
     return new KernelDevice(cct, cb, cbpriv, d_cb, d_cbpriv);
   }
+  if (type == "zoned") {
+    return new ZonedDevice(cct, cb, cbpriv, d_cb, d_cbpriv, zoned_emulation);
+  }
 #endif
 #if defined(HAVE_SPDK)
   if (type == "ust-nvme") {
@@ -155,10 +155,23 @@ public:
   virtual ~BlockDevice() = default;
 
   static BlockDevice *create(
-    CephContext* cct, const std::string& path, aio_callback_t cb, void *cbpriv, aio_callback_t d_cb, void *d_cbpriv);
+    CephContext* cct, const std::string& path, aio_callback_t cb, void *cbpriv, aio_callback_t d_cb, void *d_cbpriv,
+    bool zoned_emulation = false);
   virtual bool supported_bdev_label() { return true; }
   virtual bool is_rotational() { return rotational; }
 
+  // zoned (host-managed SMR/ZNS) devices: everything past the leading
+  // conventional zones may only be written sequentially, at the zone's
+  // write pointer, and is reclaimed by resetting the whole zone.
+  virtual bool is_smr() const { return false; }
+  virtual uint64_t get_zone_size() const { return 0; }
+  virtual uint64_t get_conventional_region_size() const { return 0; }
+  /// write pointer offset within each zone, or -EOPNOTSUPP if unknown
+  virtual int get_zone_write_pointers(std::vector<uint64_t> *wps) {
+    return -EOPNOTSUPP;
+  }
+  virtual int reset_zone(uint64_t zone) { return -EOPNOTSUPP; }
+
   virtual void aio_submit(IOContext *ioc) = 0;
 
   void set_no_exclusive_lock() {
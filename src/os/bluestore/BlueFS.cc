@@ -172,6 +172,8 @@ void BlueFS::_init_logger()
 	    "jlen", PerfCountersBuilder::PRIO_INTERESTING, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluefs_log_compactions, "log_compactions",
 		    "Compactions of the metadata log");
+  b.add_time_avg(l_bluefs_log_compaction_lock_lat, "log_compaction_lock_lat",
+		 "Time log compaction held the BlueFS lock in one go");
   b.add_u64_counter(l_bluefs_logged_bytes, "logged_bytes",
 		    "Bytes written to the metadata log", "j",
 		    PerfCountersBuilder::PRIO_CRITICAL, unit_t(UNIT_BYTES));
@@ -1833,9 +1835,58 @@ void BlueFS::_compact_log_dump_metadata(bluefs_transaction_t *t,
   }
 }
 
+void BlueFS::_compact_log_snapshot_metadata(metadata_snapshot_t *s)
+{
+  s->seq = log_seq;
+  s->uuid = super.uuid;
+  s->block_all = block_all;
+  s->fnodes.reserve(file_map.size());
+  for (auto& [ino, file_ref] : file_map) {
+    if (ino == 1)
+      continue;
+    ceph_assert(ino > 1);
+    s->fnodes.push_back(file_ref->fnode);
+  }
+  s->dirs.reserve(dir_map.size());
+  for (auto& [path, dir_ref] : dir_map) {
+    auto& d = s->dirs.emplace_back(path, vector<pair<string, uint64_t>>());
+    d.second.reserve(dir_ref->file_map.size());
+    for (auto& [fname, file_ref] : dir_ref->file_map) {
+      d.second.emplace_back(fname, file_ref->fnode.ino);
+    }
+  }
+  dout(20) << __func__ << " seq " << s->seq << " " << s->fnodes.size()
+	   << " files in " << s->dirs.size() << " dirs" << dendl;
+}
+
+// does not need the lock
+void BlueFS::_compact_log_encode_snapshot(const metadata_snapshot_t& s,
+					  bluefs_transaction_t *t)
+{
+  t->seq = 1;
+  t->uuid = s.uuid;
+  t->op_init();
+  for (unsigned bdev = 0; bdev < s.block_all.size(); ++bdev) {
+    const interval_set<uint64_t>& p = s.block_all[bdev];
+    for (auto q = p.begin(); q != p.end(); ++q) {
+      t->op_alloc_add(bdev, q.get_start(), q.get_len());
+    }
+  }
+  for (auto& fnode : s.fnodes) {
+    t->op_file_update(fnode);
+  }
+  for (auto& [path, files] : s.dirs) {
+    t->op_dir_create(path);
+    for (auto& [fname, ino] : files) {
+      t->op_dir_link(path, fname, ino);
+    }
+  }
+}
+
 void BlueFS::_compact_log_sync()
 {
   dout(10) << __func__ << dendl;
+  auto start = mono_clock::now();
   _rewrite_log_and_layout_sync(true,
     BDEV_DB,
     log_writer->file->fnode.prefer_bdev,
@@ -1843,6 +1894,7 @@ void BlueFS::_compact_log_sync()
     0,
     super.memorized_layout);
   logger->inc(l_bluefs_log_compactions);
+  logger->tinc(l_bluefs_log_compaction_lock_lat, mono_clock::now() - start);
 }
 
 void BlueFS::_rewrite_log_and_layout_sync(bool allocate_with_fallback,
@@ -1940,12 +1992,16 @@ void BlueFS::_rewrite_log_and_layout_sync(bool allocate_with_fallback,
  * 2. While still holding the lock, encode a bufferlist that dumps all of the
  * in-memory fnodes and names.  This will become the new beginning of the
  * log.  The last event will jump to the log continuation extent from #1.
+ * With bluefs_compact_log_incremental we only copy the metadata here and
+ * drop the lock for encoding it; anything that changes meanwhile is
+ * logged to the continuation and replayed on top of the copy.
  *
- * 3. Queue a write to a new extent for the new beginnging of the log.
+ * 3. Queue a write to a new extent for the new beginnging of the log
+ * (without the lock in the incremental mode).
  *
  * 4. Drop lock and wait
  *
- * 5. Retake the lock.
+ * 5. Retake the lock, and wait for any racing log flush.
  *
  * 6. Update the log_fnode to splice in the new beginning.
  *
@@ -1992,46 +2048,94 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
   _flush_and_sync_log(l, 0, old_log_jump_to);
 
   // 2. prepare compacted log
+  auto locked = mono_clock::now();
   bluefs_transaction_t t;
   //avoid record two times in log_t and _compact_log_dump_metadata.
   log_t.clear();
-  _compact_log_dump_metadata(&t, 0);
 
   uint64_t max_alloc_size = std::max(alloc_size[BDEV_WAL],
 				     std::max(alloc_size[BDEV_DB],
 					      alloc_size[BDEV_SLOW]));
 
-  // conservative estimate for final encoded size
-  new_log_jump_to = round_up_to(t.op_bl.length() + super.block_size * 2,
-                                max_alloc_size);
-  t.op_jump(log_seq, new_log_jump_to);
+  if (cct->_conf->bluefs_compact_log_incremental) {
+    metadata_snapshot_t snap;
+    _compact_log_snapshot_metadata(&snap);
+    logger->tinc(l_bluefs_log_compaction_lock_lat, mono_clock::now() - locked);
+    l.unlock();
 
-  // allocate
-  r = _allocate(BlueFS::BDEV_DB, new_log_jump_to,
-                    &new_log->fnode);
-  ceph_assert(r == 0);
+    _compact_log_encode_snapshot(snap, &t);
+    // conservative estimate for final encoded size
+    new_log_jump_to = round_up_to(t.op_bl.length() + super.block_size * 2,
+				  max_alloc_size);
+    t.op_jump(snap.seq, new_log_jump_to);
 
-  // we might have some more ops in log_t due to _allocate call
-  t.claim_ops(log_t);
+    bufferlist bl;
+    encode(t, bl);
+    _pad_bl(bl);
 
-  bufferlist bl;
-  encode(t, bl);
-  _pad_bl(bl);
+    dout(10) << __func__ << " new_log_jump_to 0x" << std::hex << new_log_jump_to
+	     << std::dec << " (incremental)" << dendl;
+
+    // whatever _allocate logs goes to the continuation, after the snapshot
+    l.lock();
+    locked = mono_clock::now();
+    r = _allocate(BlueFS::BDEV_DB, new_log_jump_to,
+		  &new_log->fnode);
+    ceph_assert(r == 0);
+    new_log_writer = _create_writer(new_log);
+    logger->tinc(l_bluefs_log_compaction_lock_lat, mono_clock::now() - locked);
+    l.unlock();
+
+    // 3. flush.  Nobody else touches new_log_writer and its extents are
+    // all allocated, so only the prepare step takes the lock.
+    new_log_writer->append(bl);
+    r = _flush_F(new_log_writer, true);
+    ceph_assert(r == 0);
 
-  dout(10) << __func__ << " new_log_jump_to 0x" << std::hex << new_log_jump_to
-	   << std::dec << dendl;
+    // 4. wait
+    l.lock();
+    _flush_bdev_safely(new_log_writer);
+  } else {
+    _compact_log_dump_metadata(&t, 0);
 
-  new_log_writer = _create_writer(new_log);
-  new_log_writer->append(bl);
+    // conservative estimate for final encoded size
+    new_log_jump_to = round_up_to(t.op_bl.length() + super.block_size * 2,
+				  max_alloc_size);
+    t.op_jump(log_seq, new_log_jump_to);
 
-  // 3. flush
-  r = _flush(new_log_writer, true);
-  ceph_assert(r == 0);
+    // allocate
+    r = _allocate(BlueFS::BDEV_DB, new_log_jump_to,
+		  &new_log->fnode);
+    ceph_assert(r == 0);
+
+    // we might have some more ops in log_t due to _allocate call
+    t.claim_ops(log_t);
+
+    bufferlist bl;
+    encode(t, bl);
+    _pad_bl(bl);
 
-  // 4. wait
-  _flush_bdev_safely(new_log_writer);
+    dout(10) << __func__ << " new_log_jump_to 0x" << std::hex << new_log_jump_to
+	     << std::dec << dendl;
+
+    new_log_writer = _create_writer(new_log);
+    new_log_writer->append(bl);
+
+    // 3. flush
+    r = _flush(new_log_writer, true);
+    ceph_assert(r == 0);
+    logger->tinc(l_bluefs_log_compaction_lock_lat, mono_clock::now() - locked);
+
+    // 4. wait
+    _flush_bdev_safely(new_log_writer);
+  }
 
   // 5. update our log fnode
+  while (log_flushing) {
+    dout(10) << __func__ << " log is currently flushing, waiting" << dendl;
+    log_cond.wait(l);
+  }
+  locked = mono_clock::now();
   // discard first old_log_jump_to extents
   dout(10) << __func__ << " remove 0x" << std::hex << old_log_jump_to << std::dec
 	   << " of " << log_file->fnode.extents << dendl;
@@ -2076,6 +2180,7 @@ void BlueFS::_compact_log_async(std::unique_lock<ceph::mutex>& l)
   super.log_fnode = log_file->fnode;
   ++super.version;
   _write_super(BDEV_DB);
+  logger->tinc(l_bluefs_log_compaction_lock_lat, mono_clock::now() - locked);
 
   lock.unlock();
   flush_bdev();
@@ -2168,8 +2273,13 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<ceph::mutex>& l,
   if (runway < (int64_t)cct->_conf->bluefs_min_log_runway) {
     dout(10) << __func__ << " allocating more log runway (0x"
 	     << std::hex << runway << std::dec  << " remaining)" << dendl;
-    while (new_log_writer) {
+    // new_log is set for the whole of an async compaction, including
+    // while it runs unlocked; the runway must not be extended before the
+    // compaction has spliced the log extents.  The compaction's own flush
+    // (with jump_to) has just allocated a full runway.
+    while (new_log) {
       dout(10) << __func__ << " waiting for async compaction" << dendl;
+      ceph_assert(!jump_to);
       log_cond.wait(l);
     }
     int r = _allocate(log_writer->file->fnode.prefer_bdev,
@@ -2265,6 +2375,34 @@ int BlueFS::_flush_and_sync_log(std::unique_lock<ceph::mutex>& l,
 
 int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
 {
+  uint64_t clear_upto = 0;
+  int r = _flush_range_prepare(h, &offset, &length, &clear_upto);
+  if (r < 0 || length == 0)
+    return r;
+  return _flush_range_data(h, offset, length, clear_upto);
+}
+
+int BlueFS::_flush_range_F(FileWriter *h, uint64_t offset, uint64_t length)
+{
+  uint64_t clear_upto = 0;
+  {
+    std::lock_guard l(lock);
+    int r = _flush_range_prepare(h, &offset, &length, &clear_upto);
+    if (r < 0 || length == 0)
+      return r;
+  }
+  return _flush_range_data(h, offset, length, clear_upto);
+}
+
+/*
+ * Allocate space for and dirty the fnode of offset~length.  Sets length to
+ * 0 if there is nothing left to flush.  Requires BlueFS::lock.
+ */
+int BlueFS::_flush_range_prepare(FileWriter *h, uint64_t *poffset,
+				 uint64_t *plength, uint64_t *clear_upto)
+{
+  uint64_t offset = *poffset;
+  uint64_t length = *plength;
   dout(10) << __func__ << " " << h << " pos 0x" << std::hex << h->pos
 	   << " 0x" << offset << "~" << length << std::dec
 	   << " to " << h->file->fnode << dendl;
@@ -2273,14 +2411,10 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
 
   h->buffer_appender.flush();
 
-  bool buffered;
-  if (h->file->fnode.ino == 1)
-    buffered = false;
-  else
-    buffered = cct->_conf->bluefs_buffered_io;
-
-  if (offset + length <= h->pos)
+  if (offset + length <= h->pos) {
+    *plength = 0;
     return 0;
+  }
   if (offset < h->pos) {
     length -= h->pos - offset;
     offset = h->pos;
@@ -2295,7 +2429,6 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
   // do not bother to dirty the file if we are overwriting
   // previously allocated extents.
   bool must_dirty = false;
-  uint64_t clear_upto = 0;
   if (allocated < offset + length) {
     // we should never run out of log space here; see the min runway check
     // in _flush_and_sync_log.
@@ -2317,7 +2450,7 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
       // records.  otherwise, we will fail to reply the rocksdb log
       // properly due to garbage on the device.
       h->file->fnode.size = h->file->fnode.get_allocated();
-      clear_upto = h->file->fnode.size;
+      *clear_upto = h->file->fnode.size;
       dout(10) << __func__ << " extending WAL size to 0x" << std::hex
 	       << h->file->fnode.size << std::dec << " to include allocated"
 	       << dendl;
@@ -2358,6 +2491,25 @@ int BlueFS::_flush_range(FileWriter *h, uint64_t offset, uint64_t length)
     }
   }
   dout(20) << __func__ << " file now " << h->file->fnode << dendl;
+  *poffset = offset;
+  *plength = length;
+  return 0;
+}
+
+/*
+ * Write out offset~length as prepared by _flush_range_prepare.  Only
+ * touches the writer and the extents that are already allocated, so
+ * BlueFS::lock is not needed if the caller otherwise has the file to
+ * itself.
+ */
+int BlueFS::_flush_range_data(FileWriter *h, uint64_t offset, uint64_t length,
+			      uint64_t clear_upto)
+{
+  bool buffered;
+  if (h->file->fnode.ino == 1)
+    buffered = false;
+  else
+    buffered = cct->_conf->bluefs_buffered_io;
 
   uint64_t x_off = 0;
   auto p = h->file->fnode.seek(offset, &x_off);
@@ -2496,37 +2648,53 @@ void BlueFS::wait_for_aio(FileWriter *h)
 }
 #endif
 
-int BlueFS::_flush(FileWriter *h, bool force)
+bool BlueFS::_should_flush(FileWriter *h, bool force)
 {
   h->buffer_appender.flush();
   uint64_t length = h->buffer.length();
-  uint64_t offset = h->pos;
   if (!force &&
       length < cct->_conf->bluefs_min_flush_size) {
     dout(10) << __func__ << " " << h << " ignoring, length " << length
 	     << " < min_flush_size " << cct->_conf->bluefs_min_flush_size
 	     << dendl;
-    return 0;
+    return false;
   }
   if (length == 0) {
-    dout(10) << __func__ << " " << h << " no dirty data on "
-	     << h->file->fnode << dendl;
-    return 0;
+    dout(10) << __func__ << " " << h << " no dirty data" << dendl;
+    return false;
   }
   dout(10) << __func__ << " " << h << " 0x"
-           << std::hex << offset << "~" << length << std::dec
-	   << " to " << h->file->fnode << dendl;
+           << std::hex << h->pos << "~" << length << std::dec << dendl;
+  return true;
+}
+
+int BlueFS::_flush(FileWriter *h, bool force)
+{
+  if (!_should_flush(h, force)) {
+    return 0;
+  }
   ceph_assert(h->pos <= h->file->fnode.size);
-  return _flush_range(h, offset, length);
+  return _flush_range(h, h->pos, h->buffer.length());
+}
+
+int BlueFS::_flush_F(FileWriter *h, bool force)
+{
+  if (!_should_flush(h, force)) {
+    return 0;
+  }
+  return _flush_range_F(h, h->pos, h->buffer.length());
 }
 
-int BlueFS::_truncate(FileWriter *h, uint64_t offset)
+int BlueFS::_truncate_F(FileWriter *h, uint64_t offset)
 {
   dout(10) << __func__ << " 0x" << std::hex << offset << std::dec
            << " file " << h->file->fnode << dendl;
-  if (h->file->deleted) {
-    dout(10) << __func__ << "  deleted, no-op" << dendl;
-    return 0;
+  {
+    std::lock_guard l(lock);
+    if (h->file->deleted) {
+      dout(10) << __func__ << "  deleted, no-op" << dendl;
+      return 0;
+    }
   }
 
   // we never truncate internal log files
@@ -2545,10 +2713,11 @@ int BlueFS::_truncate(FileWriter *h, uint64_t offset)
     ceph_abort_msg("actually this shouldn't happen");
   }
   if (h->buffer.length()) {
-    int r = _flush(h, true);
+    int r = _flush_F(h, true);
     if (r < 0)
       return r;
   }
+  std::lock_guard l(lock);
   if (offset == h->file->fnode.size) {
     return 0;  // no-op!
   }
@@ -2561,16 +2730,18 @@ int BlueFS::_truncate(FileWriter *h, uint64_t offset)
   return 0;
 }
 
-int BlueFS::_fsync(FileWriter *h, std::unique_lock<ceph::mutex>& l)
+int BlueFS::_fsync_F(FileWriter *h)
 {
   dout(10) << __func__ << " " << h << " " << h->file->fnode << dendl;
-  int r = _flush(h, true);
+  int r = _flush_F(h, true);
   if (r < 0)
      return r;
-  uint64_t old_dirty_seq = h->file->dirty_seq;
 
-  _flush_bdev_safely(h);
+  _flush_bdev(h);
 
+  // only a log flush can clean the file meanwhile, we hold File::lock
+  std::unique_lock l(lock);
+  uint64_t old_dirty_seq = h->file->dirty_seq;
   if (old_dirty_seq) {
     uint64_t s = log_seq;
     dout(20) << __func__ << " file metadata was dirty (" << old_dirty_seq
@@ -2582,7 +2753,9 @@ int BlueFS::_fsync(FileWriter *h, std::unique_lock<ceph::mutex>& l)
   return 0;
 }
 
-void BlueFS::_flush_bdev_safely(FileWriter *h)
+// wait for the writer's aios and flush the devices it wrote to; does not
+// need BlueFS::lock
+void BlueFS::_flush_bdev(FileWriter *h)
 {
   std::array<bool, MAX_BDEV> flush_devs = h->dirty_devs;
   h->dirty_devs.fill(false);
@@ -2590,18 +2763,18 @@ void BlueFS::_flush_bdev_safely(FileWriter *h)
   if (!cct->_conf->bluefs_sync_write) {
     list<aio_t> completed_ios;
     _claim_completed_aios(h, &completed_ios);
-    lock.unlock();
     wait_for_aio(h);
     completed_ios.clear();
-    flush_bdev(flush_devs);
-    lock.lock();
-  } else
-#endif
-  {
-    lock.unlock();
-    flush_bdev(flush_devs);
-    lock.lock();
   }
+#endif
+  flush_bdev(flush_devs);
+}
+
+void BlueFS::_flush_bdev_safely(FileWriter *h)
+{
+  lock.unlock();
+  _flush_bdev(h);
+  lock.lock();
 }
 
 void BlueFS::flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs)
@@ -32,6 +32,7 @@ enum {
   l_bluefs_num_files,
   l_bluefs_log_bytes,
   l_bluefs_log_compactions,
+  l_bluefs_log_compaction_lock_lat,
   l_bluefs_logged_bytes,
   l_bluefs_files_written_wal,
   l_bluefs_files_written_sst,
@@ -103,6 +104,9 @@ public:
     std::atomic_int num_readers, num_writers;
     std::atomic_int num_reading;
 
+    /// serializes writes to the file (see BlueFS::lock)
+    ceph::mutex lock = ceph::make_mutex("BlueFS::File::lock");
+
   private:
     FRIEND_MAKE_REF(File);
     File()
@@ -252,6 +256,23 @@ public:
   };
 
 private:
+  /*
+   * Locking:
+   *
+   * BlueFS::lock protects the namespace (dir_map, file_map), the log
+   * (log_t, log_writer, log_seq, dirty_files), allocations and the
+   * superblock.  Every fnode change is made with it held.
+   *
+   * File::lock serializes the writes to a file: writers take it first,
+   * take BlueFS::lock only for the fnode/log bookkeeping of a flush, and
+   * prepare and submit the data I/O with just File::lock held, so that
+   * independent writers proceed in parallel.  Never take a File::lock
+   * while holding BlueFS::lock.  Methods suffixed with _F expect
+   * File::lock and not BlueFS::lock to be held.
+   *
+   * Readers take neither; the block devices and allocators do their own
+   * locking.
+   */
   ceph::mutex lock = ceph::make_mutex("BlueFS::lock");
 
   PerfCounters *logger = nullptr;
@@ -325,9 +346,16 @@ private:
   int _allocate_without_fallback(uint8_t id, uint64_t len,
 				 PExtentVector* extents);
 
+  int _flush_range_prepare(FileWriter *h, uint64_t *offset, uint64_t *length,
+			   uint64_t *clear_upto);
+  int _flush_range_data(FileWriter *h, uint64_t offset, uint64_t length,
+			uint64_t clear_upto);
   int _flush_range(FileWriter *h, uint64_t offset, uint64_t length);
+  int _flush_range_F(FileWriter *h, uint64_t offset, uint64_t length);
+  bool _should_flush(FileWriter *h, bool force);
   int _flush(FileWriter *h, bool force);
-  int _fsync(FileWriter *h, std::unique_lock<ceph::mutex>& l);
+  int _flush_F(FileWriter *h, bool force);
+  int _fsync_F(FileWriter *h);
 
 #ifdef HAVE_LIBAIO
   void _claim_completed_aios(FileWriter *h, list<aio_t> *ls);
@@ -348,6 +376,19 @@ private:
   };
   void _compact_log_dump_metadata(bluefs_transaction_t *t,
 				  int flags);
+
+  /// copy of the metadata an incremental async compaction writes out,
+  /// so that it can be encoded and written without holding the lock
+  struct metadata_snapshot_t {
+    uint64_t seq = 0;
+    uuid_d uuid;
+    vector<interval_set<uint64_t>> block_all;
+    vector<bluefs_fnode_t> fnodes;
+    vector<pair<string, vector<pair<string, uint64_t>>>> dirs;
+  };
+  void _compact_log_snapshot_metadata(metadata_snapshot_t *s);
+  void _compact_log_encode_snapshot(const metadata_snapshot_t& s,
+				    bluefs_transaction_t *t);
   void _compact_log_sync();
   void _compact_log_async(std::unique_lock<ceph::mutex>& l);
 
@@ -360,12 +401,13 @@ private:
 
   //void _aio_finish(void *priv);
 
+  void _flush_bdev(FileWriter *h);
   void _flush_bdev_safely(FileWriter *h);
   void flush_bdev();  // this is safe to call without a lock
   void flush_bdev(std::array<bool, MAX_BDEV>& dirty_bdevs);  // this is safe to call without a lock
 
   int _preallocate(FileRef f, uint64_t off, uint64_t len);
-  int _truncate(FileWriter *h, uint64_t off);
+  int _truncate_F(FileWriter *h, uint64_t off);
 
   int _read(
     FileReader *h,   ///< [in] read from here
@@ -455,7 +497,8 @@ public:
     bool random = false);
 
   void close_writer(FileWriter *h) {
-    std::lock_guard l(lock);
+    FileRef f = h->file;
+    std::lock_guard l(f->lock);
     _close_writer(h);
   }
 
@@ -506,16 +549,16 @@ public:
   void handle_discard(unsigned dev, interval_set<uint64_t>& to_release);
 
   void flush(FileWriter *h) {
-    std::lock_guard l(lock);
-    _flush(h, false);
+    std::lock_guard l(h->file->lock);
+    _flush_F(h, false);
   }
   void flush_range(FileWriter *h, uint64_t offset, uint64_t length) {
-    std::lock_guard l(lock);
-    _flush_range(h, offset, length);
+    std::lock_guard l(h->file->lock);
+    _flush_range_F(h, offset, length);
   }
   int fsync(FileWriter *h) {
-    std::unique_lock l(lock);
-    return _fsync(h, l);
+    std::lock_guard l(h->file->lock);
+    return _fsync_F(h);
   }
   int read(FileReader *h, FileReaderBuffer *buf, uint64_t offset, size_t len,
 	   bufferlist *outbl, char *out) {
@@ -532,16 +575,18 @@ public:
     return _read_random(h, offset, len, out);
   }
   void invalidate_cache(FileRef f, uint64_t offset, uint64_t len) {
-    std::lock_guard l(lock);
+    // the extents only change under File::lock
+    std::lock_guard l(f->lock);
     _invalidate_cache(f, offset, len);
   }
   int preallocate(FileRef f, uint64_t offset, uint64_t len) {
+    std::lock_guard fl(f->lock);
     std::lock_guard l(lock);
     return _preallocate(f, offset, len);
   }
   int truncate(FileWriter *h, uint64_t offset) {
-    std::lock_guard l(lock);
-    return _truncate(h, offset);
+    std::lock_guard l(h->file->lock);
+    return _truncate_F(h, offset);
   }
 
 };
@@ -25,6 +25,7 @@
 #include "BlueStore.h"
 #include "os/kv.h"
 #include "include/compat.h"
+#include "include/crc32c.h"
 #include "include/intarith.h"
 #include "include/stringify.h"
 #include "include/str_map.h"
@@ -34,6 +35,7 @@
 #include "common/PriorityCache.h"
 #include "common/RWLock.h"
 #include "Allocator.h"
+#include "ZonedAllocator.h"
 #include "FreelistManager.h"
 #include "BlueFS.h"
 #include "BlueRocksEnv.h"
@@ -873,11 +875,24 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
     --p;
     int skipped = 0;
     int max_skipped = g_conf()->bluestore_cache_trim_max_skip_pinned;
+    // bound the second chances in case hits keep coming in while we trim
+    uint64_t promoted = 0;
+    uint64_t max_promoted = lru.size();
     while (n > 0) {
       BlueStore::Onode *o = &*p;
-      int refs = o->nref.load();
-      if (refs > 1) {
-        dout(20) << __func__ << "  " << o->oid << " has " << refs
+      if (o->lru_referenced.exchange(false) &&
+	  p != lru.begin() &&
+	  promoted < max_promoted) {
+	// hit since we last got here, this is the deferred _touch()
+	++promoted;
+	auto q = p--;
+	lru.erase(q);
+	lru.push_front(*o);
+	continue;
+      }
+      BlueStore::OnodeRef ref = o->c->onode_map.remove_unpinned(o);
+      if (!ref) {
+        dout(20) << __func__ << "  " << o->oid << " has " << o->nref.load()
                  << " refs, skipping" << dendl;
         if (++skipped >= max_skipped) {
           dout(20) << __func__ << " maximum skip pinned reached; stopping with "
@@ -894,16 +909,13 @@ struct LruOnodeCacheShard : public BlueStore::OnodeCacheShard {
         }
       }
       dout(30) << __func__ << "  rm " << o->oid << dendl;
+      --n;
       if (p != lru.begin()) {
         lru.erase(p--);
       } else {
         lru.erase(p);
-        ceph_assert(n == 1);
+        break;
       }
-      o->get();  // paranoia
-      o->c->onode_map.remove(o->oid);
-      o->put();
-      --n;
     }
     num = lru.size();
   }
@@ -1606,15 +1618,18 @@ void BlueStore::BufferSpace::split(BufferCacheShard* cache, size_t pos, BlueStor
 BlueStore::OnodeRef BlueStore::OnodeSpace::add(const ghobject_t& oid, OnodeRef o)
 {
   std::lock_guard l(cache->lock);
-  auto p = onode_map.find(oid);
-  if (p != onode_map.end()) {
-    ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
-			  << " raced, returning existing " << p->second
-			  << dendl;
-    return p->second;
+  {
+    std::unique_lock ml(map_lock);
+    auto p = onode_map.find(oid);
+    if (p != onode_map.end()) {
+      ldout(cache->cct, 30) << __func__ << " " << oid << " " << o
+			    << " raced, returning existing " << p->second
+			    << dendl;
+      return p->second;
+    }
+    ldout(cache->cct, 30) << __func__ << " " << oid << " " << o << dendl;
+    onode_map[oid] = o;
   }
-  ldout(cache->cct, 30) << __func__ << " " << oid << " " << o << dendl;
-  onode_map[oid] = o;
   cache->_add(o, 1);
   cache->_trim();
   return o;
@@ -1624,33 +1639,47 @@ BlueStore::OnodeRef BlueStore::OnodeSpace::lookup(const ghobject_t& oid)
 {
   ldout(cache->cct, 30) << __func__ << dendl;
   OnodeRef o;
-  bool hit = false;
 
   {
-    std::lock_guard l(cache->lock);
+    std::shared_lock l(map_lock);
     ceph::unordered_map<ghobject_t,OnodeRef>::iterator p = onode_map.find(oid);
-    if (p == onode_map.end()) {
-      ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
-    } else {
-      ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << p->second
-			    << dendl;
-      cache->_touch(p->second);
-      hit = true;
+    if (p != onode_map.end()) {
       o = p->second;
     }
   }
 
-  if (hit) {
+  if (o) {
+    ldout(cache->cct, 30) << __func__ << " " << oid << " hit " << o << dendl;
+    if (!o->lru_referenced.load(std::memory_order_relaxed)) {
+      o->lru_referenced.store(true, std::memory_order_relaxed);
+    }
     cache->logger->inc(l_bluestore_onode_hits);
   } else {
+    ldout(cache->cct, 30) << __func__ << " " << oid << " miss" << dendl;
     cache->logger->inc(l_bluestore_onode_misses);
   }
   return o;
 }
 
+BlueStore::OnodeRef BlueStore::OnodeSpace::remove_unpinned(Onode* o)
+{
+  std::unique_lock l(map_lock);
+  // lookups take their ref under the shared lock, so if we are the only
+  // holder nobody can get hold of o while we drop it
+  if (o->nref.load() > 1) {
+    return OnodeRef();
+  }
+  auto p = onode_map.find(o->oid);
+  ceph_assert(p != onode_map.end() && p->second == o);
+  OnodeRef ref = std::move(p->second);
+  onode_map.erase(p);
+  return ref;
+}
+
 void BlueStore::OnodeSpace::clear()
 {
   std::lock_guard l(cache->lock);
+  std::unique_lock ml(map_lock);
   ldout(cache->cct, 10) << __func__ << dendl;
   for (auto &p : onode_map) {
     cache->_rm(p.second);
@@ -1660,7 +1689,7 @@ void BlueStore::OnodeSpace::clear()
 
 bool BlueStore::OnodeSpace::empty()
 {
-  std::lock_guard l(cache->lock);
+  std::shared_lock l(map_lock);
   return onode_map.empty();
 }
 
@@ -1671,6 +1700,7 @@ void BlueStore::OnodeSpace::rename(
   const mempool::bluestore_cache_other::string& new_okey)
 {
   std::lock_guard l(cache->lock);
+  std::unique_lock ml(map_lock);
   ldout(cache->cct, 30) << __func__ << " " << old_oid << " -> " << new_oid
 			<< dendl;
   ceph::unordered_map<ghobject_t,OnodeRef>::iterator po, pn;
@@ -1696,12 +1726,13 @@ void BlueStore::OnodeSpace::rename(
   cache->_touch(o);
   o->oid = new_oid;
   o->key = new_okey;
+  ml.unlock();
   cache->_trim();
 }
 
 bool BlueStore::OnodeSpace::map_any(std::function<bool(OnodeRef)> f)
 {
-  std::lock_guard l(cache->lock);
+  std::shared_lock l(map_lock);
   ldout(cache->cct, 20) << __func__ << dendl;
   for (auto& i : onode_map) {
     if (f(i.second)) {
@@ -3679,6 +3710,9 @@ void BlueStore::Collection::split_cache(
   std::lock(cache->lock, dest->cache->lock);
   std::lock_guard l(cache->lock, std::adopt_lock);
   std::lock_guard l2(dest->cache->lock, std::adopt_lock);
+  std::lock(onode_map.map_lock, dest->onode_map.map_lock);
+  std::unique_lock ml(onode_map.map_lock, std::adopt_lock);
+  std::unique_lock ml2(dest->onode_map.map_lock, std::adopt_lock);
 
   int destbits = dest->cnode.bits;
   spg_t destpg;
@@ -3741,6 +3775,8 @@ void BlueStore::Collection::split_cache(
       }
     }
   }
+  ml.unlock();
+  ml2.unlock();
   dest->cache->_trim();
 }
 
@@ -4122,6 +4158,7 @@ BlueStore::BlueStore(CephContext *cct,
     finisher(cct, "commit_finisher", "cfin"),
     kv_sync_thread(this),
     kv_finalize_thread(this),
+    zone_cleaner_thread(this),
     min_alloc_size(_min_alloc_size),
     min_alloc_size_order(ctz(_min_alloc_size)),
     mempool_thread(this)
@@ -4526,8 +4563,23 @@ void BlueStore::_init_logger()
     "Average compress latency");
   b.add_time_avg(l_bluestore_decompress_lat, "decompress_lat",
     "Average decompress latency");
+  b.add_u64_counter(l_bluestore_decompressed_bytes, "decompressed_bytes",
+		    "Bytes produced by decompressing blobs on read",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_decompressed_read_bytes,
+		    "decompressed_read_bytes",
+		    "Bytes returned from freshly decompressed blobs",
+		    NULL, 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_decompressed_cache_hit_bytes,
+		    "decompressed_cache_hit_bytes",
+		    "Bytes of compressed blobs read from cached decompressed data",
+		    NULL, 0, unit_t(UNIT_BYTES));
   b.add_time_avg(l_bluestore_csum_lat, "csum_lat",
     "Average checksum latency");
+  b.add_u64_counter(l_bluestore_digest_csum_reused_bytes,
+		    "digest_csum_reused_bytes",
+		    "Bytes digested from stored checksums instead of data",
+		    NULL, 0, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluestore_compress_success_count, "compress_success_count",
     "Sum for beneficial compress ops");
   b.add_u64_counter(l_bluestore_compress_rejected_count, "compress_rejected_count",
@@ -4538,6 +4590,15 @@ void BlueStore::_init_logger()
 		    "Sum for deferred write op");
   b.add_u64_counter(l_bluestore_deferred_write_bytes, "deferred_write_bytes",
 		    "Sum for deferred write bytes", "def", 0, unit_t(UNIT_BYTES));
+  b.add_u64_counter(l_bluestore_deferred_write_extents,
+		    "deferred_write_extents",
+		    "Sum for deferred write extents before coalescing",
+		    NULL, PerfCountersBuilder::PRIO_DEBUGONLY);
+  b.add_u64_counter(l_bluestore_deferred_merged_batches,
+		    "deferred_merged_batches",
+		    "Sum for deferred batches submitted together with other "
+		    "sequencers' batches",
+		    NULL, PerfCountersBuilder::PRIO_DEBUGONLY);
   b.add_u64_counter(l_bluestore_write_penalty_read_ops, "write_penalty_read_ops",
 		    "Sum for write penalty read ops");
   b.add_u64(l_bluestore_allocated, "bluestore_allocated",
@@ -4608,12 +4669,22 @@ void BlueStore::_init_logger()
   b.add_u64_counter(l_bluestore_gc_merged, "bluestore_gc_merged",
 		    "Sum for extents that have been merged due to garbage "
 		    "collection");
+  b.add_u64_counter(l_bluestore_zone_resets, "zone_resets",
+		    "Zones of a zoned main device reset by the cleaner");
+  b.add_u64_counter(l_bluestore_zone_relocated_bytes, "zone_relocated_bytes",
+		    "Live data moved out of zones by the cleaner",
+		    NULL, 0, unit_t(UNIT_BYTES));
   b.add_u64_counter(l_bluestore_read_eio, "bluestore_read_eio",
                     "Read EIO errors propagated to high level callers");
   b.add_u64_counter(l_bluestore_reads_with_retries, "bluestore_reads_with_retries",
                     "Read operations that required at least one retry due to failed checksum validation");
   b.add_u64(l_bluestore_fragmentation, "bluestore_fragmentation_micros",
             "How fragmented bluestore free space is (free extents / max possible number of free extents) * 1000");
+  b.add_u64_counter(l_bluestore_alloc_snapshot_loads, "alloc_snapshot_loads",
+		    "Mounts that loaded the allocator from its snapshot");
+  b.add_u64_counter(l_bluestore_alloc_snapshot_misses, "alloc_snapshot_misses",
+		    "Mounts that found no usable allocator snapshot and "
+		    "walked the freelist");
   b.add_time_avg(l_bluestore_omap_seek_to_first_lat, "omap_seek_to_first_lat",
     "Average omap iterator seek_to_first call latency");
   b.add_time_avg(l_bluestore_omap_upper_bound_lat, "omap_upper_bound_lat",
@@ -4792,7 +4863,10 @@ void BlueStore::_set_alloc_sizes(void)
 {
   max_alloc_size = cct->_conf->bluestore_max_alloc_size;
 
-  if (cct->_conf->bluestore_prefer_deferred_size) {
+  if (bdev && bdev->is_smr()) {
+    // deferred writes land in place, which zones do not allow
+    prefer_deferred_size = 0;
+  } else if (cct->_conf->bluestore_prefer_deferred_size) {
     prefer_deferred_size = cct->_conf->bluestore_prefer_deferred_size;
   } else {
     ceph_assert(bdev);
@@ -4827,14 +4901,36 @@ int BlueStore::_open_bdev(bool create)
 {
   ceph_assert(bdev == NULL);
   string p = path + "/block";
-  bdev = BlockDevice::create(cct, p, aio_cb, static_cast<void*>(this), discard_cb, static_cast<void*>(this));
+  bdev = BlockDevice::create(cct, p, aio_cb, static_cast<void*>(this), discard_cb, static_cast<void*>(this),
+			     cct->_conf->bdev_zoned_emulation_zone_size > 0);
   int r = bdev->open(p);
   if (r < 0)
     goto fail;
 
+  if (bdev->is_smr() &&
+      bdev->get_conventional_region_size() < SUPER_RESERVED) {
+    // the label and superblock are rewritten in place
+    derr << __func__ << " zoned device needs at least 0x" << std::hex
+	 << SUPER_RESERVED << " bytes of conventional zones, has 0x"
+	 << bdev->get_conventional_region_size() << std::dec << dendl;
+    r = -EINVAL;
+    goto fail_close;
+  }
+
   if (create && cct->_conf->bdev_enable_discard) {
     bdev->discard(0, bdev->get_size());
   }
+  if (create && bdev->is_smr()) {
+    // start from empty zones, whatever was there before
+    uint64_t zone_size = bdev->get_zone_size();
+    for (uint64_t zone = bdev->get_conventional_region_size() / zone_size;
+	 zone < bdev->get_size() / zone_size;
+	 ++zone) {
+      r = bdev->reset_zone(zone);
+      if (r < 0)
+	goto fail_close;
+    }
+  }
 
   if (bdev->supported_bdev_label()) {
     r = _check_or_set_bdev_label(p, bdev->get_size(), "main", create);
@@ -5015,9 +5111,24 @@ int BlueStore::_open_alloc()
 	     << dendl;
   }
 
-  alloc = Allocator::create(cct, cct->_conf->bluestore_allocator,
-                            bdev->get_size(),
-                            min_alloc_size, "block");
+  if (bdev->is_smr()) {
+    uint64_t zone_size = bdev->get_zone_size();
+    if (zone_size % min_alloc_size) {
+      lderr(cct) << __func__ << " zone size 0x" << std::hex << zone_size
+		 << " is not a multiple of min_alloc_size 0x"
+		 << min_alloc_size << std::dec << dendl;
+      return -EINVAL;
+    }
+    alloc = Allocator::create(cct, "zoned",
+			      bdev->get_size(),
+			      min_alloc_size, "block",
+			      zone_size,
+			      bdev->get_conventional_region_size() / zone_size);
+  } else {
+    alloc = Allocator::create(cct, cct->_conf->bluestore_allocator,
+			      bdev->get_size(),
+			      min_alloc_size, "block");
+  }
   if (!alloc) {
     lderr(cct) << __func__ << " Allocator::unknown alloc type "
                << cct->_conf->bluestore_allocator
@@ -5026,19 +5137,32 @@ int BlueStore::_open_alloc()
   }
 
   uint64_t num = 0, bytes = 0;
+  utime_t start = ceph_clock_now();
 
-  dout(1) << __func__ << " opening allocation metadata" << dendl;
-  // initialize from freelist
-  fm->enumerate_reset();
-  uint64_t offset, length;
-  while (fm->enumerate_next(db, &offset, &length)) {
-    alloc->init_add_free(offset, length);
-    ++num;
-    bytes += length;
+  int r = -ENOENT;
+  // the snapshot keeps free space only, a zoned allocator needs to
+  // tell garbage from the writable zone tails
+  if (bluefs && cct->_conf->bluestore_alloc_snapshot && !bdev->is_smr()) {
+    r = _load_alloc_snapshot(&num, &bytes);
+    logger->inc(r < 0 ? l_bluestore_alloc_snapshot_misses :
+		l_bluestore_alloc_snapshot_loads);
+  }
+  if (r < 0) {
+    dout(1) << __func__ << " opening allocation metadata" << dendl;
+    // initialize from freelist
+    fm->enumerate_reset();
+    uint64_t offset, length;
+    while (fm->enumerate_next(db, &offset, &length)) {
+      alloc->init_add_free(offset, length);
+      ++num;
+      bytes += length;
+    }
+    fm->enumerate_reset();
   }
-  fm->enumerate_reset();
   dout(1) << __func__ << " loaded " << byte_u_t(bytes)
 	  << " in " << num << " extents"
+	  << (r < 0 ? "" : " from snapshot")
+	  << " in " << (ceph_clock_now() - start)
 	  << dendl;
 
   // also mark bluefs space as allocated
@@ -5046,6 +5170,20 @@ int BlueStore::_open_alloc()
     alloc->init_rm_free(e.get_start(), e.get_len());
   }
 
+  if (bdev->is_smr()) {
+    // data written by transactions that never committed still moved
+    // the device's write pointers
+    vector<uint64_t> wps;
+    if (bdev->get_zone_write_pointers(&wps) == 0) {
+      auto za = static_cast<ZonedAllocator*>(alloc);
+      uint64_t first = bdev->get_conventional_region_size() /
+	bdev->get_zone_size();
+      for (uint64_t zone = first; zone < wps.size(); ++zone) {
+	za->set_write_pointer(zone, wps[zone]);
+      }
+    }
+  }
+
   return 0;
 }
 
@@ -5061,6 +5199,232 @@ void BlueStore::_close_alloc()
   bluefs_extents.clear();
 }
 
+/*
+ * Allocator snapshot
+ *
+ * Free space as seen by the freelist (i.e. including the space given
+ * to bluefs, which the freelist does not track) is saved to a bluefs
+ * file on clean umount.  The file carries the freelist sequence it was
+ * taken at; the sequence is persisted in the DB only after the file is
+ * synced, and bumped by every mount that may modify the freelist, so a
+ * snapshot that does not match the DB is never used.
+ */
+static const string ALLOC_SNAPSHOT_DIR = "bluestore";
+static const string ALLOC_SNAPSHOT_FILE = "alloc.snapshot";
+
+int BlueStore::_load_alloc_snapshot(uint64_t* num, uint64_t* bytes)
+{
+  ceph_assert(bluefs);
+  {
+    bufferlist bl;
+    db->get(PREFIX_SUPER, "freelist_seq", &bl);
+    if (bl.length()) {
+      auto p = bl.cbegin();
+      decode(freelist_seq, p);
+    }
+  }
+  if (freelist_seq == 0) {
+    return -ENOENT;
+  }
+
+  BlueFS::FileReader* h = nullptr;
+  int r = bluefs->open_for_read(ALLOC_SNAPSHOT_DIR, ALLOC_SNAPSHOT_FILE, &h);
+  if (r < 0) {
+    dout(1) << __func__ << " no snapshot for freelist seq " << freelist_seq
+	    << dendl;
+    return r;
+  }
+  std::unique_ptr<BlueFS::FileReader> reader(h);
+  uint64_t size = h->file->fnode.size;
+  bufferlist bl;
+  BlueFS::FileReaderBuffer buf(1 << 20);
+  uint64_t pos = 0;
+  while (pos < size) {
+    r = bluefs->read(h, &buf, pos, std::min<uint64_t>(size - pos, 1 << 20),
+		     &bl, nullptr);
+    if (r <= 0) {
+      derr << __func__ << " failed to read snapshot: " << cpp_strerror(r)
+	   << dendl;
+      return r < 0 ? r : -EIO;
+    }
+    pos += r;
+  }
+  if (bl.length() < sizeof(uint32_t)) {
+    derr << __func__ << " snapshot is truncated" << dendl;
+    return -EIO;
+  }
+
+  bufferlist payload;
+  payload.substr_of(bl, 0, bl.length() - sizeof(uint32_t));
+  bufferlist crc_bl;
+  crc_bl.substr_of(bl, payload.length(), sizeof(uint32_t));
+  uint32_t crc;
+  auto cp = crc_bl.cbegin();
+  decode(crc, cp);
+  if (crc != payload.crc32c(-1)) {
+    derr << __func__ << " snapshot checksum mismatch" << dendl;
+    return -EIO;
+  }
+
+  uint64_t seq, bdev_size, fm_size, alloc_size, au;
+  interval_set<uint64_t> snap_bluefs_extents;
+  uint64_t count;
+  auto p = payload.cbegin();
+  try {
+    DECODE_START(1, p);
+    decode(seq, p);
+    decode(bdev_size, p);
+    decode(fm_size, p);
+    decode(alloc_size, p);
+    decode(au, p);
+    decode(snap_bluefs_extents, p);
+    decode(count, p);
+    if (seq != freelist_seq ||
+	bdev_size != bdev->get_size() ||
+	fm_size != fm->get_size() ||
+	alloc_size != fm->get_alloc_size() ||
+	au != min_alloc_size) {
+      dout(1) << __func__ << " snapshot is stale: seq " << seq
+	      << " size 0x" << std::hex << bdev_size << "/0x" << fm_size
+	      << " alloc unit 0x" << alloc_size << "/0x" << au << std::dec
+	      << ", expected seq " << freelist_seq << dendl;
+      return -ESTALE;
+    }
+    if (p.get_remaining() < count * 2 * sizeof(uint64_t)) {
+      derr << __func__ << " snapshot is truncated" << dendl;
+      return -EIO;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+      uint64_t offset, length;
+      decode(offset, p);
+      decode(length, p);
+      alloc->init_add_free(offset, length);
+      *bytes += length;
+    }
+    DECODE_FINISH(p);
+  } catch (buffer::error& e) {
+    // the checksum matched, so this is a bug rather than media damage
+    derr << __func__ << " failed to decode snapshot: " << e.what() << dendl;
+    ceph_abort();
+  }
+  *num = count;
+
+  // space bluefs owned at snapshot time is free from the freelist's
+  // point of view; current bluefs extents are taken out by the caller.
+  for (auto e = snap_bluefs_extents.begin();
+       e != snap_bluefs_extents.end();
+       ++e) {
+    alloc->init_add_free(e.get_start(), e.get_len());
+    ++(*num);
+    *bytes += e.get_len();
+  }
+  return 0;
+}
+
+int BlueStore::_write_alloc_snapshot()
+{
+  ceph_assert(bluefs);
+  ceph_assert(alloc);
+  utime_t start = ceph_clock_now();
+
+  // released extents might still be waiting for discard
+  bdev->discard_drain();
+
+  uint64_t seq = freelist_seq + 1;
+  bufferlist extents_bl;
+  uint64_t count = 0;
+  alloc->dump([&](uint64_t offset, uint64_t length) {
+    encode(offset, extents_bl);
+    encode(length, extents_bl);
+    ++count;
+  });
+
+  bufferlist bl;
+  ENCODE_START(1, 1, bl);
+  encode(seq, bl);
+  encode(bdev->get_size(), bl);
+  encode(fm->get_size(), bl);
+  encode(fm->get_alloc_size(), bl);
+  encode(min_alloc_size, bl);
+  encode(bluefs_extents, bl);
+  encode(count, bl);
+  bl.claim_append(extents_bl);
+  ENCODE_FINISH(bl);
+  uint32_t crc = bl.crc32c(-1);
+  encode(crc, bl);
+  uint64_t len = bl.length();
+
+  int r = 0;
+  if (!bluefs->dir_exists(ALLOC_SNAPSHOT_DIR)) {
+    r = bluefs->mkdir(ALLOC_SNAPSHOT_DIR);
+    if (r < 0) {
+      derr << __func__ << " failed to create bluefs dir: " << cpp_strerror(r)
+	   << dendl;
+      return r;
+    }
+  }
+  BlueFS::FileWriter* h;
+  r = bluefs->open_for_write(ALLOC_SNAPSHOT_DIR, ALLOC_SNAPSHOT_FILE, &h,
+			     false);
+  if (r < 0) {
+    derr << __func__ << " failed to open snapshot: " << cpp_strerror(r)
+	 << dendl;
+    return r;
+  }
+  h->append(bl);
+  r = bluefs->fsync(h);
+  bluefs->close_writer(h);
+  if (r < 0) {
+    derr << __func__ << " failed to write snapshot: " << cpp_strerror(r)
+	 << dendl;
+    return r;
+  }
+
+  KeyValueDB::Transaction t = db->get_transaction();
+  bufferlist seq_bl;
+  encode(seq, seq_bl);
+  t->set(PREFIX_SUPER, "freelist_seq", seq_bl);
+  r = db->submit_transaction_sync(t);
+  if (r < 0) {
+    derr << __func__ << " failed to update freelist seq: " << cpp_strerror(r)
+	 << dendl;
+    return r;
+  }
+  freelist_seq = seq;
+  dout(1) << __func__ << " saved " << count << " extents ("
+	  << byte_u_t(len) << ") at freelist seq " << seq
+	  << " in " << (ceph_clock_now() - start) << dendl;
+  return 0;
+}
+
+void BlueStore::_invalidate_alloc_snapshot()
+{
+  ceph_assert(bluefs);
+  if (!bluefs->dir_exists(ALLOC_SNAPSHOT_DIR)) {
+    return;
+  }
+  // bump the sequence first, an unlink that has not made it to the bluefs
+  // log yet must not leave a usable snapshot behind
+  bufferlist bl;
+  db->get(PREFIX_SUPER, "freelist_seq", &bl);
+  if (bl.length()) {
+    auto p = bl.cbegin();
+    decode(freelist_seq, p);
+    ++freelist_seq;
+    KeyValueDB::Transaction t = db->get_transaction();
+    bl.clear();
+    encode(freelist_seq, bl);
+    t->set(PREFIX_SUPER, "freelist_seq", bl);
+    db->submit_transaction_sync(t);
+  }
+  int r = bluefs->unlink(ALLOC_SNAPSHOT_DIR, ALLOC_SNAPSHOT_FILE);
+  if (r < 0 && r != -ENOENT) {
+    derr << __func__ << " failed to remove snapshot: " << cpp_strerror(r)
+	 << dendl;
+  }
+  dout(10) << __func__ << " freelist seq now " << freelist_seq << dendl;
+}
+
 int BlueStore::_open_fsid(bool create)
 {
   ceph_assert(fsid_fd < 0);
@@ -5259,6 +5623,13 @@ int BlueStore::_minimal_open_bluefs(bool create)
   } else {
     r = -errno;
     if (::lstat(bfn.c_str(), &st) == -1) {
+      if (bdev->is_smr()) {
+	// rocksdb overwrites its files in place
+	derr << __func__ << " a zoned main device needs a separate "
+	     << "block.db device" << dendl;
+	r = -EINVAL;
+	goto free_bluefs;
+      }
       r = 0;
       bluefs_layout.shared_bdev = BlueFS::BDEV_DB;
     } else {
@@ -5278,7 +5649,7 @@ int BlueStore::_minimal_open_bluefs(bool create)
 	  << cpp_strerror(r) << dendl;
     goto free_bluefs;
   }
-  if (create) {
+  if (create && !bdev->is_smr()) {
     // note: we always leave the first SUPER_RESERVED (8k) of the device unused
     uint64_t initial =
       bdev->get_size() * (cct->_conf->bluestore_bluefs_min_ratio +
@@ -5444,6 +5815,8 @@ int BlueStore::_open_db_and_around(bool read_only)
 	_close_fm();
 	return r;
       }
+      // the freelist may change from now on
+      _invalidate_alloc_snapshot();
     }
   } else {
     r = _open_db(false, false);
@@ -5742,6 +6115,10 @@ int BlueStore::allocate_bluefs_freespace(
   PExtentVector* extents_out)
 {
   ceph_assert(min_size <= size);
+  if (bdev->is_smr()) {
+    // never share a zoned main device with bluefs
+    return -ENOSPC;
+  }
   if (size) {
     // round up to alloc size
     uint64_t alloc_size = bluefs->get_alloc_size(bluefs_layout.shared_bdev);
@@ -5918,6 +6295,9 @@ int BlueStore::_balance_bluefs_freespace()
   if (clear_alert) {
     _clear_spillover_alert();
   }
+  if (bdev->is_smr()) {
+    return 0;
+  }
 
   // fixme: look at primary bdev only for now
   int64_t delta = _get_bluefs_size_delta(
@@ -6891,6 +7271,10 @@ int BlueStore::_mount(bool kv_only, bool open_db)
     _check_legacy_statfs_alert();
   }
 
+  if (bdev->is_smr()) {
+    _zone_cleaner_start();
+  }
+
   mounted = true;
   return 0;
 
@@ -6914,6 +7298,9 @@ int BlueStore::umount()
   ceph_assert(_kv_only || mounted);
   dout(1) << __func__ << dendl;
 
+  if (!_kv_only && bdev->is_smr()) {
+    _zone_cleaner_stop();
+  }
   _osr_drain_all();
 
   mounted = false;
@@ -6924,6 +7311,10 @@ int BlueStore::umount()
     _flush_cache();
     dout(20) << __func__ << " closing" << dendl;
 
+    if (bluefs && cct->_conf->bluestore_alloc_snapshot && !bdev->is_smr()) {
+      // not fatal, the next mount will walk the freelist
+      _write_alloc_snapshot();
+    }
   }
   _close_db_and_around();
   _close_bdev();
@@ -7328,10 +7719,12 @@ BlueStore::OnodeRef BlueStore::fsck_check_objects_shallow(
       ceph_assert(sbi.cid == coll_t() || sbi.cid == c->cid);
       ceph_assert(sbi.pool_id == INT64_MIN ||
         sbi.pool_id == oid.hobj.get_logical_pool());
+      if (sbi.pool_id == INT64_MIN) {
+        sbi.oid = oid;
+      }
       sbi.cid = c->cid;
       sbi.pool_id = oid.hobj.get_logical_pool();
       sbi.sb = i.first->shared_blob;
-      sbi.oids.push_back(oid);
       sbi.compressed = blob.is_compressed();
       for (auto e : blob.get_extents()) {
         if (e.is_valid()) {
@@ -7360,6 +7753,139 @@ BlueStore::OnodeRef BlueStore::fsck_check_objects_shallow(
   return o;
 }
 
+int64_t BlueStore::_fsck_deep_read(Collection* c,
+  OnodeRef& o,
+  uint64_t max_read_block,
+  uint64_t* bytes_read)
+{
+  bufferlist bl;
+  uint64_t offset = 0;
+  do {
+    uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
+    int r = _do_read(c, o, offset, l, bl,
+      CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+    if (r < 0) {
+      derr << "fsck error: " << o->oid << std::hex
+        << " error during read: "
+        << " " << offset << "~" << l
+        << " " << cpp_strerror(r) << std::dec
+        << dendl;
+      return 1;
+    }
+    *bytes_read += r;
+    offset += l;
+  } while (offset < o->onode.size);
+  return 0;
+}
+
+void BlueStore::_fsck_log_progress(uint64_t num_keys,
+  uint64_t num_objects,
+  const utime_t& start,
+  const utime_t& now,
+  uint64_t bytes_read)
+{
+  double dur = now - start;
+  dout(1) << "fsck progress: " << num_keys << " keys, "
+          << num_objects << " objects checked"
+          << " in " << (now - start)
+          << " (" << (dur > 0 ? num_keys / dur : 0) << " keys/s";
+  if (bytes_read) {
+    *_dout << ", read " << byte_u_t(bytes_read)
+           << " at " << byte_u_t(dur > 0 ? bytes_read / dur : 0) << "/s";
+  }
+  *_dout << ")" << dendl;
+}
+
+/*
+ * A small pool of threads reading object data back for deep fsck.
+ * The queue is bounded so that the key walk does not pin more than a
+ * few onodes per thread in memory while the readers catch up.
+ */
+struct BlueStore::FSCKDeepReader {
+  BlueStore* store;
+  const size_t max_queued;
+  const uint64_t max_read_block;
+
+  ceph::mutex lock = ceph::make_mutex("BlueStore::FSCKDeepReader::lock");
+  ceph::condition_variable cond;
+  std::deque<std::pair<CollectionRef, OnodeRef>> q;
+  bool stopping = false;
+  std::vector<std::thread> threads;
+
+  std::atomic<int64_t> errors = {0};
+  std::atomic<uint64_t> bytes_read = {0};
+
+  FSCKDeepReader(BlueStore* _store, size_t num_threads)
+    : store(_store),
+      max_queued(num_threads * 4),
+      // bluestore_fsck_read_bytes_cap bounds the reads in flight as a
+      // whole, each reader gets its share of it
+      max_read_block(std::max<uint64_t>(
+        store->cct->_conf->bluestore_fsck_read_bytes_cap / num_threads,
+        store->block_size)) {
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads.emplace_back(
+        make_named_thread("bstore_fsck_rd", &FSCKDeepReader::entry, this));
+    }
+  }
+  ~FSCKDeepReader() {
+    ceph_assert(threads.empty());
+  }
+
+  void queue(const CollectionRef& c, const OnodeRef& o) {
+    std::unique_lock l{lock};
+    cond.wait(l, [this] { return q.size() < max_queued; });
+    q.emplace_back(c, o);
+    cond.notify_all();
+  }
+
+  /// wait for all queued reads to complete and join the threads
+  void stop() {
+    {
+      std::lock_guard l{lock};
+      stopping = true;
+      cond.notify_all();
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    threads.clear();
+  }
+
+  int64_t get_errors() const {
+    return errors;
+  }
+  uint64_t get_bytes_read() const {
+    return bytes_read;
+  }
+
+  void entry() {
+    std::unique_lock l{lock};
+    while (true) {
+      if (q.empty()) {
+        if (stopping) {
+          break;
+        }
+        cond.wait(l);
+        continue;
+      }
+      auto c = std::move(q.front().first);
+      auto o = std::move(q.front().second);
+      q.pop_front();
+      cond.notify_all();
+      l.unlock();
+
+      uint64_t b = 0;
+      errors += store->_fsck_deep_read(c.get(), o, max_read_block, &b);
+      bytes_read += b;
+      o.reset();
+      c.reset();
+
+      l.lock();
+    }
+  }
+};
+
 #include "common/WorkQueue.h"
 
 class ShallowFSCKThreadPool : public ThreadPool
@@ -7654,13 +8180,39 @@ void BlueStore::_fsck_check_objects(FSCKDepth depth,
       thread_pool.start();
     }
 
+    // full object reads do not depend on the ordered key walk below,
+    // hand them off so that reads of different objects overlap
+    const size_t deep_read_threads =
+      cct->_conf->bluestore_fsck_deep_read_threads;
+    std::unique_ptr<FSCKDeepReader> deep_reader;
+    if (depth == FSCK_DEEP && deep_read_threads > 0) {
+      deep_reader.reset(new FSCKDeepReader(this, deep_read_threads));
+    }
+    uint64_t deep_bytes = 0;
+
+    const double progress_interval =
+      cct->_conf->bluestore_fsck_progress_interval;
+    utime_t start = ceph_clock_now();
+    utime_t next_progress = start;
+    next_progress += progress_interval;
+
     //fill global if not overriden below
     CollectionRef c;
     int64_t pool_id = -1;
     spg_t pgid;
+    uint64_t num_keys = 0;
     for (it->lower_bound(string()); it->valid(); it->next()) {
       dout(30) << __func__ << " key "
         << pretty_binary_string(it->key()) << dendl;
+      if (progress_interval > 0 && (++num_keys % 1024) == 0) {
+        utime_t now = ceph_clock_now();
+        if (now >= next_progress) {
+          _fsck_log_progress(num_keys, ctx.num_objects, start, now,
+            deep_reader ? deep_reader->get_bytes_read() : deep_bytes);
+          next_progress = now;
+          next_progress += progress_interval;
+        }
+      }
       if (is_extent_shard_key(it->key())) {
         if (depth == FSCK_SHALLOW) {
           continue;
@@ -7916,27 +8468,29 @@ void BlueStore::_fsck_check_objects(FSCKDepth depth,
           }
         } // if (depth != FSCK_SHALLOW && o->onode.has_omap())
         if (depth == FSCK_DEEP) {
-          bufferlist bl;
-          uint64_t max_read_block = cct->_conf->bluestore_fsck_read_bytes_cap;
-          uint64_t offset = 0;
-          do {
-            uint64_t l = std::min(uint64_t(o->onode.size - offset), max_read_block);
-            int r = _do_read(c.get(), o, offset, l, bl,
-              CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
-            if (r < 0) {
-              ++errors;
-              derr << "fsck error: " << oid << std::hex
-                << " error during read: "
-                << " " << offset << "~" << l
-                << " " << cpp_strerror(r) << std::dec
-                << dendl;
-              break;
-            }
-            offset += l;
-          } while (offset < o->onode.size);
+          if (deep_reader) {
+            deep_reader->queue(c, o);
+          } else {
+            errors += _fsck_deep_read(c.get(), o,
+              cct->_conf->bluestore_fsck_read_bytes_cap,
+              &deep_bytes);
+          }
         } // deep
       } //if (depth != FSCK_SHALLOW)
     } // for (it->lower_bound(string()); it->valid(); it->next())
+    if (deep_reader) {
+      deep_reader->stop();
+      errors += deep_reader->get_errors();
+      deep_bytes = deep_reader->get_bytes_read();
+    }
+    if (depth == FSCK_DEEP) {
+      double dur = ceph_clock_now() - start;
+      dout(1) << __func__ << " deep read " << byte_u_t(deep_bytes)
+              << " of " << ctx.num_objects << " objects in " << dur << "s"
+              << " (" << byte_u_t(dur > 0 ? deep_bytes / dur : 0)
+              << "/s, read threads " << deep_read_threads << ")"
+              << dendl;
+    }
     if (depth == FSCK_SHALLOW && thread_count > 0) {
       wq->finalize(thread_pool, ctx);
       if (processed_myself) {
@@ -8282,7 +8836,7 @@ int BlueStore::_fsck_on_open(BlueStore::FSCKDepth depth, bool repair)
 	  expected_statfs = &expected_pool_statfs[sbi.pool_id];
 	}
 	errors += _fsck_check_extents(sbi.cid,
-				      p->second.oids.front(),
+				      p->second.oid,
 				      extents,
 				      p->second.compressed,
 				      used_blocks,
@@ -9389,6 +9943,11 @@ void BlueStore::_read_cache(
              << " cache has 0x" << cache_interval
              << std::dec << dendl;
 
+    if (bptr->get_blob().is_compressed() && cache_interval.size()) {
+      logger->inc(l_bluestore_decompressed_cache_hit_bytes,
+		  cache_interval.size());
+    }
+
     auto pc = cache_res.begin();
     uint64_t chunk_size = bptr->get_blob().get_chunk_size(block_size);
     while (b_len > 0) {
@@ -9525,6 +10084,7 @@ int BlueStore::_generate_read_result_bl(
   vector<bufferlist>& compressed_blob_bls,
   blobs2read_t& blobs2read,
   bool buffered,
+  bool cache_decompressed,
   bool* csum_error,
   bufferlist& bl)
 {
@@ -9548,16 +10108,22 @@ int BlueStore::_generate_read_result_bl(
       auto r = _decompress(compressed_bl, &raw_bl);
       if (r < 0)
         return r;
-      if (buffered) {
+      logger->inc(l_bluestore_decompressed_bytes, raw_bl.length());
+      if (cache_decompressed) {
+        // the whole blob had to be decompressed, so keep it for reads of
+        // the neighbouring ranges; cold unless the caller wants caching
         bptr->shared_blob->bc.did_read(bptr->shared_blob->get_cache(), 0,
-                                       raw_bl);
+                                       raw_bl, buffered ? 1 : 0);
       }
+      uint64_t used = 0;
       for (auto& req : r2r) {
         for (auto& r : req.regs) {
           ready_regions[r.logical_offset].substr_of(
             raw_bl, r.blob_xoffset, r.length);
+          used += r.length;
         }
       }
+      logger->inc(l_bluestore_decompressed_read_bytes, used);
     } else {
       for (auto& req : r2r) {
         if (_verify_csum(o, &bptr->get_blob(), req.r_off, req.bl,
@@ -9644,6 +10210,10 @@ int BlueStore::_do_read(
     dout(20) << __func__ << " defaulting to buffered read" << dendl;
     buffered = true;
   }
+  bool cache_decompressed = buffered ||
+    (cct->_conf->bluestore_cache_decompressed_blobs &&
+     (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+		  CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0);
 
   if (offset + length > o->onode.size) {
     length = o->onode.size - offset;
@@ -9703,7 +10273,7 @@ int BlueStore::_do_read(
   bool csum_error = false;
   r = _generate_read_result_bl(o, offset, length, ready_regions,
                               compressed_blob_bls, blobs2read,
-                              buffered, &csum_error, bl);
+                              buffered, cache_decompressed, &csum_error, bl);
   if (csum_error) {
     // Handles spurious read errors caused by a kernel bug.
     // We sometimes get all-zero pages as a result of the read under
@@ -10003,6 +10573,10 @@ int BlueStore::_do_readv(
     dout(20) << __func__ << " defaulting to buffered read" << dendl;
     buffered = true;
   }
+  bool cache_decompressed = buffered ||
+    (cct->_conf->bluestore_cache_decompressed_blobs &&
+     (op_flags & (CEPH_OSD_OP_FLAG_FADVISE_DONTNEED |
+		  CEPH_OSD_OP_FLAG_FADVISE_NOCACHE)) == 0);
   // this method must be idempotent since we may call it several times
   // before we finally read the expected result.
   bl.clear();
@@ -10060,7 +10634,8 @@ int BlueStore::_do_readv(
                                  std::get<0>(raw_results[i]),
                                  std::get<1>(raw_results[i]),
                                  std::get<2>(raw_results[i]),
-                                 buffered, &csum_error, t);
+                                 buffered, cache_decompressed,
+                                 &csum_error, t);
     if (csum_error) {
       // Handles spurious read errors caused by a kernel bug.
       // We sometimes get all-zero pages as a result of the read under
@@ -10083,6 +10658,235 @@ int BlueStore::_do_readv(
   return bl.length();
 }
 
+int BlueStore::digest(
+  CollectionHandle &c_,
+  const ghobject_t& oid,
+  uint64_t offset,
+  size_t length,
+  uint32_t *crc,
+  uint32_t op_flags)
+{
+  auto start = mono_clock::now();
+  Collection *c = static_cast<Collection *>(c_.get());
+  const coll_t &cid = c->get_cid();
+  dout(15) << __func__ << " " << cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length << std::dec
+	   << dendl;
+  if (!c->exists)
+    return -ENOENT;
+
+  int r;
+  {
+    std::shared_lock l(c->lock);
+    auto start1 = mono_clock::now();
+    OnodeRef o = c->get_onode(oid, false);
+    log_latency("get_onode@read",
+      l_bluestore_read_onode_meta_lat,
+      mono_clock::now() - start1,
+      cct->_conf->bluestore_log_op_age);
+    if (!o || !o->exists) {
+      r = -ENOENT;
+      goto out;
+    }
+
+    if (offset == length && offset == 0)
+      length = o->onode.size;
+
+    r = _do_digest(c, o, offset, length, crc, op_flags);
+    if (r == -EIO) {
+      logger->inc(l_bluestore_read_eio);
+    }
+  }
+
+ out:
+  if (r >= 0 && _debug_data_eio(oid)) {
+    r = -EIO;
+    derr << __func__ << " " << c->cid << " " << oid << " INJECT EIO" << dendl;
+  }
+  dout(10) << __func__ << " " << cid << " " << oid
+	   << " 0x" << std::hex << offset << "~" << length
+	   << " crc 0x" << *crc << std::dec
+	   << " = " << r << dendl;
+  log_latency(__func__,
+    l_bluestore_read_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age);
+  return r;
+}
+
+int BlueStore::_do_digest(
+  Collection *c,
+  OnodeRef o,
+  uint64_t offset,
+  size_t length,
+  uint32_t *crc,
+  uint32_t op_flags,
+  uint64_t retry_count)
+{
+  FUNCTRACE(cct);
+  int r = 0;
+  int read_cache_policy = 0; // do not bypass clean or dirty cache
+
+  dout(20) << __func__ << " 0x" << std::hex << offset << "~" << length
+           << " size 0x" << o->onode.size << " (" << std::dec
+           << o->onode.size << ")" << dendl;
+
+  if (offset >= o->onode.size) {
+    return r;
+  }
+  if (offset + length > o->onode.size) {
+    length = o->onode.size - offset;
+  }
+
+  auto start = mono_clock::now();
+  o->extent_map.fault_range(db, offset, length);
+  log_latency(__func__,
+    l_bluestore_read_onode_meta_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age);
+  _dump_onode<30>(cct, *o);
+
+  if (op_flags & CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE) {
+    dout(20) << __func__ << " will bypass cache and do direct read" << dendl;
+    read_cache_policy = BufferSpace::BYPASS_CLEAN_CACHE;
+  }
+
+  ready_regions_t ready_regions;
+  blobs2read_t blobs2read;
+  _read_cache(o, offset, length, read_cache_policy, ready_regions, blobs2read);
+
+  start = mono_clock::now();
+  vector<bufferlist> compressed_blob_bls;
+  IOContext ioc(cct, NULL, true); // allow EIO
+  r = _prepare_read_ioc(blobs2read, &compressed_blob_bls, &ioc);
+  // we always issue aio for reading, so errors other than EIO are not allowed
+  if (r < 0)
+    return r;
+
+  int64_t num_ios = length;
+  if (ioc.has_pending_aios()) {
+    num_ios = -ioc.get_num_ios();
+    bdev->aio_submit(&ioc);
+    dout(20) << __func__ << " waiting for aio" << dendl;
+    ioc.aio_wait();
+    r = ioc.get_return_value();
+    if (r < 0) {
+      ceph_assert(r == -EIO); // no other errors allowed
+      return -EIO;
+    }
+  }
+  log_latency_fn(__func__,
+    l_bluestore_read_wait_aio_lat,
+    mono_clock::now() - start,
+    cct->_conf->bluestore_log_op_age,
+    [&](auto lat) { return ", num_ios = " + stringify(num_ios); }
+  );
+
+  // verify what was read.  whole csum chunks of uncompressed crc32c
+  // blobs have just been hashed by the verification, so their stored
+  // crcs stand in for the data; everything else is hashed as read.
+  map<uint64_t, uint32_t> chunk_crcs;  // logical offset -> crc32c(-1, chunk)
+  uint32_t chunk_len = 0;
+  auto p = compressed_blob_bls.begin();
+  for (auto& b2r : blobs2read) {
+    const BlobRef& bptr = b2r.first;
+    const bluestore_blob_t& blob = bptr->get_blob();
+    regions2read_t& r2r = b2r.second;
+    if (blob.is_compressed()) {
+      ceph_assert(p != compressed_blob_bls.end());
+      bufferlist& compressed_bl = *p++;
+      if (_verify_csum(o, &blob, 0, compressed_bl,
+                       r2r.front().regs.front().logical_offset) < 0) {
+        goto csum_error;
+      }
+      bufferlist raw_bl;
+      r = _decompress(compressed_bl, &raw_bl);
+      if (r < 0)
+        return r;
+      logger->inc(l_bluestore_decompressed_bytes, raw_bl.length());
+      for (auto& req : r2r) {
+        for (auto& reg : req.regs) {
+          ready_regions[reg.logical_offset].substr_of(
+            raw_bl, reg.blob_xoffset, reg.length);
+        }
+      }
+      continue;
+    }
+    for (auto& req : r2r) {
+      if (_verify_csum(o, &blob, req.r_off, req.bl,
+                       req.regs.front().logical_offset) < 0) {
+        goto csum_error;
+      }
+      uint32_t csum_chunk = blob.get_csum_chunk_size();
+      bool reuse = blob.csum_type == Checksummer::CSUM_CRC32C &&
+        !cct->_conf->bluestore_ignore_data_csum &&
+        (!chunk_len || chunk_len == csum_chunk);
+      for (const auto& reg : req.regs) {
+        if (reuse &&
+            reg.front % csum_chunk == 0 &&
+            reg.length % csum_chunk == 0) {
+          chunk_len = csum_chunk;
+          uint64_t first = (req.r_off + reg.front) / csum_chunk;
+          for (uint64_t i = 0; i < reg.length / csum_chunk; ++i) {
+            chunk_crcs[reg.logical_offset + i * csum_chunk] =
+              blob.get_csum_item(first + i);
+          }
+        } else {
+          ready_regions[reg.logical_offset].substr_of(
+            req.bl, reg.front, reg.length);
+        }
+      }
+    }
+  }
+
+  {
+    // fold everything into the crc in logical order; holes are zeros
+    uint64_t pos = offset;
+    uint64_t end = offset + length;
+    auto pr = ready_regions.begin();
+    auto pc = chunk_crcs.begin();
+    uint64_t reused = 0;
+    while (pos < end) {
+      if (pr != ready_regions.end() && pr->first == pos) {
+        *crc = pr->second.crc32c(*crc);
+        pos += pr->second.length();
+        ++pr;
+      } else if (pc != chunk_crcs.end() && pc->first == pos) {
+        // crc32c(s, B) = crc32c(-1, B) ^ crc32c(s ^ -1, zeros(len(B)))
+        *crc = pc->second ^ ceph_crc32c(*crc ^ 0xffffffff, NULL, chunk_len);
+        pos += chunk_len;
+        reused += chunk_len;
+        ++pc;
+      } else {
+        uint64_t l = end - pos;
+        if (pr != ready_regions.end())
+          l = std::min(l, pr->first - pos);
+        if (pc != chunk_crcs.end())
+          l = std::min(l, pc->first - pos);
+        *crc = ceph_crc32c(*crc, NULL, l);
+        pos += l;
+      }
+    }
+    ceph_assert(pos == end);
+    ceph_assert(pr == ready_regions.end());
+    ceph_assert(pc == chunk_crcs.end());
+    logger->inc(l_bluestore_digest_csum_reused_bytes, reused);
+  }
+  if (retry_count) {
+    logger->inc(l_bluestore_reads_with_retries);
+    dout(5) << __func__ << " read at 0x" << std::hex << offset << "~" << length
+            << " failed " << std::dec << retry_count << " times before succeeding" << dendl;
+  }
+  return length;
+
+ csum_error:
+  // same retry as _do_read, see http://tracker.ceph.com/issues/22464
+  if (retry_count >= cct->_conf->bluestore_retry_disk_reads) {
+    return -EIO;
+  }
+  return _do_digest(c, o, offset, length, crc, op_flags, retry_count + 1);
+}
+
 int BlueStore::dump_onode(CollectionHandle &c_,
   const ghobject_t& oid,
   const string& section_name,
@@ -11880,9 +12684,15 @@ void BlueStore::_kv_finalize_thread()
       deferred_stable.clear();
 
       if (!deferred_aggressive) {
-	if (deferred_queue_size >= deferred_batch_ops.load() ||
-	    throttle.should_submit_deferred()) {
+	if (throttle.should_submit_deferred()) {
 	  deferred_try_submit();
+	} else if (deferred_queue_size >= deferred_batch_ops.load()) {
+	  // give other sequencers a chance to queue adjacent writes
+	  utime_t window_end = get_deferred_last_submitted();
+	  window_end += cct->_conf->bluestore_deferred_flush_window;
+	  if (window_end <= ceph_clock_now()) {
+	    deferred_try_submit();
+	  }
 	}
       }
 
@@ -11904,6 +12714,233 @@ void BlueStore::_kv_finalize_thread()
   kv_finalize_started = false;
 }
 
+// zone cleaner
+
+void BlueStore::_zone_cleaner_start()
+{
+  dout(10) << __func__ << dendl;
+  zone_cleaner_stop = false;
+  zone_cleaner_skip.clear();
+  zone_cleaner_thread.create("bstore_zone_cln");
+}
+
+void BlueStore::_zone_cleaner_stop()
+{
+  dout(10) << __func__ << dendl;
+  {
+    std::lock_guard l{zone_cleaner_lock};
+    zone_cleaner_stop = true;
+    zone_cleaner_cond.notify_all();
+  }
+  zone_cleaner_thread.join();
+  dout(10) << __func__ << " stopped" << dendl;
+}
+
+void BlueStore::_zone_cleaner_thread()
+{
+  dout(10) << __func__ << " start" << dendl;
+  std::unique_lock l{zone_cleaner_lock};
+  while (!zone_cleaner_stop) {
+    l.unlock();
+    _zone_reset_empty();
+    _zone_clean();
+    l.lock();
+    if (zone_cleaner_stop) {
+      break;
+    }
+    zone_cleaner_cond.wait_for(
+      l, ceph::make_timespan(cct->_conf->bluestore_zoned_cleaner_interval));
+  }
+  dout(10) << __func__ << " finish" << dendl;
+}
+
+void BlueStore::_zone_reset_empty()
+{
+  auto za = static_cast<ZonedAllocator*>(alloc);
+  uint64_t zone;
+  while (!zone_cleaner_stop && za->claim_empty_zone(&zone)) {
+    int r = bdev->reset_zone(zone);
+    if (r < 0) {
+      derr << __func__ << " failed to reset zone " << zone << ": "
+	   << cpp_strerror(r) << dendl;
+      za->unclaim_zone(zone);
+      break;
+    }
+    za->reset_zone(zone);
+    logger->inc(l_bluestore_zone_resets);
+  }
+}
+
+/*
+ * There is no reverse map from physical extents to objects, so we
+ * walk all onodes and rewrite whatever part of them lives in the
+ * victim zone.  The rewrite goes through the regular write path and
+ * lands in the zone the cleaner thread is appending to; the old space
+ * is released when the transaction commits, and once nothing live is
+ * left the zone is reset by _zone_reset_empty().
+ */
+void BlueStore::_zone_clean()
+{
+  auto za = static_cast<ZonedAllocator*>(alloc);
+  uint64_t capacity = za->get_capacity();
+  uint64_t free = za->get_free();
+  if (free >= capacity * cct->_conf->bluestore_zoned_cleaner_free_ratio) {
+    return;
+  }
+  uint64_t zone_size = za->get_zone_size();
+  uint64_t zone, live;
+  if (!za->pick_zone_to_clean(
+	zone_size * cct->_conf->bluestore_zoned_cleaner_max_live_ratio,
+	zone_cleaner_skip, &zone, &live)) {
+    dout(10) << __func__ << " 0x" << std::hex << free << std::dec
+	     << " writable but no zone worth cleaning" << dendl;
+    return;
+  }
+  if (free < live) {
+    dout(1) << __func__ << " zone " << zone << " has 0x" << std::hex << live
+	    << " live bytes but only 0x" << free << std::dec
+	    << " are writable" << dendl;
+    return;
+  }
+  uint64_t zone_start = zone * zone_size;
+  uint64_t zone_end = zone_start + zone_size;
+  dout(1) << __func__ << " relocating 0x" << std::hex << live
+	  << " live bytes out of zone " << std::dec << zone << dendl;
+
+  auto in_zone = [&](OnodeRef& o) {
+    for (auto& e : o->extent_map.extent_map) {
+      for (auto& p : e.blob->get_blob().get_extents()) {
+	if (p.is_valid() &&
+	    p.offset < zone_end && p.offset + p.length > zone_start) {
+	  return true;
+	}
+      }
+    }
+    return false;
+  };
+
+  set<CollectionRef> touched;
+  uint64_t moved = 0;
+  CollectionRef c;
+  KeyValueDB::Iterator it = db->get_iterator(PREFIX_OBJ);
+  for (it->lower_bound(string());
+       it->valid() && !zone_cleaner_stop;
+       it->next()) {
+    if (is_extent_shard_key(it->key())) {
+      continue;
+    }
+    ghobject_t oid;
+    if (get_key_object(it->key(), &oid) < 0) {
+      continue;
+    }
+    if (!c || !c->contains(oid)) {
+      c = nullptr;
+      std::shared_lock l(coll_lock);
+      for (auto& p : coll_map) {
+	if (p.second->contains(oid)) {
+	  c = p.second;
+	  break;
+	}
+      }
+      if (!c) {
+	continue;
+      }
+    }
+    bool relocate = false;
+    {
+      std::shared_lock l(c->lock);
+      OnodeRef o = c->get_onode(oid, false);
+      if (o && o->exists) {
+	o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+	relocate = in_zone(o);
+      }
+    }
+    if (relocate) {
+      int r = _zone_relocate_object(c, oid, zone_start, zone_end, &moved);
+      if (r < 0) {
+	derr << __func__ << " failed to read " << oid << ": "
+	     << cpp_strerror(r) << dendl;
+      }
+      touched.insert(c);
+    }
+  }
+
+  // wait for the relocations to commit and release the old space
+  for (auto& tc : touched) {
+    _osr_drain(tc->osr.get());
+  }
+  logger->inc(l_bluestore_zone_relocated_bytes, moved);
+  uint64_t left = za->get_zone_used(zone);
+  dout(1) << __func__ << " relocated 0x" << std::hex << moved
+	  << " bytes, 0x" << left << std::dec << " left in zone " << zone
+	  << dendl;
+  if (left && !zone_cleaner_stop) {
+    derr << __func__ << " zone " << zone << " still has 0x" << std::hex
+	 << left << std::dec << " live bytes not referenced by any object,"
+	 << " not trying it again" << dendl;
+    zone_cleaner_skip.insert(zone);
+  }
+}
+
+int BlueStore::_zone_relocate_object(
+  CollectionRef& c,
+  const ghobject_t& oid,
+  uint64_t zone_start,
+  uint64_t zone_end,
+  uint64_t *moved)
+{
+  dout(10) << __func__ << " " << c->cid << " " << oid << dendl;
+  int r = 0;
+  std::unique_lock zl(zoned_prepare_lock);
+  TransContext *txc = _txc_create(c.get(), c->osr.get(), nullptr);
+  {
+    std::unique_lock l{c->lock};
+    OnodeRef o = c->get_onode(oid, false);
+    if (o && o->exists) {
+      o->extent_map.fault_range(db, 0, OBJECT_MAX_SIZE);
+      interval_set<uint64_t> to_move;
+      for (auto& e : o->extent_map.extent_map) {
+	for (auto& p : e.blob->get_blob().get_extents()) {
+	  if (p.is_valid() &&
+	      p.offset < zone_end && p.offset + p.length > zone_start) {
+	    to_move.union_insert(e.logical_offset, e.length);
+	    break;
+	  }
+	}
+      }
+      for (auto p = to_move.begin(); p != to_move.end(); ++p) {
+	bufferlist bl;
+	r = _do_read(c.get(), o, p.get_start(), p.get_len(), bl, 0);
+	if (r < 0) {
+	  break;
+	}
+	ceph_assert(r == (int)p.get_len());
+	r = _write(txc, c, o, p.get_start(), p.get_len(), bl, 0);
+	if (r < 0) {
+	  // the onode may be half updated by now, same as in
+	  // _txc_add_transaction() there is no way back
+	  derr << __func__ << " error " << cpp_strerror(r)
+	       << " rewriting " << oid << dendl;
+	  ceph_abort_msg("unexpected error relocating object");
+	}
+	*moved += p.get_len();
+      }
+    }
+  }
+  _txc_calc_cost(txc);
+  _txc_write_nodes(txc, txc->t);
+  _txc_finalize_kv(txc, txc->t);
+  zl.unlock();
+
+  auto tstart = mono_clock::now();
+  if (!throttle.try_start_transaction(*db, *txc, tstart)) {
+    throttle.finish_start_transaction(*db, *txc, tstart);
+  }
+  logger->inc(l_bluestore_txc);
+  _txc_state_proc(txc);
+  return r;
+}
+
 bluestore_deferred_op_t *BlueStore::_get_deferred_op(
   TransContext *txc)
 {
@@ -11955,6 +12992,20 @@ void BlueStore::deferred_try_submit()
   for (auto& osr : deferred_queue) {
     osrs.push_back(&osr);
   }
+  if (cct->_conf->bluestore_deferred_merge) {
+    vector<OpSequencerRef> ready;
+    for (auto& osr : osrs) {
+      if (osr->deferred_pending && !osr->deferred_running) {
+	ready.push_back(osr);
+      }
+    }
+    if (ready.size() > 1) {
+      _deferred_submit_merged_unlock(ready);
+      deferred_lock.lock();
+      deferred_last_submitted = ceph_clock_now();
+      return;
+    }
+  }
   for (auto& osr : osrs) {
     if (osr->deferred_pending) {
       if (!osr->deferred_running) {
@@ -11992,6 +13043,9 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
   for (auto& txc : b->txcs) {
     throttle.log_state_latency(txc, logger, l_bluestore_state_deferred_queued_lat);
   }
+  if (!g_conf()->bluestore_debug_omit_block_device_write) {
+    logger->inc(l_bluestore_deferred_write_extents, b->iomap.size());
+  }
   uint64_t start = 0, pos = 0;
   bufferlist bl;
   auto i = b->iomap.begin();
@@ -12029,6 +13083,80 @@ void BlueStore::_deferred_submit_unlock(OpSequencer *osr)
   bdev->aio_submit(&b->ioc);
 }
 
+void BlueStore::_deferred_submit_merged_unlock(
+  const vector<OpSequencerRef>& osrs)
+{
+  dout(10) << __func__ << " " << osrs.size() << " osrs" << dendl;
+  auto m = new DeferredMergedBatch(cct);
+  m->batches.reserve(osrs.size());
+  for (auto& osr : osrs) {
+    ceph_assert(osr->deferred_pending);
+    ceph_assert(!osr->deferred_running);
+    auto b = osr->deferred_pending;
+    deferred_queue_size -= b->seq_bytes.size();
+    osr->deferred_running = b;
+    osr->deferred_pending = nullptr;
+    m->batches.push_back(b);
+  }
+  ceph_assert(deferred_queue_size >= 0);
+
+  deferred_lock.unlock();
+
+  // sort the ios of all batches by offset so that adjacent ones from
+  // different sequencers end up in a single write.  ios from different
+  // sequencers never overlap, but if they did we would simply not
+  // merge them.
+  vector<std::pair<uint64_t, bufferlist*>> ios;
+  for (auto b : m->batches) {
+    for (auto& txc : b->txcs) {
+      throttle.log_state_latency(txc, logger,
+	l_bluestore_state_deferred_queued_lat);
+    }
+    for (auto& i : b->iomap) {
+      ios.emplace_back(i.first, &i.second.bl);
+    }
+  }
+  std::sort(ios.begin(), ios.end(),
+	    [](const auto& a, const auto& b) { return a.first < b.first; });
+
+  uint64_t num_writes = 0;
+  uint64_t start = 0, pos = 0;
+  bufferlist bl;
+  auto flush = [&]() {
+    if (!bl.length()) {
+      return;
+    }
+    dout(20) << __func__ << " write 0x" << std::hex
+	     << start << "~" << bl.length() << std::dec << dendl;
+    if (!g_conf()->bluestore_debug_omit_block_device_write) {
+      logger->inc(l_bluestore_deferred_write_ops);
+      logger->inc(l_bluestore_deferred_write_bytes, bl.length());
+      int r = bdev->aio_write(start, bl, &m->ioc, false);
+      ceph_assert(r == 0);
+    }
+    ++num_writes;
+    bl.clear();
+  };
+  for (auto& i : ios) {
+    if (!bl.length() || i.first != pos) {
+      flush();
+      start = pos = i.first;
+    }
+    pos += i.second->length();
+    bl.claim_append(*i.second);
+  }
+  flush();
+  dout(10) << __func__ << " " << ios.size() << " extents of "
+	   << m->batches.size() << " batches in " << num_writes << " writes"
+	   << dendl;
+  if (!g_conf()->bluestore_debug_omit_block_device_write) {
+    logger->inc(l_bluestore_deferred_write_extents, ios.size());
+  }
+  logger->inc(l_bluestore_deferred_merged_batches, m->batches.size());
+
+  bdev->aio_submit(&m->ioc);
+}
+
 struct C_DeferredTrySubmit : public Context {
   BlueStore *store;
   C_DeferredTrySubmit(BlueStore *s) : store(s) {}
@@ -12155,6 +13283,11 @@ int BlueStore::queue_transactions(
   OpSequencer *osr = c->osr.get();
   dout(10) << __func__ << " ch " << c << " " << c->cid << dendl;
 
+  std::shared_lock zl(zoned_prepare_lock, std::defer_lock);
+  if (bdev->is_smr()) {
+    zl.lock();
+  }
+
   // prepare
   TransContext *txc = _txc_create(static_cast<Collection*>(ch.get()), osr,
 				  &on_commit);
@@ -12178,6 +13311,9 @@ int BlueStore::queue_transactions(
   }
 
   _txc_finalize_kv(txc, txc->t);
+  if (zl.owns_lock()) {
+    zl.unlock();
+  }
   if (handle)
     handle->suspend_tp_timeout();
 
@@ -12795,7 +13931,8 @@ void BlueStore::_do_write_small(
 	uint64_t b_len = length + head_pad + tail_pad;
 
 	// direct write into unused blocks of an existing mutable blob?
-	if ((b_off % chunk_size == 0 && b_len % chunk_size == 0) &&
+	if (!bdev->is_smr() &&
+	    (b_off % chunk_size == 0 && b_len % chunk_size == 0) &&
 	    b->get_blob().get_ondisk_length() >= b_off + b_len &&
 	    b->get_blob().is_unused(b_off, b_len) &&
 	    b->get_blob().is_allocated(b_off, b_len)) {
@@ -12855,7 +13992,8 @@ void BlueStore::_do_write_small(
 	}
 
 	// chunk-aligned deferred overwrite?
-	if (b->get_blob().get_ondisk_length() >= b_off + b_len &&
+	if (!bdev->is_smr() &&
+	    b->get_blob().get_ondisk_length() >= b_off + b_len &&
 	    b_off % chunk_size == 0 &&
 	    b_len % chunk_size == 0 &&
 	    b->get_blob().is_allocated(b_off, b_len)) {
@@ -90,12 +90,18 @@ enum {
   l_bluestore_read_wait_aio_lat,
   l_bluestore_compress_lat,
   l_bluestore_decompress_lat,
+  l_bluestore_decompressed_bytes,
+  l_bluestore_decompressed_read_bytes,
+  l_bluestore_decompressed_cache_hit_bytes,
   l_bluestore_csum_lat,
+  l_bluestore_digest_csum_reused_bytes,
   l_bluestore_compress_success_count,
   l_bluestore_compress_rejected_count,
   l_bluestore_write_pad_bytes,
   l_bluestore_deferred_write_ops,
   l_bluestore_deferred_write_bytes,
+  l_bluestore_deferred_write_extents,
+  l_bluestore_deferred_merged_batches,
   l_bluestore_write_penalty_read_ops,
   l_bluestore_allocated,
   l_bluestore_stored,
@@ -127,9 +133,13 @@ enum {
   l_bluestore_blob_split,
   l_bluestore_extent_compress,
   l_bluestore_gc_merged,
+  l_bluestore_zone_resets,
+  l_bluestore_zone_relocated_bytes,
   l_bluestore_read_eio,
   l_bluestore_reads_with_retries,
   l_bluestore_fragmentation,
+  l_bluestore_alloc_snapshot_loads,
+  l_bluestore_alloc_snapshot_misses,
   l_bluestore_omap_seek_to_first_lat,
   l_bluestore_omap_upper_bound_lat,
   l_bluestore_omap_lower_bound_lat,
@@ -365,11 +375,13 @@ public:
       cache->_trim();
     }
     void _finish_write(BufferCacheShard* cache, uint64_t seq);
-    void did_read(BufferCacheShard* cache, uint32_t offset, bufferlist& bl) {
+    /// level 0 inserts the buffer cold, i.e. first in line for trimming
+    void did_read(BufferCacheShard* cache, uint32_t offset, bufferlist& bl,
+		  int level = 1) {
       std::lock_guard l(cache->lock);
       Buffer *b = new Buffer(this, Buffer::STATE_CLEAN, 0, offset, bl);
       b->cache_private = _discard(cache, offset, bl.length());
-      _add_buffer(cache, b, 1, nullptr);
+      _add_buffer(cache, b, level, nullptr);
       cache->_trim();
     }
 
@@ -1063,6 +1075,9 @@ public:
     mempool::bluestore_cache_other::string key;
 
     boost::intrusive::list_member_hook<> lru_item;
+    /// set by cache hits, which do not take the cache shard lock; the
+    /// lru is adjusted lazily when the shard is trimmed
+    std::atomic<bool> lru_referenced = {false};
 
     bluestore_onode_t onode;  ///< metadata stored as value in kv store
     bool exists;              ///< true if object logically exists
@@ -1246,6 +1261,10 @@ public:
     OnodeCacheShard *cache;
 
   private:
+    /// protect onode_map; taken after cache->lock.  lookups only take
+    /// this (shared), so that cache hits do not serialize on the shard
+    ceph::shared_mutex map_lock =
+      ceph::make_shared_mutex("BlueStore::OnodeSpace::map_lock");
     /// forward lookups
     mempool::bluestore_cache_other::unordered_map<ghobject_t,OnodeRef> onode_map;
 
@@ -1259,9 +1278,9 @@ public:
 
     OnodeRef add(const ghobject_t& oid, OnodeRef o);
     OnodeRef lookup(const ghobject_t& o);
-    void remove(const ghobject_t& oid) {
-      onode_map.erase(oid);
-    }
+    /// drop o unless it is referenced from outside the cache; the
+    /// returned ref keeps it alive until the caller is done with it
+    OnodeRef remove_unpinned(Onode* o);
     void rename(OnodeRef& o, const ghobject_t& old_oid,
 		const ghobject_t& new_oid,
 		const mempool::bluestore_cache_other::string& new_okey);
@@ -1735,6 +1754,22 @@ public:
     }
   };
 
+  /// deferred batches of several OpSequencers submitted as one set of
+  /// sorted, coalesced ios
+  struct DeferredMergedBatch final : public AioContext {
+    vector<DeferredBatch*> batches;
+    IOContext ioc;
+
+    DeferredMergedBatch(CephContext *cct) : ioc(cct, this) {}
+
+    void aio_finish(BlueStore *store) override {
+      for (auto b : batches) {
+	store->_deferred_aio_finish(b->osr);
+      }
+      delete this;
+    }
+  };
+
   class OpSequencer : public RefCountedObject {
   public:
     ceph::mutex qlock = ceph::make_mutex("BlueStore::OpSequencer::qlock");
@@ -1886,6 +1921,15 @@ public:
     }
   };
 
+  struct ZoneCleanerThread : public Thread {
+    BlueStore *store;
+    explicit ZoneCleanerThread(BlueStore *s) : store(s) {}
+    void *entry() override {
+      store->_zone_cleaner_thread();
+      return NULL;
+    }
+  };
+
   struct DBHistogram {
     struct value_dist {
       uint64_t count;
@@ -1920,6 +1964,7 @@ private:
   KeyValueDB *db = nullptr;
   BlockDevice *bdev = nullptr;
   std::string freelist_type;
+  uint64_t freelist_seq = 0;  ///< matches the last allocator snapshot written
   FreelistManager *fm = nullptr;
   Allocator *alloc = nullptr;
   uuid_d fsid;
@@ -1977,6 +2022,17 @@ private:
   deque<DeferredBatch*> deferred_stable_to_finalize; ///< pending finalization
   bool kv_finalize_in_progress = false;
 
+  ZoneCleanerThread zone_cleaner_thread;
+  ceph::mutex zone_cleaner_lock = ceph::make_mutex("BlueStore::zone_cleaner_lock");
+  ceph::condition_variable zone_cleaner_cond;
+  std::atomic<bool> zone_cleaner_stop = {false};
+  set<uint64_t> zone_cleaner_skip;  ///< zones we failed to empty
+  /// zoned main device only: held shared while a txc is prepared, and
+  /// exclusively by the zone cleaner, which rewrites objects behind the
+  /// osd's back
+  ceph::shared_mutex zoned_prepare_lock =
+    ceph::make_shared_mutex("BlueStore::zoned_prepare_lock");
+
   PerfCounters *logger = nullptr;
 
   list<CollectionRef> removed_collections;
@@ -2245,6 +2301,9 @@ private:
   void _close_fm();
   int _open_alloc();
   void _close_alloc();
+  int _load_alloc_snapshot(uint64_t* num, uint64_t* bytes);
+  int _write_alloc_snapshot();
+  void _invalidate_alloc_snapshot();
   int _open_collections();
   void _fsck_collections(int64_t* errors);
   void _close_collections();
@@ -2322,12 +2381,22 @@ private:
   void _kv_sync_thread();
   void _kv_finalize_thread();
 
+  void _zone_cleaner_start();
+  void _zone_cleaner_stop();
+  void _zone_cleaner_thread();
+  void _zone_reset_empty();
+  void _zone_clean();
+  int _zone_relocate_object(CollectionRef& c, const ghobject_t& oid,
+			    uint64_t zone_start, uint64_t zone_end,
+			    uint64_t *moved);
+
   bluestore_deferred_op_t *_get_deferred_op(TransContext *txc);
   void _deferred_queue(TransContext *txc);
 public:
   void deferred_try_submit();
 private:
   void _deferred_submit_unlock(OpSequencer *osr);
+  void _deferred_submit_merged_unlock(const vector<OpSequencerRef>& osrs);
   void _deferred_aio_finish(OpSequencer *osr);
   int _deferred_replay();
 
@@ -2636,6 +2705,7 @@ private:
     vector<bufferlist>& compressed_blob_bls,
     blobs2read_t& blobs2read,
     bool buffered,
+    bool cache_decompressed,
     bool* csum_error,
     bufferlist& bl);
 
@@ -2656,6 +2726,15 @@ private:
     uint32_t op_flags = 0,
     uint64_t retry_count = 0);
 
+  int _do_digest(
+    Collection *c,
+    OnodeRef o,
+    uint64_t offset,
+    size_t len,
+    uint32_t *crc,
+    uint32_t op_flags = 0,
+    uint64_t retry_count = 0);
+
   int _fiemap(CollectionHandle &c_, const ghobject_t& oid,
  	     uint64_t offset, size_t len, interval_set<uint64_t>& destset);
 public:
@@ -2671,6 +2750,14 @@ public:
     bufferlist& bl,
     uint32_t op_flags) override;
 
+  int digest(
+    CollectionHandle &c,
+    const ghobject_t& oid,
+    uint64_t offset,
+    size_t len,
+    uint32_t *crc,
+    uint32_t op_flags = 0) override;
+
   int dump_onode(CollectionHandle &c, const ghobject_t& oid,
     const string& section_name, Formatter *f) override;
 
@@ -3183,7 +3270,7 @@ public:
   struct sb_info_t {
     coll_t cid;
     int64_t pool_id = INT64_MIN;
-    list<ghobject_t> oids;
+    ghobject_t oid;  ///< first referencing object, only used for reporting
     BlueStore::SharedBlobRef sb;
     bluestore_extent_ref_map_t ref_map;
     bool compressed = false;
@@ -3263,8 +3350,19 @@ public:
     const BlueStore::FSCK_ObjectCtx& ctx);
 
 private:
+  struct FSCKDeepReader;
+
   void _fsck_check_objects(FSCKDepth depth,
     FSCK_ObjectCtx& ctx);
+  int64_t _fsck_deep_read(Collection* c,
+    OnodeRef& o,
+    uint64_t max_read_block,
+    uint64_t* bytes_read);
+  void _fsck_log_progress(uint64_t num_keys,
+    uint64_t num_objects,
+    const utime_t& start,
+    const utime_t& now,
+    uint64_t bytes_read);
 };
 
 inline ostream& operator<<(ostream& out, const BlueStore::volatile_statfs& s) {
@@ -0,0 +1,56 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <mutex>
+
+#include "AvlAllocator.h"
+
+/*
+ * AVL allocator whose range tree is capped by a memory budget.  Once
+ * the cap is reached the shortest free ranges are spilled over into a
+ * (lazily created) bitmap allocator, which is much more compact for
+ * heavily fragmented space.  Allocations are served from whichever
+ * tier suits the request best, falling back to the other one.
+ */
+class HybridAllocator : public AvlAllocator {
+  Allocator* bmap_alloc = nullptr;
+public:
+  HybridAllocator(CephContext* cct, int64_t device_size, int64_t _block_size,
+                  uint64_t max_mem,
+		  const std::string& name) :
+      AvlAllocator(cct, device_size, _block_size, max_mem, name),
+      name(name) {
+  }
+  ~HybridAllocator() override {
+    delete bmap_alloc;
+  }
+  int64_t allocate(
+    uint64_t want,
+    uint64_t unit,
+    uint64_t max_alloc_size,
+    int64_t  hint,
+    PExtentVector *extents) override;
+  void release(const interval_set<uint64_t>& release_set) override;
+  uint64_t get_free() override;
+  double get_fragmentation() override;
+
+  void dump() override;
+  void dump(std::function<void(uint64_t offset, uint64_t length)> notify) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+  void shutdown() override;
+
+protected:
+  // intended primarily for UT
+  Allocator* get_bmap() {
+    return bmap_alloc;
+  }
+  const Allocator* get_bmap() const {
+    return bmap_alloc;
+  }
+private:
+  const std::string name;
+
+  void _spillover_range(uint64_t start, uint64_t end) override;
+};
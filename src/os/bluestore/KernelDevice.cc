@@ -20,6 +20,7 @@
 #include <sys/file.h>
 
 #include "KernelDevice.h"
+#include "io_uring.h"
 #include "include/intarith.h"
 #include "include/types.h"
 #include "include/compat.h"
@@ -42,7 +43,6 @@
 KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, aio_callback_t d_cb, void *d_cbpriv)
   : BlockDevice(cct, cb, cbpriv),
     aio(false), dio(false),
-    aio_queue(cct->_conf->bdev_aio_max_queue_depth),
     discard_callback(d_cb),
     discard_callback_priv(d_cbpriv),
     aio_stop(false),
@@ -54,6 +54,31 @@ KernelDevice::KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, ai
 {
   fd_directs.resize(WRITE_LIFE_MAX, -1);
   fd_buffereds.resize(WRITE_LIFE_MAX, -1);
+
+  bool use_ioring = cct->_conf->bdev_ioring;
+  unsigned int iodepth = cct->_conf->bdev_aio_max_queue_depth;
+
+  if (use_ioring && ioring_queue_t::supported()) {
+    if (cct->_conf->bdev_ioring_hipri) {
+      // completions are reaped by waiting for the ring fd in epoll, which
+      // an IOPOLL ring never signals
+      derr << "WARNING: bdev_ioring_hipri is not supported, ignoring it"
+	   << dendl;
+    }
+    auto q = new ioring_queue_t(iodepth,
+				false,
+				cct->_conf->bdev_ioring_sqthread_poll);
+    ioring_fdatasync = q->supports_fdatasync();
+    io_queue = std::unique_ptr<io_queue_t>(q);
+  } else {
+    static bool once;
+    if (use_ioring && !once) {
+      derr << "WARNING: io_uring API is not supported! Fallback to libaio!"
+	   << dendl;
+      once = true;
+    }
+    io_queue = std::unique_ptr<io_queue_t>(new aio_queue_t(iodepth));
+  }
 }
 
 int KernelDevice::_lock()
@@ -401,11 +426,18 @@ int KernelDevice::flush()
     _exit(1);
   }
   utime_t start = ceph_clock_now();
-  int r = ::fdatasync(fd_directs[WRITE_LIFE_NOT_SET]);
+  int r;
+  if (ioring_fdatasync) {
+    r = _aio_fdatasync();
+  } else {
+    r = ::fdatasync(fd_directs[WRITE_LIFE_NOT_SET]);
+    if (r < 0) {
+      r = -errno;
+    }
+  }
   utime_t end = ceph_clock_now();
   utime_t dur = end - start;
   if (r < 0) {
-    r = -errno;
     derr << __func__ << " fdatasync got: " << cpp_strerror(r) << dendl;
     ceph_abort();
   }
@@ -413,11 +445,28 @@ int KernelDevice::flush()
   return r;
 }
 
+int KernelDevice::_aio_fdatasync()
+{
+  // queue the sync on the ring and let the aio thread reap it, rather
+  // than blocking this thread in fdatasync(2) for the whole duration.
+  IOContext ioc(cct, nullptr);
+  ioc.pending_aios.push_back(aio_t(&ioc, fd_directs[WRITE_LIFE_NOT_SET]));
+  ioc.pending_aios.back().fdatasync();
+  ++ioc.num_pending;
+  aio_submit(&ioc);
+  ioc.aio_wait();
+  return ioc.get_return_value();
+}
+
 int KernelDevice::_aio_start()
 {
   if (aio) {
     dout(10) << __func__ << dendl;
-    int r = aio_queue.init();
+    std::vector<int> fds;
+    fds.reserve(fd_directs.size() + fd_buffereds.size());
+    fds.insert(fds.end(), fd_directs.begin(), fd_directs.end());
+    fds.insert(fds.end(), fd_buffereds.begin(), fd_buffereds.end());
+    int r = io_queue->init(fds);
     if (r < 0) {
       if (r == -EAGAIN) {
 	derr << __func__ << " io_setup(2) failed with EAGAIN; "
@@ -439,7 +488,7 @@ void KernelDevice::_aio_stop()
     aio_stop = true;
     aio_thread.join();
     aio_stop = false;
-    aio_queue.shutdown();
+    io_queue->shutdown();
   }
 }
 
@@ -499,7 +548,7 @@ void KernelDevice::_aio_thread()
     dout(40) << __func__ << " polling" << dendl;
     int max = cct->_conf->bdev_aio_reap_max;
     aio_t *aio[max];
-    int r = aio_queue.get_next_completed(cct->_conf->bdev_aio_poll_ms,
+    int r = io_queue->get_next_completed(cct->_conf->bdev_aio_poll_ms,
 					 aio, max);
     if (r < 0) {
       derr << __func__ << " got " << cpp_strerror(r) << dendl;
@@ -520,8 +569,10 @@ void KernelDevice::_aio_thread()
 	// follows the observed io completion will include this io.  Note
 	// that an earlier, racing flush() could observe and clear this
 	// flag, but that also ensures that the IO will be stable before the
-	// later flush() occurs.
-	io_since_flush.store(true);
+	// later flush() occurs.  a completed fdatasync is not new io.
+	if (aio[i]->op != aio_t::OP_FDATASYNC) {
+	  io_since_flush.store(true);
+	}
 
 	long r = aio[i]->get_return_value();
         if (r < 0) {
@@ -533,15 +584,13 @@ void KernelDevice::_aio_thread()
             ioc->set_return_value(-EIO);
           } else {
 	    if (is_expected_ioerr(r)) {
+	      // aio_t::op is set with either io queue, unlike the iocb
 	      note_io_error_event(
 		devname.c_str(),
 		path.c_str(),
 		r,
-#if defined(HAVE_POSIXAIO)
-                aio[i]->aio.aiocb.aio_lio_opcode,
-#else
-                aio[i]->iocb.aio_lio_opcode,
-#endif
+		aio[i]->op == aio_t::OP_PREADV ? 1 :
+		aio[i]->op == aio_t::OP_PWRITEV ? 2 : 0,
 		aio[i]->offset,
 		aio[i]->length);
 	      ceph_abort_msg(
@@ -764,7 +813,7 @@ void KernelDevice::aio_submit(IOContext *ioc)
 
   void *priv = static_cast<void*>(ioc);
   int r, retries = 0;
-  r = aio_queue.submit_batch(ioc->running_aios.begin(), e,
+  r = io_queue->submit_batch(ioc->running_aios.begin(), e,
 			     pending, priv, &retries);
 
   if (retries)
@@ -45,7 +45,8 @@ class KernelDevice : public BlockDevice {
   std::atomic<bool> io_since_flush = {false};
   ceph::mutex flush_mutex = ceph::make_mutex("KernelDevice::flush_mutex");
 
-  aio_queue_t aio_queue;
+  std::unique_ptr<io_queue_t> io_queue;
+  bool ioring_fdatasync = false;  ///< flush via io_queue instead of fdatasync(2)
   aio_callback_t discard_callback;
   void *discard_callback_priv;
   bool aio_stop;
@@ -92,6 +93,7 @@ class KernelDevice : public BlockDevice {
   void _aio_log_finish(IOContext *ioc, uint64_t offset, uint64_t length);
 
   int _sync_write(uint64_t off, bufferlist& bl, bool buffered, int write_hint);
+  int _aio_fdatasync();
 
   int _lock();
 
@@ -108,6 +110,14 @@ class KernelDevice : public BlockDevice {
   void _detect_vdo();
   int choose_fd(bool buffered, int write_hint) const;
 
+protected:
+  const std::string& get_path() const {
+    return path;
+  }
+  int get_direct_fd() const {
+    return fd_directs[WRITE_LIFE_NOT_SET];
+  }
+
 public:
   KernelDevice(CephContext* cct, aio_callback_t cb, void *cbpriv, aio_callback_t d_cb, void *d_cbpriv);
 
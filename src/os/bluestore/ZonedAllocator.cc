@@ -0,0 +1,319 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "ZonedAllocator.h"
+
+#include "include/intarith.h"
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bluestore
+#undef  dout_prefix
+#define dout_prefix *_dout << "ZonedAllocator(" << this << ") "
+
+ZonedAllocator::ZonedAllocator(CephContext* cct,
+			       int64_t device_size,
+			       int64_t block_size,
+			       int64_t zone_size,
+			       int64_t first_sequential_zone,
+			       const std::string& name)
+  : Allocator(name),
+    cct(cct),
+    size(device_size),
+    block_size(block_size),
+    zone_size(zone_size),
+    first_sequential_zone(first_sequential_zone),
+    nr_zones(device_size / zone_size),
+    zone_cursor(first_sequential_zone)
+{
+  ceph_assert(zone_size % block_size == 0);
+  ceph_assert(first_sequential_zone < (int64_t)nr_zones);
+  // everything is in use until the freelist says otherwise
+  zones.resize(nr_zones, zone_state_t{zone_size, zone_size});
+  ldout(cct, 1) << __func__ << " size 0x" << std::hex << size
+		<< " zone size 0x" << zone_size << std::dec
+		<< " zones " << nr_zones
+		<< " first sequential " << first_sequential_zone
+		<< dendl;
+}
+
+ZonedAllocator::~ZonedAllocator()
+{
+}
+
+template <typename Fn>
+void ZonedAllocator::_for_each_zone(uint64_t offset, uint64_t length, Fn&& fn)
+{
+  uint64_t end = std::min(offset + length, nr_zones * zone_size);
+  while (offset < end) {
+    uint64_t zone = offset / zone_size;
+    uint64_t zone_end = _zone_start(zone) + zone_size;
+    uint64_t piece_end = std::min(end, zone_end);
+    if (zone >= first_sequential_zone) {
+      fn(zone, offset - _zone_start(zone), piece_end - offset);
+    }
+    offset = piece_end;
+  }
+}
+
+bool ZonedAllocator::_open_zone(uint64_t *zone)
+{
+  uint64_t n = nr_zones - first_sequential_zone;
+  for (uint64_t i = 0; i < n; ++i) {
+    uint64_t z = zone_cursor;
+    if (++zone_cursor == nr_zones) {
+      zone_cursor = first_sequential_zone;
+    }
+    if (zones[z].write_pointer < zone_size && !busy_zones.count(z)) {
+      busy_zones.insert(z);
+      *zone = z;
+      return true;
+    }
+  }
+  return false;
+}
+
+int64_t ZonedAllocator::allocate(
+  uint64_t want_size,
+  uint64_t alloc_unit,
+  uint64_t max_alloc_size,
+  int64_t hint,
+  PExtentVector *extents)
+{
+  ldout(cct, 10) << __func__ << std::hex
+		 << " want 0x" << want_size
+		 << " unit 0x" << alloc_unit
+		 << " max_alloc_size 0x" << max_alloc_size
+		 << std::dec << dendl;
+  ceph_assert(alloc_unit % block_size == 0);
+  ceph_assert(want_size % alloc_unit == 0);
+
+  std::lock_guard l(lock);
+  auto tid = std::this_thread::get_id();
+  uint64_t allocated = 0;
+  while (allocated < want_size) {
+    auto p = open_zones.find(tid);
+    if (p == open_zones.end()) {
+      uint64_t zone;
+      if (!_open_zone(&zone)) {
+	break;
+      }
+      ldout(cct, 20) << __func__ << " thread " << tid << " opened zone "
+		     << zone << dendl;
+      p = open_zones.emplace(tid, zone).first;
+    }
+    uint64_t zone = p->second;
+    zone_state_t& z = zones[zone];
+    uint64_t len = std::min(want_size - allocated,
+			    p2align(zone_size - z.write_pointer, alloc_unit));
+    if (max_alloc_size) {
+      len = std::min(len, p2align(max_alloc_size, alloc_unit));
+    }
+    if (len) {
+      uint64_t offset = _zone_start(zone) + z.write_pointer;
+      if (!extents->empty() &&
+	  extents->back().end() == offset &&
+	  (!max_alloc_size || extents->back().length + len <= max_alloc_size)) {
+	extents->back().length += len;
+      } else {
+	extents->emplace_back(bluestore_pextent_t(offset, len));
+      }
+      z.write_pointer += len;
+      z.used += len;
+      num_free -= len;
+      allocated += len;
+    }
+    if (zone_size - z.write_pointer < alloc_unit) {
+      // nothing useful left, close it
+      ldout(cct, 20) << __func__ << " zone " << zone << " is full" << dendl;
+      open_zones.erase(p);
+      busy_zones.erase(zone);
+    }
+  }
+  if (allocated == 0) {
+    ldout(cct, 10) << __func__ << " no writable zone left" << dendl;
+    return -ENOSPC;
+  }
+  return allocated;
+}
+
+void ZonedAllocator::release(const interval_set<uint64_t>& release_set)
+{
+  std::lock_guard l(lock);
+  for (auto p = release_set.begin(); p != release_set.end(); ++p) {
+    ldout(cct, 10) << __func__ << std::hex
+		   << " 0x" << p.get_start() << "~" << p.get_len()
+		   << std::dec << dendl;
+    _for_each_zone(p.get_start(), p.get_len(),
+      [&](uint64_t zone, uint64_t off, uint64_t len) {
+	ceph_assert(zones[zone].used >= len);
+	zones[zone].used -= len;
+      });
+  }
+}
+
+uint64_t ZonedAllocator::get_free()
+{
+  std::lock_guard l(lock);
+  return num_free;
+}
+
+double ZonedAllocator::get_fragmentation()
+{
+  // share of the written space that is garbage
+  std::lock_guard l(lock);
+  uint64_t written = 0, garbage = 0;
+  for (uint64_t i = first_sequential_zone; i < nr_zones; ++i) {
+    written += zones[i].write_pointer;
+    garbage += zones[i].write_pointer - zones[i].used;
+  }
+  return written ? (double)garbage / written : 0.0;
+}
+
+void ZonedAllocator::dump()
+{
+  std::lock_guard l(lock);
+  for (uint64_t i = first_sequential_zone; i < nr_zones; ++i) {
+    ldout(cct, 0) << __func__ << " zone " << i << std::hex
+		  << " wp 0x" << zones[i].write_pointer
+		  << " used 0x" << zones[i].used
+		  << std::dec
+		  << (busy_zones.count(i) ? " busy" : "")
+		  << dendl;
+  }
+  ldout(cct, 0) << __func__ << " free 0x" << std::hex << num_free
+		<< std::dec << " open zones " << open_zones.size() << dendl;
+}
+
+void ZonedAllocator::dump(std::function<void(uint64_t offset, uint64_t length)> notify)
+{
+  std::lock_guard l(lock);
+  for (uint64_t i = first_sequential_zone; i < nr_zones; ++i) {
+    if (zones[i].write_pointer < zone_size) {
+      notify(_zone_start(i) + zones[i].write_pointer,
+	     zone_size - zones[i].write_pointer);
+    }
+  }
+}
+
+void ZonedAllocator::init_add_free(uint64_t offset, uint64_t length)
+{
+  ldout(cct, 10) << __func__ << std::hex
+		 << " offset 0x" << offset
+		 << " length 0x" << length
+		 << std::dec << dendl;
+  std::lock_guard l(lock);
+  _for_each_zone(offset, length,
+    [&](uint64_t zone, uint64_t off, uint64_t len) {
+      zone_state_t& z = zones[zone];
+      ceph_assert(z.used >= len);
+      z.used -= len;
+      // free space reaching up to the write pointer is writable again
+      if (off + len >= z.write_pointer && off < z.write_pointer) {
+	num_free += z.write_pointer - off;
+	z.write_pointer = off;
+      }
+    });
+}
+
+void ZonedAllocator::init_rm_free(uint64_t offset, uint64_t length)
+{
+  ldout(cct, 10) << __func__ << std::hex
+		 << " offset 0x" << offset
+		 << " length 0x" << length
+		 << std::dec << dendl;
+  std::lock_guard l(lock);
+  _for_each_zone(offset, length,
+    [&](uint64_t zone, uint64_t off, uint64_t len) {
+      zone_state_t& z = zones[zone];
+      z.used += len;
+      ceph_assert(z.used <= zone_size);
+      if (off + len > z.write_pointer) {
+	num_free -= off + len - z.write_pointer;
+	z.write_pointer = off + len;
+      }
+    });
+}
+
+void ZonedAllocator::shutdown()
+{
+  std::lock_guard l(lock);
+  open_zones.clear();
+  busy_zones.clear();
+}
+
+uint64_t ZonedAllocator::get_zone_used(uint64_t zone)
+{
+  std::lock_guard l(lock);
+  return zones[zone].used;
+}
+
+void ZonedAllocator::set_write_pointer(uint64_t zone, uint64_t wp)
+{
+  std::lock_guard l(lock);
+  ceph_assert(zone >= first_sequential_zone && zone < nr_zones);
+  // the device pads partially written blocks up to the next allocation
+  wp = std::min(p2roundup(wp, block_size), zone_size);
+  zone_state_t& z = zones[zone];
+  if (wp > z.write_pointer) {
+    ldout(cct, 1) << __func__ << " zone " << zone << std::hex
+		  << " wp 0x" << z.write_pointer << " -> 0x" << wp
+		  << std::dec << dendl;
+    num_free -= wp - z.write_pointer;
+    z.write_pointer = wp;
+  }
+}
+
+bool ZonedAllocator::claim_empty_zone(uint64_t *zone)
+{
+  std::lock_guard l(lock);
+  for (uint64_t i = first_sequential_zone; i < nr_zones; ++i) {
+    if (zones[i].used == 0 && zones[i].write_pointer > 0 &&
+	!busy_zones.count(i)) {
+      busy_zones.insert(i);
+      *zone = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ZonedAllocator::reset_zone(uint64_t zone)
+{
+  std::lock_guard l(lock);
+  ceph_assert(busy_zones.count(zone));
+  zone_state_t& z = zones[zone];
+  ceph_assert(z.used == 0);
+  ldout(cct, 10) << __func__ << " zone " << zone << std::hex
+		 << " reclaimed 0x" << z.write_pointer << std::dec << dendl;
+  num_free += z.write_pointer;
+  z.write_pointer = 0;
+  busy_zones.erase(zone);
+}
+
+void ZonedAllocator::unclaim_zone(uint64_t zone)
+{
+  std::lock_guard l(lock);
+  busy_zones.erase(zone);
+}
+
+bool ZonedAllocator::pick_zone_to_clean(uint64_t max_live,
+					const std::set<uint64_t>& skip,
+					uint64_t *zone, uint64_t *live)
+{
+  std::lock_guard l(lock);
+  bool found = false;
+  for (uint64_t i = first_sequential_zone; i < nr_zones; ++i) {
+    const zone_state_t& z = zones[i];
+    if (z.write_pointer < zone_size || busy_zones.count(i) ||
+	z.used == 0 || z.used > max_live || skip.count(i)) {
+      continue;
+    }
+    if (!found || z.used < *live) {
+      *zone = i;
+      *live = z.used;
+      found = true;
+    }
+  }
+  return found;
+}
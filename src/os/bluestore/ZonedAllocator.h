@@ -0,0 +1,105 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "Allocator.h"
+#include "common/ceph_mutex.h"
+
+/*
+ * Append-only allocator for zoned devices.
+ *
+ * Every sequential zone is allocated strictly from its write pointer
+ * up.  Released space is not reusable until the whole zone has been
+ * emptied (by the zone cleaner relocating what is still live) and
+ * reset, so per zone we only track the write pointer and the number of
+ * live bytes; everything below the write pointer that is not live is
+ * garbage.  The leading conventional zones are never handed out.
+ *
+ * There is no on-disk state of its own: the write pointers are derived
+ * from the freelist on mount (the free tail of a zone is writable, free
+ * space below it is garbage) and may be raised to what the device
+ * reports.
+ */
+class ZonedAllocator : public Allocator {
+  CephContext* cct;
+  ceph::mutex lock = ceph::make_mutex("ZonedAllocator::lock");
+
+  const uint64_t size;
+  const uint64_t block_size;
+  const uint64_t zone_size;
+  const uint64_t first_sequential_zone;
+  const uint64_t nr_zones;
+
+  struct zone_state_t {
+    uint64_t write_pointer;  ///< relative to zone start
+    uint64_t used;           ///< live bytes
+  };
+  std::vector<zone_state_t> zones;
+  uint64_t num_free = 0;     ///< bytes above the write pointers
+
+  /// zone each allocating thread appends to.  Writes are queued right
+  /// after allocation by the same thread, so giving each thread its own
+  /// zone keeps the writes to every zone in write pointer order.
+  std::map<std::thread::id, uint64_t> open_zones;
+  /// zones opened by some thread or claimed for a reset
+  std::set<uint64_t> busy_zones;
+  uint64_t zone_cursor;
+
+  uint64_t _zone_start(uint64_t zone) const {
+    return zone * zone_size;
+  }
+  bool _open_zone(uint64_t *zone);
+  template <typename Fn>
+  void _for_each_zone(uint64_t offset, uint64_t length, Fn&& fn);
+
+public:
+  ZonedAllocator(CephContext* cct, int64_t device_size, int64_t block_size,
+		 int64_t zone_size, int64_t first_sequential_zone,
+		 const std::string& name);
+  ~ZonedAllocator() override;
+
+  int64_t allocate(
+    uint64_t want_size,
+    uint64_t alloc_unit,
+    uint64_t max_alloc_size,
+    int64_t hint,
+    PExtentVector *extents) override;
+  void release(const interval_set<uint64_t>& release_set) override;
+  uint64_t get_free() override;
+  double get_fragmentation() override;
+
+  void dump() override;
+  void dump(std::function<void(uint64_t offset, uint64_t length)> notify) override;
+  void init_add_free(uint64_t offset, uint64_t length) override;
+  void init_rm_free(uint64_t offset, uint64_t length) override;
+  void shutdown() override;
+
+  uint64_t get_zone_size() const {
+    return zone_size;
+  }
+  uint64_t get_zone_used(uint64_t zone);
+  /// bytes the allocator may ever hand out, i.e. all sequential zones
+  uint64_t get_capacity() const {
+    return (nr_zones - first_sequential_zone) * zone_size;
+  }
+
+  /// move a zone's write pointer up to what the device reports
+  void set_write_pointer(uint64_t zone, uint64_t wp);
+
+  /// find a written zone without live data and keep it from being
+  /// opened until reset_zone() or unclaim_zone()
+  bool claim_empty_zone(uint64_t *zone);
+  /// the claimed zone has been reset on the device
+  void reset_zone(uint64_t zone);
+  void unclaim_zone(uint64_t zone);
+
+  /// full zone with the least live data, if that is at most max_live
+  bool pick_zone_to_clean(uint64_t max_live, const std::set<uint64_t>& skip,
+			  uint64_t *zone, uint64_t *live);
+};
@@ -0,0 +1,290 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "acconfig.h"
+#if defined(HAVE_LINUX_BLKZONED_H)
+#include <linux/blkzoned.h>
+#endif
+
+#include "ZonedDevice.h"
+#include "include/intarith.h"
+#include "include/stringify.h"
+#include "common/blkdev.h"
+#include "common/errno.h"
+#include "common/debug.h"
+
+#define dout_context cct
+#define dout_subsys ceph_subsys_bdev
+#undef dout_prefix
+#define dout_prefix *_dout << "bdev(" << this << " " << get_path() << ") "
+
+ZonedDevice::ZonedDevice(CephContext* cct, aio_callback_t cb, void *cbpriv,
+			 aio_callback_t d_cb, void *d_cbpriv, bool emulated)
+  : KernelDevice(cct, cb, cbpriv, d_cb, d_cbpriv),
+    emulated(emulated)
+{
+}
+
+bool ZonedDevice::support(const std::string& path)
+{
+#if defined(HAVE_LINUX_BLKZONED_H)
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  bool ret = false;
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && S_ISBLK(st.st_mode)) {
+    ret = BlkDev(fd).is_host_managed();
+  }
+  VOID_TEMP_FAILURE_RETRY(::close(fd));
+  return ret;
+#else
+  return false;
+#endif
+}
+
+int ZonedDevice::_report_zones()
+{
+#if defined(HAVE_LINUX_BLKZONED_H)
+  const unsigned batch = 4096;
+  size_t bufsize = sizeof(struct blk_zone_report) +
+    batch * sizeof(struct blk_zone);
+  std::unique_ptr<char[]> buf(new char[bufsize]);
+  auto report = reinterpret_cast<struct blk_zone_report*>(buf.get());
+
+  write_pointers.clear();
+  zone_size = 0;
+  conventional_zones = 0;
+  bool leading_conventional = true;
+  uint64_t sector = 0;
+  uint64_t dev_sectors = get_size() >> 9;
+  while (sector < dev_sectors) {
+    memset(buf.get(), 0, bufsize);
+    report->sector = sector;
+    report->nr_zones = batch;
+    if (::ioctl(get_direct_fd(), BLKREPORTZONE, report) < 0) {
+      int r = -errno;
+      derr << __func__ << " BLKREPORTZONE at sector " << sector
+	   << " failed: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+    if (report->nr_zones == 0) {
+      break;
+    }
+    for (unsigned i = 0; i < report->nr_zones; ++i) {
+      const struct blk_zone& z = report->zones[i];
+      if (zone_size == 0) {
+	zone_size = z.len << 9;
+      }
+      if (z.type == BLK_ZONE_TYPE_CONVENTIONAL) {
+	if (leading_conventional) {
+	  ++conventional_zones;
+	}
+	write_pointers.push_back(0);
+      } else {
+	leading_conventional = false;
+	if (z.cond == BLK_ZONE_COND_FULL) {
+	  write_pointers.push_back(zone_size);
+	} else {
+	  write_pointers.push_back((z.wp - z.start) << 9);
+	}
+      }
+      sector = z.start + z.len;
+    }
+  }
+  return 0;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
+int ZonedDevice::open(const std::string& p)
+{
+  int r = KernelDevice::open(p);
+  if (r < 0) {
+    return r;
+  }
+
+  if (emulated) {
+    zone_size = cct->_conf->bdev_zoned_emulation_zone_size;
+    conventional_zones = cct->_conf->bdev_zoned_emulation_conventional_zones;
+    if (zone_size == 0 || zone_size % block_size) {
+      derr << __func__ << " bdev_zoned_emulation_zone_size 0x" << std::hex
+	   << zone_size << " is not a multiple of block size 0x"
+	   << block_size << std::dec << dendl;
+      r = -EINVAL;
+      goto out_close;
+    }
+    nr_zones = size / zone_size;
+    write_pointers.assign(nr_zones, WP_UNKNOWN);
+  } else {
+    r = _report_zones();
+    if (r < 0) {
+      goto out_close;
+    }
+    nr_zones = size / zone_size;
+    write_pointers.resize(nr_zones);
+  }
+  if (nr_zones <= conventional_zones) {
+    derr << __func__ << " device has no sequential zones" << dendl;
+    r = -EINVAL;
+    goto out_close;
+  }
+  // trailing runt zone is not usable
+  size = nr_zones * zone_size;
+
+  dout(1) << __func__ << (emulated ? " emulated" : " host-managed")
+	  << " zone size 0x" << std::hex << zone_size << std::dec
+	  << " zones " << nr_zones
+	  << " conventional " << conventional_zones
+	  << dendl;
+  return 0;
+
+ out_close:
+  KernelDevice::close();
+  return r;
+}
+
+void ZonedDevice::close()
+{
+  KernelDevice::close();
+  write_pointers.clear();
+}
+
+int ZonedDevice::collect_metadata(const std::string& prefix,
+				  map<std::string,std::string> *pm) const
+{
+  int r = KernelDevice::collect_metadata(prefix, pm);
+  (*pm)[prefix + "driver"] = "ZonedDevice";
+  (*pm)[prefix + "zoned"] = emulated ? "emulated" : "host-managed";
+  (*pm)[prefix + "zone_size"] = stringify(zone_size);
+  (*pm)[prefix + "conventional_size"] =
+    stringify(get_conventional_region_size());
+  return r;
+}
+
+int ZonedDevice::get_zone_write_pointers(std::vector<uint64_t> *wps)
+{
+  if (emulated) {
+    // not persisted anywhere, the freelist knows better
+    return -EOPNOTSUPP;
+  }
+  std::lock_guard l(zone_lock);
+  *wps = write_pointers;
+  return 0;
+}
+
+int ZonedDevice::reset_zone(uint64_t zone)
+{
+  ceph_assert(zone >= conventional_zones && zone < nr_zones);
+  dout(10) << __func__ << " zone " << zone << dendl;
+  if (!emulated) {
+#if defined(HAVE_LINUX_BLKZONED_H)
+    struct blk_zone_range range;
+    range.sector = (zone * zone_size) >> 9;
+    range.nr_sectors = zone_size >> 9;
+    if (::ioctl(get_direct_fd(), BLKRESETZONE, &range) < 0) {
+      int r = -errno;
+      derr << __func__ << " BLKRESETZONE zone " << zone
+	   << " failed: " << cpp_strerror(r) << dendl;
+      return r;
+    }
+#else
+    return -EOPNOTSUPP;
+#endif
+  } else {
+    // give the space back to thin/trimmable backing stores
+    KernelDevice::discard(zone * zone_size, zone_size);
+  }
+  std::lock_guard l(zone_lock);
+  write_pointers[zone] = 0;
+  return 0;
+}
+
+int ZonedDevice::discard(uint64_t offset, uint64_t len)
+{
+  // sequential zones are only ever reclaimed with reset_zone()
+  return 0;
+}
+
+int ZonedDevice::_advance_write_pointers(uint64_t off, uint64_t len,
+					 interval_set<uint64_t> *gaps)
+{
+  std::lock_guard l(zone_lock);
+  uint64_t end = off + len;
+  while (off < end) {
+    uint64_t zone = off / zone_size;
+    uint64_t zone_start = zone * zone_size;
+    uint64_t piece_end = std::min(end, zone_start + zone_size);
+    if (zone >= conventional_zones) {
+      uint64_t& wp = write_pointers[zone];
+      uint64_t zoff = off - zone_start;
+      if (wp == WP_UNKNOWN) {
+	wp = zoff;
+      }
+      if (zoff < wp) {
+	derr << __func__ << " write 0x" << std::hex << off << "~"
+	     << (piece_end - off) << " behind zone " << std::dec << zone
+	     << " write pointer 0x" << std::hex << (zone_start + wp)
+	     << std::dec << dendl;
+	return -EINVAL;
+      }
+      if (zoff > wp) {
+	dout(20) << __func__ << " zero-filling 0x" << std::hex
+		 << (zone_start + wp) << "~" << (zoff - wp) << std::dec
+		 << " in zone " << zone << dendl;
+	gaps->insert(zone_start + wp, zoff - wp);
+      }
+      wp = piece_end - zone_start;
+    }
+    off = piece_end;
+  }
+  return 0;
+}
+
+int ZonedDevice::write(uint64_t off, bufferlist& bl, bool buffered,
+		       int write_hint)
+{
+  interval_set<uint64_t> gaps;
+  int r = _advance_write_pointers(off, bl.length(), &gaps);
+  if (r < 0) {
+    return r;
+  }
+  // never buffered: writeback could reorder writes within a zone
+  for (auto p = gaps.begin(); p != gaps.end(); ++p) {
+    bufferlist zeros;
+    zeros.append_zero(p.get_len());
+    r = KernelDevice::write(p.get_start(), zeros, false, write_hint);
+    if (r < 0) {
+      return r;
+    }
+  }
+  return KernelDevice::write(off, bl, false, write_hint);
+}
+
+int ZonedDevice::aio_write(uint64_t off, bufferlist& bl, IOContext *ioc,
+			   bool buffered, int write_hint)
+{
+  interval_set<uint64_t> gaps;
+  int r = _advance_write_pointers(off, bl.length(), &gaps);
+  if (r < 0) {
+    return r;
+  }
+  // the gaps are queued ahead of the data, so each zone still sees
+  // its writes in order
+  for (auto p = gaps.begin(); p != gaps.end(); ++p) {
+    bufferlist zeros;
+    zeros.append_zero(p.get_len());
+    r = KernelDevice::aio_write(p.get_start(), zeros, ioc, false, write_hint);
+    if (r < 0) {
+      return r;
+    }
+  }
+  return KernelDevice::aio_write(off, bl, ioc, false, write_hint);
+}
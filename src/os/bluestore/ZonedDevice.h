@@ -0,0 +1,67 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#pragma once
+
+#include <limits>
+
+#include "KernelDevice.h"
+
+/*
+ * KernelDevice for host-managed zoned devices (SMR drives, ZNS SSDs),
+ * or for a regular file/device emulating one (bdev_zoned_emulation_*).
+ *
+ * We track the write pointer of every sequential zone.  Writes behind
+ * the write pointer are rejected; writes that skip ahead of it (the
+ * unwritten tail of an allocation unit) get the gap zero-filled first,
+ * so that the device only ever sees sequential writes.  Space is
+ * reclaimed a whole zone at a time with reset_zone().
+ */
+class ZonedDevice : public KernelDevice {
+  const bool emulated;
+  uint64_t zone_size = 0;
+  uint64_t conventional_zones = 0;
+  uint64_t nr_zones = 0;
+
+  static constexpr uint64_t WP_UNKNOWN = std::numeric_limits<uint64_t>::max();
+
+  ceph::mutex zone_lock = ceph::make_mutex("ZonedDevice::zone_lock");
+  /// write pointer of each zone, relative to the zone start; WP_UNKNOWN
+  /// for emulated zones that have not been written since open
+  std::vector<uint64_t> write_pointers;
+
+  int _report_zones();
+  int _advance_write_pointers(uint64_t off, uint64_t len,
+			      interval_set<uint64_t> *gaps);
+
+public:
+  ZonedDevice(CephContext* cct, aio_callback_t cb, void *cbpriv,
+	      aio_callback_t d_cb, void *d_cbpriv, bool emulated);
+
+  /// true if path is a host-managed zoned block device
+  static bool support(const std::string& path);
+
+  bool is_smr() const override {
+    return true;
+  }
+  uint64_t get_zone_size() const override {
+    return zone_size;
+  }
+  uint64_t get_conventional_region_size() const override {
+    return conventional_zones * zone_size;
+  }
+  int get_zone_write_pointers(std::vector<uint64_t> *wps) override;
+  int reset_zone(uint64_t zone) override;
+
+  int collect_metadata(const std::string& prefix, map<std::string,std::string> *pm) const override;
+
+  int write(uint64_t off, bufferlist& bl, bool buffered, int write_hint = WRITE_LIFE_NOT_SET) override;
+  int aio_write(uint64_t off, bufferlist& bl,
+		IOContext *ioc,
+		bool buffered,
+		int write_hint = WRITE_LIFE_NOT_SET) override;
+  int discard(uint64_t offset, uint64_t len) override;
+
+  int open(const std::string& path) override;
+  void close() override;
+};
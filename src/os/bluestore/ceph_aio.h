@@ -12,6 +12,9 @@
 #include <sys/event.h>
 #endif
 
+#include <list>
+#include <vector>
+
 #include <boost/intrusive/list.hpp>
 #include <boost/container/small_vector.hpp>
 
@@ -36,12 +39,21 @@ struct aio_t {
   long rval;
   bufferlist bl;  ///< write payload (so that it remains stable for duration)
 
+  enum {
+    OP_NONE = 0,
+    OP_PREADV,
+    OP_PWRITEV,
+    OP_FDATASYNC,  ///< only supported by ioring_queue_t
+  };
+  int op = OP_NONE;
+
   boost::intrusive::list_member_hook<> queue_item;
 
   aio_t(void *p, int f) : priv(p), fd(f), offset(0), length(0), rval(-1000) {
   }
 
   void pwritev(uint64_t _offset, uint64_t len) {
+    op = OP_PWRITEV;
     offset = _offset;
     length = len;
 #if defined(HAVE_LIBAIO)
@@ -61,6 +73,7 @@ struct aio_t {
   }
 
   void preadv(uint64_t _offset, uint64_t len) {
+    op = OP_PREADV;
     offset = _offset;
     length = len;
 #if defined(HAVE_LIBAIO)
@@ -79,6 +92,12 @@ struct aio_t {
 #endif
   }
 
+  void fdatasync() {
+    op = OP_FDATASYNC;
+    offset = 0;
+    length = 0;
+  }
+
   long get_return_value() {
     return rval;
   }
@@ -93,7 +112,19 @@ typedef boost::intrusive::list<
     boost::intrusive::list_member_hook<>,
     &aio_t::queue_item> > aio_list_t;
 
-struct aio_queue_t {
+struct io_queue_t {
+  typedef std::list<aio_t>::iterator aio_iter;
+
+  virtual ~io_queue_t() {};
+
+  virtual int init(std::vector<int> &fds) = 0;
+  virtual void shutdown() = 0;
+  virtual int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+			   void *priv, int *retries) = 0;
+  virtual int get_next_completed(int timeout_ms, aio_t **paio, int max) = 0;
+};
+
+struct aio_queue_t final : public io_queue_t {
   int max_iodepth;
 #if defined(HAVE_LIBAIO)
   io_context_t ctx;
@@ -101,17 +132,15 @@ struct aio_queue_t {
   int ctx;
 #endif
 
-  typedef list<aio_t>::iterator aio_iter;
-
   explicit aio_queue_t(unsigned max_iodepth)
     : max_iodepth(max_iodepth),
       ctx(0) {
   }
-  ~aio_queue_t() {
+  ~aio_queue_t() final {
     ceph_assert(ctx == 0);
   }
 
-  int init() {
+  int init(std::vector<int> &fds) final {
     ceph_assert(ctx == 0);
 #if defined(HAVE_LIBAIO)
     int r = io_setup(max_iodepth, &ctx);
@@ -130,7 +159,7 @@ struct aio_queue_t {
       return 0;
 #endif
   }
-  void shutdown() {
+  void shutdown() final {
     if (ctx) {
 #if defined(HAVE_LIBAIO)
       int r = io_destroy(ctx);
@@ -142,7 +171,7 @@ struct aio_queue_t {
     }
   }
 
-  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size, 
-		   void *priv, int *retries);
-  int get_next_completed(int timeout_ms, aio_t **paio, int max);
+  int submit_batch(aio_iter begin, aio_iter end, uint16_t aios_size,
+		   void *priv, int *retries) final;
+  int get_next_completed(int timeout_ms, aio_t **paio, int max) final;
 };
@@ -198,7 +198,8 @@ ECBackend::ECBackend(
   uint64_t stripe_width)
   : PGBackend(cct, pg, store, coll, ch),
     ec_impl(ec_impl),
-    sinfo(ec_impl->get_data_chunk_count(), stripe_width) {
+    sinfo(ec_impl->get_data_chunk_count(), stripe_width),
+    codec_pool(ECUtil::CodecPool::get(cct)) {
   ceph_assert((ec_impl->get_data_chunk_count() *
 	  ec_impl->get_chunk_size(stripe_width)) == stripe_width);
 }
@@ -1989,7 +1990,8 @@ bool ECBackend::try_reads_to_commit()
       &(op->temp_added),
       &(op->temp_cleared),
       get_parent()->get_dpp(),
-      get_osdmap()->require_osd_release);
+      get_osdmap()->require_osd_release,
+      codec_pool);
   }
 
   dout(20) << __func__ << ": " << cache << dendl;
@@ -2182,7 +2184,7 @@ void ECBackend::objects_read_async(
        i != to_read.end();
        ++i) {
     pair<uint64_t, uint64_t> tmp =
-      sinfo.offset_len_to_stripe_bounds(
+      sinfo.offset_len_to_chunk_bounds(
 	make_pair(i->first.get<0>(), i->first.get<1>()));
 
     es.union_insert(tmp.first, tmp.second);
@@ -2289,51 +2291,80 @@ struct CallClientContexts :
   ECBackend *ec;
   ECBackend::ClientAsyncReadStatus *status;
   list<boost::tuple<uint64_t, uint64_t, uint32_t> > to_read;
+  set<int> want_to_read;
   CallClientContexts(
     hobject_t hoid,
     ECBackend *ec,
     ECBackend::ClientAsyncReadStatus *status,
-    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read)
-    : hoid(hoid), ec(ec), status(status), to_read(to_read) {}
+    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read,
+    const set<int> &want_to_read)
+    : hoid(hoid), ec(ec), status(status), to_read(to_read),
+      want_to_read(want_to_read) {}
+  /// decode one returned stripe range, or just the wanted chunks of it
+  int decode(
+    uint64_t off,
+    map<pg_shard_t, bufferlist> &returned,
+    extent_map *decoded) {
+    map<int, bufferlist> to_decode;
+    for (auto &&j : returned) {
+      to_decode[j.first.shard].claim(j.second);
+    }
+    if (want_to_read.size() >= ec->ec_impl->get_data_chunk_count()) {
+      bufferlist bl;
+      int r = ECUtil::decode(ec->sinfo, ec->ec_impl, to_decode, &bl,
+			     ec->codec_pool);
+      if (r < 0)
+	return r;
+      if (bl.length())
+	decoded->insert(off, bl.length(), std::move(bl));
+      return 0;
+    }
+
+    map<uint64_t, bufferlist> chunks;
+    int r = ECUtil::decode_chunks(ec->sinfo, ec->ec_impl, off, want_to_read,
+				  to_decode, &chunks);
+    if (r < 0)
+      return r;
+    for (auto &&chunk : chunks) {
+      decoded->insert(chunk.first, chunk.second.length(),
+		      std::move(chunk.second));
+    }
+    return 0;
+  }
   void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
     ECBackend::read_result_t &res = in.second;
     extent_map result;
+    extent_map decoded;
     if (res.r != 0)
       goto out;
-    ceph_assert(res.returned.size() == to_read.size());
     ceph_assert(res.errors.empty());
-    for (auto &&read: to_read) {
-      pair<uint64_t, uint64_t> adjusted =
-	ec->sinfo.offset_len_to_stripe_bounds(
-	  make_pair(read.get<0>(), read.get<1>()));
-      ceph_assert(res.returned.front().get<0>() == adjusted.first &&
-	     res.returned.front().get<1>() == adjusted.second);
-      map<int, bufferlist> to_decode;
-      bufferlist bl;
-      for (map<pg_shard_t, bufferlist>::iterator j =
-	     res.returned.front().get<2>().begin();
-	   j != res.returned.front().get<2>().end();
-	   ++j) {
-	to_decode[j->first.shard].claim(j->second);
-      }
-      int r = ECUtil::decode(
-	ec->sinfo,
-	ec->ec_impl,
-	to_decode,
-	&bl);
+    for (auto &&ret : res.returned) {
+      int r = decode(ret.get<0>(), ret.get<2>(), &decoded);
       if (r < 0) {
-        res.r = r;
-        goto out;
+	res.r = r;
+	goto out;
+      }
+    }
+    res.returned.clear();
+    for (auto &&read: to_read) {
+      auto range = decoded.get_containing_range(read.get<0>(), read.get<1>());
+      if (range.first == range.second ||
+	  range.first.get_off() > read.get<0>()) {
+	// every read lies within the stripes the shards returned
+	ldpp_dout(ec->get_parent()->get_dpp(), 0)
+	  << __func__ << " " << hoid << " " << read.get<0>() << "~"
+	  << read.get<1>() << " not in decoded " << decoded << dendl;
+	res.r = -EIO;
+	goto out;
       }
       bufferlist trimmed;
       trimmed.substr_of(
-	bl,
-	read.get<0>() - adjusted.first,
+	range.first.get_val(),
+	read.get<0>() - range.first.get_off(),
 	std::min(read.get<1>(),
-	    bl.length() - (read.get<0>() - adjusted.first)));
+	    range.first.get_len() - (read.get<0>() - range.first.get_off())));
       result.insert(
 	read.get<0>(), trimmed.length(), std::move(trimmed));
-      res.returned.pop_front();
     }
 out:
     status->complete_object(hoid, res.r, std::move(result));
@@ -2356,11 +2387,34 @@ void ECBackend::objects_read_and_reconstruct(
   }
 
   map<hobject_t, set<int>> obj_want_to_read;
-  set<int> want_to_read;
-  get_want_to_read_shards(&want_to_read);
-    
   map<hobject_t, read_request_t> for_read_op;
   for (auto &&to_read: reads) {
+    // A read that does not touch every data chunk of its stripes is
+    // served by the shards holding what it touches; if one of them
+    // fails, send_all_remaining_reads() widens it to a decode.  Fast
+    // reads want the redundancy of reading everything up front.
+    set<int> want_to_read;
+    if (!fast_read) {
+      get_want_to_read_shards(to_read.second, &want_to_read);
+    }
+    if (want_to_read.empty()) {
+      get_want_to_read_shards(&want_to_read);
+    }
+
+    // shards are read in whole stripes
+    uint32_t flags = 0;
+    extent_set es;
+    for (auto &&extent : to_read.second) {
+      auto bounds = sinfo.offset_len_to_stripe_bounds(
+	make_pair(extent.get<0>(), extent.get<1>()));
+      es.union_insert(bounds.first, bounds.second);
+      flags |= extent.get<2>();
+    }
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > stripes;
+    for (auto i = es.begin(); i != es.end(); ++i) {
+      stripes.push_back(boost::make_tuple(i.get_start(), i.get_len(), flags));
+    }
+
     map<pg_shard_t, vector<pair<int, int>>> shards;
     int r = get_min_avail_to_read_shards(
       to_read.first,
@@ -2369,17 +2423,20 @@ void ECBackend::objects_read_and_reconstruct(
       fast_read,
       &shards);
     ceph_assert(r == 0);
+    dout(20) << __func__ << " " << to_read.first << " want " << want_to_read
+	     << " from " << shards << dendl;
 
     CallClientContexts *c = new CallClientContexts(
       to_read.first,
       this,
       &(in_progress_client_reads.back()),
-      to_read.second);
+      to_read.second,
+      want_to_read);
     for_read_op.insert(
       make_pair(
 	to_read.first,
 	read_request_t(
-	  to_read.second,
+	  stripes,
 	  shards,
 	  false,
 	  c)));
@@ -2498,21 +2555,25 @@ int ECBackend::be_deep_scrub(
   if (stride % sinfo.get_chunk_size())
     stride += sinfo.get_chunk_size() - (stride % sinfo.get_chunk_size());
 
+  ghobject_t ghoid(
+    poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard);
   bufferlist bl;
-  r = store->read(
-    ch,
-    ghobject_t(
-      poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-    pos.data_pos,
-    stride, bl,
-    fadvise_flags);
+  uint32_t crc = pos.data_hash.digest();
+  if (cct->_conf.get_val<bool>("osd_deep_scrub_store_digest")) {
+    r = store->digest(ch, ghoid, pos.data_pos, stride, &crc, fadvise_flags);
+  } else {
+    r = store->read(ch, ghoid, pos.data_pos, stride, bl, fadvise_flags);
+    if (r > 0) {
+      crc = bl.crc32c(crc);
+    }
+  }
   if (r < 0) {
     dout(20) << __func__ << "  " << poid << " got "
 	     << r << " on read, read_error" << dendl;
     o.read_error = true;
     return 0;
   }
-  if (bl.length() % sinfo.get_chunk_size()) {
+  if (r % sinfo.get_chunk_size()) {
     dout(20) << __func__ << "  " << poid << " got "
 	     << r << " on read, not chunk size " << sinfo.get_chunk_size() << " aligned"
 	     << dendl;
@@ -2520,7 +2581,7 @@ int ECBackend::be_deep_scrub(
     return 0;
   }
   if (r > 0) {
-    pos.data_hash << bl;
+    pos.data_hash = bufferhash(crc);
   }
   pos.data_pos += r;
   if (r == (int)stride) {
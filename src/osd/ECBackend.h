@@ -215,6 +215,19 @@ private:
       want_to_read->insert(chunk);
     }
   }
+  /// shards holding the data of the given logical extents
+  void get_want_to_read_shards(
+    const list<boost::tuple<uint64_t, uint64_t, uint32_t> > &to_read,
+    set<int> *want_to_read) const {
+    const vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+    for (auto &&extent : to_read) {
+      for (int i : sinfo.offset_len_to_data_chunks(
+	     make_pair(extent.get<0>(), extent.get<1>()))) {
+	int chunk = (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+	want_to_read->insert(chunk);
+      }
+    }
+  }
 
   /**
    * Recovery
@@ -631,6 +644,7 @@ public:
 
 
   const ECUtil::stripe_info_t sinfo;
+  ECUtil::CodecPool *codec_pool;  ///< may be nullptr
   /// If modified, ensure that the ref is held until the update is applied
   SharedPtrRegistry<hobject_t, ECUtil::HashInfo> unstable_hashinfo_registry;
   ECUtil::HashInfoRef get_hash_info(const hobject_t &hoid, bool checks = true,
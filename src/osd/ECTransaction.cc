@@ -34,7 +34,8 @@ void encode_and_write(
   ECUtil::HashInfoRef hinfo,
   extent_map &written,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
-  DoutPrefixProvider *dpp) {
+  DoutPrefixProvider *dpp,
+  ECUtil::CodecPool *codec_pool) {
   const uint64_t before_size = hinfo->get_total_logical_size(sinfo);
   ceph_assert(sinfo.logical_offset_is_stripe_aligned(offset));
   ceph_assert(sinfo.logical_offset_is_stripe_aligned(bl.length()));
@@ -42,7 +43,7 @@ void encode_and_write(
 
   map<int, bufferlist> buffers;
   int r = ECUtil::encode(
-    sinfo, ecimpl, bl, want, &buffers);
+    sinfo, ecimpl, bl, want, &buffers, codec_pool);
   ceph_assert(r == 0);
 
   written.insert(offset, bl.length(), bl);
@@ -106,7 +107,8 @@ void ECTransaction::generate_transactions(
   set<hobject_t> *temp_added,
   set<hobject_t> *temp_removed,
   DoutPrefixProvider *dpp,
-  const ceph_release_t require_osd_release)
+  const ceph_release_t require_osd_release,
+  ECUtil::CodecPool *codec_pool)
 {
   ceph_assert(written_map);
   ceph_assert(transactions);
@@ -588,7 +590,8 @@ void ECTransaction::generate_transactions(
 	  hinfo,
 	  written,
 	  transactions,
-	  dpp);
+	  dpp,
+	  codec_pool);
       }
 
       auto to_append = to_write.intersect(
@@ -615,7 +618,8 @@ void ECTransaction::generate_transactions(
 	  hinfo,
 	  written,
 	  transactions,
-	  dpp);
+	  dpp,
+	  codec_pool);
       }
 
       ldpp_dout(dpp, 20) << __func__ << ": " << oid
@@ -150,6 +150,35 @@ namespace ECTransaction {
 	  }
 	}
 
+	/* chunks entirely covered by the writes are replaced wholesale,
+	 * so only the rest of each partial stripe needs reading */
+	auto to_read = plan.to_read.find(i.first);
+	if (to_read != plan.to_read.end()) {
+	  extent_set overwritten;
+	  for (auto extent = raw_write_set.begin();
+	       extent != raw_write_set.end();
+	       ++extent) {
+	    auto bounds = sinfo.offset_len_to_chunk_bounds(
+	      make_pair(extent.get_start(), extent.get_len()));
+	    uint64_t start = bounds.first;
+	    if (start < extent.get_start())
+	      start += sinfo.get_chunk_size();
+	    uint64_t end = bounds.first + bounds.second;
+	    if (end > extent.get_start() + extent.get_len())
+	      end -= sinfo.get_chunk_size();
+	    if (start < end)
+	      overwritten.insert(start, end - start);
+	  }
+	  overwritten.intersection_of(to_read->second);
+	  if (!overwritten.empty()) {
+	    ldpp_dout(dpp, 20) << __func__ << ": not reading overwritten "
+			       << overwritten << dendl;
+	    to_read->second.subtract(overwritten);
+	    if (to_read->second.empty())
+	      plan.to_read.erase(to_read);
+	  }
+	}
+
 	if (i.second.truncate &&
 	    i.second.truncate->second > projected_size) {
 	  uint64_t truncating_to =
@@ -194,7 +223,8 @@ namespace ECTransaction {
     set<hobject_t> *temp_added,
     set<hobject_t> *temp_removed,
     DoutPrefixProvider *dpp,
-    const ceph_release_t require_osd_release = ceph_release_t::unknown);
+    const ceph_release_t require_osd_release = ceph_release_t::unknown,
+    ECUtil::CodecPool *codec_pool = nullptr);
 };
 
 #endif
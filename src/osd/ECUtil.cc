@@ -2,15 +2,225 @@
 
 #include <errno.h>
 #include "include/encoding.h"
+#include "common/Thread.h"
+#include "common/ceph_context.h"
 #include "ECUtil.h"
 
 using namespace std;
 
+ECUtil::CodecPool::CodecPool(CephContext *cct, unsigned num_threads)
+  : slice_size(cct->_conf, "osd_ec_codec_slice_size")
+{
+  for (unsigned i = 0; i < num_threads; ++i) {
+    threads.push_back(make_named_thread("ec_codec", &CodecPool::entry, this));
+  }
+}
+
+ECUtil::CodecPool::~CodecPool()
+{
+  {
+    std::lock_guard l(lock);
+    stopping = true;
+    cond.notify_all();
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+ECUtil::CodecPool *ECUtil::CodecPool::get(CephContext *cct)
+{
+  unsigned num_threads = cct->_conf.get_val<uint64_t>("osd_ec_codec_threads");
+  if (num_threads == 0) {
+    return nullptr;
+  }
+  return &cct->lookup_or_create_singleton_object<CodecPool>(
+    "ECUtil::CodecPool", true, cct, num_threads);
+}
+
+unsigned ECUtil::CodecPool::get_num_runs(uint64_t len) const
+{
+  Option::size_t size = slice_size;
+  uint64_t slice = std::max<uint64_t>(size, 1);
+  return std::min<uint64_t>(threads.size() + 1, std::max<uint64_t>(len / slice, 1));
+}
+
+void ECUtil::CodecPool::_do_run(std::unique_lock<ceph::mutex> &l)
+{
+  run_t r = runs.front();
+  runs.pop_front();
+  l.unlock();
+  (*r.fn)(r.i);
+  l.lock();
+  if (--*r.remaining == 0) {
+    done_cond.notify_all();
+  }
+}
+
+void ECUtil::CodecPool::entry()
+{
+  std::unique_lock l(lock);
+  while (!stopping) {
+    if (runs.empty()) {
+      cond.wait(l);
+      continue;
+    }
+    _do_run(l);
+  }
+}
+
+void ECUtil::CodecPool::run(unsigned n, const std::function<void(unsigned)> &fn)
+{
+  if (n == 0) {
+    return;
+  }
+  unsigned remaining = n;
+  std::unique_lock l(lock);
+  for (unsigned i = 1; i < n; ++i) {
+    runs.push_back(run_t{&fn, i, &remaining});
+  }
+  cond.notify_all();
+  l.unlock();
+  fn(0);
+  l.lock();
+  --remaining;
+  // help out rather than wait for busy threads
+  while (remaining) {
+    if (runs.empty()) {
+      done_cond.wait(l);
+    } else {
+      _do_run(l);
+    }
+  }
+}
+
+namespace {
+
+int chunk_index(ErasureCodeInterfaceRef &ec_impl, int i)
+{
+  const vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+  return (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+}
+
+/// stripes [first, last) of the ones a pool splits stripes into n runs
+pair<uint64_t, uint64_t> get_run(uint64_t stripes, unsigned n, unsigned i)
+{
+  return make_pair(stripes * i / n, stripes * (i + 1) / n);
+}
+
+void decode_stripes(
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ec_impl,
+  const map<int, bufferlist> &to_decode,
+  uint64_t first,
+  uint64_t last,
+  bufferlist *out)
+{
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  if (!ec_impl->supports_stripe_batching()) {
+    for (uint64_t i = first * chunk_size;
+	 i < last * chunk_size;
+	 i += chunk_size) {
+      map<int, bufferlist> chunks;
+      for (auto &&j : to_decode) {
+	chunks[j.first].substr_of(j.second, i, chunk_size);
+      }
+      bufferlist bl;
+      int r = ec_impl->decode_concat(chunks, &bl);
+      ceph_assert(r == 0);
+      ceph_assert(bl.length() == sinfo.get_stripe_width());
+      out->claim_append(bl);
+    }
+    return;
+  }
+
+  // one call for all the stripes, each shard's chunks are contiguous
+  const uint64_t len = (last - first) * chunk_size;
+  const int data_chunk_count = ec_impl->get_data_chunk_count();
+  map<int, bufferlist> chunks;
+  for (auto &&j : to_decode) {
+    chunks[j.first].substr_of(j.second, first * chunk_size, len);
+  }
+  set<int> want;
+  for (int i = 0; i < data_chunk_count; ++i) {
+    want.insert(chunk_index(ec_impl, i));
+  }
+  map<int, bufferlist> decoded;
+  int r = ec_impl->decode(want, chunks, &decoded, len);
+  ceph_assert(r == 0);
+  for (uint64_t off = 0; off < len; off += chunk_size) {
+    for (int i = 0; i < data_chunk_count; ++i) {
+      bufferlist bl;
+      bl.substr_of(decoded[chunk_index(ec_impl, i)], off, chunk_size);
+      out->claim_append(bl);
+    }
+  }
+}
+
+void encode_stripes(
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ec_impl,
+  const bufferlist &in,
+  const set<int> &want,
+  uint64_t first,
+  uint64_t last,
+  map<int, bufferlist> *out)
+{
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  if (!ec_impl->supports_stripe_batching()) {
+    for (uint64_t i = first * stripe_width;
+	 i < last * stripe_width;
+	 i += stripe_width) {
+      map<int, bufferlist> encoded;
+      bufferlist buf;
+      buf.substr_of(in, i, stripe_width);
+      int r = ec_impl->encode(want, buf, &encoded);
+      ceph_assert(r == 0);
+      for (auto &&j : encoded) {
+	ceph_assert(j.second.length() == chunk_size);
+	(*out)[j.first].claim_append(j.second);
+      }
+    }
+    return;
+  }
+
+  // gather each data chunk of the stripes into one buffer and code
+  // them all with one call
+  const uint64_t stripes = last - first;
+  const int data_chunk_count = ec_impl->get_data_chunk_count();
+  vector<bufferptr> chunks;
+  for (int i = 0; i < (int)ec_impl->get_chunk_count(); ++i) {
+    chunks.emplace_back(buffer::create_page_aligned(stripes * chunk_size));
+  }
+  auto p = in.begin();
+  p.seek(first * stripe_width);
+  for (uint64_t s = 0; s < stripes; ++s) {
+    for (int i = 0; i < data_chunk_count; ++i) {
+      p.copy(chunk_size, chunks[i].c_str() + s * chunk_size);
+    }
+  }
+  map<int, bufferlist> encoded;
+  for (int i = 0; i < (int)chunks.size(); ++i) {
+    encoded[chunk_index(ec_impl, i)].push_back(std::move(chunks[i]));
+  }
+  int r = ec_impl->encode_chunks(want, &encoded);
+  ceph_assert(r == 0);
+  for (auto &&i : encoded) {
+    if (want.count(i.first)) {
+      (*out)[i.first].claim_append(i.second);
+    }
+  }
+}
+
+}
+
 int ECUtil::decode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   map<int, bufferlist> &to_decode,
-  bufferlist *out) {
+  bufferlist *out,
+  CodecPool *pool) {
   ceph_assert(to_decode.size());
 
   uint64_t total_data_size = to_decode.begin()->second.length();
@@ -28,17 +238,23 @@ int ECUtil::decode(
   if (total_data_size == 0)
     return 0;
 
-  for (uint64_t i = 0; i < total_data_size; i += sinfo.get_chunk_size()) {
-    map<int, bufferlist> chunks;
-    for (map<int, bufferlist>::iterator j = to_decode.begin();
-	 j != to_decode.end();
-	 ++j) {
-      chunks[j->first].substr_of(j->second, i, sinfo.get_chunk_size());
-    }
-    bufferlist bl;
-    int r = ec_impl->decode_concat(chunks, &bl);
-    ceph_assert(r == 0);
-    ceph_assert(bl.length() == sinfo.get_stripe_width());
+  uint64_t stripes = total_data_size / sinfo.get_chunk_size();
+  unsigned n = 1;
+  if (pool && ec_impl->supports_stripe_batching()) {
+    n = std::min<uint64_t>(
+      pool->get_num_runs(stripes * sinfo.get_stripe_width()), stripes);
+  }
+  if (n <= 1) {
+    decode_stripes(sinfo, ec_impl, to_decode, 0, stripes, out);
+    return 0;
+  }
+  vector<bufferlist> decoded(n);
+  pool->run(n, [&](unsigned i) {
+      auto run = get_run(stripes, n, i);
+      decode_stripes(sinfo, ec_impl, to_decode, run.first, run.second,
+		     &decoded[i]);
+    });
+  for (auto &bl : decoded) {
     out->claim_append(bl);
   }
   return 0;
@@ -117,12 +333,56 @@ int ECUtil::decode(
   return 0;
 }
 
+int ECUtil::decode_chunks(
+  const stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ec_impl,
+  uint64_t off,
+  const set<int> &want,
+  map<int, bufferlist> &to_decode,
+  map<uint64_t, bufferlist> *out) {
+  ceph_assert(to_decode.size());
+  ceph_assert(out);
+
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  for (auto &&i : to_decode) {
+    if (i.second.length() % chunk_size != 0) {
+      return -EIO;
+    }
+  }
+
+  map<int, bufferlist> chunks;
+  map<int, bufferlist*> decoded;
+  for (int shard : want) {
+    decoded[shard] = &chunks[shard];
+  }
+  int r = decode(sinfo, ec_impl, to_decode, decoded);
+  if (r < 0)
+    return r;
+
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const vector<int> &chunk_mapping = ec_impl->get_chunk_mapping();
+  for (int i = 0; i < (int)ec_impl->get_data_chunk_count(); ++i) {
+    int shard = (int)chunk_mapping.size() > i ? chunk_mapping[i] : i;
+    auto chunk = chunks.find(shard);
+    if (chunk == chunks.end())
+      continue;
+    for (uint64_t pos = 0; pos < chunk->second.length(); pos += chunk_size) {
+      bufferlist bl;
+      bl.substr_of(chunk->second, pos, chunk_size);
+      (*out)[off + (pos / chunk_size) * stripe_width + i * chunk_size] =
+	std::move(bl);
+    }
+  }
+  return 0;
+}
+
 int ECUtil::encode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   bufferlist &in,
   const set<int> &want,
-  map<int, bufferlist> *out) {
+  map<int, bufferlist> *out,
+  CodecPool *pool) {
 
   uint64_t logical_size = in.length();
 
@@ -133,17 +393,24 @@ int ECUtil::encode(
   if (logical_size == 0)
     return 0;
 
-  for (uint64_t i = 0; i < logical_size; i += sinfo.get_stripe_width()) {
-    map<int, bufferlist> encoded;
-    bufferlist buf;
-    buf.substr_of(in, i, sinfo.get_stripe_width());
-    int r = ec_impl->encode(want, buf, &encoded);
-    ceph_assert(r == 0);
-    for (map<int, bufferlist>::iterator i = encoded.begin();
-	 i != encoded.end();
-	 ++i) {
-      ceph_assert(i->second.length() == sinfo.get_chunk_size());
-      (*out)[i->first].claim_append(i->second);
+  uint64_t stripes = logical_size / sinfo.get_stripe_width();
+  unsigned n = 1;
+  if (pool && ec_impl->supports_stripe_batching()) {
+    n = std::min<uint64_t>(pool->get_num_runs(logical_size), stripes);
+  }
+  if (n <= 1) {
+    encode_stripes(sinfo, ec_impl, in, want, 0, stripes, out);
+  } else {
+    vector<map<int, bufferlist>> encoded(n);
+    pool->run(n, [&](unsigned i) {
+	auto run = get_run(stripes, n, i);
+	encode_stripes(sinfo, ec_impl, in, want, run.first, run.second,
+		       &encoded[i]);
+      });
+    for (auto &&e : encoded) {
+      for (auto &&i : e) {
+	(*out)[i.first].claim_append(i.second);
+      }
     }
   }
 
@@ -15,12 +15,20 @@
 #ifndef ECUTIL_H
 #define ECUTIL_H
 
+#include <deque>
+#include <functional>
 #include <ostream>
+#include <set>
+#include <thread>
+#include <vector>
 #include "erasure-code/ErasureCodeInterface.h"
 #include "include/buffer_fwd.h"
 #include "include/ceph_assert.h"
 #include "include/encoding.h"
 #include "common/Formatter.h"
+#include "common/ceph_mutex.h"
+#include "common/config_proxy.h"
+#include "common/config_cacher.h"
 
 namespace ECUtil {
 
@@ -77,13 +85,75 @@ public:
       (in.first - off) + in.second);
     return std::make_pair(off, len);
   }
+  /// logical extent rounded out to the chunk_size pieces of its stripes
+  std::pair<uint64_t, uint64_t> offset_len_to_chunk_bounds(
+    std::pair<uint64_t, uint64_t> in) const {
+    uint64_t off = in.first - (in.first % chunk_size);
+    uint64_t end = in.first + in.second;
+    end = ((end + chunk_size - 1) / chunk_size) * chunk_size;
+    return std::make_pair(off, end - off);
+  }
+  /// data chunks (by position within the stripe) holding a logical extent
+  std::set<int> offset_len_to_data_chunks(
+    std::pair<uint64_t, uint64_t> in) const {
+    std::set<int> chunks;
+    uint64_t data_chunks = stripe_width / chunk_size;
+    if (in.second == 0) {
+      return chunks;
+    }
+    uint64_t first = in.first / chunk_size;
+    uint64_t last = (in.first + in.second - 1) / chunk_size;
+    for (uint64_t i = first; i <= last && chunks.size() < data_chunks; ++i) {
+      chunks.insert(i % data_chunks);
+    }
+    return chunks;
+  }
+};
+
+/**
+ * Threads shared by all the PGs of an OSD for coding large buffers.
+ *
+ * A buffer is split into runs of whole stripes which are coded by the
+ * threads and the calling thread at once.  The caller also picks up
+ * queued runs while it waits, so nothing depends on a thread being
+ * free.
+ */
+class CodecPool {
+  ceph::mutex lock = ceph::make_mutex("ECUtil::CodecPool::lock");
+  ceph::condition_variable cond;       ///< runs were queued
+  ceph::condition_variable done_cond;  ///< a run completed
+  struct run_t {
+    const std::function<void(unsigned)> *fn;
+    unsigned i;
+    unsigned *remaining;
+  };
+  std::deque<run_t> runs;
+  std::vector<std::thread> threads;
+  bool stopping = false;
+  md_config_cacher_t<Option::size_t> slice_size;
+
+  void entry();
+  void _do_run(std::unique_lock<ceph::mutex> &l);
+
+public:
+  CodecPool(CephContext *cct, unsigned num_threads);
+  ~CodecPool();
+
+  /// the pool of this process, nullptr if it has no threads
+  static CodecPool *get(CephContext *cct);
+
+  /// how many runs a buffer of len logical bytes is worth splitting into
+  unsigned get_num_runs(uint64_t len) const;
+  /// call fn(0) ... fn(n - 1) in parallel, return once all returned
+  void run(unsigned n, const std::function<void(unsigned)> &fn);
 };
 
 int decode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   std::map<int, bufferlist> &to_decode,
-  bufferlist *out);
+  bufferlist *out,
+  CodecPool *pool = nullptr);
 
 int decode(
   const stripe_info_t &sinfo,
@@ -91,12 +161,27 @@ int decode(
   std::map<int, bufferlist> &to_decode,
   std::map<int, bufferlist*> &out);
 
+/**
+ * decode only the data chunks in want of the stripes starting at
+ * logical offset off, and return each chunk at its logical offset
+ *
+ * @return -EIO if a shard did not return whole chunks
+ */
+int decode_chunks(
+  const stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ec_impl,
+  uint64_t off,
+  const std::set<int> &want,
+  std::map<int, bufferlist> &to_decode,
+  std::map<uint64_t, bufferlist> *out);
+
 int encode(
   const stripe_info_t &sinfo,
   ErasureCodeInterfaceRef &ec_impl,
   bufferlist &in,
   const std::set<int> &want,
-  std::map<int, bufferlist> *out);
+  std::map<int, bufferlist> *out,
+  CodecPool *pool = nullptr);
 
 class HashInfo {
   uint64_t total_chunk_size = 0;
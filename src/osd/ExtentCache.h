@@ -92,6 +92,11 @@
    All of the above suggests that there are 3 things users can
    ask of the cache corresponding to the 3 Write pipelines
    states.
+
+   Nothing here assumes stripe alignment.  A write pins whole stripes,
+   but only reads the chunks of them it does not replace, so the read
+   extents handed to reserve_extents_for_rmw may be chunk sized pieces
+   of a stripe.
  */
 
 /// If someone wants these types, but not ExtentCache, move to another file
@@ -62,6 +62,7 @@
 #endif
 
 #include "PrimaryLogPG.h"
+#include "ScrubStore.h"
 
 #include "msg/Messenger.h"
 #include "msg/Message.h"
@@ -234,6 +235,7 @@ OSDService::OSDService(OSD *osd, ceph::async::io_context_pool& poolctx) :
   monc(osd->monc),
   osd_max_object_size(cct->_conf, "osd_max_object_size"),
   osd_skip_data_digest(cct->_conf, "osd_skip_data_digest"),
+  osd_coalesce_reads(cct->_conf, "osd_coalesce_reads"),
   publish_lock{ceph::make_mutex("OSDService::publish_lock")},
   pre_publish_lock{ceph::make_mutex("OSDService::pre_publish_lock")},
   max_oldest_map(0),
@@ -2222,6 +2224,8 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
                                            cct->_conf->osd_op_history_duration);
   op_tracker.set_history_slow_op_size_and_threshold(cct->_conf->osd_op_history_slow_op_size,
                                                     cct->_conf->osd_op_history_slow_op_threshold);
+  op_tracker.set_history_sample_rate(
+    cct->_conf.get_val<uint64_t>("osd_op_history_sample_rate"));
   ObjectCleanRegions::set_max_num_intervals(cct->_conf->osd_object_clean_region_max_num_intervals);
 #ifdef WITH_BLKIN
   std::stringstream ss;
@@ -2231,6 +2235,7 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
 
   // initialize shards
   num_shards = get_num_op_shards();
+  num_threads_per_shard = get_num_op_threads() / num_shards;
   for (uint32_t i = 0; i < num_shards; i++) {
     OSDShard *one_shard = new OSDShard(
       i,
@@ -2795,79 +2800,7 @@ will start to track new ops received afterwards.";
     if (osize && bsize > osize)
       bsize = osize;
 
-    dout(1) << " bench count " << count
-            << " bsize " << byte_u_t(bsize) << dendl;
-
-    ObjectStore::Transaction cleanupt;
-
-    if (osize && onum) {
-      bufferlist bl;
-      bufferptr bp(osize);
-      bp.zero();
-      bl.push_back(std::move(bp));
-      bl.rebuild_page_aligned();
-      for (int i=0; i<onum; ++i) {
-	char nm[30];
-	snprintf(nm, sizeof(nm), "disk_bw_test_%d", i);
-	object_t oid(nm);
-	hobject_t soid(sobject_t(oid, 0));
-	ObjectStore::Transaction t;
-	t.write(coll_t(), ghobject_t(soid), 0, osize, bl);
-	store->queue_transaction(service.meta_ch, std::move(t), NULL);
-	cleanupt.remove(coll_t(), ghobject_t(soid));
-      }
-    }
-
-    bufferlist bl;
-    bufferptr bp(bsize);
-    bp.zero();
-    bl.push_back(std::move(bp));
-    bl.rebuild_page_aligned();
-
-    {
-      C_SaferCond waiter;
-      if (!service.meta_ch->flush_commit(&waiter)) {
-	waiter.wait();
-      }
-    }
-
-    utime_t start = ceph_clock_now();
-    for (int64_t pos = 0; pos < count; pos += bsize) {
-      char nm[30];
-      unsigned offset = 0;
-      if (onum && osize) {
-	snprintf(nm, sizeof(nm), "disk_bw_test_%d", (int)(rand() % onum));
-	offset = rand() % (osize / bsize) * bsize;
-      } else {
-	snprintf(nm, sizeof(nm), "disk_bw_test_%lld", (long long)pos);
-      }
-      object_t oid(nm);
-      hobject_t soid(sobject_t(oid, 0));
-      ObjectStore::Transaction t;
-      t.write(coll_t::meta(), ghobject_t(soid), offset, bsize, bl);
-      store->queue_transaction(service.meta_ch, std::move(t), NULL);
-      if (!onum || !osize)
-	cleanupt.remove(coll_t::meta(), ghobject_t(soid));
-    }
-
-    {
-      C_SaferCond waiter;
-      if (!service.meta_ch->flush_commit(&waiter)) {
-	waiter.wait();
-      }
-    }
-    utime_t end = ceph_clock_now();
-
-    // clean up
-    store->queue_transaction(service.meta_ch, std::move(cleanupt), NULL);
-    {
-      C_SaferCond waiter;
-      if (!service.meta_ch->flush_commit(&waiter)) {
-	waiter.wait();
-      }
-    }
-
-    double elapsed = end - start;
+    double elapsed = run_osd_bench_test(count, bsize, osize, onum);
     double rate = count / elapsed;
     double iops = rate / bsize;
     f->open_object_section("osd_bench_results");
@@ -3207,6 +3140,140 @@ int OSD::enable_disable_fuse(bool stop)
   return 0;
 }
 
+double OSD::run_osd_bench_test(int64_t count, int64_t bsize,
+			       int64_t osize, int64_t onum)
+{
+  dout(1) << " bench count " << count
+	  << " bsize " << byte_u_t(bsize) << dendl;
+
+  ObjectStore::Transaction cleanupt;
+
+  if (osize && onum) {
+    bufferlist bl;
+    bufferptr bp(osize);
+    bp.zero();
+    bl.push_back(std::move(bp));
+    bl.rebuild_page_aligned();
+    for (int i=0; i<onum; ++i) {
+      char nm[30];
+      snprintf(nm, sizeof(nm), "disk_bw_test_%d", i);
+      object_t oid(nm);
+      hobject_t soid(sobject_t(oid, 0));
+      ObjectStore::Transaction t;
+      t.write(coll_t(), ghobject_t(soid), 0, osize, bl);
+      store->queue_transaction(service.meta_ch, std::move(t), NULL);
+      cleanupt.remove(coll_t(), ghobject_t(soid));
+    }
+  }
+
+  bufferlist bl;
+  bufferptr bp(bsize);
+  bp.zero();
+  bl.push_back(std::move(bp));
+  bl.rebuild_page_aligned();
+
+  {
+    C_SaferCond waiter;
+    if (!service.meta_ch->flush_commit(&waiter)) {
+      waiter.wait();
+    }
+  }
+
+  utime_t start = ceph_clock_now();
+  for (int64_t pos = 0; pos < count; pos += bsize) {
+    char nm[30];
+    unsigned offset = 0;
+    if (onum && osize) {
+      snprintf(nm, sizeof(nm), "disk_bw_test_%d", (int)(rand() % onum));
+      offset = rand() % (osize / bsize) * bsize;
+    } else {
+      snprintf(nm, sizeof(nm), "disk_bw_test_%lld", (long long)pos);
+    }
+    object_t oid(nm);
+    hobject_t soid(sobject_t(oid, 0));
+    ObjectStore::Transaction t;
+    t.write(coll_t::meta(), ghobject_t(soid), offset, bsize, bl);
+    store->queue_transaction(service.meta_ch, std::move(t), NULL);
+    if (!onum || !osize)
+      cleanupt.remove(coll_t::meta(), ghobject_t(soid));
+  }
+
+  {
+    C_SaferCond waiter;
+    if (!service.meta_ch->flush_commit(&waiter)) {
+      waiter.wait();
+    }
+  }
+  utime_t end = ceph_clock_now();
+
+  // clean up
+  store->queue_transaction(service.meta_ch, std::move(cleanupt), NULL);
+  {
+    C_SaferCond waiter;
+    if (!service.meta_ch->flush_commit(&waiter)) {
+      waiter.wait();
+    }
+  }
+
+  return end - start;
+}
+
+void OSD::measure_mclock_capacity()
+{
+  if (cct->_conf->osd_op_queue != "mclock_scheduler" ||
+      cct->_conf.get_val<std::string>("osd_mclock_profile") == "custom" ||
+      cct->_conf.get_val<bool>("osd_mclock_skip_benchmark")) {
+    return;
+  }
+  const char *key = store_is_rotational ?
+    "osd_mclock_max_capacity_iops_hdd" : "osd_mclock_max_capacity_iops_ssd";
+  // a capacity configured by the admin, or measured by an earlier start
+  // and stored in the mon config, is left alone
+  const Option *opt = cct->_conf.find_option(key);
+  if (cct->_conf.get_val<double>(key) != boost::get<double>(opt->value)) {
+    dout(10) << __func__ << " " << key << " is set, skipping benchmark"
+	     << dendl;
+    return;
+  }
+  // random 4K writes into a few preallocated objects
+  const int64_t bsize = 4096;
+  const int64_t count = 3000 * bsize;
+  const int64_t osize = 4 << 20;
+  const int64_t onum = 16;
+  double elapsed = run_osd_bench_test(count, bsize, osize, onum);
+  mclock_measured_iops = count / bsize / elapsed;
+  dout(1) << __func__ << " " << mclock_measured_iops << " iops in "
+	  << elapsed << "s" << dendl;
+}
+
+int OSD::update_mclock_capacity()
+{
+  if (mclock_measured_iops <= 0) {
+    return 0;
+  }
+  const char *key = store_is_rotational ?
+    "osd_mclock_max_capacity_iops_hdd" : "osd_mclock_max_capacity_iops_ssd";
+  string cmd =
+    string("{\"prefix\": \"config set\", ") +
+    string("\"who\": \"osd.") + stringify(whoami) + string("\", ") +
+    string("\"name\": \"") + key + string("\", ") +
+    string("\"value\": \"") + stringify(mclock_measured_iops) +
+    string("\"}");
+  dout(10) << __func__ << " cmd: " << cmd << dendl;
+  vector<string> vcmd{cmd};
+  bufferlist inbl;
+  C_SaferCond w;
+  string outs;
+  monc->start_mon_command(vcmd, inbl, NULL, &outs, &w);
+  int r = w.wait();
+  if (r < 0) {
+    derr << __func__ << " fail: '" << outs << "': " << cpp_strerror(r) << dendl;
+    return r;
+  }
+  mclock_measured_iops = 0;
+  return 0;
+}
+
 int OSD::get_num_op_shards()
 {
   if (cct->_conf->osd_op_num_shards)
@@ -3317,6 +3384,8 @@ int OSD::init()
 
   service.meta_ch = store->open_collection(coll_t::meta());
 
+  measure_mclock_capacity();
+
   // initialize the daily loadavg with current 15min loadavg
   double loadavgs[3];
   if (getloadavg(loadavgs, 3) == 3) {
@@ -3635,6 +3704,9 @@ int OSD::init()
     exit(1);
   }
 
+  // not fatal: the scheduler keeps working with the default capacity
+  update_mclock_capacity();
+
   osd_lock.lock();
   if (is_stopping())
     return 0;
@@ -4399,6 +4471,11 @@ void OSD::clear_temp_objects()
       for (q = objects.begin(); q != objects.end(); ++q) {
 	// Hammer set pool for temps to -1, so check for clean-up
 	if (q->hobj.is_temp() || (q->hobj.pool == -1)) {
+	  if (Scrub::Store::is_store_object(*q) &&
+	      cct->_conf.get_val<bool>("osd_scrub_resume")) {
+	    // may hold the position of an interrupted scrub
+	    continue;
+	  }
 	  temps.push_back(*q);
 	} else {
 	  break;
@@ -7009,6 +7086,28 @@ void OSD::dispatch_session_waiting(const ceph::ref_t<Session>& session, OSDMapRe
 }
 
 void OSD::ms_fast_dispatch(Message *m)
+{
+  _ms_fast_dispatch(m, nullptr);
+}
+
+void OSD::ms_fast_dispatch_batch(std::vector<MessageRef>& ms)
+{
+  std::vector<OpSchedulerItem> batch;
+  batch.reserve(ms.size());
+  for (auto& m : ms) {
+    _ms_fast_dispatch(m.detach(), &batch);
+  }
+  if (!batch.empty()) {
+    op_shardedwq.queue_batch(std::move(batch));
+  }
+}
+
+/*
+ * With a batch, ops are collected there to be queued together by the
+ * caller, taking each shard lock once; everything else is still handled
+ * right away, after queueing the ops that came before it.
+ */
+void OSD::_ms_fast_dispatch(Message *m, std::vector<OpSchedulerItem> *batch)
 {
   FUNCTRACE(cct);
   if (service.is_stopping()) {
@@ -7016,6 +7115,15 @@ void OSD::ms_fast_dispatch(Message *m)
     return;
   }
 
+  // what is not batched below is queued right away, keep it behind the
+  // ops that came before it
+  auto queue_batch = [this, batch] {
+    if (batch && !batch->empty()) {
+      op_shardedwq.queue_batch(std::move(*batch));
+      batch->clear();
+    }
+  };
+
   // peering event?
   switch (m->get_type()) {
   case CEPH_MSG_PING:
@@ -7023,21 +7131,28 @@ void OSD::ms_fast_dispatch(Message *m)
     m->put();
     return;
   case MSG_OSD_FORCE_RECOVERY:
+    queue_batch();
     handle_fast_force_recovery(static_cast<MOSDForceRecovery*>(m));
     return;
   case MSG_OSD_SCRUB2:
+    queue_batch();
     handle_fast_scrub(static_cast<MOSDScrub2*>(m));
     return;
 
   case MSG_OSD_PG_CREATE2:
+    queue_batch();
     return handle_fast_pg_create(static_cast<MOSDPGCreate2*>(m));
   case MSG_OSD_PG_QUERY:
+    queue_batch();
     return handle_fast_pg_query(static_cast<MOSDPGQuery*>(m));
   case MSG_OSD_PG_NOTIFY:
+    queue_batch();
     return handle_fast_pg_notify(static_cast<MOSDPGNotify*>(m));
   case MSG_OSD_PG_INFO:
+    queue_batch();
     return handle_fast_pg_info(static_cast<MOSDPGInfo*>(m));
   case MSG_OSD_PG_REMOVE:
+    queue_batch();
     return handle_fast_pg_remove(static_cast<MOSDPGRemove*>(m));
 
     // these are single-pg messages that handle themselves
@@ -7051,6 +7166,7 @@ void OSD::ms_fast_dispatch(Message *m)
   case MSG_OSD_PG_LEASE:
   case MSG_OSD_PG_LEASE_ACK:
     {
+      queue_batch();
       MOSDPeeringOp *pm = static_cast<MOSDPeeringOp*>(m);
       if (require_osd_peer(pm)) {
 	enqueue_peering_evt(
@@ -7087,11 +7203,13 @@ void OSD::ms_fast_dispatch(Message *m)
     enqueue_op(
       static_cast<MOSDFastDispatchOp*>(m)->get_spg(),
       std::move(op),
-      static_cast<MOSDFastDispatchOp*>(m)->get_map_epoch());
+      static_cast<MOSDFastDispatchOp*>(m)->get_map_epoch(),
+      batch);
   } else {
     // legacy client, and this is an MOSDOp (the *only* fast dispatch
     // message that didn't have an explicit spg_t); we need to map
     // them to an spg_t while preserving delivery order.
+    queue_batch();
     auto priv = m->get_connection()->get_priv();
     if (auto session = static_cast<Session*>(priv.get()); session) {
       std::lock_guard l{session->session_dispatch_lock};
@@ -9549,7 +9667,8 @@ bool OSD::op_is_discardable(const MOSDOp *op)
   return false;
 }
 
-void OSD::enqueue_op(spg_t pg, OpRequestRef&& op, epoch_t epoch)
+void OSD::enqueue_op(spg_t pg, OpRequestRef&& op, epoch_t epoch,
+		     std::vector<OpSchedulerItem> *batch)
 {
   const utime_t stamp = op->get_req()->get_recv_stamp();
   const utime_t latency = ceph_clock_now() - stamp;
@@ -9567,10 +9686,14 @@ void OSD::enqueue_op(spg_t pg, OpRequestRef&& op, epoch_t epoch)
   op->osd_trace.keyval("cost", cost);
   op->mark_queued_for_pg();
   logger->tinc(l_osd_op_before_queue_op_lat, latency);
-  op_shardedwq.queue(
-    OpSchedulerItem(
-      unique_ptr<OpSchedulerItem::OpQueueable>(new PGOpItem(pg, std::move(op))),
-      cost, priority, stamp, owner, epoch));
+  OpSchedulerItem item(
+    unique_ptr<OpSchedulerItem::OpQueueable>(new PGOpItem(pg, std::move(op))),
+    cost, priority, stamp, owner, epoch);
+  if (batch) {
+    batch->push_back(std::move(item));
+  } else {
+    op_shardedwq.queue(std::move(item));
+  }
 }
 
 void OSD::enqueue_peering_evt(spg_t pgid, PGPeeringEventRef evt)
@@ -9709,6 +9832,7 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_op_history_duration",
     "osd_op_history_slow_op_size",
     "osd_op_history_slow_op_threshold",
+    "osd_op_history_sample_rate",
     "osd_enable_op_tracker",
     "osd_map_cache_size",
     "osd_pg_epoch_max_lag_factor",
@@ -9767,6 +9891,10 @@ void OSD::handle_conf_change(const ConfigProxy& conf,
     op_tracker.set_history_slow_op_size_and_threshold(cct->_conf->osd_op_history_slow_op_size,
                                                       cct->_conf->osd_op_history_slow_op_threshold);
   }
+  if (changed.count("osd_op_history_sample_rate")) {
+    op_tracker.set_history_sample_rate(
+      cct->_conf.get_val<uint64_t>("osd_op_history_sample_rate"));
+  }
   if (changed.count("osd_enable_op_tracker")) {
       op_tracker.set_tracking(cct->_conf->osd_enable_op_tracker);
   }
@@ -10230,6 +10358,15 @@ void OSDShard::consume_map(
 	   << dendl;
   bool queued = false;
 
+  std::map<int64_t, ceph::osd::scheduler::pool_qos_t> pool_qos;
+  for (auto& [id, pool] : new_osdmap->get_pools()) {
+    auto& qos = pool_qos[id];
+    pool.opts.get(pool_opts_t::QOS_RESERVATION, &qos.reservation);
+    pool.opts.get(pool_opts_t::QOS_WEIGHT, &qos.weight);
+    pool.opts.get(pool_opts_t::QOS_LIMIT, &qos.limit);
+  }
+  scheduler->update_pool_qos(pool_qos);
+
   // check slots
   auto p = pg_slots.begin();
   while (p != pg_slots.end()) {
@@ -10285,6 +10422,7 @@ void OSDShard::consume_map(
     }
     if (slot->waiting.empty() &&
 	slot->num_running == 0 &&
+	!slot->in_progress &&
 	slot->waiting_for_split.empty() &&
 	!slot->pg) {
       dout(20) << __func__ << "  " << pgid << " empty, pruning" << dendl;
@@ -10312,12 +10450,14 @@ void OSDShard::_wake_pg_slot(
        i != slot->to_process.rend();
        ++i) {
     scheduler->enqueue_front(std::move(*i));
+    ++queue_depth;
   }
   slot->to_process.clear();
   for (auto i = slot->waiting.rbegin();
        i != slot->waiting.rend();
        ++i) {
     scheduler->enqueue_front(std::move(*i));
+    ++queue_depth;
   }
   slot->waiting.clear();
   for (auto i = slot->waiting_peering.rbegin();
@@ -10328,9 +10468,11 @@ void OSDShard::_wake_pg_slot(
     // someday, if we decide this inefficiency matters
     for (auto j = i->second.rbegin(); j != i->second.rend(); ++j) {
       scheduler->enqueue_front(std::move(*j));
+      ++queue_depth;
     }
   }
   slot->waiting_peering.clear();
+  slot->handed_off = 0;
   ++slot->requeue_seq;
 }
 
@@ -10533,7 +10675,8 @@ OSDShard::OSDShard(
     osdmap_lock{make_mutex(osdmap_lock_name)},
     shard_lock_name(shard_name + "::shard_lock"),
     shard_lock{make_mutex(shard_lock_name)},
-    scheduler(ceph::osd::scheduler::make_scheduler(cct)),
+    scheduler(ceph::osd::scheduler::make_scheduler(
+      cct, osd->num_shards, osd->store_is_rotational)),
     context_queue(sdata_wait_lock, sdata_cond)
 {
   dout(0) << "using op scheduler " << *scheduler << dendl;
@@ -10570,10 +10713,50 @@ void OSD::ShardedOpWQ::_add_slot_waiter(
 #undef dout_prefix
 #define dout_prefix *_dout << "osd." << osd->whoami << " op_wq(" << shard_index << ") "
 
+OSDShard *OSD::ShardedOpWQ::_steal_shard(uint32_t shard_index)
+{
+  for (uint32_t i = 1; i < osd->num_shards; i++) {
+    OSDShard *victim = osd->shards[(shard_index + i) % osd->num_shards];
+    // never wait for a busy shard, its own threads are on it anyway
+    if (!victim->shard_lock.try_lock()) {
+      continue;
+    }
+    // only help out if more is queued than the shard's own threads can
+    // take on: otherwise whatever we dequeue would likely be for a pg one
+    // of them is running, and we would just wait for its pg lock
+    if (victim->queue_depth > osd->num_threads_per_shard) {
+      return victim;
+    }
+    victim->shard_lock.unlock();
+  }
+  return nullptr;
+}
+
+bool OSD::ShardedOpWQ::_take_handed_off(OSDShard *sdata, spg_t token,
+					 OSDShardPGSlot **pslot)
+{
+  sdata->shard_lock.lock();
+  auto q = sdata->pg_slots.find(token);
+  if (q != sdata->pg_slots.end()) {
+    OSDShardPGSlot *slot = q->second.get();
+    slot->in_progress = false;
+    if (slot->handed_off && !slot->to_process.empty()) {
+      --slot->handed_off;
+      dout(20) << __func__ << " " << token << " " << slot->handed_off
+	       << " more" << dendl;
+      *pslot = slot;
+      return true;
+    }
+    slot->handed_off = 0;
+  }
+  sdata->shard_lock.unlock();
+  return false;
+}
+
 void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 {
   uint32_t shard_index = thread_index % osd->num_shards;
-  auto& sdata = osd->shards[shard_index];
+  OSDShard *sdata = osd->shards[shard_index];
   ceph_assert(sdata);
 
   // If all threads of shards do oncommits, there is a out-of-order
@@ -10584,6 +10767,27 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
 
   // peek at spg_t
   sdata->shard_lock.lock();
+  bool stolen = false;
+  if (sdata->scheduler->empty() &&
+      (!is_smallest_thread_index || sdata->context_queue.empty()) &&
+      osd->num_shards > 1 &&
+      osd->cct->_conf->osd_op_queue_work_stealing) {
+    // nothing to do here; help a backlogged shard instead of sleeping.
+    // we act as one more thread of that shard: items go through its pg
+    // slots and the pg lock, so per-pg ordering is unaffected.
+    sdata->shard_lock.unlock();
+    OSDShard *victim = _steal_shard(shard_index);
+    if (victim) {
+      dout(20) << __func__ << " stealing from shard " << victim->shard_id
+	       << dendl;
+      sdata = victim;
+      stolen = true;
+      // the oncommits belong to the owning shard's first thread
+      is_smallest_thread_index = false;
+    } else {
+      sdata->shard_lock.lock();
+    }
+  }
   if (sdata->scheduler->empty() &&
       (!is_smallest_thread_index || sdata->context_queue.empty())) {
     std::unique_lock wait_lock{sdata->sdata_wait_lock};
@@ -10594,7 +10798,9 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       dout(20) << __func__ << " empty q, waiting" << dendl;
       osd->cct->get_heartbeat_map()->clear_timeout(hb);
       sdata->shard_lock.unlock();
+      ++sdata->num_idle_threads;
       sdata->sdata_cond.wait(wait_lock);
+      --sdata->num_idle_threads;
       wait_lock.unlock();
       sdata->shard_lock.lock();
       if (sdata->scheduler->empty() &&
@@ -10632,6 +10838,7 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   }
 
   OpSchedulerItem item = sdata->scheduler->dequeue();
+  --sdata->queue_depth;
   if (osd->is_stopping()) {
     sdata->shard_lock.unlock();
     for (auto c : oncommits) {
@@ -10656,6 +10863,21 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   slot->to_process.push_back(std::move(item));
   dout(20) << __func__ << " " << slot->to_process.back()
 	   << " queued" << dendl;
+  if (stolen) {
+    if (slot->pg && (slot->in_progress || slot->num_running)) {
+      // the pg is being processed by a thread of its own shard.  the item
+      // has been charged by the scheduler and is not put back; leave it
+      // to that thread rather than wait for the pg lock away from our
+      // own shard
+      ++slot->handed_off;
+      dout(20) << __func__ << " " << token << " busy, handed off "
+	       << slot->handed_off << dendl;
+      sdata->shard_lock.unlock();
+      return;
+    }
+    ++sdata->num_stolen;
+    osd->logger->inc(l_osd_op_wq_steals);
+  }
 
  retry_pg:
   PGRef pg = slot->pg;
@@ -10710,6 +10932,8 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       pg->unlock();
       goto retry_pg;
     }
+    // stealers may leave items to us from here on, see _take_handed_off
+    slot->in_progress = true;
   }
 
   dout(20) << __func__ << " " << token
@@ -10814,6 +11038,10 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
       sdata->shard_lock.unlock();
       pg->unlock();
       handle_oncommits(oncommits);
+      oncommits.clear();
+      if (_take_handed_off(sdata, token, &slot)) {
+	goto retry_pg;
+      }
       return;
     }
   }
@@ -10862,6 +11090,11 @@ void OSD::ShardedOpWQ::_process(uint32_t thread_index, heartbeat_handle_d *hb)
   }
 
   handle_oncommits(oncommits);
+  oncommits.clear();
+
+  if (pg && _take_handed_off(sdata, token, &slot)) {
+    goto retry_pg;
+  }
 }
 
 void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
@@ -10874,15 +11107,81 @@ void OSD::ShardedOpWQ::_enqueue(OpSchedulerItem&& item) {
   assert (NULL != sdata);
 
   bool empty = true;
+  uint64_t depth = 0;
   {
     std::lock_guard l{sdata->shard_lock};
     empty = sdata->scheduler->empty();
     sdata->scheduler->enqueue(std::move(item));
+    depth = ++sdata->queue_depth;
+  }
+
+  _wake(shard_index, empty, 1, depth);
+}
+
+void OSD::ShardedOpWQ::queue_batch(std::vector<OpSchedulerItem>&& items)
+{
+  const uint32_t num_shards = osd->shards.size();
+  std::vector<uint32_t> shard_of(items.size());
+  for (size_t i = 0; i < items.size(); ++i) {
+    shard_of[i] = items[i].get_ordering_token().hash_to_shard(num_shards);
+  }
+
+  // one pass per shard, keeping the items' order within each shard
+  std::vector<bool> queued(items.size(), false);
+  for (size_t i = 0; i < items.size(); ++i) {
+    if (queued[i]) {
+      continue;
+    }
+    const uint32_t shard_index = shard_of[i];
+    OSDShard* sdata = osd->shards[shard_index];
+    assert (NULL != sdata);
+
+    bool empty = true;
+    unsigned count = 0;
+    uint64_t depth = 0;
+    {
+      std::lock_guard l{sdata->shard_lock};
+      empty = sdata->scheduler->empty();
+      for (size_t j = i; j < items.size(); ++j) {
+	if (queued[j] || shard_of[j] != shard_index) {
+	  continue;
+	}
+	dout(20) << __func__ << " " << items[j] << dendl;
+	sdata->scheduler->enqueue(std::move(items[j]));
+	++sdata->queue_depth;
+	queued[j] = true;
+	++count;
+      }
+      depth = sdata->queue_depth;
+    }
+
+    _wake(shard_index, empty, count, depth);
   }
+}
 
-  if (empty) {
+void OSD::ShardedOpWQ::_wake(uint32_t shard_index, bool was_empty,
+			     unsigned queued, uint64_t queue_depth)
+{
+  OSDShard* sdata = osd->shards[shard_index];
+  if (was_empty) {
     std::lock_guard l{sdata->sdata_wait_lock};
-    sdata->sdata_cond.notify_one();
+    if (queued > 1) {
+      sdata->sdata_cond.notify_all();
+    } else {
+      sdata->sdata_cond.notify_one();
+    }
+  } else if (queue_depth > osd->num_threads_per_shard &&
+	     osd->cct->_conf->osd_op_queue_work_stealing) {
+    // we are backing up beyond what our own threads can take on; wake an
+    // idle thread of some other shard to steal from us
+    for (uint32_t i = 1; i < osd->num_shards; i++) {
+      OSDShard *idle = osd->shards[(shard_index + i) % osd->num_shards];
+      if (idle->num_idle_threads) {
+	std::lock_guard l{idle->sdata_wait_lock};
+	idle->sdata_cond.notify_one();
+	break;
+      }
+    }
   }
 }
 
@@ -10909,6 +11208,7 @@ void OSD::ShardedOpWQ::_enqueue_front(OpSchedulerItem&& item)
     dout(20) << __func__ << " " << item << dendl;
   }
   sdata->scheduler->enqueue_front(std::move(item));
+  ++sdata->queue_depth;
   sdata->shard_lock.unlock();
   std::lock_guard l{sdata->sdata_wait_lock};
   sdata->sdata_cond.notify_one();
@@ -123,6 +123,7 @@ public:
 
   md_config_cacher_t<Option::size_t> osd_max_object_size;
   md_config_cacher_t<bool> osd_skip_data_digest;
+  md_config_cacher_t<bool> osd_coalesce_reads;
 
   void enqueue_back(OpSchedulerItem&& qi);
   void enqueue_front(OpSchedulerItem&& qi);
@@ -964,6 +965,8 @@ struct OSDShardPGSlot {
   PGRef pg;                      ///< pg reference
   deque<OpSchedulerItem> to_process; ///< order items for this slot
   int num_running = 0;          ///< _process threads doing pg lookup/lock
+  bool in_progress = false;     ///< a _process thread is running an item
+  unsigned handed_off = 0;      ///< to_process items left to that thread
 
   deque<OpSchedulerItem> waiting;   ///< waiting for pg (or map + pg)
 
@@ -1031,9 +1034,16 @@ struct OSDShard {
 
   /// priority queue
   ceph::osd::scheduler::OpSchedulerRef scheduler;
+  /// number of items in scheduler
+  uint64_t queue_depth = 0;
 
   bool stop_waiting = false;
 
+  /// threads of this shard blocked on sdata_cond
+  std::atomic<unsigned> num_idle_threads = {0};
+  /// items dequeued from this shard by threads of other shards
+  std::atomic<uint64_t> num_stolen = {0};
+
   ContextQueue context_queue;
 
   void _attach_pg(OSDShardPGSlot *slot, PG *pg);
@@ -1597,12 +1607,30 @@ protected:
       OSDShardPGSlot *slot,
       OpSchedulerItem&& qi);
 
+    /// find another shard with queued work; returns it with shard_lock held
+    OSDShard *_steal_shard(uint32_t shard_index);
+
+    /**
+     * Done with an item of the pg of @token: take on the next one if a
+     * stealer left it to us.  Returns true with shard_lock held and
+     * *pslot set if so.
+     */
+    bool _take_handed_off(OSDShard *sdata, spg_t token,
+			  OSDShardPGSlot **pslot);
+
     /// try to do some work
     void _process(uint32_t thread_index, heartbeat_handle_d *hb) override;
 
     /// enqueue a new item
     void _enqueue(OpSchedulerItem&& item) override;
 
+    /// enqueue new items, taking each shard lock once
+    void queue_batch(std::vector<OpSchedulerItem>&& items);
+
+    /// wake a thread for items just queued on a shard, now queue_depth deep
+    void _wake(uint32_t shard_index, bool was_empty, unsigned queued,
+	       uint64_t queue_depth);
+
     /// requeue an old item (at the front of the line)
     void _enqueue_front(OpSchedulerItem&& item) override;
       
@@ -1635,6 +1663,8 @@ protected:
 
 	std::scoped_lock l{sdata->shard_lock};
 	f->open_object_section(queue_name);
+	f->dump_unsigned("queue_depth", sdata->queue_depth);
+	f->dump_unsigned("stolen", sdata->num_stolen);
 	sdata->scheduler->dump(*f);
 	f->close_section();
       }
@@ -1660,7 +1690,8 @@ protected:
   } op_shardedwq;
 
 
-  void enqueue_op(spg_t pg, OpRequestRef&& op, epoch_t epoch);
+  void enqueue_op(spg_t pg, OpRequestRef&& op, epoch_t epoch,
+		  std::vector<OpSchedulerItem> *batch = nullptr);
   void dequeue_op(
     PGRef pg, OpRequestRef op,
     ThreadPool::TPHandle &handle);
@@ -1744,6 +1775,7 @@ public:
   // -- shards --
   vector<OSDShard*> shards;
   uint32_t num_shards = 0;
+  uint32_t num_threads_per_shard = 0;
 
   void inc_num_pgs() {
     ++num_pgs;
@@ -1986,6 +2018,8 @@ private:
     }
   }
   void ms_fast_dispatch(Message *m) override;
+  void ms_fast_dispatch_batch(std::vector<MessageRef>& ms) override;
+  void _ms_fast_dispatch(Message *m, std::vector<OpSchedulerItem> *batch);
   bool ms_dispatch(Message *m) override;
   void ms_handle_connect(Connection *con) override;
   void ms_handle_fast_connect(Connection *con) override;
@@ -2044,6 +2078,15 @@ private:
   int get_num_op_shards();
   int get_num_op_threads();
 
+  /// write count bytes in bsize chunks to the meta collection
+  double run_osd_bench_test(int64_t count, int64_t bsize,
+			    int64_t osize, int64_t onum);
+  /// measure the IOPS capacity the mclock scheduler works with
+  void measure_mclock_capacity();
+  /// store the measured capacity in the mon config
+  int update_mclock_capacity();
+  double mclock_measured_iops = 0;
+
   float get_osd_recovery_sleep();
   float get_osd_delete_sleep();
   float get_osd_snap_trim_sleep();
@@ -823,14 +823,29 @@ bool PG::check_in_progress_op(
   eversion_t *version,
   version_t *user_version,
   int *return_code,
-  vector<pg_log_op_return_item_t> *op_returns
+  vector<pg_log_op_return_item_t> *op_returns,
+  bool resend
   ) const
 {
-  return (
-    projected_log.get_request(r, version, user_version, return_code,
-			      op_returns) ||
-    recovery_state.get_pg_log().get_log().get_request(
-      r, version, user_version, return_code, op_returns));
+  if (projected_log.get_request(r, version, user_version, return_code,
+				op_returns) ||
+      recovery_state.get_pg_log().get_log().get_request(
+	r, version, user_version, return_code, op_returns)) {
+    return true;
+  }
+  if (resend && recovery_state.get_pg_log().get_dups_on_disk_only()) {
+    pg_log_dup_t dup;
+    if (recovery_state.get_pg_log().find_dup_on_disk(
+	  osd->store, ch, pgmeta_oid, r, &dup)) {
+      dout(10) << __func__ << " found " << dup << " on disk" << dendl;
+      *version = dup.version;
+      *user_version = dup.user_version;
+      *return_code = dup.return_code;
+      *op_returns = dup.op_returns;
+      return true;
+    }
+  }
+  return false;
 }
 
 void PG::publish_stats_to_osd()
@@ -1175,6 +1190,18 @@ void PG::update_snap_map(
   const vector<pg_log_entry_t> &log_entries,
   ObjectStore::Transaction &t)
 {
+  // entries which only drop mappings, like those of a batch of snap
+  // trims, have their removals gathered so adjacent keys go in ranges
+  SnapMapper::Batch batch;
+  SnapMapper::Batch *pbatch = nullptr;
+  if (log_entries.size() > 1 &&
+      std::none_of(log_entries.begin(), log_entries.end(),
+		   [](const pg_log_entry_t &e) {
+		     return e.soid.snap < CEPH_MAXSNAP &&
+		       (e.is_clone() || e.is_promote());
+		   })) {
+    pbatch = &batch;
+  }
   for (vector<pg_log_entry_t>::const_iterator i = log_entries.begin();
        i != log_entries.end();
        ++i) {
@@ -1183,7 +1210,8 @@ void PG::update_snap_map(
       if (i->is_delete()) {
 	int r = snap_mapper.remove_oid(
 	  i->soid,
-	  &_t);
+	  &_t,
+	  pbatch);
 	if (r != 0)
 	  derr << __func__ << " remove_oid " << i->soid << " failed with " << r << dendl;
         // On removal tolerate missing key corruption
@@ -1211,7 +1239,8 @@ void PG::update_snap_map(
 	    i->soid,
 	    _snaps,
 	    0,
-	    &_t);
+	    &_t,
+	    pbatch);
 	  ceph_assert(r == 0);
 	} else {
 	  ceph_assert(i->is_clean());
@@ -1219,6 +1248,10 @@ void PG::update_snap_map(
       }
     }
   }
+  if (!batch.to_remove.empty()) {
+    OSDriver::OSTransaction _t(osdriver.get_transaction(&t));
+    snap_mapper.remove_batched(&batch, &_t);
+  }
 }
 
 /**
@@ -2363,6 +2396,14 @@ int PG::build_scrub_map_chunk(
 }
 
 void PG::Scrubber::cleanup_store(ObjectStore::Transaction *t) {
+  if (!store)
+    return;
+  store->cleanup(t);
+  close_store(t);
+}
+
+// let go of the store but leave its object, for a later scrub to resume
+void PG::Scrubber::close_store(ObjectStore::Transaction *t) {
   if (!store)
     return;
   struct OnComplete : Context {
@@ -2372,7 +2413,6 @@ void PG::Scrubber::cleanup_store(ObjectStore::Transaction *t) {
       : store(std::move(store)) {}
     void finish(int) override {}
   };
-  store->cleanup(t);
   t->register_on_complete(new OnComplete(std::move(store)));
   ceph_assert(!store);
 }
@@ -2655,14 +2695,16 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 
 	{
 	  ObjectStore::Transaction t;
-	  scrubber.cleanup_store(&t);
-	  scrubber.store.reset(Scrub::Store::create(osd->store, &t,
-						    info.pgid, coll));
+	  if (!scrub_resume()) {
+	    scrubber.cleanup_store(&t);
+	    scrubber.store.reset(Scrub::Store::create(osd->store, &t,
+						      info.pgid, coll));
+	    // Don't include temporary objects when scrubbing
+	    scrubber.start = info.pgid.pgid.get_hobj_start();
+	  }
 	  osd->store->queue_transaction(ch, std::move(t), nullptr);
 	}
 
-        // Don't include temporary objects when scrubbing
-        scrubber.start = info.pgid.pgid.get_hobj_start();
         scrubber.state = PG::Scrubber::NEW_CHUNK;
 
 	{
@@ -2888,6 +2930,7 @@ void PG::chunky_scrub(ThreadPool::TPHandle &handle)
 
         scrub_compare_maps();
 	scrubber.start = scrubber.end;
+	scrub_save_progress();
 	scrubber.run_callbacks();
 
         // requeue the writes from the chunk that just finished
@@ -3141,6 +3184,84 @@ void PG::scrub_compare_maps()
   }
 }
 
+/*
+ * pick up the scrub where an interrupted one of the same kind left
+ * off, if nothing that could invalidate its results happened since.
+ */
+bool PG::scrub_resume()
+{
+  if (!cct->_conf.get_val<bool>("osd_scrub_resume") ||
+      state_test(PG_STATE_REPAIR)) {
+    return false;
+  }
+  if (!scrubber.store) {
+    scrubber.store.reset(Scrub::Store::open(osd->store, info.pgid, coll));
+    if (!scrubber.store) {
+      return false;
+    }
+  }
+  Scrub::progress_t progress;
+  if (!scrubber.store->get_progress(&progress)) {
+    return false;
+  }
+  if (progress.deep != state_test(PG_STATE_DEEP_SCRUB) ||
+      progress.last_scrub_stamp != info.history.last_scrub_stamp ||
+      progress.epoch <= info.history.last_epoch_split ||
+      progress.start < info.pgid.pgid.get_hobj_start()) {
+    dout(10) << __func__ << " not resuming from " << progress.start
+	     << " recorded at epoch " << progress.epoch << dendl;
+    return false;
+  }
+  dout(10) << __func__ << " resuming from " << progress.start
+	   << " recorded at epoch " << progress.epoch << dendl;
+  scrubber.start = progress.start;
+  scrubber.shallow_errors = progress.shallow_errors;
+  scrubber.deep_errors = progress.deep_errors;
+  scrubber.omap_stats.large_omap_objects = progress.large_omap_objects;
+  scrubber.omap_stats.omap_bytes = progress.omap_bytes;
+  scrubber.omap_stats.omap_keys = progress.omap_keys;
+  scrubber.resumed = true;
+  return true;
+}
+
+void PG::scrub_save_progress()
+{
+  // objects held back for the snap metadata scrub of the next chunk
+  // would be missed when resuming after them
+  if (scrubber.end.is_max() ||
+      state_test(PG_STATE_REPAIR) ||
+      !scrubber.cleaned_meta_map.objects.empty() ||
+      !cct->_conf.get_val<bool>("osd_scrub_resume")) {
+    return;
+  }
+  Scrub::progress_t progress;
+  progress.deep = state_test(PG_STATE_DEEP_SCRUB);
+  progress.start = scrubber.start;
+  progress.epoch = get_osdmap_epoch();
+  progress.last_scrub_stamp = info.history.last_scrub_stamp;
+  progress.shallow_errors = scrubber.shallow_errors;
+  progress.deep_errors = scrubber.deep_errors;
+  progress.large_omap_objects = scrubber.omap_stats.large_omap_objects;
+  progress.omap_bytes = scrubber.omap_stats.omap_bytes;
+  progress.omap_keys = scrubber.omap_stats.omap_keys;
+  ObjectStore::Transaction t;
+  scrubber.store->set_progress(&t, progress);
+  osd->store->queue_transaction(ch, std::move(t), nullptr);
+}
+
+/*
+ * drop the scrub results object, also when no scrub has it open, so
+ * that the progress of an interrupted scrub does not linger on disk
+ */
+void PG::scrub_remove_store(ObjectStore::Transaction *t)
+{
+  if (scrubber.store) {
+    scrubber.cleanup_store(t);
+  } else {
+    Scrub::Store::remove(t, info.pgid, coll);
+  }
+}
+
 bool PG::scrub_process_inconsistent()
 {
   dout(10) << __func__ << ": checking authoritative" << dendl;
@@ -3260,6 +3381,10 @@ void PG::scrub_finish()
   {
     // finish up
     ObjectStore::Transaction t;
+    if (scrubber.store) {
+      // nothing left to resume
+      scrubber.store->clear_progress(&t);
+    }
     recovery_state.update_stats(
       [this, deep_scrub](auto &history, auto &stats) {
 	utime_t now = ceph_clock_now();
@@ -1198,6 +1198,8 @@ public:
     } state;
 
     std::unique_ptr<Scrub::Store> store;
+    // picked up from where an interrupted scrub stopped
+    bool resumed = false;
     // deep scrub
     bool deep;
     int preempt_left;
@@ -1265,6 +1267,7 @@ public:
       deep_errors = 0;
       fixed = 0;
       omap_stats = (const struct omap_stat_t){ 0 };
+      resumed = false;
       deep = false;
       run_callbacks();
       inconsistent.clear();
@@ -1283,6 +1286,7 @@ public:
 
     void create_results(const hobject_t& obj);
     void cleanup_store(ObjectStore::Transaction *t);
+    void close_store(ObjectStore::Transaction *t);
   } scrubber;
 
 protected:
@@ -1308,6 +1312,9 @@ protected:
 
   void chunky_scrub(ThreadPool::TPHandle &handle);
   void scrub_compare_maps();
+  bool scrub_resume();
+  void scrub_save_progress();
+  void scrub_remove_store(ObjectStore::Transaction *t);
   /**
    * return true if any inconsistency/missing is repaired, false otherwise
    */
@@ -1442,7 +1449,8 @@ protected:
     eversion_t *version,
     version_t *user_version,
     int *return_code,
-    vector<pg_log_op_return_item_t> *op_returns) const;
+    vector<pg_log_op_return_item_t> *op_returns,
+    bool resend = false) const;
   eversion_t projected_last_update;
   eversion_t get_next_version() const {
     eversion_t at_version(
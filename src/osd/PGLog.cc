@@ -169,6 +169,10 @@ void PGLog::clear() {
   missing.clear();
   log.clear();
   log_keys_debug.clear();
+  dup_epochs.clear();
+  dups_on_disk.clear();
+  // commits of earlier writes must not drop dups added from now on
+  dups_committed_to = std::make_shared<std::atomic<version_t>>(0);
   undirty();
 }
 
@@ -197,6 +201,28 @@ void PGLog::trim(
     dout(10) << "trim " << log << " to " << trim_to << dendl;
     log.trim(cct, trim_to, &trimmed, &trimmed_dups, &write_from_dups);
     info.log_tail = log.tail;
+    if (dups_on_disk_only &&
+	log.head.version > cct->_conf->osd_pg_log_dups_tracked) {
+      // same window as IndexedLog::trim() keeps in memory
+      version_t earliest_dup_version =
+	log.head.version - cct->_conf->osd_pg_log_dups_tracked + 1;
+      auto p = dup_epochs.upper_bound(earliest_dup_version);
+      if (p != dup_epochs.begin()) {
+	--p;
+	// dup keys sort by (epoch, version); every dup older than
+	// earliest_dup_version sorts before this one, and no newer one does
+	eversion_t to(p->second, earliest_dup_version);
+	if (to > dups_trim_to) {
+	  dout(10) << __func__ << " trimming dups on disk to " << to << dendl;
+	  dups_trim_to = to;
+	}
+	dup_epochs.erase(dup_epochs.begin(), p);
+      }
+      while (!dups_on_disk.empty() &&
+	     dups_on_disk.front().version < earliest_dup_version) {
+	dups_on_disk.pop_front();
+      }
+    }
     if (log.complete_to != log.log.end())
       dout(10) << " after trim complete_to " << log.complete_to->version << dendl;
   }
@@ -621,6 +647,9 @@ void PGLog::write_log_and_missing(
   const ghobject_t &log_oid,
   bool require_rollback)
 {
+  if (dups_on_disk_only) {
+    drop_dups_on_disk(*dups_committed_to);
+  }
   if (needs_write()) {
     dout(6) << "write_log_and_missing with: "
 	     << "dirty_to: " << dirty_to
@@ -630,6 +659,21 @@ void PGLog::write_log_and_missing(
 	     << ", trimmed_dups: " << trimmed_dups
 	     << ", clear_divergent_priors: " << clear_divergent_priors
 	     << dendl;
+    if (dups_on_disk_only) {
+      // most dups are not in memory, so never rewrite them wholesale:
+      // write out whatever we hold if any dups are dirty, and only drop
+      // on-disk dups that were trimmed or overlap the log
+      if (dirty_to_dups != eversion_t() ||
+	  dirty_from_dups != eversion_t::max()) {
+	write_from_dups = eversion_t();
+      }
+      if (dirty_from_dups != eversion_t::max()) {
+	dirty_from_dups = std::max(
+	  dirty_from_dups,
+	  eversion_t(log.tail.epoch, log.tail.version + 1));
+      }
+      dirty_to_dups = dups_trim_to;
+    }
     _write_log_and_missing(
       t, km, log, coll, log_oid,
       dirty_to,
@@ -647,11 +691,74 @@ void PGLog::write_log_and_missing(
       &may_include_deletes_in_missing_dirty,
       (pg_log_debug ? &log_keys_debug : nullptr));
     undirty();
+    if (dups_on_disk_only && !log.dups.empty()) {
+      // the store may not return the dups before they are committed, so
+      // keep them in memory until then
+      t.register_on_commit(make_lambda_context(
+	[committed_to = dups_committed_to,
+	 v = log.dups.back().version.version](int) {
+	  auto cur = committed_to->load();
+	  while (cur < v && !committed_to->compare_exchange_weak(cur, v));
+	}));
+    }
   } else {
     dout(10) << "log is not dirty" << dendl;
   }
 }
 
+void PGLog::drop_dups_on_disk(version_t to)
+{
+  size_t n = 0;
+  while (!log.dups.empty() && log.dups.front().version.version <= to) {
+    const auto& d = log.dups.front();
+    note_dup_on_disk(d);
+    log.unindex(d);
+    log.dups.pop_front();
+    ++n;
+  }
+  if (n) {
+    dout(20) << __func__ << " dropped " << n << " dups up to " << to
+	     << ", " << log.dups.size() << " left in memory" << dendl;
+  }
+}
+
+bool PGLog::find_dup_on_disk(
+  ObjectStore *store,
+  ObjectStore::CollectionHandle ch,
+  const ghobject_t &pgmeta_oid,
+  const osd_reqid_t &r,
+  pg_log_dup_t *dup) const
+{
+  // read the keys of the dups whose reqid hash matches, newest first,
+  // until one of them is for r
+  auto hash = std::hash<osd_reqid_t>()(r);
+  for (auto i = dups_on_disk.rbegin(); i != dups_on_disk.rend(); ++i) {
+    if (i->hash != hash) {
+      continue;
+    }
+    auto p = dup_epochs.upper_bound(i->version);
+    ceph_assert(p != dup_epochs.begin());
+    pg_log_dup_t key;
+    key.version = eversion_t(std::prev(p)->second, i->version);
+    set<string> keys{key.get_key_name()};
+    map<string, bufferlist> values;
+    int r2 = store->omap_get_values(ch, pgmeta_oid, keys, &values);
+    if (r2 < 0 || values.empty()) {
+      derr << __func__ << " dup " << key.version << " not found on disk, r = "
+	   << r2 << dendl;
+      continue;
+    }
+    auto bp = values.begin()->second.cbegin();
+    pg_log_dup_t d;
+    decode(d, bp);
+    if (d.reqid == r) {
+      *dup = std::move(d);
+      return true;
+    }
+  }
+  return false;
+}
+
 // static
 void PGLog::write_log_and_missing_wo_missing(
     ObjectStore::Transaction& t,
@@ -20,6 +20,9 @@
 #include "include/ceph_assert.h"
 #include "osd_types.h"
 #include "os/ObjectStore.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <list>
 
 #ifdef WITH_SEASTAR
@@ -68,6 +71,137 @@ struct PGLog : DoutPrefixProvider {
   using LogEntryHandlerRef = unique_ptr<LogEntryHandler>;
 
 public:
+  /**
+   * DupIndex - dups by reqid.
+   *
+   * There are up to osd_pg_log_dups_tracked dups per PG, so rather than
+   * a hash table node per dup this is a sorted array of (reqid hash,
+   * dup) pairs searched with a binary search.  New dups go to a short
+   * unsorted tail which is merged in once it grows to the square root
+   * of the sorted part; removed dups are cleared in place and dropped
+   * on the next merge.
+   */
+  class DupIndex {
+    struct entry_t {
+      uint64_t hash;
+      pg_log_dup_t *dup;  ///< nullptr once removed
+      bool operator<(const entry_t &rhs) const {
+	return hash < rhs.hash;
+      }
+    };
+    mempool::osd_pglog::vector<entry_t> sorted;
+    mempool::osd_pglog::vector<entry_t> recent;
+    size_t num_removed = 0;
+
+    static uint64_t hash_of(const osd_reqid_t &r) {
+      return std::hash<osd_reqid_t>()(r);
+    }
+
+    void merge() {
+      sorted.erase(
+	std::remove_if(sorted.begin(), sorted.end(),
+		       [](const entry_t &e) { return !e.dup; }),
+	sorted.end());
+      auto n = sorted.size();
+      for (auto& e : recent) {
+	if (e.dup) {
+	  sorted.push_back(e);
+	}
+      }
+      recent.clear();
+      num_removed = 0;
+      // stable, so that the newest dup of a reqid comes last
+      std::stable_sort(sorted.begin() + n, sorted.end());
+      std::inplace_merge(sorted.begin(), sorted.begin() + n, sorted.end());
+    }
+
+  public:
+    size_t size() const {
+      return sorted.size() + recent.size() - num_removed;
+    }
+
+    void clear() {
+      sorted.clear();
+      sorted.shrink_to_fit();
+      recent.clear();
+      num_removed = 0;
+    }
+
+    template <typename Container>
+    void rebuild(Container &dups) {
+      clear();
+      sorted.reserve(dups.size());
+      for (auto& d : dups) {
+	sorted.push_back(entry_t{hash_of(d.reqid), &d});
+      }
+      std::stable_sort(sorted.begin(), sorted.end());
+    }
+
+    void insert(pg_log_dup_t *dup) {
+      recent.push_back(entry_t{hash_of(dup->reqid), dup});
+      if (recent.size() > 16 && recent.size() * recent.size() > sorted.size()) {
+	merge();
+      }
+    }
+
+    void erase(const pg_log_dup_t &dup) {
+      auto clear = [&](entry_t &e) {
+	if (e.dup == &dup) {
+	  e.dup = nullptr;
+	  ++num_removed;
+	  return true;
+	}
+	return false;
+      };
+      bool found = false;
+      for (auto& e : recent) {
+	if ((found = clear(e))) {
+	  break;
+	}
+      }
+      if (!found) {
+	auto range = std::equal_range(sorted.begin(), sorted.end(),
+				      entry_t{hash_of(dup.reqid), nullptr});
+	for (auto i = range.first; i != range.second; ++i) {
+	  if (clear(*i)) {
+	    break;
+	  }
+	}
+      }
+      if (num_removed > 16 && num_removed * 2 > sorted.size()) {
+	merge();
+      }
+    }
+
+    /// the most recently indexed dup for reqid r, if any
+    const pg_log_dup_t *find(const osd_reqid_t &r) const {
+      auto hash = hash_of(r);
+      for (auto i = recent.rbegin(); i != recent.rend(); ++i) {
+	if (i->hash == hash && i->dup && i->dup->reqid == r) {
+	  return i->dup;
+	}
+      }
+      auto range = std::equal_range(sorted.begin(), sorted.end(),
+				    entry_t{hash, nullptr});
+      for (auto i = range.second; i != range.first; --i) {
+	auto& e = *(i - 1);
+	if (e.dup && e.dup->reqid == r) {
+	  return e.dup;
+	}
+      }
+      return nullptr;
+    }
+
+    size_t count(const osd_reqid_t &r) const {
+      return find(r) ? 1 : 0;
+    }
+
+    /// bytes held by the index itself
+    size_t get_bytes() const {
+      return (sorted.capacity() + recent.capacity()) * sizeof(entry_t);
+    }
+  };
+
   /**
    * IndexLog - adds in-memory index of the log, by oid.
    * plus some methods to manipulate it all.
@@ -76,7 +210,7 @@ public:
     mutable ceph::unordered_map<hobject_t,pg_log_entry_t*> objects;  // ptrs into log.  be careful!
     mutable ceph::unordered_map<osd_reqid_t,pg_log_entry_t*> caller_ops;
     mutable ceph::unordered_multimap<osd_reqid_t,pg_log_entry_t*> extra_caller_ops;
-    mutable ceph::unordered_map<osd_reqid_t,pg_log_dup_t*> dup_index;
+    mutable DupIndex dup_index;
 
     // recovery pointers
     list<pg_log_entry_t>::iterator complete_to; // not inclusive of referenced item
@@ -317,12 +451,11 @@ public:
       if (!(indexed_data & PGLOG_INDEXED_DUPS)) {
         index_dups();
       }
-      auto q = dup_index.find(r);
-      if (q != dup_index.end()) {
-	*version = q->second->version;
-	*user_version = q->second->user_version;
-	*return_code = q->second->return_code;
-	*op_returns = q->second->op_returns;
+      if (auto dup = dup_index.find(r); dup) {
+	*version = dup->version;
+	*user_version = dup->user_version;
+	*return_code = dup->return_code;
+	*op_returns = dup->op_returns;
 	return true;
       }
 
@@ -377,10 +510,7 @@ public:
       if (to_index & PGLOG_INDEXED_EXTRA_CALLER_OPS)
 	extra_caller_ops.clear();
       if (to_index & PGLOG_INDEXED_DUPS) {
-	dup_index.clear();
-	for (auto& i : dups) {
-	  dup_index[i.reqid] = const_cast<pg_log_dup_t*>(&i);
-	}
+	dup_index.rebuild(const_cast<IndexedLog*>(this)->dups);
       }
 
       constexpr __u16 any_log_entry_index =
@@ -497,16 +627,13 @@ public:
 
     void index(pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	dup_index[e.reqid] = &e;
+	dup_index.insert(&e);
       }
     }
 
     void unindex(const pg_log_dup_t& e) {
       if (indexed_data & PGLOG_INDEXED_DUPS) {
-	auto i = dup_index.find(e.reqid);
-	if (i != dup_index.end()) {
-	  dup_index.erase(i);
-	}
+	dup_index.erase(e);
       }
     }
 
@@ -586,6 +713,33 @@ protected:
   bool clear_divergent_priors;
   bool may_include_deletes_in_missing_dirty = false;
 
+  /// osd_pg_log_dups_on_disk_only: dups are dropped from memory once
+  /// committed and only looked up in omap for resent ops
+  bool dups_on_disk_only;
+  /// epoch of the on-disk dups, by the first version seen in that epoch
+  std::map<version_t, epoch_t> dup_epochs;
+  /// reqid hash and version of the on-disk dups, in version order
+  struct dup_on_disk_t {
+    uint64_t hash;
+    version_t version;
+  };
+  std::deque<dup_on_disk_t,
+	     mempool::osd_pglog::pool_allocator<dup_on_disk_t>> dups_on_disk;
+  eversion_t dups_trim_to;     ///< must clear dups < dups_trim_to
+  /// in-memory dups up to this version are committed; set by the
+  /// on_commit callback of the transaction that wrote them
+  std::shared_ptr<std::atomic<version_t>> dups_committed_to;
+
+  void note_dup_on_disk(const pg_log_dup_t &d) {
+    auto p = dup_epochs.upper_bound(d.version.version);
+    if (p == dup_epochs.begin() || std::prev(p)->second != d.version.epoch) {
+      dup_epochs.emplace_hint(p, d.version.version, d.version.epoch);
+    }
+    dups_on_disk.push_back(
+      dup_on_disk_t{std::hash<osd_reqid_t>()(d.reqid), d.version.version});
+  }
+  void drop_dups_on_disk(version_t to);
+
   void mark_dirty_to(eversion_t to) {
     if (to > dirty_to)
       dirty_to = to;
@@ -622,6 +776,7 @@ public:
       (dirty_to_dups != eversion_t()) ||
       (dirty_from_dups != eversion_t::max()) ||
       (write_from_dups != eversion_t::max()) ||
+      (dups_trim_to != eversion_t()) ||
       may_include_deletes_in_missing_dirty;
   }
 
@@ -635,6 +790,9 @@ public:
   bool get_may_include_deletes_in_missing_dirty() const {
     return may_include_deletes_in_missing_dirty;
   }
+  bool get_dups_on_disk_only() const {
+    return dups_on_disk_only;
+  }
 protected:
 
   /// DEBUG
@@ -668,6 +826,7 @@ protected:
     dirty_to_dups = eversion_t();
     dirty_from_dups = eversion_t::max();
     write_from_dups = eversion_t::max();
+    dups_trim_to = eversion_t();
   }
 public:
 
@@ -681,7 +840,9 @@ public:
     pg_log_debug(!(cct && !(cct->_conf->osd_debug_pg_log_writeout))),
     touched_log(false),
     dirty_log(false),
-    clear_divergent_priors(false)
+    clear_divergent_priors(false),
+    dups_on_disk_only(cct && cct->_conf->osd_pg_log_dups_on_disk_only),
+    dups_committed_to(std::make_shared<std::atomic<version_t>>(0))
   { }
 
   void reset_backfill();
@@ -1317,6 +1478,14 @@ public:
     set<string> *log_keys_debug
     );
 
+  /// look up the most recent dup for r in the pg's omap
+  bool find_dup_on_disk(
+    ObjectStore *store,
+    ObjectStore::CollectionHandle ch,
+    const ghobject_t &pgmeta_oid,
+    const osd_reqid_t &r,
+    pg_log_dup_t *dup) const;
+
   void read_log_and_missing(
     ObjectStore *store,
     ObjectStore::CollectionHandle& ch,
@@ -1326,7 +1495,7 @@ public:
     bool tolerate_divergent_missing_log,
     bool debug_verify_stored_missing = false
     ) {
-    return read_log_and_missing(
+    read_log_and_missing(
       store, ch, pgmeta_oid, info,
       log, missing, oss,
       tolerate_divergent_missing_log,
@@ -1334,6 +1503,9 @@ public:
       this,
       (pg_log_debug ? &log_keys_debug : nullptr),
       debug_verify_stored_missing);
+    if (dups_on_disk_only) {
+      drop_dups_on_disk(std::numeric_limits<version_t>::max());
+    }
   }
 
   template <typename missing_type>
@@ -2062,7 +2062,8 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
     int return_code = 0;
     vector<pg_log_op_return_item_t> op_returns;
     bool got = check_in_progress_op(
-      m->get_reqid(), &version, &user_version, &return_code, &op_returns);
+      m->get_reqid(), &version, &user_version, &return_code, &op_returns,
+      m->is_retry_attempt());
     if (got) {
       dout(3) << __func__ << " dup " << m->get_reqid()
 	      << " version " << version << dendl;
@@ -4291,8 +4292,6 @@ int PrimaryLogPG::trim_object(
   bool first, const hobject_t &coid, snapid_t snap_to_trim,
   PrimaryLogPG::OpContextUPtr *ctxp)
 {
-  *ctxp = NULL;
-
   // load clone info
   bufferlist bl;
   ObjectContextRef obc = get_object_context(coid, false, NULL);
@@ -4353,28 +4352,51 @@ int PrimaryLogPG::trim_object(
     }
   }
 
-  OpContextUPtr ctx = simple_opc_create(obc);
-  ctx->head_obc = head_obc;
+  // the objects of a batch all go into the context of its first one
+  OpContextUPtr new_ctx;
+  OpContext *ctx = ctxp->get();
+  if (!ctx) {
+    new_ctx = simple_opc_create(obc);
+    new_ctx->head_obc = head_obc;
+    ctx = new_ctx.get();
+  }
 
   if (!ctx->lock_manager.get_snaptrimmer_write(
 	coid,
 	obc,
 	first)) {
-    close_op_ctx(ctx.release());
+    if (new_ctx)
+      close_op_ctx(new_ctx.release());
     dout(10) << __func__ << ": Unable to get a wlock on " << coid << dendl;
     return -ENOLCK;
   }
 
-  if (!ctx->lock_manager.get_snaptrimmer_write(
+  if (!ctx->lock_manager.is_locked(head_oid) &&
+      !ctx->lock_manager.get_snaptrimmer_write(
 	head_oid,
 	head_obc,
 	first)) {
-    close_op_ctx(ctx.release());
+    if (new_ctx) {
+      close_op_ctx(new_ctx.release());
+    } else {
+      // the rest of the batch keeps its locks until the repop completes,
+      // this clone is not part of it
+      ObcLockManager clone_lock;
+      ctx->lock_manager.move_lock(coid, clone_lock);
+      release_object_locks(clone_lock);
+    }
     dout(10) << __func__ << ": Unable to get a wlock on " << head_oid << dendl;
     return -ENOLCK;
   }
 
-  ctx->at_version = get_next_version();
+  if (new_ctx) {
+    ctx->at_version = get_next_version();
+  } else {
+    // follow the log entries already in the batch
+    ctx->at_version.version++;
+    ctx->op_t->add_obc(obc);
+    ctx->op_t->add_obc(head_obc);
+  }
 
   PGTransaction *t = ctx->op_t.get();
  
@@ -4431,7 +4453,7 @@ int PrimaryLogPG::trim_object(
 	pg_log_entry_t::DELETE,
 	coid,
 	ctx->at_version,
-	ctx->obs->oi.version,
+	coi.version,
 	0,
 	osd_reqid_t(),
 	ctx->mtime,
@@ -4561,7 +4583,8 @@ int PrimaryLogPG::trim_object(
     t->setattrs(head_oid, attrs);
   }
 
-  *ctxp = std::move(ctx);
+  if (new_ctx)
+    *ctxp = std::move(new_ctx);
   return 0;
 }
 
@@ -5432,6 +5455,111 @@ int PrimaryLogPG::finish_extent_cmp(OSDOp& osd_op, const bufferlist &read_bl)
   return 0;
 }
 
+void PrimaryLogPG::batch_reads(OpContext *ctx, vector<OSDOp>& ops)
+{
+  auto& oi = ctx->new_obs.oi;
+  auto& soid = oi.soid;
+  const int first = ctx->current_osd_subop_num;
+  const uint32_t flags = ops[first].op.flags;
+
+  ctx->batched_reads.clear();
+  ctx->batched_sparse_extents.clear();
+  ctx->batched_reads_end = first + 1;
+  auto is_batchable = [flags](const ceph_osd_op& op) {
+    return op.flags == flags &&
+      (op.op == CEPH_OSD_OP_READ || op.op == CEPH_OSD_OP_SYNC_READ ||
+       (op.op == CEPH_OSD_OP_SPARSE_READ && !op.extent.truncate_seq));
+  };
+  if (!osd->osd_coalesce_reads ||
+      first + 1 == (int)ops.size() ||
+      !is_batchable(ops[first].op) ||
+      !is_batchable(ops[first + 1].op)) {
+    return;
+  }
+
+  // collect the extents of the run of reads starting here
+  interval_set<uint64_t> want;
+  unsigned num_extents = 0;
+  auto p = ops.begin() + first;
+  for (; p != ops.end() && is_batchable(p->op); ++p) {
+    auto& op = p->op;
+    if (op.op == CEPH_OSD_OP_SPARSE_READ) {
+      map<uint64_t, uint64_t> m;
+      int r = osd->store->fiemap(ch, ghobject_t(soid, ghobject_t::NO_GEN,
+						info.pgid.shard),
+				 op.extent.offset, op.extent.length, m);
+      if (r < 0) {
+	break;
+      }
+      for (auto& [off, len] : m) {
+	want.union_insert(off, len);
+	++num_extents;
+      }
+      ctx->batched_sparse_extents[p - ops.begin()] = std::move(m);
+      continue;
+    }
+    // trimmed to the object size the same way do_read() does
+    uint64_t size = oi.size;
+    if (oi.truncate_seq < op.extent.truncate_seq &&
+	op.extent.offset + op.extent.length > op.extent.truncate_size &&
+	size > op.extent.truncate_size) {
+      size = op.extent.truncate_size;
+    }
+    if (op.extent.offset >= size) {
+      continue;
+    }
+    uint64_t len = op.extent.length ? op.extent.length : size;
+    len = std::min<uint64_t>(len, size - op.extent.offset);
+    if (len) {
+      want.union_insert(op.extent.offset, len);
+      ++num_extents;
+    }
+  }
+  ctx->batched_reads_end = p - ops.begin();
+  if (ctx->batched_reads_end - first < 2 || want.empty()) {
+    return;
+  }
+
+  map<uint64_t, uint64_t> m;
+  want.move_into(m);
+  bufferlist bl;
+  int r = pgbackend->objects_readv_sync(soid, m, flags, &bl);
+  if (r < 0) {
+    // let each op read (and repair) on its own
+    dout(10) << __func__ << " readv of " << m << " got " << r << dendl;
+    ctx->batched_reads.clear();
+    return;
+  }
+  uint64_t pos = 0;
+  for (auto& [off, len] : m) {
+    if (pos + len > bl.length()) {
+      break;
+    }
+    ctx->batched_reads[off].substr_of(bl, pos, len);
+    pos += len;
+  }
+  dout(20) << __func__ << " subops [" << first << "," << ctx->batched_reads_end
+	   << ") " << num_extents << " extents -> " << m << dendl;
+  osd->logger->inc(l_osd_op_r_coalesced_extents, num_extents - m.size());
+}
+
+bool PrimaryLogPG::get_batched_read(OpContext *ctx, uint64_t off,
+				    uint64_t len, bufferlist *bl)
+{
+  auto p = ctx->batched_reads.upper_bound(off);
+  if (p == ctx->batched_reads.begin()) {
+    return false;
+  }
+  --p;
+  if (off + len > p->first + p->second.length()) {
+    return false;
+  }
+  bufferlist t;
+  t.substr_of(p->second, off - p->first, len);
+  bl->claim_append(t);
+  return true;
+}
+
 int PrimaryLogPG::do_read(OpContext *ctx, OSDOp& osd_op) {
   dout(20) << __func__ << dendl;
   auto& op = osd_op.op;
@@ -5493,8 +5621,15 @@ int PrimaryLogPG::do_read(OpContext *ctx, OSDOp& osd_op) {
     ctx->op_finishers[ctx->current_osd_subop_num].reset(
       new ReadFinisher(osd_op));
   } else {
-    int r = pgbackend->objects_read_sync(
-      soid, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata);
+    int r;
+    if (get_batched_read(ctx, op.extent.offset, op.extent.length,
+			 &osd_op.outdata)) {
+      osd->logger->inc(l_osd_op_r_coalesced);
+      r = op.extent.length;
+    } else {
+      r = pgbackend->objects_read_sync(
+	soid, op.extent.offset, op.extent.length, op.flags, &osd_op.outdata);
+    }
     // whole object?  can we verify the checksum?
     if (r >= 0 && op.extent.offset == 0 &&
         (uint64_t)r == oi.size && oi.is_data_digest()) {
@@ -5571,15 +5706,33 @@ int PrimaryLogPG::do_sparse_read(OpContext *ctx, OSDOp& osd_op) {
     // read into a buffer
     map<uint64_t, uint64_t> m;
     uint32_t total_read = 0;
-    int r = osd->store->fiemap(ch, ghobject_t(soid, ghobject_t::NO_GEN,
-					      info.pgid.shard),
-			       op.extent.offset, op.extent.length, m);
-    if (r < 0)  {
-      return r;
+    int r;
+    auto batched = ctx->batched_sparse_extents.find(
+      ctx->current_osd_subop_num);
+    if (batched != ctx->batched_sparse_extents.end()) {
+      m.swap(batched->second);
+      ctx->batched_sparse_extents.erase(batched);
+    } else {
+      r = osd->store->fiemap(ch, ghobject_t(soid, ghobject_t::NO_GEN,
+					    info.pgid.shard),
+			     op.extent.offset, op.extent.length, m);
+      if (r < 0)  {
+	return r;
+      }
     }
 
     bufferlist data_bl;
-    r = pgbackend->objects_readv_sync(soid, m, op.flags, &data_bl);
+    bool all_batched = !ctx->batched_reads.empty();
+    for (auto i = m.begin(); all_batched && i != m.end(); ++i) {
+      all_batched = get_batched_read(ctx, i->first, i->second, &data_bl);
+    }
+    if (all_batched) {
+      osd->logger->inc(l_osd_op_r_coalesced);
+      r = data_bl.length();
+    } else {
+      data_bl.clear();
+      r = pgbackend->objects_readv_sync(soid, m, op.flags, &data_bl);
+    }
     if (r == -EIO) {
       r = rep_repair_primary_object(soid, ctx);
     }
@@ -5734,6 +5887,10 @@ int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 	if (!ctx->data_off) {
 	  ctx->data_off = op.extent.offset;
 	}
+	if (!pool.info.is_erasure() &&
+	    ctx->current_osd_subop_num >= ctx->batched_reads_end) {
+	  batch_reads(ctx, ops);
+	}
 	result = do_read(ctx, osd_op);
       } else {
 	result = op_finisher->execute();
@@ -5787,6 +5944,10 @@ int PrimaryLogPG::do_osd_ops(OpContext *ctx, vector<OSDOp>& ops)
 		 op.extent.length, op.extent.truncate_size,
 		 op.extent.truncate_seq);
       if (op_finisher == nullptr) {
+	if (!pool.info.is_erasure() &&
+	    ctx->current_osd_subop_num >= ctx->batched_reads_end) {
+	  batch_reads(ctx, ops);
+	}
 	result = do_sparse_read(ctx, osd_op);
       } else {
 	result = op_finisher->execute();
@@ -12003,6 +12164,7 @@ void PrimaryLogPG::on_removal(ObjectStore::Transaction &t)
   dout(10) << __func__ << dendl;
 
   on_shutdown();
+  scrub_remove_store(&t);
 
   t.register_on_commit(new C_DeleteMore(this, get_osdmap_epoch()));
 }
@@ -12229,7 +12391,11 @@ void PrimaryLogPG::on_change(ObjectStore::Transaction &t)
   context_registry_on_change();
 
   pgbackend->on_change_cleanup(&t);
-  scrubber.cleanup_store(&t);
+  // only the same primary resumes a scrub
+  if (cct->_conf.get_val<bool>("osd_scrub_resume") && is_primary())
+    scrubber.close_store(&t);
+  else
+    scrub_remove_store(&t);
   pgbackend->on_change();
 
   // clear snap_trimmer state
@@ -15034,6 +15200,12 @@ void PrimaryLogPG::_scrub_finish()
   bool deep_scrub = state_test(PG_STATE_DEEP_SCRUB);
   const char *mode = (repair ? "repair": (deep_scrub ? "deep-scrub" : "scrub"));
 
+  if (scrubber.resumed) {
+    // objects scrubbed before the interruption were not counted
+    dout(10) << mode << " was resumed, not checking stats" << dendl;
+    return;
+  }
+
   if (info.stats.stats_invalid) {
     recovery_state.update_stats(
       [=](auto &history, auto &stats) {
@@ -15266,8 +15438,11 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
   ldout(pg->cct, 10) << "AwaitAsyncWork: trimming snap " << snap_to_trim << dendl;
 
   vector<hobject_t> to_trim;
-  unsigned max = pg->cct->_conf->osd_pg_max_concurrent_snap_trims;
+  unsigned batch_size = std::max<uint64_t>(
+    pg->cct->_conf.get_val<uint64_t>("osd_snap_trim_batch_size"), 1);
+  unsigned max = pg->cct->_conf->osd_pg_max_concurrent_snap_trims * batch_size;
   to_trim.reserve(max);
+  context<Trimming>().last_trimmed = 0;
   int r = pg->snap_mapper.get_next_objects_to_trim(
     snap_to_trim,
     max,
@@ -15310,11 +15485,37 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
   }
   ceph_assert(!to_trim.empty());
 
+  // up to batch_size objects are trimmed by each repop
+  OpContextUPtr ctx;
+  vector<hobject_t> batch;
+  auto submit = [&]() {
+    for (auto &object : batch) {
+      in_flight.insert(object);
+    }
+    context<Trimming>().last_trimmed += batch.size();
+    ctx->register_on_success(
+      [pg, batch, &in_flight]() {
+	for (auto &object : batch) {
+	  ceph_assert(in_flight.find(object) != in_flight.end());
+	  in_flight.erase(object);
+	}
+	if (in_flight.empty()) {
+	  if (pg->state_test(PG_STATE_SNAPTRIM_ERROR)) {
+	    pg->snap_trimmer_machine.process_event(Reset());
+	  } else {
+	    pg->snap_trimmer_machine.process_event(RepopsComplete());
+	  }
+	}
+      });
+    pg->simple_opc_submit(std::move(ctx));
+    batch.clear();
+  };
+
   for (auto &&object: to_trim) {
     // Get next
     ldout(pg->cct, 10) << "AwaitAsyncWork react trimming " << object << dendl;
-    OpContextUPtr ctx;
-    int error = pg->trim_object(in_flight.empty(), object, snap_to_trim, &ctx);
+    int error = pg->trim_object(in_flight.empty() && !ctx, object,
+				snap_to_trim, &ctx);
     if (error) {
       if (error == -ENOLCK) {
 	ldout(pg->cct, 10) << "could not get write lock on obj "
@@ -15323,6 +15524,9 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
 	pg->state_set(PG_STATE_SNAPTRIM_ERROR);
 	ldout(pg->cct, 10) << "Snaptrim error=" << error << dendl;
       }
+      if (ctx) {
+	submit();
+      }
       if (!in_flight.empty()) {
 	ldout(pg->cct, 10) << "letting the ones we already started finish" << dendl;
 	return transit< WaitRepops >();
@@ -15336,21 +15540,13 @@ boost::statechart::result PrimaryLogPG::AwaitAsyncWork::react(const DoSnapWork&)
       }
     }
 
-    in_flight.insert(object);
-    ctx->register_on_success(
-      [pg, object, &in_flight]() {
-	ceph_assert(in_flight.find(object) != in_flight.end());
-	in_flight.erase(object);
-	if (in_flight.empty()) {
-	  if (pg->state_test(PG_STATE_SNAPTRIM_ERROR)) {
-	    pg->snap_trimmer_machine.process_event(Reset());
-	  } else {
-	    pg->snap_trimmer_machine.process_event(RepopsComplete());
-	  }
-	}
-      });
-
-    pg->simple_opc_submit(std::move(ctx));
+    batch.push_back(object);
+    if (batch.size() >= batch_size) {
+      submit();
+    }
+  }
+  if (ctx) {
+    submit();
   }
 
   return transit< WaitRepops >();
@@ -670,6 +670,12 @@ public:
 
     bool sent_reply = false;
 
+    // data of a run of reads in the op vector, read with a single
+    // readv: <offset> -> data of the merged extent
+    map<uint64_t, bufferlist> batched_reads;
+    map<int, map<uint64_t, uint64_t>> batched_sparse_extents; ///< fiemap by subop
+    int batched_reads_end = 0;  ///< first subop after that run
+
     // pending async reads <off, len, op_flags> -> <outbl, outr>
     list<pair<boost::tuple<uint64_t, uint64_t, unsigned>,
 	      pair<bufferlist*, Context*> > > pending_async_reads;
@@ -1432,6 +1438,9 @@ protected:
 
   friend class C_ExtentCmpRead;
 
+  void batch_reads(OpContext *ctx, vector<OSDOp>& ops);
+  bool get_batched_read(OpContext *ctx, uint64_t off, uint64_t len,
+			bufferlist *bl);
   int do_read(OpContext *ctx, OSDOp& osd_op);
   int do_sparse_read(OpContext *ctx, OSDOp& osd_op);
   int do_writesame(OpContext *ctx, OSDOp& osd_op);
@@ -1525,6 +1534,7 @@ public:
 
   void handle_backoff(OpRequestRef& op);
 
+  /// trim coid into *ctxp, a new context unless one is passed in
   int trim_object(bool first, const hobject_t &coid, snapid_t snap_to_trim,
 		  OpContextUPtr *ctxp);
   void snap_trimmer(epoch_t e) override;
@@ -1645,6 +1655,7 @@ private:
 
     set<hobject_t> in_flight;
     snapid_t snap_to_trim;
+    unsigned last_trimmed = 0;  ///< objects in the last round of repops
 
     explicit Trimming(my_context ctx)
       : my_base(ctx),
@@ -1689,6 +1700,14 @@ private:
       };
       auto *pg = context< SnapTrimmer >().pg;
       float osd_snap_trim_sleep = pg->osd->osd->get_osd_snap_trim_sleep();
+      double objects_per_sec = pg->cct->_conf.get_val<double>(
+	"osd_snap_trim_objects_per_sec");
+      if (objects_per_sec > 0) {
+	// keep the pg within its budget of trimmed objects
+	osd_snap_trim_sleep = std::max<float>(
+	  osd_snap_trim_sleep,
+	  context<Trimming>().last_trimmed / objects_per_sec);
+      }
       if (osd_snap_trim_sleep > 0) {
 	std::lock_guard l(pg->osd->sleep_lock);
 	wakeup = pg->osd->sleep_timer.add_event_after(
@@ -635,23 +635,33 @@ int ReplicatedBackend::be_deep_scrub(
       pos.data_hash = bufferhash(-1);
     }
 
-    bufferlist bl;
-    r = store->read(
-      ch,
-      ghobject_t(
-	poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard),
-      pos.data_pos,
-      cct->_conf->osd_deep_scrub_stride, bl,
-      fadvise_flags);
+    ghobject_t ghoid(
+      poid, ghobject_t::NO_GEN, get_parent()->whoami_shard().shard);
+    if (cct->_conf.get_val<bool>("osd_deep_scrub_store_digest")) {
+      uint32_t crc = pos.data_hash.digest();
+      r = store->digest(
+	ch, ghoid, pos.data_pos,
+	cct->_conf->osd_deep_scrub_stride, &crc,
+	fadvise_flags);
+      if (r > 0) {
+	pos.data_hash = bufferhash(crc);
+      }
+    } else {
+      bufferlist bl;
+      r = store->read(
+	ch, ghoid, pos.data_pos,
+	cct->_conf->osd_deep_scrub_stride, bl,
+	fadvise_flags);
+      if (r > 0) {
+	pos.data_hash << bl;
+      }
+    }
     if (r < 0) {
       dout(20) << __func__ << "  " << poid << " got "
 	       << r << " on read, read_error" << dendl;
       o.read_error = true;
       return 0;
     }
-    if (r > 0) {
-      pos.data_hash << bl;
-    }
     pos.data_pos += r;
     if (r == cct->_conf->osd_deep_scrub_stride) {
       dout(20) << __func__ << "  " << poid << " more data, digest so far 0x"
@@ -14,6 +14,10 @@ ghobject_t make_scrub_object(const spg_t& pgid)
   return pgid.make_temp_ghobject(ss.str());
 }
 
+// sorts between the SCRUB_OBJ_ and SCRUB_SS_ keys, so get_errors()
+// never runs into it
+const string progress_key = "SCRUB_PROGRESS";
+
 string first_object_key(int64_t pool)
 {
   auto hoid = hobject_t(object_t(),
@@ -93,6 +97,36 @@ string last_snap_key(int64_t pool)
 
 namespace Scrub {
 
+void progress_t::encode(bufferlist& bl) const
+{
+  ENCODE_START(1, 1, bl);
+  encode(deep, bl);
+  encode(start, bl);
+  encode(epoch, bl);
+  encode(last_scrub_stamp, bl);
+  encode(shallow_errors, bl);
+  encode(deep_errors, bl);
+  encode(large_omap_objects, bl);
+  encode(omap_bytes, bl);
+  encode(omap_keys, bl);
+  ENCODE_FINISH(bl);
+}
+
+void progress_t::decode(bufferlist::const_iterator& bl)
+{
+  DECODE_START(1, bl);
+  decode(deep, bl);
+  decode(start, bl);
+  decode(epoch, bl);
+  decode(last_scrub_stamp, bl);
+  decode(shallow_errors, bl);
+  decode(deep_errors, bl);
+  decode(large_omap_objects, bl);
+  decode(omap_bytes, bl);
+  decode(omap_keys, bl);
+  DECODE_FINISH(bl);
+}
+
 Store*
 Store::create(ObjectStore* store,
 	      ObjectStore::Transaction* t,
@@ -102,10 +136,40 @@ Store::create(ObjectStore* store,
   ceph_assert(store);
   ceph_assert(t);
   ghobject_t oid = make_scrub_object(pgid);
+  // start empty, without the results or progress of an earlier scrub
+  t->remove(coll, oid);
   t->touch(coll, oid);
   return new Store{coll, oid, store};
 }
 
+Store*
+Store::open(ObjectStore* store,
+	    const spg_t& pgid,
+	    const coll_t& coll)
+{
+  ceph_assert(store);
+  ghobject_t oid = make_scrub_object(pgid);
+  auto ch = store->open_collection(coll);
+  if (!ch || !store->exists(ch, oid)) {
+    return nullptr;
+  }
+  return new Store{coll, oid, store};
+}
+
+void Store::remove(ObjectStore::Transaction* t,
+		   const spg_t& pgid,
+		   const coll_t& coll)
+{
+  ceph_assert(t);
+  t->remove(coll, make_scrub_object(pgid));
+}
+
+bool Store::is_store_object(const ghobject_t& oid)
+{
+  return oid.hobj.is_temp() &&
+    oid.hobj.oid.name.compare(0, 6, "scrub_") == 0;
+}
+
 Store::Store(const coll_t& coll, const ghobject_t& oid, ObjectStore* store)
   : coll(coll),
     hoid(oid),
@@ -146,6 +210,36 @@ void Store::flush(ObjectStore::Transaction* t)
   results.clear();
 }
 
+void Store::set_progress(ObjectStore::Transaction* t,
+			 const progress_t& progress)
+{
+  map<string, bufferlist> to_set;
+  encode(progress, to_set[progress_key]);
+  OSDriver::OSTransaction txn = driver.get_transaction(t);
+  backend.set_keys(to_set, &txn);
+}
+
+bool Store::get_progress(progress_t* progress)
+{
+  map<string, bufferlist> got;
+  if (backend.get_keys({progress_key}, &got) < 0 || got.empty()) {
+    return false;
+  }
+  try {
+    auto p = got.begin()->second.cbegin();
+    decode(*progress, p);
+  } catch (buffer::error&) {
+    return false;
+  }
+  return true;
+}
+
+void Store::clear_progress(ObjectStore::Transaction* t)
+{
+  OSDriver::OSTransaction txn = driver.get_transaction(t);
+  backend.remove_keys({progress_key}, &txn);
+}
+
 void Store::cleanup(ObjectStore::Transaction* t)
 {
   t->remove(coll, hoid);
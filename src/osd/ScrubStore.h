@@ -16,6 +16,23 @@ struct inconsistent_snapset_wrapper;
 
 namespace Scrub {
 
+/// how far a scrub got, so that it can go on after an interruption
+struct progress_t {
+  bool deep = false;
+  hobject_t start;		///< first object not scrubbed yet
+  epoch_t epoch = 0;		///< osdmap epoch this was recorded at
+  utime_t last_scrub_stamp;	///< of the pg when this scrub started
+  int32_t shallow_errors = 0;
+  int32_t deep_errors = 0;
+  int32_t large_omap_objects = 0;
+  int64_t omap_bytes = 0;
+  int64_t omap_keys = 0;
+
+  void encode(bufferlist& bl) const;
+  void decode(bufferlist::const_iterator& bl);
+};
+WRITE_CLASS_ENCODER(progress_t)
+
 class Store {
 public:
   ~Store();
@@ -23,6 +40,19 @@ public:
 		       ObjectStore::Transaction* t,
 		       const spg_t& pgid,
 		       const coll_t& coll);
+  /// the object left by an earlier scrub, nullptr if there is none
+  static Store* open(ObjectStore* store,
+		     const spg_t& pgid,
+		     const coll_t& coll);
+  /// remove the object of pgid's store, whether or not it is open
+  static void remove(ObjectStore::Transaction* t,
+		     const spg_t& pgid,
+		     const coll_t& coll);
+  static bool is_store_object(const ghobject_t& oid);
+  void set_progress(ObjectStore::Transaction *t, const progress_t& progress);
+  /// @return false if no progress was recorded
+  bool get_progress(progress_t *progress);
+  void clear_progress(ObjectStore::Transaction *t);
   void add_object_error(int64_t pool, const inconsistent_obj_wrapper& e);
   void add_snap_error(int64_t pool, const inconsistent_snapset_wrapper& e);
   bool empty() const;
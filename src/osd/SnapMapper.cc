@@ -233,14 +233,15 @@ int SnapMapper::update_snaps(
   const hobject_t &oid,
   const set<snapid_t> &new_snaps,
   const set<snapid_t> *old_snaps_check,
-  MapCacher::Transaction<std::string, bufferlist> *t)
+  MapCacher::Transaction<std::string, bufferlist> *t,
+  Batch *batch)
 {
   dout(20) << __func__ << " " << oid << " " << new_snaps
 	   << " was " << (old_snaps_check ? *old_snaps_check : set<snapid_t>())
 	   << dendl;
   ceph_assert(check(oid));
   if (new_snaps.empty())
-    return remove_oid(oid, t);
+    return remove_oid(oid, t, batch);
 
   object_snaps out;
   int r = get_snaps(oid, &out);
@@ -266,7 +267,7 @@ int SnapMapper::update_snaps(
       dout(20) << __func__ << " rm " << i << dendl;
     }
   }
-  backend.remove_keys(to_remove, t);
+  _remove_mappings(to_remove, t, batch);
   return 0;
 }
 
@@ -354,16 +355,18 @@ int SnapMapper::get_next_objects_to_trim(
 
 int SnapMapper::remove_oid(
   const hobject_t &oid,
-  MapCacher::Transaction<std::string, bufferlist> *t)
+  MapCacher::Transaction<std::string, bufferlist> *t,
+  Batch *batch)
 {
   dout(20) << __func__ << " " << oid << dendl;
   ceph_assert(check(oid));
-  return _remove_oid(oid, t);
+  return _remove_oid(oid, t, batch);
 }
 
 int SnapMapper::_remove_oid(
   const hobject_t &oid,
-  MapCacher::Transaction<std::string, bufferlist> *t)
+  MapCacher::Transaction<std::string, bufferlist> *t,
+  Batch *batch)
 {
   dout(20) << __func__ << " " << oid << dendl;
   object_snaps out;
@@ -384,10 +387,66 @@ int SnapMapper::_remove_oid(
       dout(20) << __func__ << " rm " << i << dendl;
     }
   }
-  backend.remove_keys(to_remove, t);
+  _remove_mappings(to_remove, t, batch);
   return 0;
 }
 
+void SnapMapper::_remove_mappings(
+  const set<string> &to_remove,
+  MapCacher::Transaction<std::string, bufferlist> *t,
+  Batch *batch)
+{
+  if (batch) {
+    batch->to_remove.insert(to_remove.begin(), to_remove.end());
+  } else {
+    backend.remove_keys(to_remove, t);
+  }
+}
+
+void SnapMapper::remove_batched(
+  Batch *batch,
+  MapCacher::Transaction<std::string, bufferlist> *t)
+{
+  const uint64_t min_range =
+    cct->_conf.get_val<uint64_t>("osd_snap_trim_range_delete_min_keys");
+  set<string> singles;
+  auto i = batch->to_remove.begin();
+  while (i != batch->to_remove.end()) {
+    // extend the run for as long as the next key present is also removed
+    auto last = i;
+    size_t len = 1;
+    if (min_range) {
+      for (auto j = std::next(i); j != batch->to_remove.end(); ++j) {
+	pair<string, bufferlist> next;
+	if (backend.get_next(*last, &next) != 0 || next.first != *j)
+	  break;
+	last = j;
+	++len;
+      }
+    }
+    auto end = std::next(last);
+    if (min_range && len >= min_range) {
+      // the key right after *last
+      string range_end = *last + '\0';
+      dout(20) << __func__ << " rm range [" << *i << ", " << *last << "], "
+	       << len << " keys" << dendl;
+      backend.remove_range(set<string>(i, end), *i, range_end, t);
+    } else {
+      singles.insert(i, end);
+    }
+    i = end;
+  }
+  if (!singles.empty()) {
+    if (g_conf()->subsys.should_gather<ceph_subsys_osd, 20>()) {
+      for (auto& k : singles) {
+	dout(20) << __func__ << " rm " << k << dendl;
+      }
+    }
+    backend.remove_keys(singles, t);
+  }
+  batch->to_remove.clear();
+}
+
 int SnapMapper::get_snaps(
   const hobject_t &oid,
   std::set<snapid_t> *snaps)
@@ -53,6 +53,11 @@ public:
       const std::set<std::string> &to_remove) override {
       t->omap_rmkeys(cid, hoid, to_remove);
     }
+    void remove_range(
+      const std::string &first,
+      const std::string &last) override {
+      t->omap_rmkeyrange(cid, hoid, first, last);
+    }
     void add_callback(
       Context *c) override {
       t->register_on_applied(c);
@@ -244,11 +249,31 @@ private:
   // True if hoid belongs in this mapping based on mask_bits and match
   bool check(const hobject_t &hoid) const;
 
+public:
+  /**
+   * Mapping keys removed by a series of updates
+   *
+   * Snap trimming removes the mappings of a snap in key order, so the
+   * keys removed by a batch of trims mostly form runs with no other
+   * key in between, which remove_batched() turns into range removals.
+   * Only usable for updates which do not also add mappings.
+   */
+  struct Batch {
+    std::set<std::string> to_remove;
+  };
+
+private:
   int _remove_oid(
     const hobject_t &oid,    ///< [in] oid to remove
-    MapCacher::Transaction<std::string, bufferlist> *t ///< [out] transaction
+    MapCacher::Transaction<std::string, bufferlist> *t, ///< [out] transaction
+    Batch *batch = nullptr   ///< [in,out] batch to defer removals to
     );
 
+  void _remove_mappings(
+    const std::set<std::string> &to_remove,
+    MapCacher::Transaction<std::string, bufferlist> *t,
+    Batch *batch);
+
 public:
   static string make_shard_prefix(shard_id_t shard) {
     if (shard == shard_id_t::NO_SHARD)
@@ -300,7 +325,8 @@ public:
     const hobject_t &oid,       ///< [in] oid to update
     const std::set<snapid_t> &new_snaps, ///< [in] new snap set
     const std::set<snapid_t> *old_snaps, ///< [in] old snaps (for debugging)
-    MapCacher::Transaction<std::string, bufferlist> *t ///< [out] transaction
+    MapCacher::Transaction<std::string, bufferlist> *t, ///< [out] transaction
+    Batch *batch = nullptr      ///< [in,out] batch to defer removals to
     ); ///@ return error, 0 on success
 
   /// Add mapping for oid, must not already be mapped
@@ -320,9 +346,16 @@ public:
   /// Remove mapping for oid
   int remove_oid(
     const hobject_t &oid,    ///< [in] oid to remove
-    MapCacher::Transaction<std::string, bufferlist> *t ///< [out] transaction
+    MapCacher::Transaction<std::string, bufferlist> *t, ///< [out] transaction
+    Batch *batch = nullptr   ///< [in,out] batch to defer removals to
     ); ///< @return error, -ENOENT if the object is not mapped
 
+  /// Remove the mappings gathered in batch
+  void remove_batched(
+    Batch *batch,            ///< [in,out] batch to apply, emptied
+    MapCacher::Transaction<std::string, bufferlist> *t ///< [out] transaction
+    );
+
   /// Get snaps for oid
   int get_snaps(
     const hobject_t &oid,     ///< [in] oid to get snaps for
@@ -362,6 +362,9 @@ public:
   bool empty() const {
     return locks.empty();
   }
+  bool is_locked(const hobject_t &hoid) const {
+    return locks.count(hoid);
+  }
   bool get_lock_type(
     ObjectContext::RWState::State type,
     const hobject_t &hoid,
@@ -436,6 +439,13 @@ public:
     }
   }
 
+  /// hand the lock on hoid over to another lock manager
+  void move_lock(const hobject_t &hoid, ObcLockManager &to) {
+    auto p = locks.find(hoid);
+    ceph_assert(p != locks.end());
+    to.locks.insert(locks.extract(p));
+  }
+
   void put_locks(
     list<pair<ObjectContextRef, list<OpRequestRef> > > *to_requeue,
     bool *requeue_recovery,
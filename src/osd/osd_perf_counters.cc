@@ -276,6 +276,17 @@ PerfCounters *build_osd_logger(CephContext *cct) {
   osd_plb.add_u64_counter(
     l_osd_pg_biginfo, "osd_pg_biginfo", "PG updated its biginfo attr");
 
+  osd_plb.add_u64_counter(
+    l_osd_op_wq_steals, "op_wq_steals",
+    "Ops dequeued by a thread of another op shard");
+
+  osd_plb.add_u64_counter(
+    l_osd_op_r_coalesced, "op_r_coalesced",
+    "Client read ops served from a readv shared with other ops");
+  osd_plb.add_u64_counter(
+    l_osd_op_r_coalesced_extents, "op_r_coalesced_extents",
+    "Read extents merged with an overlapping or adjacent one");
+
   return osd_plb.create_perf_counters();
 }
  
@@ -117,6 +117,11 @@ enum {
   l_osd_pg_fastinfo,
   l_osd_pg_biginfo,
 
+  l_osd_op_wq_steals,
+
+  l_osd_op_r_coalesced,
+  l_osd_op_r_coalesced_extents,
+
   l_osd_last,
 };
 
@@ -1344,7 +1344,13 @@ static opt_mapping_t opt_mapping = boost::assign::map_list_of
            ("pg_autoscale_bias", pool_opts_t::opt_desc_t(
 	     pool_opts_t::PG_AUTOSCALE_BIAS, pool_opts_t::DOUBLE))
            ("read_lease_interval", pool_opts_t::opt_desc_t(
-	     pool_opts_t::READ_LEASE_INTERVAL, pool_opts_t::DOUBLE));
+	     pool_opts_t::READ_LEASE_INTERVAL, pool_opts_t::DOUBLE))
+           ("qos_reservation", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_RESERVATION, pool_opts_t::DOUBLE))
+           ("qos_weight", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_WEIGHT, pool_opts_t::DOUBLE))
+           ("qos_limit", pool_opts_t::opt_desc_t(
+	     pool_opts_t::QOS_LIMIT, pool_opts_t::DOUBLE));
 
 bool pool_opts_t::is_opt_name(const std::string& name)
 {
@@ -1056,6 +1056,9 @@ public:
     TARGET_SIZE_RATIO,  // fraction of total cluster
     PG_AUTOSCALE_BIAS,
     READ_LEASE_INTERVAL,
+    QOS_RESERVATION,    // dmclock client reservation
+    QOS_WEIGHT,         // dmclock client weight
+    QOS_LIMIT,          // dmclock client limit
   };
 
   enum type_t {
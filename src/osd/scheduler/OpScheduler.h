@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <map>
 #include <ostream>
 
 #include "common/ceph_context.h"
@@ -23,6 +24,13 @@ namespace ceph::osd::scheduler {
 
 using client = uint64_t;
 
+/// client QoS set on a pool, 0 where the scheduler's default applies
+struct pool_qos_t {
+  double reservation = 0;
+  double weight = 0;
+  double limit = 0;
+};
+
 /**
  * Base interface for classes responsible for choosing
  * op processing order in the OSD.
@@ -48,6 +56,9 @@ public:
   // Print human readable brief description with relevant parameters
   virtual void print(std::ostream &out) const = 0;
 
+  // Apply the client QoS of every pool in the current OSDMap
+  virtual void update_pool_qos(const std::map<int64_t, pool_qos_t> &pools) {}
+
   // Destructor
   virtual ~OpScheduler() {};
 };
@@ -55,7 +66,8 @@ public:
 std::ostream &operator<<(std::ostream &lhs, const OpScheduler &);
 using OpSchedulerRef = std::unique_ptr<OpScheduler>;
 
-OpSchedulerRef make_scheduler(CephContext *cct);
+OpSchedulerRef make_scheduler(CephContext *cct, uint32_t num_shards,
+			      bool is_rotational);
 
 /**
  * Implements OpScheduler in terms of OpQueue
@@ -85,6 +85,13 @@ public:
       return nullptr;
     }
 
+    /// dmclock delta and rho the client sent along with the op
+    virtual std::pair<uint32_t, uint32_t> get_qos_params() const {
+      return {0, 0};
+    }
+    /// tell the client in which phase and at what cost the op was served
+    virtual void set_qos_response(bool reservation, uint32_t cost) {}
+
     virtual ostream &print(ostream &rhs) const = 0;
 
     virtual void run(OSD *osd, OSDShard *sdata, PGRef& pg, ThreadPool::TPHandle &handle) = 0;
@@ -161,6 +168,13 @@ public:
     return qitem->creates_pg();
   }
 
+  std::pair<uint32_t, uint32_t> get_qos_params() const {
+    return qitem->get_qos_params();
+  }
+  void set_qos_response(bool reservation, uint32_t cost) {
+    qitem->set_qos_response(reservation, cost);
+  }
+
   bool peering_requires_pg() const {
     return qitem->peering_requires_pg();
   }
@@ -251,6 +265,21 @@ public:
     }
   }
 
+  std::pair<uint32_t, uint32_t> get_qos_params() const final {
+    if (auto m = maybe_get_mosd_op()) {
+      // dmclock asserts rho <= delta, don't trust the client on that
+      return {m->get_qos_delta(), std::min(m->get_qos_rho(), m->get_qos_delta())};
+    }
+    return {0, 0};
+  }
+
+  void set_qos_response(bool reservation, uint32_t cost) final {
+    if (maybe_get_mosd_op()) {
+      static_cast<MOSDOp*>(op->get_nonconst_req())->set_qos_response(
+	reservation, cost);
+    }
+  }
+
   void run(OSD *osd, OSDShard *sdata, PGRef& pg, ThreadPool::TPHandle &handle) final;
 };
 
@@ -13,6 +13,8 @@
  */
 
 
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <functional>
 
@@ -30,7 +32,44 @@ using namespace std::placeholders;
 
 namespace ceph::osd::scheduler {
 
-mClockScheduler::mClockScheduler(CephContext *cct) :
+namespace {
+
+/// share of one op class, res and lim as fractions of the capacity
+struct class_share_t {
+  double res;
+  double wgt;
+  double lim;  ///< 0 for no limit
+};
+
+struct profile_t {
+  class_share_t client;
+  class_share_t background_recovery;
+  class_share_t background_best_effort;
+};
+
+const std::map<std::string, profile_t> profiles = {
+  { "high_client_ops",
+    { { .60, 5, 0 }, { .20, 1, .50 }, { 0, 1, .10 } } },
+  { "balanced",
+    { { .40, 1, 0 }, { .40, 1, 0 }, { 0, 1, .20 } } },
+  { "high_recovery_ops",
+    { { .30, 1, 0 }, { .60, 2, 0 }, { 0, 1, .20 } } },
+};
+
+void update_info(dmc::ClientInfo& info, const class_share_t& share,
+		 double capacity)
+{
+  info.update(share.res * capacity, share.wgt, share.lim * capacity);
+}
+
+}
+
+mClockScheduler::mClockScheduler(CephContext *cct,
+				 uint32_t num_shards,
+				 bool is_rotational) :
+  cct(cct),
+  num_shards(num_shards),
+  is_rotational(is_rotational),
   scheduler(
     std::bind(&mClockScheduler::ClientRegistry::get_info,
 	      &client_registry,
@@ -38,12 +77,118 @@ mClockScheduler::mClockScheduler(CephContext *cct) :
     dmc::AtLimit::Allow,
     cct->_conf.get_val<double>("osd_mclock_scheduler_anticipation_timeout"))
 {
+  ceph_assert(num_shards > 0);
   cct->_conf.add_observer(this);
-  client_registry.update_from_config(cct->_conf);
+  update_capacity(cct->_conf);
+}
+
+mClockScheduler::~mClockScheduler()
+{
+  cct->_conf.remove_observer(this);
+}
+
+void mClockScheduler::update_capacity(const ConfigProxy &conf)
+{
+  std::lock_guard l(capacity_lock);
+  _update_capacity(conf);
+}
+
+void mClockScheduler::_update_capacity(const ConfigProxy &conf)
+{
+  double iops;
+  uint64_t bandwidth;
+  if (is_rotational) {
+    iops = conf.get_val<double>("osd_mclock_max_capacity_iops_hdd");
+    bandwidth = conf.get_val<Option::size_t>(
+      "osd_mclock_max_sequential_bandwidth_hdd");
+  } else {
+    iops = conf.get_val<double>("osd_mclock_max_capacity_iops_ssd");
+    bandwidth = conf.get_val<Option::size_t>(
+      "osd_mclock_max_sequential_bandwidth_ssd");
+  }
+  calibration_interval = conf.get_val<double>(
+    "osd_mclock_calibration_interval");
+
+  if (conf.get_val<std::string>("osd_mclock_profile") == "custom") {
+    // reservations and limits are in ops, every op costs the same
+    capacity_per_shard = 0;
+    bytes_per_io = 0;
+  } else {
+    capacity_per_shard = measured_capacity > 0 ?
+      measured_capacity : std::max(iops, 1.0) / num_shards;
+    bytes_per_io = (double)bandwidth / std::max(iops, 1.0);
+  }
+  dout(1) << "mClockScheduler: " << __func__
+	  << " profile " << conf.get_val<std::string>("osd_mclock_profile")
+	  << " capacity per shard " << capacity_per_shard
+	  << (measured_capacity > 0 ? " (measured)" : "")
+	  << " bytes per io " << bytes_per_io << dendl;
+  client_registry.update_from_config(conf, capacity_per_shard, num_shards);
 }
 
-void mClockScheduler::ClientRegistry::update_from_config(const ConfigProxy &conf)
+uint32_t mClockScheduler::calc_cost(const OpSchedulerItem &item) const
 {
+  std::lock_guard l(capacity_lock);
+  if (bytes_per_io <= 0) {
+    return 1;
+  }
+  double ios = std::max(item.get_cost(), 0) / bytes_per_io;
+  return 1 + std::min<double>(ios, std::numeric_limits<uint32_t>::max() - 1);
+}
+
+void mClockScheduler::sample_dequeue(uint32_t cost, double now)
+{
+  std::lock_guard l(capacity_lock);
+  if (calibration_interval <= 0 || capacity_per_shard <= 0) {
+    return;
+  }
+  if (!sampling) {
+    sampling = true;
+    sample_start = now;
+    sample_cost = 0;
+  }
+  sample_cost += cost;
+  if (scheduler.empty()) {
+    // we ran dry, so the dequeue rate says nothing about the device
+    sampling = false;
+    return;
+  }
+  double elapsed = now - sample_start;
+  if (elapsed < calibration_interval) {
+    return;
+  }
+  sampling = false;
+  double rate = sample_cost / elapsed;
+  if (std::abs(rate - capacity_per_shard) > capacity_per_shard / 10) {
+    dout(10) << "mClockScheduler: " << __func__ << " dequeued " << rate
+	     << "/s while backlogged, capacity was " << capacity_per_shard
+	     << dendl;
+    measured_capacity = rate;
+    _update_capacity(cct->_conf);
+  }
+}
+
+void mClockScheduler::ClientRegistry::update_from_config(
+  const ConfigProxy &conf,
+  double capacity_per_shard,
+  uint32_t num_shards)
+{
+  auto profile = profiles.find(conf.get_val<std::string>("osd_mclock_profile"));
+  if (profile != profiles.end()) {
+    update_info(default_external_client_info, profile->second.client,
+		capacity_per_shard);
+    update_info(
+      internal_client_infos[
+	static_cast<size_t>(op_scheduler_class::background_recovery)],
+      profile->second.background_recovery, capacity_per_shard);
+    update_info(
+      internal_client_infos[
+	static_cast<size_t>(op_scheduler_class::background_best_effort)],
+      profile->second.background_best_effort, capacity_per_shard);
+    update_pool_infos(num_shards);
+    return;
+  }
+
   default_external_client_info.update(
     conf.get_val<uint64_t>("osd_mclock_scheduler_client_res"),
     conf.get_val<uint64_t>("osd_mclock_scheduler_client_wgt"),
@@ -60,16 +205,60 @@ void mClockScheduler::ClientRegistry::update_from_config(const ConfigProxy &conf
     conf.get_val<uint64_t>("osd_mclock_scheduler_background_best_effort_res"),
     conf.get_val<uint64_t>("osd_mclock_scheduler_background_best_effort_wgt"),
     conf.get_val<uint64_t>("osd_mclock_scheduler_background_best_effort_lim"));
+  update_pool_infos(num_shards);
+}
+
+void mClockScheduler::ClientRegistry::update_pool_qos(
+  const std::map<int64_t, pool_qos_t> &pools,
+  uint32_t num_shards)
+{
+  pool_qos = pools;
+  update_pool_infos(num_shards);
+}
+
+void mClockScheduler::ClientRegistry::update_pool_infos(uint32_t num_shards)
+{
+  const auto& def = default_external_client_info;
+  // pools without a qos, or gone, fall back to the defaults
+  for (auto& [pool, info] : pool_client_infos) {
+    if (!pool_qos.count(static_cast<int64_t>(pool))) {
+      info = def;
+    }
+  }
+  for (auto& [pool, qos] : pool_qos) {
+    auto info = pool_client_infos.try_emplace(
+      static_cast<profile_id_t>(pool), def).first;
+    info->second.update(
+      qos.reservation > 0 ? qos.reservation / num_shards : def.reservation,
+      qos.weight > 0 ? qos.weight : def.weight,
+      qos.limit > 0 ? qos.limit / num_shards : def.limit);
+  }
+}
+
+void mClockScheduler::ClientRegistry::dump(ceph::Formatter &f) const
+{
+  f.open_array_section("pools");
+  for (auto& [pool, info] : pool_client_infos) {
+    f.open_object_section("pool");
+    f.dump_int("pool", static_cast<int64_t>(pool));
+    f.dump_float("reservation", info.reservation);
+    f.dump_float("weight", info.weight);
+    f.dump_float("limit", info.limit);
+    f.close_section();
+  }
+  f.close_section();
 }
 
 const dmc::ClientInfo *mClockScheduler::ClientRegistry::get_external_client(
   const client_profile_id_t &client) const
 {
   auto ret = external_client_infos.find(client);
-  if (ret == external_client_infos.end())
-    return &default_external_client_info;
-  else
+  if (ret != external_client_infos.end())
     return &(ret->second);
+  auto pool = pool_client_infos.find(client.profile_id);
+  if (pool != pool_client_infos.end())
+    return &(pool->second);
+  return &default_external_client_info;
 }
 
 const dmc::ClientInfo *mClockScheduler::ClientRegistry::get_info(
@@ -88,21 +277,38 @@ const dmc::ClientInfo *mClockScheduler::ClientRegistry::get_info(
 
 void mClockScheduler::dump(ceph::Formatter &f) const
 {
+  {
+    std::lock_guard l(capacity_lock);
+    f.dump_float("capacity_per_shard", capacity_per_shard);
+    f.dump_float("measured_capacity", measured_capacity);
+    f.dump_float("bytes_per_io", bytes_per_io);
+    client_registry.dump(f);
+  }
+  f.dump_unsigned("immediate", immediate.size());
+}
+
+void mClockScheduler::update_pool_qos(
+  const std::map<int64_t, pool_qos_t> &pools)
+{
+  std::lock_guard l(capacity_lock);
+  client_registry.update_pool_qos(pools, num_shards);
 }
 
 void mClockScheduler::enqueue(OpSchedulerItem&& item)
 {
   auto id = get_scheduler_id(item);
-  // TODO: express cost, mclock params in terms of per-node capacity?
-  auto cost = 1; //std::max(item.get_cost(), 1);
 
   // TODO: move this check into OpSchedulerItem, handle backwards compat
   if (op_scheduler_class::immediate == item.get_scheduler_class()) {
     immediate.push_front(std::move(item));
   } else {
-    scheduler.add_request(
+    auto cost = calc_cost(item);
+    auto [delta, rho] = item.get_qos_params();
+    scheduler.add_request_time(
       std::move(item),
       id,
+      dmc::ReqParams(delta, rho),
+      get_time(),
       cost);
   }
 }
@@ -121,7 +327,8 @@ OpSchedulerItem mClockScheduler::dequeue()
     immediate.pop_back();
     return ret;
   } else {
-    mclock_queue_t::PullReq result = scheduler.pull_request();
+    auto now = get_time();
+    mclock_queue_t::PullReq result = scheduler.pull_request(now);
     if (result.is_future()) {
       ceph_assert(
 	0 == "Not implemented, user would have to be able to be woken up");
@@ -134,6 +341,10 @@ OpSchedulerItem mClockScheduler::dequeue()
       ceph_assert(result.is_retn());
 
       auto &retn = result.get_retn();
+      auto cost = calc_cost(*retn.request);
+      retn.request->set_qos_response(
+	retn.phase == dmc::PhaseType::reservation, cost);
+      sample_dequeue(cost, now);
       return std::move(*retn.request);
     }
   }
@@ -151,6 +362,12 @@ const char** mClockScheduler::get_tracked_conf_keys() const
     "osd_mclock_scheduler_background_best_effort_res",
     "osd_mclock_scheduler_background_best_effort_wgt",
     "osd_mclock_scheduler_background_best_effort_lim",
+    "osd_mclock_profile",
+    "osd_mclock_max_capacity_iops_hdd",
+    "osd_mclock_max_capacity_iops_ssd",
+    "osd_mclock_max_sequential_bandwidth_hdd",
+    "osd_mclock_max_sequential_bandwidth_ssd",
+    "osd_mclock_calibration_interval",
     NULL
   };
   return KEYS;
@@ -160,7 +377,14 @@ void mClockScheduler::handle_conf_change(
   const ConfigProxy& conf,
   const std::set<std::string> &changed)
 {
-  client_registry.update_from_config(conf);
+  std::lock_guard l(capacity_lock);
+  if (changed.count("osd_mclock_max_capacity_iops_hdd") ||
+      changed.count("osd_mclock_max_capacity_iops_ssd")) {
+    // a new measurement or an admin knows better than our estimate
+    measured_capacity = 0;
+    sampling = false;
+  }
+  _update_capacity(conf);
 }
 
 }
@@ -25,6 +25,7 @@
 
 #include "osd/scheduler/OpScheduler.h"
 #include "common/config.h"
+#include "common/ceph_mutex.h"
 #include "include/cmp.h"
 #include "common/ceph_context.h"
 #include "common/mClockPriorityQueue.h"
@@ -56,10 +57,52 @@ WRITE_CMP_OPERATORS_2(scheduler_id_t, class_id, client_profile_id)
 /**
  * Scheduler implementation based on mclock.
  *
- * TODO: explain configs
+ * Unless osd_mclock_profile is "custom", reservations and limits are
+ * not taken from the osd_mclock_scheduler_* options but derived from
+ * the capacity of the device, in IO units per second: an op costs one
+ * IO plus one more for every bytes_per_io bytes it moves.  Each shard
+ * has its own scheduler and gets an equal share of the capacity.  The
+ * capacity starts out as osd_mclock_max_capacity_iops_(hdd|ssd), which
+ * the OSD measures on startup, and is re-estimated from the dequeue
+ * rate whenever the queue stays backlogged for
+ * osd_mclock_calibration_interval.
+ *
+ * Client ops are tracked per client and pool, with the reservation,
+ * weight and limit of the pool's qos_* options where set.  Those are
+ * for a client across the cluster; the client sends the dmclock delta
+ * and rho along with each op so that service it got from other OSDs
+ * counts against it here, and each shard enforces 1/num_shards of the
+ * values, assuming the client's ops are spread evenly over the shards.
  */
 class mClockScheduler : public OpScheduler, md_config_obs_t {
 
+  CephContext *cct;
+  const uint32_t num_shards;
+  const bool is_rotational;
+
+  /// guards the capacity state below and the pool infos of client_registry:
+  /// config changes arrive on the config observer thread while ops are
+  /// dequeued, and new maps consumed, on the shard's threads
+  mutable ceph::mutex capacity_lock =
+    ceph::make_mutex("mClockScheduler::capacity_lock");
+
+  /// IO units per second available to this shard
+  double capacity_per_shard = 0;
+  /// bytes an op can move for the cost of one IO
+  double bytes_per_io = 0;
+
+  /// dequeue rate observed while backlogged, 0 if none yet
+  double measured_capacity = 0;
+  double calibration_interval = 0;
+  bool sampling = false;
+  double sample_start = 0;
+  uint64_t sample_cost = 0;
+
+  void update_capacity(const ConfigProxy &conf);
+  void _update_capacity(const ConfigProxy &conf);
+  uint32_t calc_cost(const OpSchedulerItem &item) const;
+  void sample_dequeue(uint32_t cost, double now);
+
   class ClientRegistry {
     std::array<
       crimson::dmclock::ClientInfo,
@@ -73,10 +116,23 @@ class mClockScheduler : public OpScheduler, md_config_obs_t {
     crimson::dmclock::ClientInfo default_external_client_info = {1, 1, 1};
     std::map<client_profile_id_t,
 	     crimson::dmclock::ClientInfo> external_client_infos;
+
+    /// qos of each pool, with the values for the whole OSD
+    std::map<int64_t, pool_qos_t> pool_qos;
+    /// client info of each pool.  dmclock keeps pointers to these, so
+    /// entries are updated in place and never removed.
+    std::map<profile_id_t, crimson::dmclock::ClientInfo> pool_client_infos;
+    void update_pool_infos(uint32_t num_shards);
+
     const crimson::dmclock::ClientInfo *get_external_client(
       const client_profile_id_t &client) const;
   public:
-    void update_from_config(const ConfigProxy &conf);
+    void update_from_config(const ConfigProxy &conf,
+			    double capacity_per_shard,
+			    uint32_t num_shards);
+    void update_pool_qos(const std::map<int64_t, pool_qos_t> &pools,
+			 uint32_t num_shards);
+    void dump(ceph::Formatter &f) const;
     const crimson::dmclock::ClientInfo *get_info(
       const scheduler_id_t &id) const;
   } client_registry;
@@ -91,17 +147,31 @@ class mClockScheduler : public OpScheduler, md_config_obs_t {
   std::list<OpSchedulerItem> immediate;
 
   static scheduler_id_t get_scheduler_id(const OpSchedulerItem &item) {
+    auto op_class = item.get_scheduler_class();
     return scheduler_id_t{
-      item.get_scheduler_class(),
+      op_class,
 	client_profile_id_t{
 	item.get_owner(),
-	  0
+	  op_class == op_scheduler_class::client ?
+	  static_cast<profile_id_t>(item.get_ordering_token().pool()) : 0
 	  }
     };
   }
 
+protected:
+  /// current time as seen by the dmclock tags
+  virtual double get_time() const {
+    return crimson::dmclock::get_time();
+  }
+
 public:
-  mClockScheduler(CephContext *cct);
+  mClockScheduler(CephContext *cct, uint32_t num_shards, bool is_rotational);
+  ~mClockScheduler() override;
+
+  double get_capacity_per_shard() const {
+    std::lock_guard l(capacity_lock);
+    return capacity_per_shard;
+  }
 
   // Enqueue op in the back of the regular queue
   void enqueue(OpSchedulerItem &&item) final;
@@ -124,6 +194,8 @@ public:
     ostream << "mClockScheduler";
   }
 
+  void update_pool_qos(const std::map<int64_t, pool_qos_t> &pools) final;
+
   const char** get_tracked_conf_keys() const final;
   void handle_conf_change(const ConfigProxy& conf,
 			  const std::set<std::string> &changed) final;
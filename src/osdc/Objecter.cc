@@ -47,6 +47,8 @@
 
 #include "messages/MWatchNotify.h"
 
+#include "dmclock/src/dmclock_client.h"
+
 
 #include "common/Cond.h"
 #include "common/config.h"
@@ -92,6 +94,7 @@ namespace bc = boost::container;
 namespace bs = boost::system;
 namespace ca = ceph::async;
 namespace cb = ceph::buffer;
+namespace dmc = crimson::dmclock;
 
 #define dout_subsys ceph_subsys_objecter
 #undef dout_prefix
@@ -200,6 +203,11 @@ public:
 	   cb::list& out) override;
 };
 
+struct Objecter::QosTracker {
+  dmc::OrigTracker tracker;
+  QosTracker(uint64_t delta, uint64_t rho) : tracker(delta, rho) {}
+};
+
 std::unique_lock<std::mutex> Objecter::OSDSession::get_lock(object_t& oid)
 {
   if (oid.name.empty())
@@ -3215,6 +3223,16 @@ void Objecter::_send_op(Op *op)
     m->clear_payload();  // reencode
   }
 
+  {
+    std::lock_guard l(qos_lock);
+    auto& qos = op->session->qos_tracker;
+    if (!qos) {
+      qos = std::make_unique<QosTracker>(qos_delta, qos_rho);
+    }
+    auto params = qos->tracker.prepare_req(qos_delta, qos_rho);
+    m->set_qos_params(params.delta, params.rho);
+  }
+
   ldout(cct, 15) << "_send_op " << op->tid << " to "
 		 << op->target.actual_pgid << " on osd." << op->session->osd
 		 << dendl;
@@ -3341,6 +3359,16 @@ void Objecter::handle_osd_op_reply(MOSDOpReply *m)
 		<< " in " << m->get_pg()
 		<< " attempt " << m->get_retry_attempt()
 		<< dendl;
+  if (m->get_qos_cost()) {
+    // served by the mclock scheduler
+    std::lock_guard l(qos_lock);
+    if (s->qos_tracker) {
+      s->qos_tracker->tracker.resp_update(
+	m->get_qos_reservation() ? dmc::PhaseType::reservation :
+	dmc::PhaseType::priority,
+	qos_delta, qos_rho, m->get_qos_cost());
+    }
+  }
   Op *op = iter->second;
   op->trace.event("osd op reply");
 
@@ -4912,6 +4940,13 @@ void Objecter::_finish_command(CommandOp *c, bs::error_code ec,
   logger->dec(l_osdc_command_active);
 }
 
+Objecter::OSDSession::OSDSession(CephContext *cct, int o) :
+  osd(o), incarnation(0), con(NULL),
+  num_locks(cct->_conf->objecter_completion_locks_per_session),
+  completion_locks(new std::mutex[num_locks])
+{
+}
+
 Objecter::OSDSession::~OSDSession()
 {
   // Caller is responsible for re-assigning or
@@ -2232,6 +2232,8 @@ public:
     hobject_t begin, end;
   };
 
+  struct QosTracker;
+
   struct OSDSession : public RefCountedObject {
     ceph::shared_mutex lock =
       ceph::make_shared_mutex("OSDSession::lock");
@@ -2251,11 +2253,10 @@ public:
     int num_locks;
     std::unique_ptr<std::mutex[]> completion_locks;
 
-    OSDSession(CephContext *cct, int o) :
-      osd(o), incarnation(0), con(NULL),
-      num_locks(cct->_conf->objecter_completion_locks_per_session),
-      completion_locks(new std::mutex[num_locks]) {}
+    /// dmclock delta/rho of our requests to this osd, under qos_lock
+    std::unique_ptr<QosTracker> qos_tracker;
 
+    OSDSession(CephContext *cct, int o);
     ~OSDSession() override;
 
     bool is_homeless() { return (osd == -1); }
@@ -2264,6 +2265,12 @@ public:
   };
   std::map<int,OSDSession*> osd_sessions;
 
+  /// responses from all osds, in total and in dmclock reservation
+  /// phase, for the delta/rho sent along with each op
+  ceph::mutex qos_lock = ceph::make_mutex("Objecter::qos_lock");
+  uint64_t qos_delta = 0;
+  uint64_t qos_rho = 0;
+
   bool osdmap_full_flag() const;
   bool osdmap_pool_full(const int64_t pool_id) const;
 
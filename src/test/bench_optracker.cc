@@ -0,0 +1,92 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include "include/types.h"
+#include "common/Thread.h"
+#include "common/Clock.h"
+#include "common/TrackedOp.h"
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+
+struct BenchOp : public TrackedOp {
+  explicit BenchOp(OpTracker *tracker)
+    : TrackedOp(tracker, ceph_clock_now()) {}
+  void _dump_op_descriptor_unlocked(std::ostream& stream) const override {
+    stream << "bench_op";
+  }
+};
+
+struct T : public Thread {
+  OpTracker *tracker;
+  int num;
+  T(OpTracker *tracker, int n) : tracker(tracker), num(n) {}
+
+  void *entry() override {
+    while (num-- > 0) {
+      TrackedOpRef op(new BenchOp(tracker));
+      op->tracking_start();
+      op->mark_event("queued");
+      op->mark_event("started");
+    }
+    return 0;
+  }
+};
+
+static double run(OpTracker *tracker, int threads, int num)
+{
+  utime_t start = ceph_clock_now();
+
+  list<T*> ls;
+  for (int i=0; i<threads; i++) {
+    T *t = new T(tracker, num);
+    t->create("t");
+    ls.push_back(t);
+  }
+
+  for (int i=0; i<threads; i++) {
+    T *t = ls.front();
+    ls.pop_front();
+    t->join();
+    delete t;
+  }
+
+  utime_t dur = ceph_clock_now() - start;
+  return (double)threads * num / (double)dur;
+}
+
+int main(int argc, const char **argv)
+{
+  if (argc < 3) {
+    cerr << "usage: " << argv[0] << " <threads> <ops per thread> [sample rate]"
+	 << std::endl;
+    return 1;
+  }
+  int threads = atoi(argv[1]);
+  int num = atoi(argv[2]);
+  uint32_t sample_rate = argc > 3 ? atoi(argv[3]) : 1;
+
+  cout << threads << " threads, " << num << " ops per thread" << std::endl;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY,
+			 CINIT_FLAG_NO_DEFAULT_CONFIG_FILE);
+
+  for (bool tracking : {false, true}) {
+    OpTracker tracker(g_ceph_context, tracking,
+		      g_conf()->osd_num_op_tracker_shard);
+    tracker.set_history_size_and_duration(g_conf()->osd_op_history_size,
+					  g_conf()->osd_op_history_duration);
+    tracker.set_history_slow_op_size_and_threshold(
+      g_conf()->osd_op_history_slow_op_size,
+      g_conf()->osd_op_history_slow_op_threshold);
+    tracker.set_history_sample_rate(sample_rate);
+    double rate = run(&tracker, threads, num);
+    tracker.on_shutdown();
+    cout << "tracking " << (tracking ? "on" : "off") << ": "
+	 << rate << " ops/sec" << std::endl;
+  }
+  return 0;
+}
@@ -21,6 +21,7 @@
 #include "crush/CrushWrapper.h"
 #include "include/stringify.h"
 #include "erasure-code/jerasure/ErasureCodeJerasure.h"
+#include "osd/ECUtil.h"
 #include "global/global_context.h"
 #include "common/config.h"
 #include "gtest/gtest.h"
@@ -129,6 +130,57 @@ TYPED_TEST(ErasureCodeTest, encode_decode)
   }
 }
 
+TYPED_TEST(ErasureCodeTest, batched_stripes)
+{
+  ErasureCodeInterfaceRef jerasure(new TypeParam());
+  ErasureCodeProfile profile;
+  profile["k"] = "2";
+  profile["m"] = "2";
+  profile["packetsize"] = "8";
+  ASSERT_EQ(0, jerasure->init(profile, &cerr));
+  ASSERT_TRUE(jerasure->supports_stripe_batching());
+
+  const unsigned stripe_width = jerasure->get_chunk_size(8192) * 2;
+  const unsigned stripes = 16;
+  ECUtil::stripe_info_t sinfo(2, stripe_width);
+  bufferlist in;
+  for (unsigned i = 0; i < stripe_width * stripes; ++i) {
+    in.append((char)rand());
+  }
+  set<int> want = { 0, 1, 2, 3 };
+
+  // one stripe at a time, the way the plugin is called without batching
+  map<int, bufferlist> expected;
+  for (unsigned s = 0; s < stripes; ++s) {
+    bufferlist stripe;
+    stripe.substr_of(in, s * stripe_width, stripe_width);
+    map<int, bufferlist> encoded;
+    ASSERT_EQ(0, jerasure->encode(want, stripe, &encoded));
+    for (auto &&i : encoded) {
+      expected[i.first].claim_append(i.second);
+    }
+  }
+
+  g_conf().set_val("osd_ec_codec_slice_size", stringify(stripe_width));
+  g_conf().apply_changes(nullptr);
+  ECUtil::CodecPool pool(g_ceph_context, 3);
+  for (auto p : { (ECUtil::CodecPool *)nullptr, &pool }) {
+    map<int, bufferlist> encoded;
+    ASSERT_EQ(0, ECUtil::encode(sinfo, jerasure, in, want, &encoded, p));
+    ASSERT_EQ(expected.size(), encoded.size());
+    for (auto &&i : expected) {
+      EXPECT_TRUE(i.second.contents_equal(encoded[i.first]));
+    }
+
+    map<int, bufferlist> degraded = encoded;
+    degraded.erase(0);
+    degraded.erase(1);
+    bufferlist decoded;
+    ASSERT_EQ(0, ECUtil::decode(sinfo, jerasure, degraded, &decoded, p));
+    EXPECT_TRUE(in.contents_equal(decoded));
+  }
+}
+
 TYPED_TEST(ErasureCodeTest, minimum_to_decode)
 {
   TypeParam jerasure;
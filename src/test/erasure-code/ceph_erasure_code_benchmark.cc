@@ -33,6 +33,7 @@
 #include "include/utime.h"
 #include "erasure-code/ErasureCodePlugin.h"
 #include "erasure-code/ErasureCode.h"
+#include "osd/ECUtil.h"
 #include "ceph_erasure_code_benchmark.h"
 
 namespace po = boost::program_options;
@@ -62,6 +63,11 @@ int ErasureCodeBench::setup(int argc, char** argv) {
      " the first chunk, then the second etc.)")
     ("parameter,P", po::value<vector<string> >(),
      "add a parameter to the erasure code profile")
+    ("stripe-width", po::value<int>()->default_value(0),
+     "code the buffer as stripes of this width, the way the OSD does "
+     "(0 codes it as a single stripe)")
+    ("threads,t", po::value<int>()->default_value(0),
+     "with --stripe-width, threads helping to code the stripes")
     ;
 
   po::variables_map vm;
@@ -114,6 +120,8 @@ int ErasureCodeBench::setup(int argc, char** argv) {
   plugin = vm["plugin"].as<string>();
   workload = vm["workload"].as<string>();
   erasures = vm["erasures"].as<int>();
+  stripe_width = vm["stripe-width"].as<int>();
+  threads = vm["threads"].as<int>();
   if (vm.count("erasures-generation") > 0 &&
       vm["erasures-generation"].as<string>() == "exhaustive")
     exhaustive_erasures = true;
@@ -138,6 +146,16 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     return -EINVAL;
   } 
 
+  if (stripe_width < 0 || threads < 0) {
+    cout << "--stripe-width and --threads must be >= 0" << endl;
+    return -EINVAL;
+  }
+  if (stripe_width && in_size % stripe_width) {
+    cout << "--size " << in_size << " is not a multiple of --stripe-width "
+	 << stripe_width << endl;
+    return -EINVAL;
+  }
+
   verbose = vm.count("verbose") > 0 ? true : false;
 
   return 0;
@@ -147,12 +165,89 @@ int ErasureCodeBench::run() {
   ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
   instance.disable_dlclose = true;
 
+  if (stripe_width)
+    return code_stripes();
   if (workload == "encode")
     return encode();
   else
     return decode();
 }
 
+int ErasureCodeBench::code_stripes()
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf().get_val<std::string>("erasure_code_dir"),
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << endl;
+    return code;
+  }
+  if (erasure_code->get_chunk_size(stripe_width) * k != (unsigned)stripe_width) {
+    cerr << "--stripe-width " << stripe_width << " is not a multiple of "
+	 << "the stripe alignment of the plugin" << endl;
+    return -EINVAL;
+  }
+  ECUtil::stripe_info_t sinfo(k, stripe_width);
+  std::unique_ptr<ECUtil::CodecPool> pool;
+  if (threads) {
+    pool.reset(new ECUtil::CodecPool(g_ceph_context, threads));
+  }
+
+  bufferlist in;
+  in.append(string(in_size, 'X'));
+  in.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  set<int> want_to_encode;
+  for (int i = 0; i < k + m; i++) {
+    want_to_encode.insert(i);
+  }
+
+  map<int,bufferlist> encoded;
+  utime_t begin_time = ceph_clock_now();
+  if (workload == "encode") {
+    for (int i = 0; i < max_iterations; i++) {
+      encoded.clear();
+      code = ECUtil::encode(sinfo, erasure_code, in, want_to_encode,
+			    &encoded, pool.get());
+      if (code)
+	return code;
+    }
+  } else {
+    code = ECUtil::encode(sinfo, erasure_code, in, want_to_encode,
+			  &encoded, pool.get());
+    if (code)
+      return code;
+    for (auto i : erased)
+      encoded.erase(i);
+    begin_time = ceph_clock_now();
+    for (int i = 0; i < max_iterations; i++) {
+      map<int,bufferlist> chunks = encoded;
+      if (erased.empty()) {
+	for (int j = 0; j < erasures; j++) {
+	  int erasure;
+	  do {
+	    erasure = rand() % ( k + m );
+	  } while(chunks.count(erasure) == 0);
+	  chunks.erase(erasure);
+	}
+      }
+      bufferlist decoded;
+      code = ECUtil::decode(sinfo, erasure_code, chunks, &decoded, pool.get());
+      if (code)
+	return code;
+      if (verbose && !decoded.contents_equal(in)) {
+	cerr << "decoded content is different" << endl;
+	return -1;
+      }
+    }
+  }
+  utime_t end_time = ceph_clock_now();
+  cout << (end_time - begin_time) << "\t" << (max_iterations * (in_size / 1024)) << endl;
+  return 0;
+}
+
 int ErasureCodeBench::encode()
 {
   ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
@@ -31,6 +31,9 @@ class ErasureCodeBench {
 
   string plugin;
 
+  int stripe_width;
+  int threads;
+
   bool exhaustive_erasures;
   vector<int> erased;
   string workload;
@@ -49,6 +52,7 @@ public:
 		      ErasureCodeInterfaceRef erasure_code);
   int decode();
   int encode();
+  int code_stripes();
 };
 
 #endif
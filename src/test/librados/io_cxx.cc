@@ -203,6 +203,49 @@ TEST_F(LibRadosIoPP, SparseReadOpPP) {
   }
 }
 
+TEST_F(LibRadosIoPP, MultiExtentReadOpPP) {
+  char buf[4096];
+  for (size_t i = 0; i < sizeof(buf); ++i) {
+    buf[i] = i % 251;
+  }
+  bufferlist bl;
+  bl.append(buf, sizeof(buf));
+  ASSERT_EQ(0, ioctx.write("foo", bl, sizeof(buf), 0));
+
+  // overlapping, adjacent, disjoint and trimmed extents in one op,
+  // which the osd may read together
+  std::pair<uint64_t, uint64_t> reads[] = {
+    {0, 100}, {50, 100}, {150, 50}, {1000, 10}, {4000, 200}, {8192, 10}
+  };
+  bufferlist read_bl[std::size(reads)];
+  int rval[std::size(reads)];
+  std::map<uint64_t, uint64_t> extents;
+  bufferlist sparse_bl;
+  int sparse_rval = -1;
+  ObjectReadOperation op;
+  for (size_t i = 0; i < std::size(reads); ++i) {
+    rval[i] = -1;
+    op.read(reads[i].first, reads[i].second, &read_bl[i], &rval[i]);
+  }
+  op.sparse_read(90, 20, &extents, &sparse_bl, &sparse_rval);
+  ASSERT_EQ(0, ioctx.operate("foo", &op, nullptr));
+  for (size_t i = 0; i < std::size(reads); ++i) {
+    ASSERT_EQ(0, rval[i]);
+    uint64_t off = std::min<uint64_t>(reads[i].first, sizeof(buf));
+    uint64_t len = std::min<uint64_t>(reads[i].second, sizeof(buf) - off);
+    ASSERT_EQ(len, read_bl[i].length());
+    ASSERT_EQ(0, memcmp(read_bl[i].c_str(), buf + off, len));
+  }
+  ASSERT_EQ(0, sparse_rval);
+  uint64_t pos = 0;
+  for (auto& [off, len] : extents) {
+    ASSERT_LE(pos + len, sparse_bl.length());
+    ASSERT_EQ(0, memcmp(sparse_bl.c_str() + pos, buf + off, len));
+    pos += len;
+  }
+  ASSERT_EQ(pos, sparse_bl.length());
+}
+
 TEST_F(LibRadosIoPP, RoundTripPP) {
   char buf[128];
   Rados cluster;
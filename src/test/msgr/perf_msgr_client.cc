@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <string>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <iostream>
 
 using namespace std;
@@ -173,6 +174,16 @@ void usage(const string &name) {
   cerr << "       [ios]: how much messages sent for each client" << std::endl;
   cerr << "       [thinktime]: sleep time when do fast dispatching(match client logic)" << std::endl;
   cerr << "       [msg length]: message data bytes" << std::endl;
+  cerr << "  e.g. compare --ms_async_send_zerocopy_min_bytes=0 and =64K" << std::endl;
+  cerr << "  or, with 4K messages, the server's --ms_fast_dispatch_batch_size" << std::endl;
+}
+
+static double cpu_seconds()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+    ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
 }
 
 int main(int argc, char **argv)
@@ -206,15 +217,26 @@ int main(int argc, char **argv)
   cerr << "       ios " << ios << std::endl;
   cerr << "       thinktime(us) " << think_time << std::endl;
   cerr << "       message data bytes " << len << std::endl;
+  cerr << "       zerocopy min bytes "
+       << g_conf().get_val<Option::size_t>("ms_async_send_zerocopy_min_bytes")
+       << std::endl;
 
   MessengerClient client(public_msgr_type, args[0], think_time);
 
   client.ready(concurrent, numjobs, ios, len);
   Cycles::init();
   uint64_t start = Cycles::rdtsc();
+  double start_cpu = cpu_seconds();
   client.start();
   uint64_t stop = Cycles::rdtsc();
-  cerr << " Total op " << ios << " run time " << Cycles::to_microseconds(stop - start) << "us." << std::endl;
+  double cpu = cpu_seconds() - start_cpu;
+  uint64_t us = Cycles::to_microseconds(stop - start);
+  double bytes = (double)numjobs * ios * len;
+  cerr << " Total op " << ios << " run time " << us << "us." << std::endl;
+  cerr << " Throughput " << bytes / us << " MB/s, cpu " << cpu << "s, "
+       << bytes / (1 << 20) / cpu << " MB per cpu second" << std::endl;
+  // with small messages, per message costs dominate
+  cerr << " " << (double)numjobs * ios * 1000000 / us << " ops/s" << std::endl;
 
   return 0;
 }
@@ -19,12 +19,15 @@
 #include <string>
 #include <unistd.h>
 #include <iostream>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 
 #include "common/ceph_argparse.h"
 #include "common/debug.h"
 #include "common/WorkQueue.h"
+#include "common/perf_counters_collection.h"
 #include "global/global_init.h"
 #include "msg/Messenger.h"
 #include "messages/MOSDOp.h"
@@ -99,12 +102,72 @@ class ServerDispatcher : public Dispatcher {
     usleep(think_time);
     //cerr << __func__ << " reply message=" << m << std::endl;
     op_wq.queue(m);
+    batches++;
   }
+  // like the OSD, take the queue lock once per batch
+  void ms_fast_dispatch_batch(std::vector<MessageRef>& ms) override {
+    usleep(think_time);
+    op_wq.lock();
+    for (auto& m : ms) {
+      op_wq._enqueue(m.detach());
+    }
+    op_wq._wake();
+    op_wq.unlock();
+    batches++;
+  }
+  std::atomic<uint64_t> batches = {0};
   int ms_handle_authentication(Connection *con) override {
     return 1;
   }
 };
 
+// sum of a messenger worker counter over all the workers
+static uint64_t get_worker_counter(const string &name)
+{
+  const string suffix = "." + name;
+  uint64_t sum = 0;
+  g_ceph_context->get_perfcounters_collection()->with_counters(
+    [&](const PerfCountersCollectionImpl::CounterMap &by_path) {
+      for (auto& [path, ref] : by_path) {
+	if (path.compare(0, 15, "AsyncMessenger:") == 0 &&
+	    path.size() > suffix.size() &&
+	    path.compare(path.size() - suffix.size(), suffix.size(),
+			 suffix) == 0) {
+	  sum += ref.data->u64;
+	}
+      }
+    });
+  return sum;
+}
+
+// report message rate, dispatch batching and receive buffer allocations
+// per message every few seconds
+static void report_allocations(const ServerDispatcher *dispatcher)
+{
+  const unsigned interval = 5;
+  uint64_t last_msgs = 0, last_allocs = 0, last_reuses = 0, last_batches = 0;
+  while (true) {
+    sleep(interval);
+    uint64_t msgs = get_worker_counter("msgr_recv_messages");
+    uint64_t allocs = get_worker_counter("msgr_recv_buffer_allocs");
+    uint64_t reuses = get_worker_counter("msgr_recv_buffer_reuses");
+    uint64_t batches = dispatcher->batches;
+    if (msgs > last_msgs) {
+      double n = msgs - last_msgs;
+      cerr << " " << msgs - last_msgs << " messages ("
+	   << n / interval << "/s), "
+	   << n / std::max<uint64_t>(batches - last_batches, 1)
+	   << " per dispatch, "
+	   << (allocs - last_allocs) / n << " buffer allocations and "
+	   << (reuses - last_reuses) / n << " reuses per message" << std::endl;
+    }
+    last_msgs = msgs;
+    last_allocs = allocs;
+    last_reuses = reuses;
+    last_batches = batches;
+  }
+}
+
 class MessengerServer {
   Messenger *msgr;
   string type;
@@ -125,6 +188,9 @@ class MessengerServer {
     msgr->shutdown();
     msgr->wait();
   }
+  const ServerDispatcher *get_dispatcher() const {
+    return &dispatcher;
+  }
   void start() {
     entity_addr_t addr;
     addr.parse(bindaddr.c_str());
@@ -171,6 +237,8 @@ int main(int argc, char **argv)
   cerr << "       thinktime(us) " << think_time << std::endl;
 
   MessengerServer server(public_msgr_type, args[0], worker_threads, think_time);
+  std::thread reporter(report_allocations, server.get_dispatcher());
+  reporter.detach();
   server.start();
 
   return 0;
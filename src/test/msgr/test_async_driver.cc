@@ -330,6 +330,31 @@ TEST(EventCenterTest, DispatchTest) {
   worker2.join();
 }
 
+TEST(EventCenterTest, BusyPollDispatchTest) {
+  g_ceph_context->_conf.set_val("ms_async_busy_poll_us", "100");
+  Worker worker(g_ceph_context, 1);
+  g_ceph_context->_conf.set_val("ms_async_busy_poll_us", "0");
+  std::atomic<unsigned> count = { 0 };
+  ceph::mutex lock = ceph::make_mutex("BusyPollDispatchTest::lock");
+  ceph::condition_variable cond;
+  worker.create("worker");
+  for (int i = 0; i < 1000; ++i) {
+    // now and then, let the worker run out of polling and go to sleep
+    if (i % 100 == 0)
+      usleep(1000);
+    count++;
+    worker.center.dispatch_event_external(EventCallbackRef(new CountEvent(&count, &lock, &cond)));
+    std::unique_lock l{lock};
+    // a wakeup lost to the polling would leave us waiting a whole second
+    ASSERT_TRUE(cond.wait_for(l, std::chrono::milliseconds(500), [&] { return count == 0; }));
+  }
+  // stopping must not be lost either
+  auto start = ceph::mono_clock::now();
+  worker.stop();
+  worker.join();
+  ASSERT_GT(std::chrono::milliseconds(500), ceph::mono_clock::now() - start);
+}
+
 INSTANTIATE_TEST_SUITE_P(
   AsyncMessenger,
   EventDriverTest,
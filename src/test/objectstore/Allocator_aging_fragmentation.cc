@@ -10,6 +10,7 @@
 #include <boost/random/triangle_distribution.hpp>
 
 #include "common/ceph_mutex.h"
+#include "common/ceph_time.h"
 #include "common/Cond.h"
 #include "common/errno.h"
 #include "include/stringify.h"
@@ -91,6 +92,8 @@ public:
   uint64_t fragmented = 0;
   uint64_t fragments = 0;
   uint64_t total_fragments = 0;
+  uint64_t alloc_calls = 0;
+  ceph::timespan alloc_time = ceph::timespan::zero();
 
   void do_fill(uint64_t high_mark, std::function<uint32_t()> size_generator, double leak_factor = 0);
   void do_free(uint64_t low_mark);
@@ -105,6 +108,9 @@ struct test_result {
   double fragments_count = 0;
   double time = 0;
   double frag_score = 0;
+  uint64_t alloc_calls = 0;
+  double alloc_time = 0;
+  uint64_t mem_bytes = 0;    ///< max bluestore_alloc mempool usage seen
 };
 
 std::map<std::string, test_result> results_per_allocator;
@@ -189,7 +195,10 @@ void AllocTest::do_fill(uint64_t high_mark, std::function<uint32_t()> size_gener
   {
     uint32_t want = size_generator();
     tmp.clear();
+    auto t0 = ceph::mono_clock::now();
     auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+    alloc_time += ceph::mono_clock::now() - t0;
+    ++alloc_calls;
     if (r < want) {
       break;
     }
@@ -237,6 +246,8 @@ void AllocTest::doAgingTest(
   utime_t start = ceph_clock_now();
   level = 0;
   allocs = 0;
+  alloc_calls = 0;
+  alloc_time = ceph::timespan::zero();
   fragmented = 0;
   fragments = 0;
   total_fragments = 0;
@@ -270,6 +281,7 @@ void AllocTest::doAgingTest(
         " time=" << (ceph_clock_now() - start) * 1000 << "ms" << std::endl;
   }
   double frag_score = alloc->get_fragmentation_score();
+  uint64_t mem_bytes = mempool::bluestore_alloc::allocated_bytes();
   do_free(0);
   double free_frag_score = alloc->get_fragmentation_score();
   ASSERT_EQ(alloc->get_free(), capacity);
@@ -277,7 +289,9 @@ void AllocTest::doAgingTest(
   std::cout << "    fragmented allocs=" << 100.0 * fragmented / allocs << "%" <<
         " #frags=" << ( fragmented != 0 ? double(fragments) / fragmented : 0 ) <<
         " time=" << (ceph_clock_now() - start) * 1000 << "ms" <<
-        " frag.score=" << frag_score << " after free frag.score=" << free_frag_score << std::endl;
+        " frag.score=" << frag_score << " after free frag.score=" << free_frag_score <<
+        " alloc.lat=" << (alloc_calls ? std::chrono::nanoseconds(alloc_time).count() / alloc_calls : 0) << "ns" <<
+        " mem=" << mem_bytes / 1024 << "KiB" << std::endl;
 
   uint64_t sum = 0;
   uint64_t cnt = 0;
@@ -297,6 +311,9 @@ void AllocTest::doAgingTest(
   r.fragments_count += ( fragmented != 0 ? double(fragments) / fragmented : 2 );
   r.time += ceph_clock_now() - start;
   r.frag_score += frag_score;
+  r.alloc_calls += alloc_calls;
+  r.alloc_time += std::chrono::duration<double>(alloc_time).count();
+  r.mem_bytes = std::max(r.mem_bytes, mem_bytes);
 }
 
 void AllocTest::TearDownTestCase() {
@@ -306,7 +323,10 @@ void AllocTest::TearDownTestCase() {
         "    fragmented allocs=" << r.second.fragmented_percent / r.second.tests_cnt << "%" <<
         " #frags=" << r.second.fragments_count / r.second.tests_cnt <<
         " free_score=" << r.second.frag_score / r.second.tests_cnt <<
-        " time=" << r.second.time * 1000 << "ms" << std::endl;
+        " time=" << r.second.time * 1000 << "ms" <<
+        " alloc.lat=" << (r.second.alloc_calls ?
+			  r.second.alloc_time * 1e9 / r.second.alloc_calls : 0) << "ns" <<
+        " max.mem=" << r.second.mem_bytes / 1024 << "KiB" << std::endl;
   }
 }
 
@@ -434,5 +454,5 @@ TEST_P(AllocTest, test_bonus_empty_fragmented)
 INSTANTIATE_TEST_CASE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap", "avl"));
+  ::testing::Values("stupid", "bitmap", "avl", "hybrid"));
 
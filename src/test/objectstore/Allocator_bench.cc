@@ -4,14 +4,17 @@
  * In memory space allocator benchmarks.
  * Author: Igor Fedotov, ifedotov@suse.com
  */
+#include <array>
 #include <iostream>
 #include <boost/scoped_ptr.hpp>
 #include <gtest/gtest.h>
 
+#include "common/ceph_time.h"
 #include "common/Cond.h"
 #include "common/errno.h"
 #include "include/stringify.h"
 #include "include/Context.h"
+#include "include/intarith.h"
 #include "os/bluestore/Allocator.h"
 
 #include <boost/random/uniform_int.hpp>
@@ -21,20 +24,76 @@ typedef boost::mt11213b gen_type;
 #define dout_context g_ceph_context
 #define dout_subsys ceph_subsys_
 
+// log2-bucketed latency histogram, cheap enough to sit in the
+// allocation loop for billions of calls
+class LatencyTracker
+{
+  static constexpr size_t NUM_BUCKETS = 64;
+  std::array<uint64_t, NUM_BUCKETS> buckets = {0};
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+
+public:
+  void add(uint64_t ns) {
+    ++buckets[ns ? cbits(ns) - 1 : 0];
+    ++count;
+    total_ns += ns;
+    max_ns = std::max(max_ns, ns);
+  }
+  // upper bound of the bucket the given percentile falls into
+  uint64_t percentile(double pct) const {
+    uint64_t target = count * pct / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+      seen += buckets[i];
+      if (seen > target) {
+	return std::min(max_ns, (uint64_t(2) << i) - 1);
+      }
+    }
+    return max_ns;
+  }
+  void dump(std::ostream& out) const {
+    out << "allocate() calls " << count
+	<< " avg " << (count ? total_ns / count : 0) << "ns"
+	<< " p50 <" << percentile(50) << "ns"
+	<< " p99 <" << percentile(99) << "ns"
+	<< " p99.9 <" << percentile(99.9) << "ns"
+	<< " max " << max_ns << "ns";
+  }
+};
+
 class AllocTest : public ::testing::TestWithParam<const char*> {
 
 public:
   boost::scoped_ptr<Allocator> alloc;
+  LatencyTracker alloc_lat;
   AllocTest(): alloc(0) { }
   void init_alloc(int64_t size, uint64_t min_alloc_size) {
     std::cout << "Creating alloc type " << string(GetParam()) << " \n";
     alloc.reset(Allocator::create(g_ceph_context, string(GetParam()), size,
 				  min_alloc_size));
+    alloc_lat = LatencyTracker();
   }
 
   void init_close() {
     alloc.reset(0);
   }
+  int64_t timed_allocate(uint64_t want_size, uint64_t alloc_unit,
+			 PExtentVector *extents) {
+    auto t0 = ceph::mono_clock::now();
+    auto r = alloc->allocate(want_size, alloc_unit, 0, 0, extents);
+    alloc_lat.add(std::chrono::nanoseconds(ceph::mono_clock::now() - t0).count());
+    return r;
+  }
+  void report() {
+    std::cout << "Allocator " << GetParam() << ": ";
+    alloc_lat.dump(std::cout);
+    std::cout << ", bluestore_alloc mempool "
+	      << mempool::bluestore_alloc::allocated_bytes() / 1024
+	      << " KiB in " << mempool::bluestore_alloc::allocated_items()
+	      << " items" << std::endl;
+  }
   void doOverwriteTest(uint64_t capacity, uint64_t prefill,
     uint64_t overwrite);
 };
@@ -147,7 +206,7 @@ TEST_P(AllocTest, test_alloc_bench_seq)
   {
     tmp.clear();
     EXPECT_EQ(static_cast<int64_t>(want_size),
-	      alloc->allocate(want_size, alloc_unit, 0, 0, &tmp));
+	      timed_allocate(want_size, alloc_unit, &tmp));
     if (0 == (i % (1 * 1024 * _1m))) {
       std::cout << "alloc " << i / 1024 / 1024 << " mb of "
         << capacity / 1024 / 1024 << std::endl;
@@ -166,6 +225,7 @@ TEST_P(AllocTest, test_alloc_bench_seq)
     }
   }
   std::cout<<"Executed in "<< ceph_clock_now() - start << std::endl;
+  report();
   dump_mempools();
 }
 
@@ -189,7 +249,7 @@ TEST_P(AllocTest, test_alloc_bench)
     uint32_t want = alloc_unit << u1(rng);
 
     tmp.clear();
-    auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+    auto r = timed_allocate(want, alloc_unit, &tmp);
     if (r < want) {
       break;
     }
@@ -220,6 +280,7 @@ TEST_P(AllocTest, test_alloc_bench)
   }
   std::cout<<"Executed in "<< ceph_clock_now() - start << std::endl;
   std::cout<<"Avail "<< alloc->get_free() / _1m << " MB" << std::endl;
+  report();
   dump_mempools();
 }
 
@@ -244,7 +305,7 @@ void AllocTest::doOverwriteTest(uint64_t capacity, uint64_t prefill,
   {
     uint32_t want = alloc_unit << u1(rng);
     tmp.clear();
-    auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+    auto r = timed_allocate(want, alloc_unit, &tmp);
     if (r < want) {
       break;
     }
@@ -279,7 +340,7 @@ void AllocTest::doOverwriteTest(uint64_t capacity, uint64_t prefill,
 
     uint32_t want = alloc_unit << u1(rng);
     tmp.clear();
-    auto r = alloc->allocate(want, alloc_unit, 0, 0, &tmp);
+    auto r = timed_allocate(want, alloc_unit, &tmp);
     if (r != want) {
       std::cout<<"Can't allocate more space, stopping."<< std::endl;
       break;
@@ -299,6 +360,7 @@ void AllocTest::doOverwriteTest(uint64_t capacity, uint64_t prefill,
   std::cout<<"Executed in "<< ceph_clock_now() - start << std::endl;
   std::cout<<"Avail "<< alloc->get_free() / _1m << " MB" << std::endl;
 
+  report();
   dump_mempools();
 }
 
@@ -329,4 +391,4 @@ TEST_P(AllocTest, test_alloc_bench_10_300)
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap", "avl"));
+  ::testing::Values("stupid", "bitmap", "avl", "hybrid"));
@@ -266,9 +266,9 @@ TEST_P(AllocTest, test_alloc_fragmentation)
   }
   EXPECT_EQ(-ENOSPC, alloc->allocate(want_size, alloc_unit, 0, 0, &tmp));
 
-  if (GetParam() == string("avl")) {
+  if (GetParam() == string("avl") || GetParam() == string("hybrid")) {
     // AVL allocator uses a different allocating strategy
-    GTEST_SKIP() << "skipping for AVL allocator";
+    GTEST_SKIP() << "skipping for AVL/hybrid allocator";
   }
 
   for (size_t i = 0; i < allocated.size(); i += 2)
@@ -449,4 +449,4 @@ TEST_P(AllocTest, test_alloc_big3)
 INSTANTIATE_TEST_SUITE_P(
   Allocator,
   AllocTest,
-  ::testing::Values("stupid", "bitmap", "avl"));
+  ::testing::Values("stupid", "bitmap", "avl", "hybrid"));
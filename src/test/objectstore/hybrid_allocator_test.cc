@@ -0,0 +1,168 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <iostream>
+#include <gtest/gtest.h>
+
+#include "global/global_context.h"
+#include "os/bluestore/HybridAllocator.h"
+
+class TestHybridAllocator : public HybridAllocator {
+public:
+  TestHybridAllocator(CephContext* cct,
+                      int64_t device_size,
+                      int64_t _block_size,
+                      uint64_t max_entries,
+      const std::string& name) :
+    HybridAllocator(cct, device_size, _block_size,
+      max_entries * sizeof(range_seg_t),
+      name) {
+  }
+
+  uint64_t get_bmap_free() {
+    return get_bmap() ? get_bmap()->get_free() : 0;
+  }
+  uint64_t get_avl_free() {
+    return AvlAllocator::get_free();
+  }
+};
+
+const uint64_t _1m = 1024 * 1024;
+const uint64_t _4m = 4 * 1024 * 1024;
+
+TEST(HybridAllocator, basic)
+{
+  {
+    uint64_t block_size = 0x1000;
+    uint64_t capacity = 0x10000 * _1m; // = 64GB
+    TestHybridAllocator ha(g_ceph_context, capacity, block_size,
+      4, "test_hybrid_allocator");
+
+    ASSERT_EQ(0u, ha.get_free());
+    ASSERT_EQ(0u, ha.get_avl_free());
+    ASSERT_EQ(0u, ha.get_bmap_free());
+
+    ha.init_add_free(0, _4m);
+    ASSERT_EQ(_4m, ha.get_free());
+    ASSERT_EQ(_4m, ha.get_avl_free());
+    ASSERT_EQ(0u, ha.get_bmap_free());
+
+    ha.init_add_free(2 * _4m, _4m);
+    ASSERT_EQ(_4m * 2, ha.get_free());
+    ASSERT_EQ(_4m * 2, ha.get_avl_free());
+    ASSERT_EQ(0u, ha.get_bmap_free());
+
+    ha.init_add_free(100 * _4m, _4m);
+    ha.init_add_free(102 * _4m, _4m);
+
+    ASSERT_EQ(_4m * 4, ha.get_free());
+    ASSERT_EQ(_4m * 4, ha.get_avl_free());
+    ASSERT_EQ(0u, ha.get_bmap_free());
+
+    // next allocs will go to bitmap
+    ha.init_add_free(4 * _4m, _4m);
+    ASSERT_EQ(_4m * 5, ha.get_free());
+    ASSERT_EQ(_4m * 4, ha.get_avl_free());
+    ASSERT_EQ(_4m * 1, ha.get_bmap_free());
+
+    ha.init_add_free(6 * _4m, _4m);
+    ASSERT_EQ(_4m * 6, ha.get_free());
+    ASSERT_EQ(_4m * 4, ha.get_avl_free());
+    ASSERT_EQ(_4m * 2, ha.get_bmap_free());
+
+    // so we have 6x4M chunks, 4 chunks at AVL and 2 at bitmap
+
+    ha.init_rm_free(_1m, _1m); // take 1M from AVL
+    ASSERT_EQ(_1m * 23, ha.get_free());
+    ASSERT_EQ(_1m * 14, ha.get_avl_free());
+    ASSERT_EQ(_1m * 9, ha.get_bmap_free());
+
+    ha.init_rm_free(6 * _4m + _1m, _1m); // take 1M from bmap
+    ASSERT_EQ(_1m * 22, ha.get_free());
+    ASSERT_EQ(_1m * 14, ha.get_avl_free());
+    ASSERT_EQ(_1m * 8, ha.get_bmap_free());
+
+    // so we have at avl: 2M~2M, 8M~4M, 400M~4M , 408M~4M
+    // and at bmap: 0~1M, 16M~4M, 24M~1M, 26M~2M
+
+    // this doesn't fit into the full AVL tree and goes back to bitmap
+    ha.init_add_free(6 * _4m + _1m, _1m);
+    ASSERT_EQ(_1m * 23, ha.get_free());
+    ASSERT_EQ(_1m * 14, ha.get_avl_free());
+    ASSERT_EQ(_1m * 9, ha.get_bmap_free());
+
+    // this one is merged with its AVL neighbor 2M~2M
+    ha.init_add_free(_1m, _1m);
+    ASSERT_EQ(_1m * 24, ha.get_free());
+    ASSERT_EQ(_1m * 15, ha.get_avl_free());
+    ASSERT_EQ(_1m * 9, ha.get_bmap_free());
+  }
+}
+
+TEST(HybridAllocator, spillover_keeps_largest)
+{
+  uint64_t block_size = 0x1000;
+  uint64_t capacity = 0x10000 * _1m;
+  TestHybridAllocator ha(g_ceph_context, capacity, block_size,
+    2, "test_hybrid_allocator");
+
+  ha.init_add_free(0, _1m);
+  ha.init_add_free(2 * _4m, _4m);
+  ASSERT_EQ(_1m + _4m, ha.get_avl_free());
+  ASSERT_EQ(0u, ha.get_bmap_free());
+
+  // a larger range evicts the shortest one to the bitmap
+  ha.init_add_free(4 * _4m, 2 * _4m);
+  ASSERT_EQ(_4m * 3, ha.get_avl_free());
+  ASSERT_EQ(_1m, ha.get_bmap_free());
+
+  // a shorter one goes straight to the bitmap
+  ha.init_add_free(10 * _4m, _1m);
+  ASSERT_EQ(_4m * 3, ha.get_avl_free());
+  ASSERT_EQ(_1m * 2, ha.get_bmap_free());
+  ASSERT_EQ(_4m * 3 + _1m * 2, ha.get_free());
+
+  uint64_t sum = 0;
+  ha.dump([&](uint64_t offset, uint64_t length) {
+    sum += length;
+  });
+  ASSERT_EQ(ha.get_free(), sum);
+}
+
+TEST(HybridAllocator, allocate_from_both_tiers)
+{
+  uint64_t block_size = 0x1000;
+  uint64_t capacity = 0x10000 * _1m;
+  TestHybridAllocator ha(g_ceph_context, capacity, block_size,
+    2, "test_hybrid_allocator");
+
+  ha.init_add_free(0, _4m);
+  ha.init_add_free(2 * _4m, _4m);
+  ha.init_add_free(4 * _4m, _1m);
+  ha.init_add_free(6 * _4m, _1m);
+  ASSERT_EQ(_4m * 2, ha.get_avl_free());
+  ASSERT_EQ(_1m * 2, ha.get_bmap_free());
+
+  PExtentVector extents;
+  // short requests are served from the bitmap to keep AVL ranges intact
+  EXPECT_EQ(int64_t(_1m), ha.allocate(_1m, block_size, 0, 0, &extents));
+  ASSERT_EQ(1u, extents.size());
+  ASSERT_EQ(_4m * 2, ha.get_avl_free());
+  ASSERT_EQ(_1m, ha.get_bmap_free());
+
+  // everything that is left, spanning both tiers
+  extents.clear();
+  EXPECT_EQ(int64_t(_4m * 2 + _1m),
+	    ha.allocate(_4m * 2 + _1m, block_size, 0, 0, &extents));
+  ASSERT_EQ(0u, ha.get_free());
+
+  extents.clear();
+  EXPECT_EQ(-ENOSPC, ha.allocate(block_size, block_size, 0, 0, &extents));
+  ASSERT_TRUE(extents.empty());
+
+  interval_set<uint64_t> release_set;
+  release_set.insert(0, _4m);
+  ha.release(release_set);
+  ASSERT_EQ(_4m, ha.get_free());
+  ha.shutdown();
+}
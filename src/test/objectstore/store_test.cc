@@ -401,6 +401,55 @@ TEST_P(StoreTest, UnprintableCharsName) {
   }
 }
 
+TEST_P(StoreTest, Digest) {
+  coll_t cid;
+  int r = 0;
+  ghobject_t oid(hobject_t(sobject_t("digest_object", CEPH_NOSNAP)));
+  auto ch = store->create_new_collection(cid);
+  {
+    bufferlist bl;
+    for (unsigned i = 0; i < 256 * 1024; ++i)
+      bl.append((char)(i * 7 + (i >> 12)));
+    bufferlist tail;
+    tail.substr_of(bl, 0, 5000);
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, oid, 0, bl.length(), bl);
+    // leave a hole, and a tail that is not block aligned
+    t.write(cid, oid, 512 * 1024, tail.length(), tail);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  ch.reset();
+  EXPECT_EQ(store->umount(), 0);
+  EXPECT_EQ(store->mount(), 0);
+  ch = store->open_collection(cid);
+
+  const uint32_t flags = CEPH_OSD_OP_FLAG_BYPASS_CLEAN_CACHE;
+  const uint64_t size = 512 * 1024 + 5000;
+  vector<pair<uint64_t, uint64_t>> ranges = {
+    {0, size}, {0, 4096}, {4096, 65536}, {100, 3000}, {4000, 200000},
+    {200000, 400000}, {520000, 100000}, {size, 4096}};
+  for (auto& range : ranges) {
+    for (uint32_t seed : {0u, 0xffffffffu, 0x12345678u}) {
+      bufferlist bl;
+      int rr = store->read(ch, oid, range.first, range.second, bl, flags);
+      uint32_t crc = seed;
+      r = store->digest(ch, oid, range.first, range.second, &crc, flags);
+      ASSERT_EQ(rr, r);
+      ASSERT_EQ(bl.crc32c(seed), crc)
+	<< range.first << "~" << range.second << " seed " << seed;
+    }
+  }
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, oid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTest, FiemapEmpty) {
   coll_t cid;
   int r = 0;
@@ -1081,6 +1130,95 @@ void StoreTest::doCompressionTest()
   }
 }
 
+TEST_P(StoreTestSpecificAUSize, DecompressedBlobCache) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_compression_algorithm", "snappy");
+  SetVal(g_conf(), "bluestore_compression_mode", "force");
+  SetVal(g_conf(), "bluestore_compression_min_blob_size", "65536");
+  SetVal(g_conf(), "bluestore_compression_max_blob_size", "65536");
+  SetVal(g_conf(), "bluestore_default_buffered_read", "false");
+  SetVal(g_conf(), "bluestore_cache_decompressed_blobs", "true");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(4096);
+
+  const size_t block_size = 4096;
+  const size_t blob_size = 65536;
+  const PerfCounters* logger = store->get_perf_counters();
+  int r;
+
+  coll_t cid;
+  ghobject_t hoid(hobject_t("decompressed_cache", "", CEPH_NOSNAP, 0, -1, ""));
+  auto ch = store->create_new_collection(cid);
+  bufferlist data;
+  for (unsigned i = 0; i < blob_size / block_size; ++i) {
+    data.append(std::string(block_size, 'a' + i));
+  }
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    t.write(cid, hoid, 0, data.length(), data);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  // start with a cold cache
+  ch.reset();
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+  ch = store->open_collection(cid);
+
+  auto read_block = [&](unsigned i, uint32_t flags) {
+    bufferlist bl, expected;
+    expected.substr_of(data, i * block_size, block_size);
+    ASSERT_EQ((int)block_size,
+	      store->read(ch, hoid, i * block_size, block_size, bl, flags));
+    ASSERT_TRUE(bl_eq(expected, bl));
+  };
+
+  uint64_t decompressed = logger->get(l_bluestore_decompressed_bytes);
+  uint64_t returned = logger->get(l_bluestore_decompressed_read_bytes);
+  uint64_t hits = logger->get(l_bluestore_decompressed_cache_hit_bytes);
+  read_block(0, 0);
+  ASSERT_EQ(decompressed + blob_size,
+	    logger->get(l_bluestore_decompressed_bytes));
+  ASSERT_EQ(returned + block_size,
+	    logger->get(l_bluestore_decompressed_read_bytes));
+
+  // neighbours come from the cached decompressed blob
+  for (unsigned i = 1; i < 4; ++i) {
+    read_block(i, 0);
+  }
+  ASSERT_EQ(decompressed + blob_size,
+	    logger->get(l_bluestore_decompressed_bytes));
+  ASSERT_EQ(hits + 3 * block_size,
+	    logger->get(l_bluestore_decompressed_cache_hit_bytes));
+
+  // a NOCACHE read does not populate the cache
+  ch.reset();
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+  ch = store->open_collection(cid);
+  decompressed = logger->get(l_bluestore_decompressed_bytes);
+  read_block(0, CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+  read_block(1, CEPH_OSD_OP_FLAG_FADVISE_NOCACHE);
+  ASSERT_EQ(decompressed + 2 * blob_size,
+	    logger->get(l_bluestore_decompressed_bytes));
+
+  {
+    ObjectStore::Transaction t;
+    t.remove(cid, hoid);
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTest, CompressionTest) {
   if (string(GetParam()) != "bluestore")
     return;
@@ -4619,6 +4757,159 @@ TEST_P(StoreTestSpecificAUSize, BlueFSExtenderTest) {
   bstore->mount();
 }
 
+TEST_P(StoreTestSpecificAUSize, AllocSnapshotMountTime) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  // fragment the freelist so that walking it takes a while
+  SetVal(g_conf(), "bluestore_debug_prefill", "0.2");
+  SetVal(g_conf(), "bluestore_debug_prefragment_max", "65536");
+  SetVal(g_conf(), "bluestore_bluefs_balance_interval", "100000");
+  SetVal(g_conf(), "bluestore_alloc_snapshot", "true");
+  g_conf().apply_changes(nullptr);
+
+  StartDeferred(4096);
+  const PerfCounters* logger = store->get_perf_counters();
+
+  // bluestore_alloc_snapshot is read by umount, which saves the snapshot,
+  // and by mount, which loads it
+  auto timed_remount = [&](bool save, store_statfs_t* st, double* secs) {
+    SetVal(g_conf(), "bluestore_alloc_snapshot", save ? "true" : "false");
+    g_conf().apply_changes(nullptr);
+    int r = store->umount();
+    ASSERT_EQ(r, 0);
+    SetVal(g_conf(), "bluestore_alloc_snapshot", "true");
+    g_conf().apply_changes(nullptr);
+    mono_clock::time_point start = mono_clock::now();
+    r = store->mount();
+    ASSERT_EQ(r, 0);
+    *secs = std::chrono::duration<double>(mono_clock::now() - start).count();
+    r = store->statfs(st);
+    ASSERT_EQ(r, 0);
+  };
+
+  store_statfs_t statfs0, statfs1, statfs2, statfs3;
+  int r = store->statfs(&statfs0);
+  ASSERT_EQ(r, 0);
+  uint64_t loads = logger->get(l_bluestore_alloc_snapshot_loads);
+  uint64_t misses = logger->get(l_bluestore_alloc_snapshot_misses);
+
+  // a clean umount saves the snapshot, mount loads it
+  double with_snapshot = 0;
+  timed_remount(true, &statfs1, &with_snapshot);
+  ASSERT_EQ(loads + 1, logger->get(l_bluestore_alloc_snapshot_loads));
+  ASSERT_EQ(misses, logger->get(l_bluestore_alloc_snapshot_misses));
+  ASSERT_EQ(statfs0.available, statfs1.available);
+
+  // the mount above invalidated the snapshot it loaded; without a new one
+  // saved, as after a crash, the next mount walks the freelist
+  double from_freelist = 0;
+  timed_remount(false, &statfs2, &from_freelist);
+  ASSERT_EQ(loads + 1, logger->get(l_bluestore_alloc_snapshot_loads));
+  ASSERT_EQ(misses + 1, logger->get(l_bluestore_alloc_snapshot_misses));
+  ASSERT_EQ(statfs0.available, statfs2.available);
+
+  // and the following clean umount saves a fresh snapshot again
+  double rebuilt = 0;
+  timed_remount(true, &statfs3, &rebuilt);
+  ASSERT_EQ(loads + 2, logger->get(l_bluestore_alloc_snapshot_loads));
+  ASSERT_EQ(misses + 1, logger->get(l_bluestore_alloc_snapshot_misses));
+  ASSERT_EQ(statfs0.available, statfs3.available);
+
+  std::cout << "mount from freelist " << from_freelist << "s"
+	    << ", from allocator snapshot " << with_snapshot << "s"
+	    << std::endl;
+
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(store->fsck(false), 0);
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+}
+
+TEST_P(StoreTest, HotOnodeConcurrentReads) {
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  const unsigned num_objects = 16;
+  const unsigned num_threads = 8;
+  const unsigned ops_per_thread = 20000;
+
+  int r;
+  coll_t cid(spg_t(pg_t(0, 1), shard_id_t::NO_SHARD));
+  auto ch = store->create_new_collection(cid);
+  {
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+  vector<ghobject_t> objects;
+  bufferlist bl;
+  bl.append(std::string(4096, 'a'));
+  for (unsigned i = 0; i < num_objects; ++i) {
+    ghobject_t hoid(hobject_t(sobject_t("hot_onode_" + stringify(i),
+					CEPH_NOSNAP), "", 0, 1, ""));
+    objects.push_back(hoid);
+    ObjectStore::Transaction t;
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+
+  // every read after the first one per object is an onode cache hit
+  vector<vector<uint64_t>> lat(num_threads);
+  std::atomic<unsigned> errors = {0};
+  vector<std::thread> threads;
+  for (unsigned t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      lat[t].reserve(ops_per_thread);
+      for (unsigned i = 0; i < ops_per_thread; ++i) {
+	auto& hoid = objects[(i + t) % num_objects];
+	bufferlist out;
+	mono_clock::time_point start = mono_clock::now();
+	int r = store->read(ch, hoid, 0, 512, out);
+	lat[t].push_back(
+	  std::chrono::nanoseconds(mono_clock::now() - start).count());
+	if (r != 512) {
+	  ++errors;
+	}
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0u, errors.load());
+
+  vector<uint64_t> all;
+  for (auto& v : lat) {
+    all.insert(all.end(), v.begin(), v.end());
+  }
+  std::sort(all.begin(), all.end());
+  auto pct = [&](double p) {
+    return all[std::min<size_t>(all.size() - 1, all.size() * p / 100)];
+  };
+  std::cout << num_threads << " threads, " << all.size()
+	    << " reads of hot objects, latency (ns)"
+	    << " p50 " << pct(50)
+	    << " p90 " << pct(90)
+	    << " p99 " << pct(99)
+	    << " p99.9 " << pct(99.9)
+	    << " max " << all.back()
+	    << std::endl;
+
+  {
+    ObjectStore::Transaction t;
+    for (auto& hoid : objects) {
+      t.remove(cid, hoid);
+    }
+    t.remove_collection(cid);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, SyntheticMatrixSharding) {
   if (string(GetParam()) != "bluestore")
     return;
@@ -6408,6 +6699,78 @@ TEST_P(StoreTestSpecificAUSize, OnodeSizeTracking) {
   }
 }
 
+TEST_P(StoreTestSpecificAUSize, DeferredWriteMerge) {
+
+  if (string(GetParam()) != "bluestore")
+    return;
+
+  SetVal(g_conf(), "bluestore_prefer_deferred_size", "65536");
+  SetVal(g_conf(), "bluestore_deferred_batch_ops", "1000");
+  SetVal(g_conf(), "bluestore_deferred_merge", "true");
+  g_conf().apply_changes(nullptr);
+  StartDeferred(65536);
+
+  const unsigned num_colls = 4;
+  const size_t block_size = 4096;
+  const PerfCounters* logger = store->get_perf_counters();
+
+  int r;
+  vector<coll_t> cids;
+  vector<ObjectStore::CollectionHandle> chs;
+  vector<ghobject_t> hoids;
+  for (unsigned i = 0; i < num_colls; ++i) {
+    coll_t cid(spg_t(pg_t(i, 1), shard_id_t::NO_SHARD));
+    ghobject_t hoid(hobject_t("deferred_merge", "", CEPH_NOSNAP,
+			      i, 1, ""));
+    auto ch = store->create_new_collection(cid);
+    ObjectStore::Transaction t;
+    t.create_collection(cid, 0);
+    bufferlist bl;
+    bl.append(std::string(65536, 'a'));
+    t.write(cid, hoid, 0, bl.length(), bl);
+    r = queue_transaction(store, ch, std::move(t));
+    ASSERT_EQ(r, 0);
+    cids.push_back(cid);
+    chs.push_back(ch);
+    hoids.push_back(hoid);
+  }
+
+  uint64_t merged = logger->get(l_bluestore_deferred_merged_batches);
+  // small overwrites in already allocated space go through the deferred
+  // queue; they stay pending until the queue is flushed below
+  for (unsigned j = 0; j < 4; ++j) {
+    for (unsigned i = 0; i < num_colls; ++i) {
+      ObjectStore::Transaction t;
+      bufferlist bl;
+      bl.append(std::string(block_size, 'b' + i));
+      t.write(cids[i], hoids[i], j * block_size, bl.length(), bl);
+      r = queue_transaction(store, chs[i], std::move(t));
+      ASSERT_EQ(r, 0);
+    }
+  }
+  r = store->umount();
+  ASSERT_EQ(r, 0);
+  ASSERT_LT(merged, logger->get(l_bluestore_deferred_merged_batches));
+  r = store->mount();
+  ASSERT_EQ(r, 0);
+
+  for (unsigned i = 0; i < num_colls; ++i) {
+    chs[i] = store->open_collection(cids[i]);
+    bufferlist bl, expected;
+    expected.append(std::string(4 * block_size, 'b' + i));
+    expected.append(std::string(65536 - 4 * block_size, 'a'));
+    r = store->read(chs[i], hoids[i], 0, 65536, bl);
+    ASSERT_EQ(r, 65536);
+    ASSERT_TRUE(bl_eq(expected, bl));
+
+    ObjectStore::Transaction t;
+    t.remove(cids[i], hoids[i]);
+    t.remove_collection(cids[i]);
+    r = queue_transaction(store, chs[i], std::move(t));
+    ASSERT_EQ(r, 0);
+  }
+}
+
 TEST_P(StoreTestSpecificAUSize, BlobReuseOnOverwrite) {
 
   if (string(GetParam()) != "bluestore")
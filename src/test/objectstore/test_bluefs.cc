@@ -628,6 +628,157 @@ TEST(BlueFS, test_replay) {
   fs.umount();
 }
 
+// aggregate throughput of independent writers, each appending to a file
+// of its own with a flush per append and periodic fsyncs, like RocksDB's
+// WAL and SST writers do
+TEST(BlueFS, test_concurrent_writers_throughput) {
+  uint64_t size = 1048576 * 512;
+  TempBdev bdev{size};
+  g_ceph_context->_conf.set_val(
+    "bluefs_alloc_size",
+    "65536");
+
+  const uint64_t per_thread_bytes = 16 * 1048576;
+  const unsigned append_size = 65536;
+  const unsigned fsync_every = 16;
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(0, fs.mkdir("dir.bench"));
+  for (unsigned num_threads : {1, 2, 4, 8}) {
+    std::vector<std::thread> threads;
+    auto start = ceph::mono_clock::now();
+    for (unsigned t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&fs, t, per_thread_bytes] {
+	BlueFS::FileWriter *h;
+	ASSERT_EQ(0, fs.open_for_write("dir.bench", "file." + stringify(t),
+				       &h, false));
+	std::unique_ptr<char[]> buf = gen_buffer(append_size);
+	for (uint64_t n = 1; n * append_size <= per_thread_bytes; ++n) {
+	  h->append(buf.get(), append_size);
+	  fs.flush(h);
+	  if (n % fsync_every == 0) {
+	    ASSERT_EQ(0, fs.fsync(h));
+	  }
+	}
+	ASSERT_EQ(0, fs.fsync(h));
+	fs.close_writer(h);
+      });
+    }
+    join_all(threads);
+    double secs = std::chrono::duration<double>(
+      ceph::mono_clock::now() - start).count();
+    std::cout << num_threads << " writers: "
+	      << (num_threads * per_thread_bytes / 1048576) / secs
+	      << " MB/s" << std::endl;
+
+    for (unsigned t = 0; t < num_threads; ++t) {
+      uint64_t file_size;
+      utime_t mtime;
+      ASSERT_EQ(0, fs.stat("dir.bench", "file." + stringify(t),
+			   &file_size, &mtime));
+      ASSERT_EQ(per_thread_bytes, file_size);
+      ASSERT_EQ(0, fs.unlink("dir.bench", "file." + stringify(t)));
+    }
+    fs.sync_metadata();
+  }
+  fs.umount();
+}
+
+// fsync latencies of a WAL-like writer while the log is compacted over
+// and over again, with enough files that dumping the metadata matters.
+void compaction_write_latency(bool incremental,
+			      std::vector<ceph::timespan> *lat)
+{
+  uint64_t size = 1048576 * 256;
+  TempBdev bdev{size};
+  g_ceph_context->_conf.set_val(
+    "bluefs_alloc_size",
+    "65536");
+  g_ceph_context->_conf.set_val(
+    "bluefs_compact_log_sync",
+    "false");
+  g_ceph_context->_conf.set_val(
+    "bluefs_compact_log_incremental",
+    incremental ? "true" : "false");
+
+  const unsigned num_files = 20000;
+  const unsigned num_compactions = 20;
+  const uint64_t max_wal_bytes = 64 * 1048576;
+
+  BlueFS fs(g_ceph_context);
+  ASSERT_EQ(0, fs.add_block_device(BlueFS::BDEV_DB, bdev.path, false));
+  fs.add_block_extent(BlueFS::BDEV_DB, 1048576, size - 1048576);
+  uuid_d fsid;
+  ASSERT_EQ(0, fs.mkfs(fsid, { BlueFS::BDEV_DB, false, false }));
+  ASSERT_EQ(0, fs.mount());
+  ASSERT_EQ(0, fs.mkdir("dir.meta"));
+  for (unsigned i = 0; i < num_files; ++i) {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("dir.meta", "file." + stringify(i), &h,
+				   false));
+    fs.close_writer(h);
+  }
+  fs.sync_metadata();
+
+  std::atomic<bool> stop = false;
+  uint64_t written = 0;
+  std::thread writer([&] {
+    BlueFS::FileWriter *h;
+    ASSERT_EQ(0, fs.open_for_write("dir.meta", "wal", &h, false));
+    std::unique_ptr<char[]> buf = gen_buffer(ALLOC_SIZE);
+    while (!stop && written < max_wal_bytes) {
+      auto start = ceph::mono_clock::now();
+      h->append(buf.get(), ALLOC_SIZE);
+      ASSERT_EQ(0, fs.fsync(h));
+      lat->push_back(ceph::mono_clock::now() - start);
+      written += ALLOC_SIZE;
+    }
+    fs.close_writer(h);
+  });
+  for (unsigned i = 0; i < num_compactions; ++i) {
+    fs.compact_log();
+  }
+  stop = true;
+  writer.join();
+  fs.umount();
+
+  // the compacted log, with the writes that raced it, must replay
+  ASSERT_EQ(0, fs.mount());
+  vector<string> ls;
+  ASSERT_EQ(0, fs.readdir("dir.meta", &ls));
+  ASSERT_EQ(num_files + 3, ls.size());  // + wal, ".", ".."
+  uint64_t wal_size;
+  utime_t mtime;
+  ASSERT_EQ(0, fs.stat("dir.meta", "wal", &wal_size, &mtime));
+  ASSERT_EQ(written, wal_size);
+  fs.umount();
+}
+
+TEST(BlueFS, test_compaction_write_latency) {
+  for (bool incremental : {false, true}) {
+    std::vector<ceph::timespan> lat;
+    compaction_write_latency(incremental, &lat);
+    ASSERT_FALSE(lat.empty());
+    std::sort(lat.begin(), lat.end());
+    auto us = [](ceph::timespan t) {
+      return std::chrono::duration_cast<std::chrono::microseconds>(t).count();
+    };
+    std::cout << (incremental ? "incremental" : "locked")
+	      << " compaction: " << lat.size() << " fsyncs"
+	      << ", p50 " << us(lat[lat.size() / 2]) << "us"
+	      << ", p99 " << us(lat[lat.size() * 99 / 100]) << "us"
+	      << ", max " << us(lat.back()) << "us" << std::endl;
+  }
+  g_ceph_context->_conf.set_val(
+    "bluefs_compact_log_incremental",
+    "true");
+}
+
 int main(int argc, char **argv) {
   vector<const char*> args;
   argv_to_vec(argc, (const char **)argv, args);
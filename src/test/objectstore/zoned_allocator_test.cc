@@ -0,0 +1,139 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+#include <iostream>
+#include <thread>
+#include <gtest/gtest.h>
+
+#include "global/global_context.h"
+#include "os/bluestore/ZonedAllocator.h"
+
+const uint64_t _1m = 1024 * 1024;
+const uint64_t _4m = 4 * 1024 * 1024;
+const uint64_t block_size = 0x10000;
+
+// 16 zones of 4M, the first one conventional
+TEST(ZonedAllocator, init_from_freelist)
+{
+  ZonedAllocator za(g_ceph_context, 16 * _4m, block_size, _4m, 1,
+		    "test_zoned_allocator");
+  ASSERT_EQ(0u, za.get_free());
+  ASSERT_EQ(15 * _4m, za.get_capacity());
+
+  // conventional zone is ignored
+  za.init_add_free(0, _4m);
+  ASSERT_EQ(0u, za.get_free());
+
+  // zone 1: tail is writable, free space below the data is garbage
+  za.init_add_free(_4m, _1m);
+  za.init_add_free(_4m + 2 * _1m, 2 * _1m);
+  ASSERT_EQ(2 * _1m, za.get_free());
+  ASSERT_EQ(_1m, za.get_zone_used(1));
+
+  // zones 2..15 are empty
+  za.init_add_free(2 * _4m, 14 * _4m);
+  ASSERT_EQ(2 * _1m + 14 * _4m, za.get_free());
+  ASSERT_EQ(0u, za.get_zone_used(2));
+
+  // something allocated in the middle of zone 3 moves its write pointer
+  za.init_rm_free(3 * _4m + _1m, _1m);
+  ASSERT_EQ(2 * _1m + 14 * _4m - 2 * _1m, za.get_free());
+  ASSERT_EQ(_1m, za.get_zone_used(3));
+
+  // and so does the device
+  za.set_write_pointer(4, _1m + 1);
+  ASSERT_EQ(14 * _4m - _1m - block_size, za.get_free());
+  ASSERT_EQ(0u, za.get_zone_used(4));
+
+  uint64_t sum = 0;
+  za.dump([&](uint64_t offset, uint64_t length) {
+    ASSERT_EQ(0u, (offset + length) % _4m);
+    sum += length;
+  });
+  ASSERT_EQ(za.get_free(), sum);
+}
+
+TEST(ZonedAllocator, append_only)
+{
+  ZonedAllocator za(g_ceph_context, 4 * _4m, block_size, _4m, 1,
+		    "test_zoned_allocator");
+  za.init_add_free(_4m, 3 * _4m);
+  ASSERT_EQ(3 * _4m, za.get_free());
+
+  PExtentVector extents;
+  EXPECT_EQ(int64_t(_1m), za.allocate(_1m, block_size, 0, 0, &extents));
+  ASSERT_EQ(1u, extents.size());
+  ASSERT_EQ(_4m, extents[0].offset);
+
+  // the next allocation of this thread continues right after it
+  EXPECT_EQ(int64_t(_1m), za.allocate(_1m, block_size, 0, 0, &extents));
+  ASSERT_EQ(1u, extents.size());
+  ASSERT_EQ(2 * _1m, extents[0].length);
+
+  // released space is garbage, not free
+  interval_set<uint64_t> release_set;
+  release_set.insert(_4m, _1m);
+  za.release(release_set);
+  ASSERT_EQ(3 * _4m - 2 * _1m, za.get_free());
+  ASSERT_EQ(_1m, za.get_zone_used(1));
+
+  // another thread gets a zone of its own
+  PExtentVector other;
+  std::thread t([&] {
+    EXPECT_EQ(int64_t(_1m), za.allocate(_1m, block_size, 0, 0, &other));
+  });
+  t.join();
+  ASSERT_EQ(1u, other.size());
+  ASSERT_EQ(0u, other[0].offset % _4m);
+  ASSERT_NE(_4m, other[0].offset);
+
+  // allocations spill over into the next zone
+  extents.clear();
+  EXPECT_EQ(int64_t(_4m), za.allocate(_4m, block_size, 0, 0, &extents));
+  ASSERT_EQ(2u, extents.size());
+  ASSERT_EQ(_4m + 2 * _1m, extents[0].offset);
+  ASSERT_EQ(2 * _1m, extents[0].length);
+  za.shutdown();
+}
+
+TEST(ZonedAllocator, clean_and_reset)
+{
+  ZonedAllocator za(g_ceph_context, 4 * _4m, block_size, _4m, 1,
+		    "test_zoned_allocator");
+  // zone 1 is full with 1M live, zone 2 full with 3M live, zone 3 empty
+  za.init_add_free(_4m, 3 * _1m);
+  za.init_add_free(2 * _4m, _1m);
+  za.init_add_free(3 * _4m, _4m);
+  ASSERT_EQ(_4m, za.get_free());
+
+  uint64_t zone = 0, live = 0;
+  std::set<uint64_t> skip;
+  ASSERT_TRUE(za.pick_zone_to_clean(2 * _1m, skip, &zone, &live));
+  ASSERT_EQ(1u, zone);
+  ASSERT_EQ(_1m, live);
+  skip.insert(1);
+  ASSERT_FALSE(za.pick_zone_to_clean(2 * _1m, skip, &zone, &live));
+  ASSERT_TRUE(za.pick_zone_to_clean(_4m, skip, &zone, &live));
+  ASSERT_EQ(2u, zone);
+
+  ASSERT_FALSE(za.claim_empty_zone(&zone));
+  interval_set<uint64_t> release_set;
+  release_set.insert(_4m + 3 * _1m, _1m);
+  za.release(release_set);
+  ASSERT_TRUE(za.claim_empty_zone(&zone));
+  ASSERT_EQ(1u, zone);
+
+  // a claimed zone is never opened for allocation
+  PExtentVector extents;
+  EXPECT_EQ(int64_t(_4m), za.allocate(_4m, block_size, 0, 0, &extents));
+  ASSERT_EQ(1u, extents.size());
+  ASSERT_EQ(3 * _4m, extents[0].offset);
+  extents.clear();
+  EXPECT_EQ(-ENOSPC, za.allocate(block_size, block_size, 0, 0, &extents));
+
+  za.reset_zone(1);
+  ASSERT_EQ(_4m, za.get_free());
+  EXPECT_EQ(int64_t(_1m), za.allocate(_1m, block_size, 0, 0, &extents));
+  ASSERT_EQ(_4m, extents[0].offset);
+  za.shutdown();
+}
@@ -18,6 +18,7 @@
 #include <signal.h>
 #include "osd/ECBackend.h"
 #include "gtest/gtest.h"
+#include "../erasure-code/ErasureCodeExample.h"
 
 TEST(ECUtil, stripe_info_t)
 {
@@ -58,3 +59,127 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+
+TEST(ECUtil, chunk_bounds)
+{
+  const uint64_t swidth = 16384;
+  const uint64_t ssize = 4;
+
+  ECUtil::stripe_info_t s(ssize, swidth);
+  const uint64_t csize = s.get_chunk_size();
+
+  ASSERT_EQ(s.offset_len_to_chunk_bounds(make_pair(csize, csize)),
+	    make_pair(csize, csize));
+  ASSERT_EQ(s.offset_len_to_chunk_bounds(make_pair(csize + 1, (uint64_t)10)),
+	    make_pair(csize, csize));
+  ASSERT_EQ(s.offset_len_to_chunk_bounds(make_pair(csize - 1, (uint64_t)2)),
+	    make_pair((uint64_t)0, 2 * csize));
+  ASSERT_EQ(s.offset_len_to_chunk_bounds(make_pair(swidth - 1, (uint64_t)2)),
+	    make_pair(swidth - csize, 2 * csize));
+
+  ASSERT_EQ(s.offset_len_to_data_chunks(make_pair((uint64_t)0, (uint64_t)0)),
+	    set<int>());
+  ASSERT_EQ(s.offset_len_to_data_chunks(make_pair(csize + 1, (uint64_t)10)),
+	    set<int>({1}));
+  ASSERT_EQ(s.offset_len_to_data_chunks(make_pair(csize - 1, (uint64_t)2)),
+	    set<int>({0, 1}));
+  // wraps into the next stripe
+  ASSERT_EQ(s.offset_len_to_data_chunks(make_pair(swidth - 1, (uint64_t)2)),
+	    set<int>({0, 3}));
+  ASSERT_EQ(s.offset_len_to_data_chunks(make_pair(csize, swidth)),
+	    set<int>({0, 1, 2, 3}));
+}
+
+// Shard bytes read per client byte for small random reads, as
+// ECBackend plans them: whole stripes on each shard read, from every
+// data shard for a full-stripe read, or only from the shards holding
+// the data for a partial-stripe read.
+TEST(ECUtil, partial_stripe_read_bytes)
+{
+  const uint64_t ssize = 4;
+  const uint64_t swidth = ssize * 4096;
+  const uint64_t object_size = 4 << 20;
+  const unsigned reads = 10000;
+
+  ECUtil::stripe_info_t s(ssize, swidth);
+  srand(0);
+  for (uint64_t len : {512ull, 4096ull, 8192ull, 65536ull}) {
+    uint64_t client = 0, full = 0, partial = 0;
+    for (unsigned i = 0; i < reads; ++i) {
+      uint64_t off = rand() % (object_size - len);
+      auto per_shard = s.aligned_offset_len_to_chunk(
+	s.offset_len_to_stripe_bounds(make_pair(off, len))).second;
+      auto chunks = s.offset_len_to_data_chunks(make_pair(off, len));
+      ASSERT_FALSE(chunks.empty());
+      ASSERT_LE(chunks.size(), ssize);
+      client += len;
+      full += ssize * per_shard;
+      partial += chunks.size() * per_shard;
+    }
+    std::cout << "read len " << len
+	      << ": full stripe " << (double)full / client
+	      << ", partial stripe " << (double)partial / client
+	      << " bytes read per client byte" << std::endl;
+    ASSERT_LE(partial, full);
+    if (len <= s.get_chunk_size()) {
+      // a read of at most a chunk touches one or two of the four chunks
+      ASSERT_LE(partial * 2, full);
+    }
+    if (len >= swidth) {
+      // and a read of a whole stripe width touches all of them
+      ASSERT_EQ(partial, full);
+    }
+  }
+}
+
+// Read the second data chunk of a few stripes of a k=2, m=1 object,
+// from its own shard and, with that shard lost, from the other two.
+TEST(ECUtil, decode_chunks)
+{
+  const uint64_t csize = 4096;
+  const uint64_t swidth = 2 * csize;
+  const uint64_t stripes = 3;
+  const uint64_t off = 5 * swidth;
+
+  ECUtil::stripe_info_t s(2, swidth);
+  ErasureCodeInterfaceRef ec_impl(new ErasureCodeExample());
+
+  bufferptr data(stripes * swidth);
+  for (unsigned i = 0; i < data.length(); ++i) {
+    data[i] = rand();
+  }
+  map<int, bufferlist> shards;
+  for (uint64_t stripe = 0; stripe < stripes; ++stripe) {
+    bufferptr parity(csize);
+    for (unsigned i = 0; i < csize; ++i) {
+      parity[i] = data[stripe * swidth + i] ^ data[stripe * swidth + csize + i];
+    }
+    // one buffer per chunk, as ErasureCodeExample wants them
+    shards[0].push_back(bufferptr(data.c_str() + stripe * swidth, csize));
+    shards[1].push_back(
+      bufferptr(data.c_str() + stripe * swidth + csize, csize));
+    shards[2].push_back(parity);
+  }
+
+  auto check = [&](map<int, bufferlist> to_decode) {
+    map<uint64_t, bufferlist> out;
+    ASSERT_EQ(0, ECUtil::decode_chunks(s, ec_impl, off, {1}, to_decode, &out));
+    ASSERT_EQ(stripes, out.size());
+    for (uint64_t stripe = 0; stripe < stripes; ++stripe) {
+      auto chunk = out.find(off + stripe * swidth + csize);
+      ASSERT_NE(out.end(), chunk);
+      bufferlist expected;
+      expected.append(data.c_str() + stripe * swidth + csize, csize);
+      ASSERT_TRUE(expected.contents_equal(chunk->second));
+    }
+  };
+  check({{1, shards[1]}});
+  check({{0, shards[0]}, {2, shards[2]}});
+
+  // a shard returning less than whole chunks is an error, not a short read
+  bufferlist truncated;
+  truncated.substr_of(shards[1], 0, shards[1].length() - 100);
+  map<int, bufferlist> to_decode = {{1, truncated}};
+  map<uint64_t, bufferlist> out;
+  ASSERT_EQ(-EIO, ECUtil::decode_chunks(s, ec_impl, off, {1}, to_decode, &out));
+}
@@ -1,5 +1,8 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 
+#include <algorithm>
+#include <iostream>
+
 #include "gtest/gtest.h"
 
 #include "global/global_context.h"
@@ -32,7 +35,7 @@ public:
   uint64_t client3;
 
   mClockSchedulerTest() :
-    q(g_ceph_context),
+    q(g_ceph_context, 1, false),
     client1(1001),
     client2(9999),
     client3(100000001)
@@ -40,11 +43,20 @@ public:
 
   struct MockDmclockItem : public PGOpQueueable {
     op_scheduler_class scheduler_class;
+    uint32_t qos_delta = 0;
+    uint32_t qos_rho = 0;
 
     MockDmclockItem(op_scheduler_class _scheduler_class) :
       PGOpQueueable(spg_t()),
       scheduler_class(_scheduler_class) {}
 
+    MockDmclockItem(op_scheduler_class _scheduler_class, int64_t pool,
+		    uint32_t delta = 0, uint32_t rho = 0) :
+      PGOpQueueable(spg_t(pg_t(0, pool))),
+      scheduler_class(_scheduler_class),
+      qos_delta(delta),
+      qos_rho(rho) {}
+
     MockDmclockItem()
       : MockDmclockItem(op_scheduler_class::background_best_effort) {}
 
@@ -62,6 +74,10 @@ public:
       return scheduler_class;
     }
 
+    std::pair<uint32_t, uint32_t> get_qos_params() const final {
+      return {qos_delta, qos_rho};
+    }
+
     void run(OSD *osd, OSDShard *sdata, PGRef& pg, ThreadPool::TPHandle &handle) final {}
   };
 };
@@ -77,6 +93,17 @@ OpSchedulerItem create_item(
     utime_t(), owner, e);
 }
 
+template <typename... Args>
+OpSchedulerItem create_item_with_cost(
+  epoch_t e, uint64_t owner, int cost, Args&&... args)
+{
+  return OpSchedulerItem(
+    std::make_unique<mClockSchedulerTest::MockDmclockItem>(
+      std::forward<Args>(args)...),
+    cost, 12,
+    utime_t(), owner, e);
+}
+
 TEST_F(mClockSchedulerTest, TestEmpty) {
   ASSERT_TRUE(q.empty());
 
@@ -154,3 +181,283 @@ TEST_F(mClockSchedulerTest, TestMultiClientOrderedEnqueueDequeue) {
   }
   ASSERT_TRUE(q.empty());
 }
+
+// mClockScheduler on a simulated device that completes one op at a time
+// at a fixed rate.  The dmclock tags use the simulated time, so that a
+// long run of the device takes no time at all.
+class SimulatedDeviceScheduler : public mClockScheduler {
+public:
+  const double capacity;      ///< IO units per second
+  const double bytes_per_io;  ///< bytes costing one more IO unit
+  double now;
+
+  SimulatedDeviceScheduler(double capacity, double bytes_per_io) :
+    mClockScheduler(g_ceph_context, 1, false),
+    capacity(capacity),
+    bytes_per_io(bytes_per_io),
+    now(crimson::dmclock::get_time()) {}
+
+  /// dequeue the next op and run it on the device
+  OpSchedulerItem serve() {
+    auto item = dequeue();
+    now += (1 + (uint64_t)(item.get_cost() / bytes_per_io)) / capacity;
+    return item;
+  }
+
+protected:
+  double get_time() const final {
+    return now;
+  }
+};
+
+// the simulations change the mclock options in g_conf; put them back
+// so that they don't leak into the tests that follow
+class mClockSchedulerSimulation : public testing::Test {
+  static constexpr const char* keys[] = {
+    "osd_mclock_profile",
+    "osd_mclock_max_capacity_iops_ssd",
+    "osd_mclock_max_sequential_bandwidth_ssd",
+    "osd_mclock_calibration_interval",
+    "osd_mclock_scheduler_client_res",
+    "osd_mclock_scheduler_client_wgt",
+    "osd_mclock_scheduler_client_lim",
+  };
+  std::map<std::string, std::string> saved;
+
+public:
+  void SetUp() override {
+    for (auto key : keys) {
+      ASSERT_EQ(0, g_ceph_context->_conf.get_val(key, &saved[key]));
+    }
+  }
+
+  void TearDown() override {
+    auto &conf = g_ceph_context->_conf;
+    for (auto& [key, val] : saved) {
+      conf.set_val(key, val);
+    }
+    conf.apply_changes(nullptr);
+  }
+};
+
+static void set_capacity_config(
+  const std::string &profile,
+  const std::string &iops,
+  const std::string &bandwidth,
+  const std::string &calibration_interval)
+{
+  auto &conf = g_ceph_context->_conf;
+  conf.set_val("osd_mclock_profile", profile);
+  conf.set_val("osd_mclock_max_capacity_iops_ssd", iops);
+  conf.set_val("osd_mclock_max_sequential_bandwidth_ssd", bandwidth);
+  conf.set_val("osd_mclock_calibration_interval", calibration_interval);
+  conf.apply_changes(nullptr);
+}
+
+TEST_F(mClockSchedulerSimulation, ClientLatencyDuringBackfill) {
+  const uint64_t client = 1001;
+  const double capacity = 1000;
+  const int client_op_size = 4096;
+  const int recovery_op_size = 1 << 20;
+  const unsigned recovery_queue_depth = 8;
+  // clients use 30% of the device, backfill would take all of it
+  const double client_interval = 1.0 / 300;
+  const unsigned num_client_ops = 6000;
+
+  for (auto profile : {"high_client_ops", "balanced", "high_recovery_ops"}) {
+    // 64 KiB cost one IO: a 4K client op is one IO unit, a 1M
+    // recovery op is 17
+    set_capacity_config(profile, "1000", "64000000", "0");
+    SimulatedDeviceScheduler q(capacity, 64000);
+    ASSERT_EQ(capacity, q.get_capacity_per_shard());
+
+    std::vector<double> arrival;
+    std::vector<double> latency;
+    unsigned recovery_queued = 0;
+    uint64_t recovery_ops = 0;
+    double start = q.now;
+    double next_client = start;
+    while (latency.size() < num_client_ops) {
+      while (arrival.size() < num_client_ops && next_client <= q.now) {
+	q.enqueue(create_item_with_cost(arrival.size(), client, client_op_size,
+					op_scheduler_class::client));
+	arrival.push_back(next_client);
+	next_client += client_interval;
+      }
+      while (recovery_queued < recovery_queue_depth) {
+	q.enqueue(create_item_with_cost(0, 0, recovery_op_size,
+					op_scheduler_class::background_recovery));
+	++recovery_queued;
+      }
+      auto item = q.serve();
+      if (item.get_scheduler_class() == op_scheduler_class::client) {
+	latency.push_back(q.now - arrival[item.get_map_epoch()]);
+      } else {
+	--recovery_queued;
+	++recovery_ops;
+      }
+    }
+    double elapsed = q.now - start;
+
+    std::sort(latency.begin(), latency.end());
+    double p99 = latency[latency.size() * 99 / 100];
+    double recovery_share = recovery_ops * 17 / capacity / elapsed;
+    std::cout << profile << ": client p99 " << p99 * 1000 << "ms"
+	      << ", max " << latency.back() * 1000 << "ms"
+	      << ", backfill got " << recovery_share * 100
+	      << "% of the device" << std::endl;
+
+    // in FIFO order a client op would wait for the whole backfill queue,
+    // 8 * 17ms.  it should mostly wait for the recovery op that is
+    // already running and a few client ops that arrived with it.
+    EXPECT_LT(p99, 4 * 0.017);
+    // and backfill still gets everything the clients leave over
+    EXPECT_GT(recovery_share, 0.5);
+  }
+}
+
+TEST_F(mClockSchedulerSimulation, CalibrateWhileBacklogged) {
+  const uint64_t client = 1001;
+  // the device is half as fast as configured
+  set_capacity_config("balanced", "1000", "64000000", "1");
+  SimulatedDeviceScheduler q(500, 64000);
+  ASSERT_EQ(1000, q.get_capacity_per_shard());
+
+  epoch_t e = 0;
+  for (unsigned i = 0; i < 16; ++i) {
+    q.enqueue(create_item_with_cost(e++, client, 4096,
+				    op_scheduler_class::client));
+  }
+  // two seconds of backlog at 500 ops/s
+  for (unsigned i = 0; i < 1000; ++i) {
+    q.serve();
+    q.enqueue(create_item_with_cost(e++, client, 4096,
+				    op_scheduler_class::client));
+  }
+  EXPECT_NEAR(500, q.get_capacity_per_shard(), 50);
+
+  // running dry does not count as a measurement
+  while (!q.empty()) {
+    q.serve();
+  }
+  q.now += 10;
+  q.enqueue(create_item_with_cost(e++, client, 4096,
+				  op_scheduler_class::client));
+  q.serve();
+  EXPECT_NEAR(500, q.get_capacity_per_shard(), 50);
+
+  // a new configured capacity replaces the estimate
+  set_capacity_config("balanced", "2000", "64000000", "0");
+  EXPECT_EQ(2000, q.get_capacity_per_shard());
+}
+
+static void set_custom_client_config(
+  const std::string &res,
+  const std::string &wgt,
+  const std::string &lim)
+{
+  auto &conf = g_ceph_context->_conf;
+  conf.set_val("osd_mclock_profile", "custom");
+  conf.set_val("osd_mclock_scheduler_client_res", res);
+  conf.set_val("osd_mclock_scheduler_client_wgt", wgt);
+  conf.set_val("osd_mclock_scheduler_client_lim", lim);
+  conf.set_val("osd_mclock_calibration_interval", "0");
+  conf.apply_changes(nullptr);
+}
+
+TEST_F(mClockSchedulerSimulation, PoolQoS) {
+  // every op costs one IO with the custom profile
+  set_custom_client_config("1", "1", "0");
+  SimulatedDeviceScheduler q(1000, 64000);
+
+  // a client in each pool: a noisy one limited to 100 ops/s, one with
+  // a small weight but 300 ops/s reserved, and one getting the rest
+  const uint64_t limited = 1, reserved = 2, other = 3;
+  std::map<int64_t, pool_qos_t> pools;
+  pools[limited].limit = 100;
+  pools[reserved].reservation = 300;
+  pools[other].weight = 9;
+  q.update_pool_qos(pools);
+
+  std::map<uint64_t, unsigned> queued, served;
+  auto fill = [&] {
+    for (auto client : {limited, reserved, other}) {
+      for (; queued[client] < 16; ++queued[client]) {
+	q.enqueue(create_item(0, client, op_scheduler_class::client,
+			      (int64_t)client));
+      }
+    }
+  };
+  double start = q.now;
+  while (q.now - start < 10) {
+    fill();
+    auto item = q.serve();
+    --queued[item.get_owner()];
+    ++served[item.get_owner()];
+  }
+  double elapsed = q.now - start;
+  for (auto client : {limited, reserved, other}) {
+    std::cout << "client " << client << ": "
+	      << served[client] / elapsed << " ops/s" << std::endl;
+  }
+
+  // the limit holds although the client always has ops queued
+  EXPECT_NEAR(100, served[limited] / elapsed, 10);
+  // with weight 1 against 9 it would get 90 ops/s
+  EXPECT_GT(served[reserved] / elapsed, 300 * 0.95);
+  EXPECT_GT(served[other] / elapsed, 500);
+
+  // unset, the pools fall back to the defaults and share evenly
+  q.update_pool_qos({{limited, {}}, {reserved, {}}, {other, {}}});
+  served.clear();
+  start = q.now;
+  while (q.now - start < 10) {
+    fill();
+    auto item = q.serve();
+    --queued[item.get_owner()];
+    ++served[item.get_owner()];
+  }
+  elapsed = q.now - start;
+  for (auto client : {limited, reserved, other}) {
+    EXPECT_NEAR(1000 / 3.0, served[client] / elapsed, 30);
+  }
+}
+
+TEST_F(mClockSchedulerSimulation, DistributedClients) {
+  set_custom_client_config("1", "1", "0");
+  SimulatedDeviceScheduler q(1000, 64000);
+
+  // the same limit for two clients, but one of them also gets served
+  // by three other OSDs in between, as told by the delta and rho it
+  // sends, and so should get only a quarter of the limit here.  a
+  // third, unlimited client keeps the device busy.
+  const uint64_t local = 1, distributed = 2, filler = 3;
+  const int64_t pool = 1, filler_pool = 2;
+  q.update_pool_qos({{pool, {0, 0, 400}}, {filler_pool, {}}});
+
+  std::map<uint64_t, unsigned> queued, served;
+  double start = q.now;
+  while (q.now - start < 10) {
+    for (; queued[local] < 16; ++queued[local]) {
+      q.enqueue(create_item(0, local, op_scheduler_class::client, pool));
+    }
+    for (; queued[distributed] < 16; ++queued[distributed]) {
+      q.enqueue(create_item(0, distributed, op_scheduler_class::client,
+			    pool, 3, 0));
+    }
+    for (; queued[filler] < 16; ++queued[filler]) {
+      q.enqueue(create_item(0, filler, op_scheduler_class::client,
+			    filler_pool));
+    }
+    auto item = q.serve();
+    --queued[item.get_owner()];
+    ++served[item.get_owner()];
+  }
+  double elapsed = q.now - start;
+  std::cout << "local " << served[local] / elapsed << " ops/s, "
+	    << "distributed " << served[distributed] / elapsed << " ops/s"
+	    << std::endl;
+
+  EXPECT_NEAR(400, served[local] / elapsed, 40);
+  EXPECT_NEAR(100, served[distributed] / elapsed, 20);
+}
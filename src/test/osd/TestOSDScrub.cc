@@ -28,6 +28,8 @@
 #include "mon/MonClient.h"
 #include "common/ceph_argparse.h"
 #include "msg/Messenger.h"
+#include "osd/ScrubStore.h"
+#include "../objectstore/store_test_fixture.h"
 
 class TestOSDScrub: public OSD {
 
@@ -145,6 +147,109 @@ TEST(TestOSDScrub, scrub_time_permit) {
 
 }
 
+class ScrubStoreTest : public StoreTestFixture {
+public:
+  ScrubStoreTest() : StoreTestFixture("memstore") {}
+
+  void SetUp() override {
+    StoreTestFixture::SetUp();
+    pgid = spg_t(pg_t(0, 1));
+    coll = coll_t(pgid);
+    ch = store->create_new_collection(coll);
+    ObjectStore::Transaction t;
+    t.create_collection(coll, 0);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  }
+
+  void TearDown() override {
+    ch.reset();
+    StoreTestFixture::TearDown();
+  }
+
+  void queue(ObjectStore::Transaction &t) {
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+  }
+
+  spg_t pgid;
+  coll_t coll;
+  ObjectStore::CollectionHandle ch;
+};
+
+TEST_F(ScrubStoreTest, progress) {
+  Scrub::progress_t progress;
+  progress.deep = true;
+  progress.epoch = 10;
+  progress.shallow_errors = 1;
+  {
+    ObjectStore::Transaction t;
+    std::unique_ptr<Scrub::Store> s(
+      Scrub::Store::create(store.get(), &t, pgid, coll));
+    s->set_progress(&t, progress);
+    queue(t);
+  }
+  // an interrupted scrub left its progress behind
+  std::unique_ptr<Scrub::Store> s(Scrub::Store::open(store.get(), pgid, coll));
+  ASSERT_TRUE(s);
+  Scrub::progress_t got;
+  ASSERT_TRUE(s->get_progress(&got));
+  EXPECT_TRUE(got.deep);
+  EXPECT_EQ(10u, got.epoch);
+  EXPECT_EQ(1, got.shallow_errors);
+
+  // a scrub that does not resume starts with an empty store
+  {
+    ObjectStore::Transaction t;
+    s.reset(Scrub::Store::create(store.get(), &t, pgid, coll));
+    queue(t);
+  }
+  s.reset(Scrub::Store::open(store.get(), pgid, coll));
+  ASSERT_TRUE(s);
+  EXPECT_FALSE(s->get_progress(&got));
+
+  // a finished scrub leaves nothing to resume
+  {
+    ObjectStore::Transaction t;
+    s->set_progress(&t, progress);
+    queue(t);
+  }
+  s.reset(Scrub::Store::open(store.get(), pgid, coll));
+  ASSERT_TRUE(s->get_progress(&got));
+  {
+    ObjectStore::Transaction t;
+    s->clear_progress(&t);
+    queue(t);
+  }
+  s.reset(Scrub::Store::open(store.get(), pgid, coll));
+  EXPECT_FALSE(s->get_progress(&got));
+}
+
+TEST_F(ScrubStoreTest, remove_without_open_store) {
+  {
+    ObjectStore::Transaction t;
+    std::unique_ptr<Scrub::Store> s(
+      Scrub::Store::create(store.get(), &t, pgid, coll));
+    s->set_progress(&t, Scrub::progress_t());
+    queue(t);
+  }
+  // with resume off or after an interval change, no scrub holds the
+  // store open, but its object goes all the same
+  {
+    ObjectStore::Transaction t;
+    Scrub::Store::remove(&t, pgid, coll);
+    queue(t);
+  }
+  std::unique_ptr<Scrub::Store> s(Scrub::Store::open(store.get(), pgid, coll));
+  EXPECT_FALSE(s);
+  // and removing it when there is none is fine
+  {
+    ObjectStore::Transaction t;
+    Scrub::Store::remove(&t, pgid, coll);
+    queue(t);
+  }
+  s.reset(Scrub::Store::open(store.get(), pgid, coll));
+  EXPECT_FALSE(s);
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_osdscrub ; ./unittest_osdscrub --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
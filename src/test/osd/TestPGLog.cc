@@ -3243,6 +3243,317 @@ TEST_F(PGLogTrimTest, TestCopyAfter2) {
   EXPECT_EQ(7u, copy.dups.size()) << copy;
 }
 
+TEST(PGLogDupIndex, Lookup) {
+  mempool::osd_pglog::list<pg_log_dup_t> dups;
+  PGLog::DupIndex index;
+  entity_name_t client = entity_name_t::CLIENT(777);
+  // enough to go through a few merges of the unsorted tail
+  for (unsigned i = 1; i <= 1000; ++i) {
+    dups.push_back(pg_log_dup_t(eversion_t(1, i), i,
+				osd_reqid_t(client, 8, i), 0));
+    index.insert(&dups.back());
+  }
+  EXPECT_EQ(1000u, index.size());
+  for (auto& d : dups) {
+    ASSERT_EQ(&d, index.find(d.reqid));
+  }
+  EXPECT_EQ(nullptr, index.find(osd_reqid_t(client, 8, 1001)));
+
+  // reqids hashing to the same value are told apart
+  osd_reqid_t a(entity_name_t::CLIENT(1), 0, 2);
+  osd_reqid_t b(entity_name_t::CLIENT(2), 0, 1);
+  ASSERT_EQ(std::hash<osd_reqid_t>()(a), std::hash<osd_reqid_t>()(b));
+  dups.push_back(pg_log_dup_t(eversion_t(1, 1001), 1001, a, 0));
+  index.insert(&dups.back());
+  EXPECT_EQ(nullptr, index.find(b));
+  dups.push_back(pg_log_dup_t(eversion_t(1, 1002), 1002, b, 0));
+  index.insert(&dups.back());
+  EXPECT_EQ(eversion_t(1, 1001), index.find(a)->version);
+  EXPECT_EQ(eversion_t(1, 1002), index.find(b)->version);
+
+  // the most recent dup of a reqid wins
+  dups.push_back(pg_log_dup_t(eversion_t(1, 1003), 1003,
+			      osd_reqid_t(client, 8, 5), 0));
+  index.insert(&dups.back());
+  EXPECT_EQ(eversion_t(1, 1003), index.find(osd_reqid_t(client, 8, 5))->version);
+
+  // trim from the front like IndexedLog::trim()
+  for (unsigned i = 1; i <= 900; ++i) {
+    index.erase(dups.front());
+    dups.pop_front();
+  }
+  EXPECT_EQ(dups.size(), index.size());
+  for (auto& d : dups) {
+    ASSERT_EQ(d.version, index.find(d.reqid)->version);
+  }
+  EXPECT_EQ(nullptr, index.find(osd_reqid_t(client, 8, 1)));
+  EXPECT_EQ(eversion_t(1, 1003), index.find(osd_reqid_t(client, 8, 5))->version);
+
+  index.rebuild(dups);
+  EXPECT_EQ(dups.size(), index.size());
+  for (auto& d : dups) {
+    ASSERT_EQ(d.version, index.find(d.reqid)->version);
+  }
+  index.clear();
+  EXPECT_EQ(0u, index.size());
+  EXPECT_EQ(nullptr, index.find(a));
+}
+
+class PGLogDupsOnDiskTest : protected PGLog, public PGLogTestBase,
+			    public StoreTestFixture {
+public:
+  PGLogDupsOnDiskTest() : PGLog(g_ceph_context), StoreTestFixture("memstore") {}
+
+  void SetUp() override {
+    StoreTestFixture::SetUp();
+    g_ceph_context->_conf.set_val_or_die("osd_pg_log_dups_tracked", "25");
+    dups_on_disk_only = true;
+    ObjectStore::Transaction t;
+    test_coll = coll_t(spg_t(pg_t(1, 1)));
+    ch = store->create_new_collection(test_coll);
+    t.create_collection(test_coll, 0);
+    store->queue_transaction(ch, std::move(t));
+    hobject_t hoid;
+    hoid.pool = 1;
+    hoid.oid = "log";
+    log_oid = ghobject_t(hoid);
+  }
+
+  void TearDown() override {
+    clear();
+    ch.reset();
+    g_ceph_context->_conf.set_val_or_die("osd_pg_log_dups_tracked", "3000");
+    StoreTestFixture::TearDown();
+  }
+
+  static eversion_t mk_ver(unsigned v) {
+    return eversion_t(10 + v / 8, v);
+  }
+  static osd_reqid_t mk_reqid(unsigned v) {
+    return osd_reqid_t(entity_name_t::CLIENT(777), 8, v);
+  }
+
+  // add entries up to version to, then trim the log to trim_to
+  void add_and_trim(unsigned to, unsigned trim_to) {
+    for (unsigned v = log.head.version + 1; v <= to; ++v) {
+      add(mk_ple_mod(mk_obj(v), mk_ver(v), mk_ver(v - 1), mk_reqid(v)));
+    }
+    log.skip_can_rollback_to_to_head();
+    pg_info_t info;
+    info.last_complete = log.head;
+    trim(mk_ver(trim_to), info);
+  }
+
+  // the pg log of another pg, to compare memory use
+  struct OtherPGLog : PGLog {
+    explicit OtherPGLog(bool on_disk_only) : PGLog(g_ceph_context) {
+      dups_on_disk_only = on_disk_only;
+    }
+    void unindex_dups() {
+      log.dup_index.clear();
+      log.indexed_data &= ~PGLOG_INDEXED_DUPS;
+    }
+    void index_dups() {
+      log.index_dups();
+    }
+  };
+
+  void write_to(PGLog &pl, const ghobject_t &oid,
+		ObjectStore::Transaction &t) {
+    map<string, bufferlist> km;
+    pl.write_log_and_missing(t, &km, test_coll, oid, false);
+    if (!km.empty()) {
+      t.omap_setkeys(test_coll, oid, km);
+    }
+  }
+
+  // write the log and wait for the transaction to commit
+  void write(PGLog &pl, const ghobject_t &oid) {
+    ObjectStore::Transaction t;
+    write_to(pl, oid, t);
+    C_SaferCond committed;
+    t.register_on_commit(&committed);
+    ASSERT_EQ(0, store->queue_transaction(ch, std::move(t)));
+    committed.wait();
+  }
+  void write() {
+    write(*this, log_oid);
+  }
+
+  // is the dup of version v in the pg log object?
+  bool on_disk(unsigned v) {
+    pg_log_dup_t key;
+    key.version = mk_ver(v);
+    map<string, bufferlist> values;
+    store->omap_get_values(ch, log_oid, {key.get_key_name()}, &values);
+    return !values.empty();
+  }
+
+  // can a resent op of version v be found on disk?
+  bool found_on_disk(unsigned v) {
+    pg_log_dup_t dup;
+    if (!find_dup_on_disk(store.get(), ch, log_oid, mk_reqid(v), &dup)) {
+      return false;
+    }
+    EXPECT_EQ(mk_ver(v), dup.version);
+    return true;
+  }
+
+  coll_t test_coll;
+  ObjectStore::CollectionHandle ch;
+  ghobject_t log_oid;
+};
+
+TEST_F(PGLogDupsOnDiskTest, TrimAndLookup) {
+  // head 30 tracks dups from 6 on
+  add_and_trim(30, 20);
+  EXPECT_EQ(15u, log.dups.size());
+  write();
+  // dropped from memory on the next write only
+  EXPECT_EQ(15u, log.dups.size());
+  EXPECT_TRUE(on_disk(6));
+  EXPECT_TRUE(on_disk(20));
+  EXPECT_FALSE(on_disk(21));
+  EXPECT_FALSE(found_on_disk(6));
+
+  // head 40 tracks dups from 16 on
+  add_and_trim(40, 30);
+  write();
+  EXPECT_EQ(10u, log.dups.size());
+  EXPECT_EQ(mk_ver(21), log.dups.front().version);
+  EXPECT_FALSE(on_disk(15));
+  EXPECT_TRUE(on_disk(16));
+  EXPECT_TRUE(on_disk(30));
+  EXPECT_FALSE(found_on_disk(15));
+  EXPECT_TRUE(found_on_disk(16));
+  EXPECT_TRUE(found_on_disk(20));
+  EXPECT_FALSE(found_on_disk(21));
+
+  // nothing is kept in memory after a restart
+  clear();
+  pg_info_t info;
+  info.last_update = info.last_complete = mk_ver(40);
+  info.log_tail = mk_ver(30);
+  ostringstream err;
+  read_log_and_missing(store.get(), ch, log_oid, info, err, false);
+  EXPECT_TRUE(log.dups.empty());
+  EXPECT_EQ(10u, log.log.size());
+  eversion_t version;
+  version_t user_version;
+  int return_code;
+  vector<pg_log_op_return_item_t> op_returns;
+  EXPECT_FALSE(log.get_request(mk_reqid(20), &version, &user_version,
+			       &return_code, &op_returns));
+  EXPECT_TRUE(found_on_disk(20));
+  EXPECT_TRUE(found_on_disk(30));
+  EXPECT_TRUE(log.get_request(mk_reqid(35), &version, &user_version,
+			      &return_code, &op_returns));
+
+  // head 50 tracks dups from 26 on, the older ones go from disk
+  add_and_trim(50, 40);
+  write();
+  EXPECT_EQ(10u, log.dups.size());
+  EXPECT_FALSE(on_disk(25));
+  EXPECT_FALSE(found_on_disk(25));
+  EXPECT_TRUE(on_disk(26));
+  EXPECT_TRUE(found_on_disk(26));
+  EXPECT_TRUE(on_disk(40));
+  EXPECT_TRUE(log.get_request(mk_reqid(40), &version, &user_version,
+			      &return_code, &op_returns));
+  EXPECT_EQ(mk_ver(40), version);
+}
+
+TEST_F(PGLogDupsOnDiskTest, KeptUntilCommitted) {
+  add_and_trim(30, 20);
+  ObjectStore::Transaction t1;
+  write_to(*this, log_oid, t1);
+  // t1 is not committed yet, so its dups may not be readable
+  add_and_trim(40, 30);
+  ObjectStore::Transaction t2;
+  write_to(*this, log_oid, t2);
+  EXPECT_EQ(15u, log.dups.size());
+  EXPECT_EQ(mk_ver(16), log.dups.front().version);
+
+  C_SaferCond committed;
+  t2.register_on_commit(&committed);
+  ASSERT_EQ(0, store->queue_transaction(ch, std::move(t1)));
+  ASSERT_EQ(0, store->queue_transaction(ch, std::move(t2)));
+  committed.wait();
+  // both are committed now, so the next write drops their dups
+  write();
+  EXPECT_TRUE(log.dups.empty());
+  EXPECT_FALSE(on_disk(15));
+  EXPECT_TRUE(found_on_disk(16));
+  EXPECT_TRUE(found_on_disk(30));
+}
+
+TEST_F(PGLogDupsOnDiskTest, MemoryManyPGs) {
+  // 200 PGs per OSD, each with the default osd_pg_log_dups_tracked
+  constexpr unsigned num_pgs = 200;
+  constexpr unsigned num_dups = 3000;
+  g_ceph_context->_conf.set_val_or_die("osd_pg_log_dups_tracked",
+				       stringify(num_dups));
+
+  auto build = [&](std::list<OtherPGLog>& pglogs, bool on_disk_only) {
+    for (unsigned pg = 0; pg < num_pgs; ++pg) {
+      pglogs.emplace_back(on_disk_only);
+      auto& pl = pglogs.back();
+      for (unsigned v = 1; v <= num_dups; ++v) {
+	pl.add(mk_ple_mod(mk_obj(v), mk_ver(v), mk_ver(v - 1),
+			  osd_reqid_t(entity_name_t::CLIENT(1000 + v % 64),
+				      0, pg * num_dups + v)));
+      }
+      pl.skip_rollforward();
+      pg_info_t info;
+      info.last_complete = pl.get_head();
+      pl.trim(pl.get_head(), info);
+      EXPECT_EQ(num_dups, pl.get_log().dups.size());
+    }
+  };
+
+  size_t baseline, indexed;
+  {
+    size_t before = mempool::osd_pglog::allocated_bytes();
+    std::list<OtherPGLog> pglogs;
+    build(pglogs, false);
+    // the dups alone, as after a restart before the first lookup
+    for (auto& pl : pglogs) {
+      pl.unindex_dups();
+    }
+    baseline = mempool::osd_pglog::allocated_bytes() - before;
+    for (auto& pl : pglogs) {
+      pl.index_dups();
+    }
+    indexed = mempool::osd_pglog::allocated_bytes() - before;
+  }
+
+  size_t on_disk_only;
+  {
+    size_t before = mempool::osd_pglog::allocated_bytes();
+    std::list<OtherPGLog> pglogs;
+    build(pglogs, true);
+    unsigned pg = 0;
+    for (auto& pl : pglogs) {
+      hobject_t hoid;
+      hoid.pool = 1;
+      hoid.oid = "log_" + stringify(pg++);
+      ghobject_t oid(hoid);
+      write(pl, oid);
+      // drops whatever the first write committed
+      write(pl, oid);
+    }
+    on_disk_only = mempool::osd_pglog::allocated_bytes() - before;
+  }
+
+  std::cout << num_pgs << " pgs x " << num_dups << " dups: osd_pglog "
+	    << baseline << " bytes before indexing, "
+	    << indexed << " bytes indexed, "
+	    << on_disk_only << " bytes on disk only" << std::endl;
+  // a (hash, pointer) pair per dup, nothing else
+  EXPECT_GE(baseline + num_pgs * num_dups * 16, indexed);
+  EXPECT_LT(on_disk_only * 4, baseline);
+}
+
 // Local Variables:
 // compile-command: "cd ../.. ; make unittest_pglog ; ./unittest_pglog --log-to-stderr=true  --debug-osd=20 # --gtest_filter=*.* "
 // End:
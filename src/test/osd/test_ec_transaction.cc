@@ -122,3 +122,63 @@ TEST(ectransaction, many_writes)
   ASSERT_EQ(0u, plan.to_read.size());
   ASSERT_EQ(1u, plan.will_write.size());
 }
+
+TEST(ectransaction, overwrite_skips_covered_chunks)
+{
+  hobject_t h;
+  PGTransactionUPtr t(new PGTransaction);
+  bufferlist a, b;
+  a.append_zero(4096);
+  b.append_zero(200);
+
+  ECUtil::stripe_info_t sinfo(2, 8192);
+  // the second chunk of the second stripe is replaced wholesale
+  t->write(h, 12288, a.length(), a, 0);
+  // the first stripe is only partly written
+  t->write(h, 100, b.length(), b, 0);
+
+  auto plan = ECTransaction::get_write_plan(
+    sinfo,
+    std::move(t),
+    [&](const hobject_t &i) {
+      ECUtil::HashInfoRef ref(new ECUtil::HashInfo(2));
+      ref->set_projected_total_logical_size(sinfo, 32768);
+      return ref;
+    },
+    &dpp);
+  generic_derr << "to_read " << plan.to_read << dendl;
+  generic_derr << "will_write " << plan.will_write << dendl;
+
+  ASSERT_EQ(1u, plan.to_read.size());
+  ASSERT_EQ(12288u, plan.to_read[h].size());
+  ASSERT_TRUE(plan.to_read[h].contains(0, 12288));
+  ASSERT_TRUE(plan.will_write[h].contains(0, 16384));
+}
+
+TEST(ectransaction, overwrite_covering_partial_stripe)
+{
+  hobject_t h;
+  PGTransactionUPtr t(new PGTransaction);
+  bufferlist a;
+  a.append_zero(8192);
+
+  ECUtil::stripe_info_t sinfo(2, 8192);
+  // the unaligned truncate leaves a partial stripe, but the write
+  // replaces all of it
+  t->truncate(h, 10000);
+  t->write(h, 8192, a.length(), a, 0);
+
+  auto plan = ECTransaction::get_write_plan(
+    sinfo,
+    std::move(t),
+    [&](const hobject_t &i) {
+      ECUtil::HashInfoRef ref(new ECUtil::HashInfo(2));
+      ref->set_projected_total_logical_size(sinfo, 32768);
+      return ref;
+    },
+    &dpp);
+  generic_derr << "to_read " << plan.to_read << dendl;
+  generic_derr << "will_write " << plan.will_write << dendl;
+
+  ASSERT_EQ(0u, plan.to_read.size());
+}
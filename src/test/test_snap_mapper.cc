@@ -1,6 +1,9 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 #include <map>
 #include <set>
+#include <atomic>
+#include <chrono>
+#include <iostream>
 #include <boost/scoped_ptr.hpp>
 #include <sys/types.h>
 #include <cstdlib>
@@ -52,6 +55,14 @@ class PausyAsyncMap : public MapCacher::StoreDriver<string, bufferlist> {
       }
     }
   };
+  struct RemoveRange : public _Op {
+    string first, last;
+    RemoveRange(const string &first, const string &last)
+      : first(first), last(last) {}
+    void operate(map<string, bufferlist> *store) override {
+      store->erase(store->lower_bound(first), store->lower_bound(last));
+    }
+  };
   struct Insert : public _Op {
     map<string, bufferlist> to_insert;
     explicit Insert(const map<string, bufferlist> &to_insert) : to_insert(to_insert) {}
@@ -76,12 +87,18 @@ public:
     friend class PausyAsyncMap;
     list<Op> ops;
     list<Op> callbacks;
+    uint64_t removals = 0;
   public:
     void set_keys(const map<string, bufferlist> &i) override {
       ops.push_back(Op(new Insert(i)));
     }
     void remove_keys(const set<string> &r) override {
       ops.push_back(Op(new Remove(r)));
+      removals += r.size();
+    }
+    void remove_range(const string &first, const string &last) override {
+      ops.push_back(Op(new RemoveRange(first, last)));
+      ++removals;
     }
     void add_callback(Context *c) override {
       callbacks.push_back(Op(new Callback(c)));
@@ -195,7 +212,11 @@ public:
       return -ENOENT;
     }
   }
+  /// keys and ranges removed, each one a tombstone in a real store
+  std::atomic<uint64_t> removals = {0};
+
   void submit(Transaction *t) {
+    removals += t->removals;
     doer.submit(t->ops);
     doer.submit(t->callbacks);
   }
@@ -499,7 +520,7 @@ public:
     }
   }
 
-  void trim_snap() {
+  void trim_snap(bool batched = false) {
     std::lock_guard l{lock};
     if (snap_to_hobject.empty())
       return;
@@ -510,6 +531,8 @@ public:
     vector<hobject_t> hoids;
     while (mapper->get_next_objects_to_trim(
 	     snap->first, rand() % 5 + 1, &hoids) == 0) {
+      SnapMapper::Batch batch;
+      PausyAsyncMap::Transaction bt;
       for (auto &&hoid: hoids) {
 	ceph_assert(!hoid.is_max());
 	ceph_assert(hobjects.count(hoid));
@@ -521,7 +544,14 @@ public:
 	set<snapid_t> old_snaps(j->second);
 	j->second.erase(snap->first);
 
-	{
+	if (batched) {
+	  mapper->update_snaps(
+	    hoid,
+	    j->second,
+	    &old_snaps,
+	    &bt,
+	    &batch);
+	} else {
 	  PausyAsyncMap::Transaction t;
 	  mapper->update_snaps(
 	    hoid,
@@ -535,6 +565,10 @@ public:
 	}
 	hoid = hobject_t::get_max();
       }
+      if (batched) {
+	mapper->remove_batched(&batch, &bt);
+	driver->submit(&bt);
+      }
       hoids.clear();
     }
     ceph_assert(hobjects.empty());
@@ -626,7 +660,7 @@ protected:
 	get_tester().create_object();
 	break;
       case 2:
-	get_tester().trim_snap();
+	get_tester().trim_snap(rand() % 2);
 	break;
       case 3:
 	get_tester().check_oid();
@@ -655,3 +689,65 @@ TEST_F(SnapMapperTest, MultiPG) {
   init(50);
   run();
 }
+
+TEST_F(SnapMapperTest, BatchedTrim) {
+  init(1);
+  get_tester().create_snap();
+  for (int i = 0; i < 100; ++i)
+    get_tester().create_object();
+  get_tester().trim_snap(true);
+  get_tester().check_oid();
+}
+
+TEST_F(SnapMapperTest, BatchedTrimThroughput) {
+  const unsigned num_objects = 2000;
+  const unsigned batch_size = 32;
+  uint64_t removals[2];
+  for (int batched = 0; batched < 2; ++batched) {
+    SnapMapper mapper(g_ceph_context, driver.get(), 0, 0, 0, shard_id_t(1));
+    snapid_t snap = 1 + batched;
+    for (unsigned i = 0; i < num_objects; ++i) {
+      hobject_t hoid(random_string(16), "", snap, rand(), 0, "");
+      PausyAsyncMap::Transaction t;
+      mapper.add_oid(hoid, {snap}, &t);
+      driver->submit(&t);
+    }
+    driver->flush();
+
+    uint64_t start_removals = driver->removals;
+    auto start = std::chrono::steady_clock::now();
+    unsigned trimmed = 0;
+    vector<hobject_t> hoids;
+    while (mapper.get_next_objects_to_trim(snap, batch_size, &hoids) == 0) {
+      SnapMapper::Batch batch;
+      PausyAsyncMap::Transaction bt;
+      for (auto &hoid : hoids) {
+	set<snapid_t> old_snaps = {snap};
+	if (batched) {
+	  mapper.update_snaps(hoid, {}, &old_snaps, &bt, &batch);
+	} else {
+	  PausyAsyncMap::Transaction t;
+	  mapper.update_snaps(hoid, {}, &old_snaps, &t);
+	  driver->submit(&t);
+	}
+      }
+      if (batched) {
+	mapper.remove_batched(&batch, &bt);
+	driver->submit(&bt);
+      }
+      trimmed += hoids.size();
+      hoids.clear();
+    }
+    driver->flush();
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+    removals[batched] = driver->removals - start_removals;
+    ASSERT_EQ(num_objects, trimmed);
+    std::cout << (batched ? "batched" : "unbatched") << ": trimmed "
+	      << trimmed << " objects in " << elapsed.count() << "s, "
+	      << trimmed / elapsed.count() << " objects/s, "
+	      << removals[batched] << " removals" << std::endl;
+  }
+  // the object keys still go one by one, the mappings in ranges
+  ASSERT_LT(removals[1], removals[0]);
+}